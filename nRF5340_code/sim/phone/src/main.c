@@ -0,0 +1,381 @@
+/**
+ * @file    main.c
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Simulated phone for the uplink benchmark: connects to the
+ *          board, subscribes the TX characteristic of the data service
+ *          and drives the load generator of the board (RX_CMD_BENCH) for
+ *          every connection interval, PHY and rate of the Kconfig.
+ *          One "#BENCH" JSON line is printed per measurement.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr.h>
+#include <stdlib.h>
+#include <string.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/gatt.h>
+#include <bluetooth/uuid.h>
+#include <sys/byteorder.h>
+
+#include "dataService.h"
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+#define MAX_LIST            16
+
+// latency histogram: 1 ms buckets, the last bucket collects the rest
+#define LATENCY_BUCKETS     512
+
+// time for the queued frames of the board after the stop
+#define DRAIN_MS            1000
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+static struct bt_uuid_128 serviceUuid = BT_UUID_INIT_128(DATA_SERVICE_UUID);
+static struct bt_uuid_128 rxUuid = BT_UUID_INIT_128(RX_CHARACTERISTIC_UUID);
+static struct bt_uuid_128 txUuid = BT_UUID_INIT_128(TX_CHARACTERISTIC_UUID);
+
+static struct bt_conn *conn;
+static K_SEM_DEFINE(stepSem, 0, 1);
+
+// handles of the data service
+static uint16_t rxHandle;
+static uint16_t txHandle;
+static uint16_t txCccHandle;
+static uint16_t serviceEnd;
+
+static struct bt_gatt_discover_params discoverParams;
+static struct bt_gatt_subscribe_params subscribeParams;
+static struct bt_gatt_exchange_params mtuParams;
+
+// statistics of one measurement
+static uint32_t received;
+static uint32_t lost;
+static bool firstFrame;
+static uint16_t nextSequence;
+static uint32_t latencyMaxUs;
+static uint32_t latency[LATENCY_BUCKETS];
+
+/*---------------------------------------------------------------------------
+ * HELPERS
+ *--------------------------------------------------------------------------*/
+// "1,2,3" -> {1, 2, 3}
+static uint8_t parse_list(const char *text, uint16_t *out)
+{
+	uint8_t cnt = 0;
+
+	while (*text != '\0' && cnt < MAX_LIST)
+	{
+		char *end;
+		unsigned long value = strtoul(text, &end, 10);
+
+		if (end == text)
+		{
+			break;
+		}
+		out[cnt++] = (uint16_t) value;
+		text = (*end == ',') ? end + 1 : end;
+	}
+	return cnt;
+}
+
+static uint32_t percentile(uint32_t permille)
+{
+	uint32_t target = (received * permille + 999) / 1000;
+	uint32_t sum = 0;
+
+	for (uint16_t i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		sum += latency[i];
+		if (sum >= target && target != 0)
+		{
+			// upper limit of the bucket
+			return (i + 1) * 1000U;
+		}
+	}
+	return latencyMaxUs;
+}
+
+static void reset_stats(void)
+{
+	received = 0;
+	lost = 0;
+	firstFrame = true;
+	latencyMaxUs = 0;
+	memset(latency, 0, sizeof(latency));
+}
+
+/*---------------------------------------------------------------------------
+ * DATA SERVICE CLIENT
+ *--------------------------------------------------------------------------*/
+static uint8_t on_notify(struct bt_conn *c, struct bt_gatt_subscribe_params *params,
+			 const void *data, uint16_t length)
+{
+	const uint8_t *frame = data;
+	uint32_t now = k_cyc_to_us_floor32(k_cycle_get_32());
+	uint32_t delay;
+	uint16_t sequence;
+
+	if (data == NULL)
+	{
+		return BT_GATT_ITER_STOP;
+	}
+	if (length < 7 || frame[0] != TYPE_BENCH)
+	{
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	sequence = sys_get_le16(&frame[1]);
+	if (!firstFrame)
+	{
+		lost += (uint16_t) (sequence - nextSequence);
+	}
+	firstFrame = false;
+	nextSequence = sequence + 1;
+	received++;
+
+	// board and phone share the simulated time
+	delay = now - sys_get_le32(&frame[3]);
+	latency[MIN(delay / 1000U, LATENCY_BUCKETS - 1)]++;
+	if (delay > latencyMaxUs)
+	{
+		latencyMaxUs = delay;
+	}
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static uint8_t discover_func(struct bt_conn *c, const struct bt_gatt_attr *attr,
+			     struct bt_gatt_discover_params *params)
+{
+	if (attr == NULL)
+	{
+		k_sem_give(&stepSem);
+		return BT_GATT_ITER_STOP;
+	}
+
+	switch (params->type)
+	{
+	case BT_GATT_DISCOVER_PRIMARY:
+		serviceEnd = ((struct bt_gatt_service_val *) attr->user_data)->end_handle;
+		k_sem_give(&stepSem);
+		return BT_GATT_ITER_STOP;
+	case BT_GATT_DISCOVER_CHARACTERISTIC:
+	{
+		struct bt_gatt_chrc *chrc = attr->user_data;
+
+		if (bt_uuid_cmp(chrc->uuid, &rxUuid.uuid) == 0)
+		{
+			rxHandle = chrc->value_handle;
+		}
+		else if (bt_uuid_cmp(chrc->uuid, &txUuid.uuid) == 0)
+		{
+			txHandle = chrc->value_handle;
+		}
+		return BT_GATT_ITER_CONTINUE;
+	}
+	case BT_GATT_DISCOVER_DESCRIPTOR:
+		txCccHandle = attr->handle;
+		k_sem_give(&stepSem);
+		return BT_GATT_ITER_STOP;
+	default:
+		return BT_GATT_ITER_STOP;
+	}
+}
+
+static int discover(uint8_t type, const struct bt_uuid *uuid, uint16_t start, uint16_t end)
+{
+	int err;
+
+	discoverParams.uuid = uuid;
+	discoverParams.func = discover_func;
+	discoverParams.start_handle = start;
+	discoverParams.end_handle = end;
+	discoverParams.type = type;
+	err = bt_gatt_discover(conn, &discoverParams);
+	if (err == 0)
+	{
+		k_sem_take(&stepSem, K_FOREVER);
+	}
+	return err;
+}
+
+static void mtu_exchanged(struct bt_conn *c, uint8_t err, struct bt_gatt_exchange_params *params)
+{
+	k_sem_give(&stepSem);
+}
+
+static int send_bench(uint16_t rate, uint8_t len)
+{
+	uint8_t cmd[4];
+
+	cmd[0] = RX_CMD_BENCH;
+	sys_put_le16(rate, &cmd[1]);
+	cmd[3] = len;
+	return bt_gatt_write_without_response(conn, rxHandle, cmd, sizeof(cmd), false);
+}
+
+/*---------------------------------------------------------------------------
+ * CONNECTION
+ *--------------------------------------------------------------------------*/
+static bool ad_has_service(struct bt_data *data, void *user_data)
+{
+	bool *found = user_data;
+
+	if (data->type == BT_DATA_UUID128_ALL && data->data_len >= 16 &&
+	    memcmp(data->data, serviceUuid.val, 16) == 0)
+	{
+		*found = true;
+		return false;
+	}
+	return true;
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+			 struct net_buf_simple *ad)
+{
+	uint16_t intervals[MAX_LIST];
+	bool found = false;
+
+	bt_data_parse(ad, ad_has_service, &found);
+	if (!found || conn != NULL)
+	{
+		return;
+	}
+
+	parse_list(CONFIG_BENCH_INTERVALS, intervals);
+	bt_le_scan_stop();
+	if (bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN,
+			      BT_LE_CONN_PARAM(intervals[0], intervals[0], 0, 400), &conn))
+	{
+		printk("Connecting failed\n");
+	}
+}
+
+static void connected(struct bt_conn *c, uint8_t err)
+{
+	if (err)
+	{
+		printk("Connection failed (err %u)\n", err);
+		return;
+	}
+	k_sem_give(&stepSem);
+}
+
+static void disconnected(struct bt_conn *c, uint8_t reason)
+{
+	printk("#BENCH {\"error\":\"disconnected\",\"reason\":%u}\n", reason);
+}
+
+static struct bt_conn_cb conn_callbacks = {
+	.connected = connected,
+	.disconnected = disconnected,
+};
+
+/*---------------------------------------------------------------------------
+ * BENCHMARK
+ *--------------------------------------------------------------------------*/
+static int setup(void)
+{
+	int err;
+
+	err = bt_le_scan_start(BT_LE_SCAN_ACTIVE, device_found);
+	if (err)
+	{
+		return err;
+	}
+	k_sem_take(&stepSem, K_FOREVER);
+
+	mtuParams.func = mtu_exchanged;
+	if (bt_gatt_exchange_mtu(conn, &mtuParams) == 0)
+	{
+		k_sem_take(&stepSem, K_FOREVER);
+	}
+
+	discover(BT_GATT_DISCOVER_PRIMARY, &serviceUuid.uuid, 0x0001, 0xffff);
+	discover(BT_GATT_DISCOVER_CHARACTERISTIC, NULL, 0x0001, serviceEnd);
+	discover(BT_GATT_DISCOVER_DESCRIPTOR, BT_UUID_GATT_CCC, txHandle + 1, serviceEnd);
+	if (rxHandle == 0 || txHandle == 0 || txCccHandle == 0)
+	{
+		return -ENOENT;
+	}
+
+	subscribeParams.notify = on_notify;
+	subscribeParams.value = BT_GATT_CCC_NOTIFY;
+	subscribeParams.value_handle = txHandle;
+	subscribeParams.ccc_handle = txCccHandle;
+	return bt_gatt_subscribe(conn, &subscribeParams);
+}
+
+static void measure(uint16_t interval, uint16_t phy, uint16_t rate)
+{
+	uint32_t offered;
+
+	reset_stats();
+	send_bench(rate, CONFIG_BENCH_FRAME_LEN);
+	k_sleep(K_SECONDS(CONFIG_BENCH_STEP_S));
+	send_bench(0, 0);
+	k_sleep(K_MSEC(DRAIN_MS));
+
+	offered = received + lost;
+	printk("#BENCH {\"mtu\":%u,\"phy\":%u,\"interval_us\":%u,\"frame_len\":%u,\"offered_hz\":%u,"
+	       "\"delivered_hz\":%u,\"drop_permille\":%u,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"max_us\":%u}\n",
+	       bt_gatt_get_mtu(conn), phy, interval * 1250U, CONFIG_BENCH_FRAME_LEN, rate,
+	       received / CONFIG_BENCH_STEP_S, offered != 0 ? lost * 1000U / offered : 0,
+	       percentile(500), percentile(900), percentile(990), latencyMaxUs);
+}
+
+void main(void)
+{
+	uint16_t rates[MAX_LIST];
+	uint16_t intervals[MAX_LIST];
+	uint16_t phys[MAX_LIST];
+	uint8_t nbrRates = parse_list(CONFIG_BENCH_RATES, rates);
+	uint8_t nbrIntervals = parse_list(CONFIG_BENCH_INTERVALS, intervals);
+	uint8_t nbrPhys = parse_list(CONFIG_BENCH_PHYS, phys);
+	int err;
+
+	err = bt_enable(NULL);
+	if (err)
+	{
+		printk("Bluetooth init failed (err %d)\n", err);
+		return;
+	}
+	bt_conn_cb_register(&conn_callbacks);
+
+	err = setup();
+	if (err)
+	{
+		printk("#BENCH {\"error\":\"setup\",\"err\":%d}\n", err);
+		return;
+	}
+
+	for (uint8_t i = 0; i < nbrIntervals; i++)
+	{
+		struct bt_le_conn_param param = BT_LE_CONN_PARAM_INIT(intervals[i], intervals[i], 0, 400);
+
+		bt_conn_le_param_update(conn, &param);
+		k_sleep(K_SECONDS(1));
+
+		for (uint8_t p = 0; p < nbrPhys; p++)
+		{
+			bt_conn_le_phy_update(conn, phys[p] == 2 ? BT_CONN_LE_PHY_PARAM_2M : BT_CONN_LE_PHY_PARAM_1M);
+			k_sleep(K_MSEC(500));
+
+			for (uint8_t r = 0; r < nbrRates; r++)
+			{
+				measure(intervals[i], phys[p], rates[r]);
+			}
+		}
+	}
+	printk("#BENCH {\"done\":true}\n");
+}
@@ -0,0 +1,125 @@
+#!/bin/bash
+#
+# Copyright (c) 2021
+#
+# Runs the application (nrf52_bsim build with preset sensor addresses)
+# against a fleet of simulated sensors in BabbleSim and writes the
+# statistics of the run as JSON (tools/sim_report.py).
+#
+# usage: run_fleet.sh <scenario.fleet> [simulated seconds] [output directory]
+#
+# Scenario file, one device per line:
+#   hub info=<1-7> diameter=<code>
+#   sensor <csc_speed|csc_cadence|hrs> <address> [interval=ms] [rpm=n] [hr=bpm]
+#          [rollover=y] [disconnect=s] [service=n] [bas=n] [att=dB] [broadcast=y]
+# The first 3 connected sensors are preset in the board, att is the path
+# loss between the board and the sensor (RSSI profile), default 60 dB.
+# service=n removes the CSC or heart rate service, bas=n the battery service.
+# A sensor with broadcast=y is not connectable, it sends its measurements
+# in the advertising and is allowlisted in the board (CONFIG_APP_ADV_INGEST).
+#
+# Requires ZEPHYR_BASE, BSIM_OUT_PATH and BSIM_COMPONENTS_PATH (BabbleSim)
+# and west.
+#
+
+set -e
+
+SCENARIO=$1
+SIM_SECONDS=${2:-60}
+OUT=${3:-$(pwd)/fleet_out}
+APP_DIR=$(cd "$(dirname "$0")/.." && pwd)
+SIM_ID=fleet_$$
+
+if [ -z "$SCENARIO" ] || [ ! -f "$SCENARIO" ]; then
+	echo "usage: $0 <scenario.fleet> [simulated seconds] [output directory]"
+	exit 1
+fi
+: "${ZEPHYR_BASE:?}" "${BSIM_OUT_PATH:?}" "${BSIM_COMPONENTS_PATH:?}"
+
+mkdir -p "$OUT"
+
+HUB_INFO=4
+HUB_DIAMETER=56
+SENSORS=()
+while read -r kind rest; do
+	case "$kind" in
+	hub)
+		for kv in $rest; do
+			case "$kv" in
+			info=*) HUB_INFO=${kv#info=} ;;
+			diameter=*) HUB_DIAMETER=${kv#diameter=} ;;
+			esac
+		done
+		;;
+	sensor)
+		SENSORS+=("$rest")
+		;;
+	esac
+done < <(grep -v '^\s*#' "$SCENARIO")
+
+# build the sensors, collect the addresses and the attenuations
+PRESET=""
+NBR_PRESET=0
+ALLOWLIST=""
+ATT_FILE=$OUT/attenuation.txt
+: > "$ATT_FILE"
+for i in "${!SENSORS[@]}"; do
+	set -- ${SENSORS[$i]}
+	profile=$1
+	address=$2
+	shift 2
+	args=(-DCONFIG_SIM_SENSOR_ADDRESS=\"$address\")
+	case "$profile" in
+	csc_speed) args+=(-DCONFIG_SIM_SENSOR_CSC_SPEED=y) ;;
+	csc_cadence) args+=(-DCONFIG_SIM_SENSOR_CSC_CADENCE=y) ;;
+	hrs) args+=(-DCONFIG_SIM_SENSOR_HRS=y) ;;
+	*) echo "unknown profile $profile"; exit 1 ;;
+	esac
+	att=60
+	broadcast=n
+	for kv in "$@"; do
+		case "$kv" in
+		interval=*) args+=(-DCONFIG_SIM_NOTIFY_INTERVAL_MS=${kv#*=}) ;;
+		rpm=*) args+=(-DCONFIG_SIM_REVS_PER_MIN=${kv#*=}) ;;
+		hr=*) args+=(-DCONFIG_SIM_HEART_RATE=${kv#*=}) ;;
+		rollover=*) args+=(-DCONFIG_SIM_ROLLOVER=${kv#*=}) ;;
+		disconnect=*) args+=(-DCONFIG_SIM_DISCONNECT_PERIOD_S=${kv#*=}) ;;
+		service=*) args+=(-DCONFIG_SIM_PROFILE_SERVICE=${kv#*=}) ;;
+		bas=*) args+=(-DCONFIG_SIM_BAS=${kv#*=}) ;;
+		att=*) att=${kv#*=} ;;
+		broadcast=*) broadcast=${kv#*=}; args+=(-DCONFIG_SIM_BROADCAST=$broadcast) ;;
+		esac
+	done
+	if [ "$broadcast" = "y" ]; then
+		ALLOWLIST=${ALLOWLIST:+$ALLOWLIST,}$address
+	elif [ "$NBR_PRESET" -lt 3 ]; then
+		PRESET=${PRESET:+$PRESET,}$address
+		NBR_PRESET=$((NBR_PRESET + 1))
+	fi
+	# device 0 is the board
+	echo "0 $((i + 1)) : $att" >> "$ATT_FILE"
+	west build -p auto -b nrf52_bsim -d "$OUT/sensor_$i" "$APP_DIR/sim/sensor" -- "${args[@]}" > "$OUT/build_sensor_$i.log"
+done
+
+HUB_ARGS=()
+if [ -n "$ALLOWLIST" ]; then
+	HUB_ARGS+=(-DCONFIG_APP_ADV_INGEST=y -DCONFIG_APP_ADV_INGEST_ALLOWLIST=\"$ALLOWLIST\")
+fi
+
+west build -p auto -b nrf52_bsim -d "$OUT/hub" "$APP_DIR" -- "${HUB_ARGS[@]}" \
+	-DCONFIG_APP_SENSOR_PRESET=\"$PRESET\" \
+	-DCONFIG_APP_SENSOR_PRESET_INFO=$HUB_INFO \
+	-DCONFIG_APP_SENSOR_PRESET_DIAMETER=$HUB_DIAMETER > "$OUT/build_hub.log"
+
+# run the simulation
+DEVICES=$((${#SENSORS[@]} + 1))
+cd "$BSIM_OUT_PATH/bin"
+./bs_2G4_phy_v1 -s=$SIM_ID -D=$DEVICES -sim_length=${SIM_SECONDS}e6 \
+	-channel=multiatt -argschannel -at=60 -file="$ATT_FILE" > "$OUT/phy.log" 2>&1 &
+"$OUT/hub/zephyr/zephyr.exe" -s=$SIM_ID -d=0 > "$OUT/hub.log" 2>&1 &
+for i in "${!SENSORS[@]}"; do
+	"$OUT/sensor_$i/zephyr/zephyr.exe" -s=$SIM_ID -d=$((i + 1)) > "$OUT/sensor_$i.log" 2>&1 &
+done
+wait
+
+python3 "$APP_DIR/tools/sim_report.py" "$OUT/hub.log" "$OUT"/sensor_*.log | tee "$OUT/report.json"
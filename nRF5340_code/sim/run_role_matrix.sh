@@ -0,0 +1,101 @@
+#!/bin/bash
+#
+# Copyright (c) 2021
+#
+# Build matrix of the role variants (CONFIG_APP_ROLE_*): builds every
+# variant for the board and reports the used flash and RAM, then runs the
+# nrf52_bsim build of the variant alone in BabbleSim and reports the boot
+# time ("Ready after ... us", simulated time from reset until the roles
+# are advertising/scanning).
+#
+# usage: run_role_matrix.sh [output directory]
+#
+# Environment (optional): BOARD=nrf5340dk_nrf5340_cpuappns
+#                         VARIANTS="hybrid central central_diag peripheral"
+# central_diag is the central only image with the diagnostic shell
+# (overlay-diag-shell.conf).
+# Requires west, the boot time also ZEPHYR_BASE, BSIM_OUT_PATH and
+# BSIM_COMPONENTS_PATH (BabbleSim), without them it is reported as null.
+#
+# Every variant is one JSON line in <output directory>/roles.jsonl.
+# The script fails if a variant does not link or links the code of a role
+# it does not have: a peripheral only image without scanning, GATT
+# discovery and BAS client, a central only image without the data,
+# diagnostic and CSC GATT services.
+#
+
+set -e
+
+OUT=${1:-$(pwd)/roles_out}
+APP_DIR=$(cd "$(dirname "$0")/.." && pwd)
+BOARD=${BOARD:-nrf5340dk_nrf5340_cpuappns}
+VARIANTS=${VARIANTS:-"hybrid central central_diag peripheral"}
+FIRMWARE=$(git -C "$APP_DIR" describe --always --dirty 2>/dev/null || echo unknown)
+
+# used bytes of a memory region in the linker summary of the build log
+region() { awk -v r="$1:" '$1 == r { v = $2; if ($3 == "KB") v *= 1024; print v; exit }' "$2"; }
+
+# Kconfig options which must be off and symbols which must not be linked
+# in the image of a role variant, fails with the first one found
+check_role() {
+	local variant=$1 dir=$2 options symbols nm
+	case "$variant" in
+	peripheral)
+		options="CONFIG_BT_SCAN CONFIG_BT_GATT_DM CONFIG_BT_BAS_CLIENT CONFIG_BT_CENTRAL"
+		symbols="bt_scan_init bt_gatt_dm_start bt_bas_client_init"
+		;;
+	central|central_diag)
+		options="CONFIG_BT_PERIPHERAL"
+		symbols="data_service diag_service csc_srv"
+		;;
+	*)
+		return 0
+		;;
+	esac
+	for option in $options; do
+		if grep -q "^$option=y" "$dir/zephyr/.config"; then
+			echo "$variant: $option is enabled"
+			exit 1
+		fi
+	done
+	nm=$(sed -n 's/^CMAKE_NM:FILEPATH=//p' "$dir/CMakeCache.txt")
+	for symbol in $symbols; do
+		if "${nm:-nm}" "$dir/zephyr/zephyr.elf" | awk '{ print $NF }' | grep -qx "$symbol"; then
+			echo "$variant: $symbol is linked"
+			exit 1
+		fi
+	done
+}
+
+mkdir -p "$OUT"
+: > "$OUT/roles.jsonl"
+
+for variant in $VARIANTS; do
+	role=(-DCONFIG_APP_ROLE_$(echo "${variant%_diag}" | tr a-z A-Z)=y)
+	if [ "$variant" != "${variant%_diag}" ]; then
+		role+=(-DOVERLAY_CONFIG=overlay-diag-shell.conf)
+	fi
+
+	west build -p auto -b "$BOARD" -d "$OUT/${variant}_board" "$APP_DIR" -- "${role[@]}" > "$OUT/build_$variant.log"
+	check_role "$variant" "$OUT/${variant}_board"
+	flash=$(region FLASH "$OUT/build_$variant.log")
+	ram=$(region SRAM "$OUT/build_$variant.log")
+
+	boot=null
+	if [ -n "$BSIM_OUT_PATH" ]; then
+		west build -p auto -b nrf52_bsim -d "$OUT/${variant}_bsim" "$APP_DIR" -- "${role[@]}" > "$OUT/build_${variant}_bsim.log"
+		SIM_ID=roles_$$_$variant
+		(
+			cd "$BSIM_OUT_PATH/bin"
+			./bs_2G4_phy_v1 -s=$SIM_ID -D=1 -sim_length=2e6 > "$OUT/phy_$variant.log" 2>&1 &
+			"$OUT/${variant}_bsim/zephyr/zephyr.exe" -s=$SIM_ID -d=0 > "$OUT/boot_$variant.log" 2>&1 &
+			wait
+		)
+		boot=$(sed -n 's/.*Ready after \([0-9]*\) us.*/\1/p' "$OUT/boot_$variant.log" | head -n 1)
+		boot=${boot:-null}
+	fi
+
+	echo "{\"firmware\":\"$FIRMWARE\",\"variant\":\"$variant\",\"board\":\"$BOARD\",\"flash\":${flash:-null},\"ram\":${ram:-null},\"boot_us\":$boot}" >> "$OUT/roles.jsonl"
+done
+
+cat "$OUT/roles.jsonl"
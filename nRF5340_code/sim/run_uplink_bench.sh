@@ -0,0 +1,75 @@
+#!/bin/bash
+#
+# Copyright (c) 2021
+#
+# Uplink benchmark in BabbleSim: the simulated phone (sim/phone) connects
+# to the application, subscribes the TX characteristic and measures the
+# delivered rate, the drops and the latency percentiles for every
+# connection interval, PHY and offered load. The ATT MTU is set per build,
+# the frames of the board fill the MTU.
+#
+# usage: run_uplink_bench.sh [output directory]
+#
+# Environment (optional): MTUS="23 65 247" RATES="10,20,50" INTERVALS="6,12,24"
+#                         PHYS="1,2" STEP_S=10
+# Requires ZEPHYR_BASE, BSIM_OUT_PATH and BSIM_COMPONENTS_PATH (BabbleSim)
+# and west.
+#
+# Every measurement is one JSON line in <output directory>/bench.jsonl,
+# tagged with the firmware version (git describe) for comparisons.
+#
+
+set -e
+
+OUT=${1:-$(pwd)/bench_out}
+APP_DIR=$(cd "$(dirname "$0")/.." && pwd)
+MTUS=${MTUS:-"23 65 247"}
+RATES=${RATES:-"10,20,50,100,200,400,800"}
+INTERVALS=${INTERVALS:-"6,12,24,40"}
+PHYS=${PHYS:-"1,2"}
+STEP_S=${STEP_S:-10}
+FIRMWARE=$(git -C "$APP_DIR" describe --always --dirty 2>/dev/null || echo unknown)
+
+: "${ZEPHYR_BASE:?}" "${BSIM_OUT_PATH:?}" "${BSIM_COMPONENTS_PATH:?}"
+
+count() { echo "$1" | tr ',' '\n' | grep -c .; }
+MEASUREMENTS=$(( $(count "$RATES") * $(count "$INTERVALS") * $(count "$PHYS") ))
+# each measurement: step + 1 s drain, 1.5 s per interval and PHY change, 10 s connection setup
+SIM_SECONDS=$(( MEASUREMENTS * (STEP_S + 1) + $(count "$INTERVALS") * $(count "$PHYS") * 2 + 10 ))
+
+mkdir -p "$OUT"
+: > "$OUT/bench.jsonl"
+
+for mtu in $MTUS; do
+	len=$((mtu - 3))
+	west build -p auto -b nrf52_bsim -d "$OUT/board_$mtu" "$APP_DIR" -- \
+		-DCONFIG_APP_UPLINK_BENCH=y \
+		-DCONFIG_APP_UPLINK_FRAME_SIZE=$len \
+		-DCONFIG_BT_L2CAP_TX_MTU=$mtu \
+		-DCONFIG_BT_CTLR_DATA_LENGTH_MAX=251 > "$OUT/build_board_$mtu.log"
+	west build -p auto -b nrf52_bsim -d "$OUT/phone_$mtu" "$APP_DIR/sim/phone" -- \
+		-DCONFIG_BENCH_RATES=\"$RATES\" \
+		-DCONFIG_BENCH_INTERVALS=\"$INTERVALS\" \
+		-DCONFIG_BENCH_PHYS=\"$PHYS\" \
+		-DCONFIG_BENCH_STEP_S=$STEP_S \
+		-DCONFIG_BENCH_FRAME_LEN=$len > "$OUT/build_phone_$mtu.log"
+
+	SIM_ID=bench_$$_$mtu
+	(
+		cd "$BSIM_OUT_PATH/bin"
+		./bs_2G4_phy_v1 -s=$SIM_ID -D=2 -sim_length=${SIM_SECONDS}e6 > "$OUT/phy_$mtu.log" 2>&1 &
+		"$OUT/board_$mtu/zephyr/zephyr.exe" -s=$SIM_ID -d=0 > "$OUT/board_$mtu.log" 2>&1 &
+		"$OUT/phone_$mtu/zephyr/zephyr.exe" -s=$SIM_ID -d=1 > "$OUT/phone_$mtu.log" 2>&1 &
+		wait
+	)
+
+	# "#BENCH {...}" -> {"firmware":"...",...}, with the frames which were
+	# still queued or dropped in the board when the measurement stopped
+	# ("#BENCH_BOARD {...}", one line per measurement in the same order)
+	sed -n 's/.*#BENCH {\(.*\)}.*/{"firmware":"'"$FIRMWARE"'",\1}/p' "$OUT/phone_$mtu.log" > "$OUT/phone_$mtu.jsonl"
+	sed -n 's/.*#BENCH_BOARD {\(.*\)}.*/"board":{\1}}/p' "$OUT/board_$mtu.log" > "$OUT/board_$mtu.jsonl"
+	paste -d, <(grep '"offered_hz"' "$OUT/phone_$mtu.jsonl" | sed 's/}$//') "$OUT/board_$mtu.jsonl" >> "$OUT/bench.jsonl"
+	grep -v '"offered_hz"' "$OUT/phone_$mtu.jsonl" >> "$OUT/bench.jsonl" || true
+done
+
+cat "$OUT/bench.jsonl"
@@ -0,0 +1,90 @@
+#include "CscService.h"
+
+#include <errno.h>
+#include <bluetooth/gatt.h>
+#include <bluetooth/uuid.h>
+#include <sys/byteorder.h>
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+static bool notificationsEnabled;
+
+#if defined(CONFIG_SIM_PROFILE_SERVICE)
+
+#if defined(CONFIG_SIM_SENSOR_CSC_SPEED)
+static const uint16_t features = CSC_WHEEL_REV_PRESENT;
+#else
+static const uint16_t features = CSC_CRANK_REV_PRESENT;
+#endif
+
+static void ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	notificationsEnabled = (value == BT_GATT_CCC_NOTIFY);
+}
+
+static ssize_t read_features(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			     void *buf, uint16_t len, uint16_t offset)
+{
+	uint16_t value = sys_cpu_to_le16(features);
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &value, sizeof(value));
+}
+
+BT_GATT_SERVICE_DEFINE(csc_service,
+BT_GATT_PRIMARY_SERVICE(BT_UUID_CSC),
+BT_GATT_CHARACTERISTIC(BT_UUID_CSC_MEASUREMENT, BT_GATT_CHRC_NOTIFY,
+		       BT_GATT_PERM_NONE, NULL, NULL, NULL),
+BT_GATT_CCC(ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+BT_GATT_CHARACTERISTIC(BT_UUID_CSC_FEATURE, BT_GATT_CHRC_READ,
+		       BT_GATT_PERM_READ, read_features, NULL, NULL),
+);
+#endif
+
+bool csc_notifications_enabled(void)
+{
+	return notificationsEnabled;
+}
+
+uint8_t csc_encode_wheel(uint8_t *buf, uint32_t revs, uint16_t eventTime)
+{
+	buf[0] = CSC_WHEEL_REV_PRESENT;
+	sys_put_le32(revs, &buf[1]);
+	sys_put_le16(eventTime, &buf[5]);
+	return 7;
+}
+
+uint8_t csc_encode_crank(uint8_t *buf, uint16_t revs, uint16_t eventTime)
+{
+	buf[0] = CSC_CRANK_REV_PRESENT;
+	sys_put_le16(revs, &buf[1]);
+	sys_put_le16(eventTime, &buf[3]);
+	return 5;
+}
+
+#if defined(CONFIG_SIM_PROFILE_SERVICE)
+int csc_notify_wheel(uint32_t revs, uint16_t eventTime)
+{
+	uint8_t buf[CSC_MEASUREMENT_MAX_LEN];
+
+	return bt_gatt_notify(NULL, &csc_service.attrs[1], buf, csc_encode_wheel(buf, revs, eventTime));
+}
+
+int csc_notify_crank(uint16_t revs, uint16_t eventTime)
+{
+	uint8_t buf[CSC_MEASUREMENT_MAX_LEN];
+
+	return bt_gatt_notify(NULL, &csc_service.attrs[1], buf, csc_encode_crank(buf, revs, eventTime));
+}
+#else
+// no service, the client never subscribes
+int csc_notify_wheel(uint32_t revs, uint16_t eventTime)
+{
+	return -ENOTSUP;
+}
+
+int csc_notify_crank(uint16_t revs, uint16_t eventTime)
+{
+	return -ENOTSUP;
+}
+#endif
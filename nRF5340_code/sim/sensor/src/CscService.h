@@ -0,0 +1,77 @@
+/**
+ * @file    CscService.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Minimal cycling speed and cadence service of the simulated
+ *          sensor: measurement (notify) and feature characteristic
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef CSC_SERVICE_H_
+#define CSC_SERVICE_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+#include <bluetooth/conn.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// flags of the measurement, also the feature bits
+#define CSC_WHEEL_REV_PRESENT   0x01
+#define CSC_CRANK_REV_PRESENT   0x02
+
+// longest measurement: flags, wheel revolutions (4) and event time (2)
+#define CSC_MEASUREMENT_MAX_LEN 7
+
+/**
+ * @brief notifications of the measurement enabled
+ *
+ * @return true if the client subscribed
+ */
+bool csc_notifications_enabled(void);
+
+/**
+ * @brief encode a wheel revolution measurement
+ *
+ * @param buf measurement, CSC_MEASUREMENT_MAX_LEN bytes
+ * @param revs cumulative wheel revolutions
+ * @param eventTime last wheel event time in 1/1024 s
+ * @return uint8_t length of the measurement
+ */
+uint8_t csc_encode_wheel(uint8_t *buf, uint32_t revs, uint16_t eventTime);
+
+/**
+ * @brief encode a crank revolution measurement
+ *
+ * @param buf measurement, CSC_MEASUREMENT_MAX_LEN bytes
+ * @param revs cumulative crank revolutions
+ * @param eventTime last crank event time in 1/1024 s
+ * @return uint8_t length of the measurement
+ */
+uint8_t csc_encode_crank(uint8_t *buf, uint16_t revs, uint16_t eventTime);
+
+/**
+ * @brief notify a wheel revolution measurement
+ *
+ * @param revs cumulative wheel revolutions
+ * @param eventTime last wheel event time in 1/1024 s
+ * @return int error code of bt_gatt_notify
+ */
+int csc_notify_wheel(uint32_t revs, uint16_t eventTime);
+
+/**
+ * @brief notify a crank revolution measurement
+ *
+ * @param revs cumulative crank revolutions
+ * @param eventTime last crank event time in 1/1024 s
+ * @return int error code of bt_gatt_notify
+ */
+int csc_notify_crank(uint16_t revs, uint16_t eventTime);
+
+#endif /* CSC_SERVICE_H_ */
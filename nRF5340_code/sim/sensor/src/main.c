@@ -0,0 +1,318 @@
+/**
+ * @file    main.c
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Simulated CSC or heart rate sensor with battery service for
+ *          the BabbleSim sensor fleet. Rate, counter rollover, periodic
+ *          disconnects, the battery service and the broadcast of the
+ *          measurements are set in the Kconfig, see ../run_fleet.sh
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/uuid.h>
+#if defined(CONFIG_SIM_SENSOR_HRS)
+#if defined(CONFIG_SIM_PROFILE_SERVICE)
+#include <bluetooth/services/hrs.h>
+#endif
+#else
+#include "CscService.h"
+#endif
+#if defined(CONFIG_SIM_BAS)
+#include <bluetooth/services/bas.h>
+#endif
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+#if defined(CONFIG_SIM_SENSOR_CSC_SPEED)
+#define PROFILE_NAME    "csc_speed"
+#define PROFILE_SERVICE BT_UUID_CSC_VAL
+#elif defined(CONFIG_SIM_SENSOR_CSC_CADENCE)
+#define PROFILE_NAME    "csc_cadence"
+#define PROFILE_SERVICE BT_UUID_CSC_VAL
+#else
+#define PROFILE_NAME    "hrs"
+#define PROFILE_SERVICE BT_UUID_HRS_VAL
+#endif
+#define PROFILE_UUID    BT_UUID_16_ENCODE(PROFILE_SERVICE)
+
+// not connectable, advertised with the identity address the board allowlists
+#define BROADCAST_PARAM BT_LE_ADV_PARAM(BT_LE_ADV_OPT_USE_IDENTITY, BT_GAP_ADV_FAST_INT_MIN_2, \
+					BT_GAP_ADV_FAST_INT_MAX_2, NULL)
+
+#if defined(CONFIG_SIM_ROLLOVER) && defined(CONFIG_SIM_SENSOR_CSC_SPEED)
+// 16 revolutions and 1 s before the counters wrap around, 32 bit wheel revolutions
+#define REVS_START      0xFFFFFFF0
+#define TIME_START      (0xFFFF - 1024)
+#elif defined(CONFIG_SIM_ROLLOVER)
+// 16 bit crank revolutions
+#define REVS_START      0xFFF0
+#define TIME_START      (0xFFFF - 1024)
+#else
+#define REVS_START      0
+#define TIME_START      0
+#endif
+
+// battery level decreases by 1 % every minute
+#define BATTERY_PERIOD_MS 60000
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+static const struct bt_data ad[] = {
+	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+	BT_DATA_BYTES(BT_DATA_UUID16_ALL, PROFILE_UUID),
+};
+
+#if defined(CONFIG_SIM_BROADCAST)
+// service data: 16 bit UUID of the service followed by the measurement
+static uint8_t serviceData[2 + CSC_MEASUREMENT_MAX_LEN] = {PROFILE_UUID};
+
+static struct bt_data adBroadcast[] = {
+	BT_DATA_BYTES(BT_DATA_FLAGS, BT_LE_AD_NO_BREDR),
+	BT_DATA(BT_DATA_SVC_DATA16, serviceData, sizeof(serviceData)),
+};
+#endif
+
+static struct bt_conn *conn;
+static int64_t connectedTime;
+static int64_t advStart;
+
+// statistics of the report
+static uint32_t sent;
+static uint32_t failed;
+static uint32_t connects;
+static uint32_t ttcLast;
+static uint32_t ttcMax;
+
+#if !defined(CONFIG_SIM_SENSOR_HRS)
+// cumulative revolutions and the part of the next one in 1/1000,
+// the event time advances with every whole revolution
+static uint32_t revs = REVS_START;
+static uint32_t milliRevs;
+static uint16_t eventTime = TIME_START;
+#endif
+
+static void adv_work_handler(struct k_work *work);
+static K_WORK_DEFINE(advWork, adv_work_handler);
+
+/*---------------------------------------------------------------------------
+ * CONNECTION
+ *--------------------------------------------------------------------------*/
+static void adv_work_handler(struct k_work *work)
+{
+#if defined(CONFIG_SIM_BROADCAST)
+	int err = bt_le_adv_start(BROADCAST_PARAM, adBroadcast, ARRAY_SIZE(adBroadcast), NULL, 0);
+#else
+	int err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad), NULL, 0);
+#endif
+
+	// still running: the stack resumes the advertising after a connection
+	if (err == -EALREADY)
+	{
+		return;
+	}
+	if (err)
+	{
+		printk("Advertising failed to start (err %d)\n", err);
+		return;
+	}
+	advStart = k_uptime_get();
+}
+
+static void connected(struct bt_conn *c, uint8_t err)
+{
+	if (err)
+	{
+		k_work_submit(&advWork);
+		return;
+	}
+
+	conn = bt_conn_ref(c);
+	connects++;
+	connectedTime = k_uptime_get();
+	ttcLast = (uint32_t) (connectedTime - advStart);
+	if (ttcLast > ttcMax)
+	{
+		ttcMax = ttcLast;
+	}
+}
+
+static void disconnected(struct bt_conn *c, uint8_t reason)
+{
+	if (conn)
+	{
+		bt_conn_unref(conn);
+		conn = NULL;
+	}
+	// the stack resumes the connectable advertising by itself
+	advStart = k_uptime_get();
+}
+
+static struct bt_conn_cb conn_callbacks = {
+	.connected = connected,
+	.disconnected = disconnected,
+};
+
+/*---------------------------------------------------------------------------
+ * MEASUREMENTS
+ *--------------------------------------------------------------------------*/
+#if !defined(CONFIG_SIM_SENSOR_HRS)
+// revolutions of one notification interval
+static void advance(uint32_t nowMs)
+{
+	milliRevs += CONFIG_SIM_REVS_PER_MIN * CONFIG_SIM_NOTIFY_INTERVAL_MS / 60U;
+	if (milliRevs >= 1000U)
+	{
+		// the counter wraps around like the one of a real sensor
+		revs += milliRevs / 1000U;
+		milliRevs %= 1000U;
+		// time of the last revolution in 1/1024 s
+		eventTime = (uint16_t) (TIME_START + (uint64_t) nowMs * 1024U / 1000U);
+	}
+}
+#endif
+
+static int notify(uint32_t nowMs)
+{
+#if defined(CONFIG_SIM_SENSOR_HRS) && defined(CONFIG_SIM_PROFILE_SERVICE)
+	return bt_hrs_notify(CONFIG_SIM_HEART_RATE);
+#elif defined(CONFIG_SIM_SENSOR_HRS)
+	// no service, nothing to notify
+	return -EAGAIN;
+#else
+	advance(nowMs);
+
+	if (!csc_notifications_enabled())
+	{
+		return -EAGAIN;
+	}
+#if defined(CONFIG_SIM_SENSOR_CSC_SPEED)
+	return csc_notify_wheel(revs, eventTime);
+#else
+	return csc_notify_crank((uint16_t) revs, eventTime);
+#endif
+#endif
+}
+
+#if defined(CONFIG_SIM_BROADCAST)
+// the measurement of the interval in the service data
+static int broadcast(uint32_t nowMs)
+{
+	uint8_t *measurement = &serviceData[2];
+	uint8_t len;
+
+#if defined(CONFIG_SIM_SENSOR_HRS)
+	// flags: 8 bit heart rate
+	measurement[0] = 0;
+	measurement[1] = CONFIG_SIM_HEART_RATE;
+	len = 2;
+#else
+	advance(nowMs);
+#if defined(CONFIG_SIM_SENSOR_CSC_SPEED)
+	len = csc_encode_wheel(measurement, revs, eventTime);
+#else
+	len = csc_encode_crank(measurement, (uint16_t) revs, eventTime);
+#endif
+#endif
+	adBroadcast[1].data_len = 2 + len;
+	return bt_le_adv_update_data(adBroadcast, ARRAY_SIZE(adBroadcast), NULL, 0);
+}
+#endif
+
+static void report(uint32_t nowMs)
+{
+	printk("#SIM sensor {\"addr\":\"%s\",\"profile\":\"%s\",\"t_ms\":%u,\"sent\":%u,\"failed\":%u,"
+	       "\"connects\":%u,\"ttc_last_ms\":%u,\"ttc_max_ms\":%u}\n",
+	       CONFIG_SIM_SENSOR_ADDRESS, PROFILE_NAME, nowMs, sent, failed, connects, ttcLast, ttcMax);
+}
+
+void main(void)
+{
+	bt_addr_le_t addr;
+	uint32_t lastReport = 0;
+	uint32_t lastBattery = 0;
+	int err;
+
+	// fixed identity, the board finds the sensor by this address
+	err = bt_addr_le_from_str(CONFIG_SIM_SENSOR_ADDRESS, "random", &addr);
+	if (err || bt_id_create(&addr, NULL) < 0)
+	{
+		printk("Invalid sensor address %s\n", CONFIG_SIM_SENSOR_ADDRESS);
+		return;
+	}
+
+	err = bt_enable(NULL);
+	if (err)
+	{
+		printk("Bluetooth init failed (err %d)\n", err);
+		return;
+	}
+
+	bt_conn_cb_register(&conn_callbacks);
+	k_work_submit(&advWork);
+
+	while (1)
+	{
+		uint32_t now;
+
+		k_sleep(K_MSEC(CONFIG_SIM_NOTIFY_INTERVAL_MS));
+		now = k_uptime_get_32();
+
+#if defined(CONFIG_SIM_BROADCAST)
+		if (broadcast(now) == 0)
+		{
+			sent++;
+		}
+		else
+		{
+			failed++;
+		}
+#endif
+
+		if (conn)
+		{
+			err = notify(now);
+			if (err == 0)
+			{
+				sent++;
+			}
+			else if (err != -EAGAIN)
+			{
+				failed++;
+			}
+
+			if (CONFIG_SIM_DISCONNECT_PERIOD_S != 0 &&
+			    k_uptime_get() - connectedTime >= CONFIG_SIM_DISCONNECT_PERIOD_S * 1000)
+			{
+				bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+			}
+		}
+
+#if defined(CONFIG_SIM_BAS)
+		if (now - lastBattery >= BATTERY_PERIOD_MS)
+		{
+			uint8_t level = bt_bas_get_battery_level();
+
+			lastBattery = now;
+			bt_bas_set_battery_level(level > 1 ? level - 1 : 100);
+		}
+#endif
+
+		if (now - lastReport >= CONFIG_SIM_REPORT_INTERVAL_S * 1000U)
+		{
+			lastReport = now;
+			report(now);
+		}
+	}
+}
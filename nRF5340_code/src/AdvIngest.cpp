@@ -0,0 +1,307 @@
+#include "AdvIngest.h"
+#include "EventLog.h"
+#include "Protocol.h"
+#include "SensorProfile.h"
+
+#include <bluetooth/bluetooth.h>
+#include <sys/byteorder.h>
+#include <string.h>
+#if defined(CONFIG_SHELL)
+#include <shell/shell.h>
+#endif
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+// one allowlisted sensor
+struct adv_sensor
+{
+	bt_addr_le_t addr;
+	uint32_t lastHash;          // hash of the last accepted measurement
+	int32_t lastSequence;       // event time of the last accepted measurement, -1 if none
+	uint32_t lastAcceptMs;
+	uint16_t accepted;
+	uint16_t duplicates;
+	uint16_t outOfOrder;
+	uint16_t ignored;           // measurements while another sensor had the profile
+	int8_t rssi;
+	uint8_t profile;
+};
+
+// allowlist, written by the RX command, the shell and the init, an entry
+// is complete before it is counted in nbrSensors
+static struct adv_sensor sensors[CONFIG_APP_ADV_INGEST_MAX_SENSORS];
+static uint8_t nbrSensors;
+
+static adv_ingest_cb_t measurementCb;
+
+// advertisement in process, passed through bt_data_parse()
+struct adv_report
+{
+	struct adv_sensor *sensor;
+	uint8_t index;
+	uint32_t now;
+};
+
+// FNV-1a, a repeated advertisement has the same measurement
+static uint32_t hash(const uint8_t *data, uint8_t length)
+{
+	uint32_t h = 2166136261u;
+
+	for (uint8_t i = 0; i < length; i++)
+	{
+		h = (h ^ data[i]) * 16777619u;
+	}
+	return h;
+}
+
+static struct adv_sensor *find_sensor(const bt_addr_le_t *addr, uint8_t *index)
+{
+	for (uint8_t i = 0; i < nbrSensors; i++)
+	{
+		if (bt_addr_le_cmp(&sensors[i].addr, addr) == 0)
+		{
+			*index = i;
+			return &sensors[i];
+		}
+	}
+	return NULL;
+}
+
+// the counters and event times of two sensors must not be differenced against
+// each other, a profile is taken from one sensor until it is silent
+static bool profile_taken(uint8_t profile, uint8_t index, uint32_t now)
+{
+	for (uint8_t i = 0; i < nbrSensors; i++)
+	{
+		if (i != index && sensors[i].profile == profile && sensors[i].accepted &&
+		    now - sensors[i].lastAcceptMs < ADV_INGEST_RESYNC_MS)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// one AD structure of an allowlisted sensor, true to continue with the next one
+static bool parse_ad(struct bt_data *ad, void *user_data)
+{
+	struct adv_report *report = (struct adv_report *) user_data;
+	struct adv_sensor *sensor = report->sensor;
+
+	// service data: 16 bit UUID of the service followed by the measurement
+	if (ad->type != BT_DATA_SVC_DATA16 || ad->data_len < 3)
+	{
+		return true;
+	}
+
+	uint8_t profile = SensorProfiles::idOfService(sys_get_le16(ad->data));
+	if (profile == SENSOR_PROFILE_NONE)
+	{
+		return true;
+	}
+
+	if (profile_taken(profile, report->index, report->now))
+	{
+		sensor->ignored++;
+		return false;
+	}
+
+	const uint8_t *measurement = &ad->data[2];
+	uint8_t length = ad->data_len - 2;
+	uint32_t h = hash(measurement, length);
+	bool resync = report->now - sensor->lastAcceptMs >= ADV_INGEST_RESYNC_MS || sensor->profile != profile;
+
+	// the advertising interval is shorter than the measurement interval
+	if (h == sensor->lastHash && !resync && report->now - sensor->lastAcceptMs < ADV_INGEST_REPEAT_MS)
+	{
+		sensor->duplicates++;
+		return false;
+	}
+
+	// the event time must not go back, e.g. an advertisement of an older set
+	int32_t sequence = SensorProfiles::sequence(profile, measurement, length);
+	if (sequence >= 0 && sensor->lastSequence >= 0 && !resync &&
+	    (int16_t) (sequence - sensor->lastSequence) < 0)
+	{
+		sensor->outOfOrder++;
+		ELOG1(INGEST_OUT_OF_ORDER, report->index);
+		return false;
+	}
+
+	sensor->profile = profile;
+	sensor->lastHash = h;
+	sensor->lastSequence = sequence;
+	sensor->lastAcceptMs = report->now;
+	sensor->accepted++;
+	measurementCb(profile, measurement, length, report->index, resync);
+	return false;
+}
+
+static void scan_recv(const struct bt_le_scan_recv_info *info, struct net_buf_simple *buf)
+{
+	struct adv_report report;
+
+	report.sensor = find_sensor(info->addr, &report.index);
+	if (report.sensor == NULL)
+	{
+		return;
+	}
+
+	report.now = k_uptime_get_32();
+	report.sensor->rssi = info->rssi;
+	bt_data_parse(buf, parse_ad, &report);
+}
+
+static struct bt_le_scan_cb scanCallbacks = {
+	.recv = scan_recv,
+};
+
+/*---------------------------------------------------------------------------
+ * ALLOWLIST
+ *--------------------------------------------------------------------------*/
+int adv_ingest_allow(const bt_addr_le_t *addr)
+{
+	uint8_t index;
+
+	if (find_sensor(addr, &index) != NULL)
+	{
+		return 0;
+	}
+	if (nbrSensors >= ARRAY_SIZE(sensors))
+	{
+		return -ENOMEM;
+	}
+
+	memset(&sensors[nbrSensors], 0, sizeof(sensors[nbrSensors]));
+	bt_addr_le_copy(&sensors[nbrSensors].addr, addr);
+	sensors[nbrSensors].lastSequence = -1;
+	sensors[nbrSensors].profile = SENSOR_PROFILE_NONE;
+	nbrSensors++;
+	return 0;
+}
+
+void adv_ingest_clear(void)
+{
+	nbrSensors = 0;
+}
+
+void adv_ingest_command(const uint8_t *data, uint16_t length)
+{
+	// flags, then address type and address (little endian) of every sensor
+	if (length < 1)
+	{
+		return;
+	}
+	if (data[0] & RX_ADV_ALLOW_CLEAR)
+	{
+		adv_ingest_clear();
+	}
+
+	for (uint16_t pos = 1; pos + 1 + BT_ADDR_SIZE <= length; pos += 1 + BT_ADDR_SIZE)
+	{
+		bt_addr_le_t addr;
+
+		addr.type = data[pos];
+		memcpy(addr.a.val, &data[pos + 1], BT_ADDR_SIZE);
+		if (adv_ingest_allow(&addr))
+		{
+			printk("Allowlist of the broadcasting sensors full\n");
+			break;
+		}
+	}
+	ELOG1(INGEST_ALLOWLIST, nbrSensors);
+}
+
+uint8_t adv_ingest_count(void)
+{
+	return nbrSensors;
+}
+
+// addresses of CONFIG_APP_ADV_INGEST_ALLOWLIST, "XX:XX:XX:XX:XX:XX" separated by ","
+static void load_allowlist(void)
+{
+	const char *list = CONFIG_APP_ADV_INGEST_ALLOWLIST;
+	char address[BT_ADDR_STR_LEN];
+
+	while (strlen(list) >= BT_ADDR_STR_LEN - 1)
+	{
+		bt_addr_le_t addr;
+
+		memcpy(address, list, BT_ADDR_STR_LEN - 1);
+		address[BT_ADDR_STR_LEN - 1] = '\0';
+		list += BT_ADDR_STR_LEN - 1;
+		if (*list == ',')
+		{
+			list++;
+		}
+
+		// the sensors use static random addresses
+		if (bt_addr_le_from_str(address, "random", &addr) || adv_ingest_allow(&addr))
+		{
+			printk("Broadcasting sensor %s not allowlisted\n", address);
+		}
+	}
+}
+
+int adv_ingest_init(adv_ingest_cb_t cb)
+{
+	measurementCb = cb;
+	load_allowlist();
+	if (nbrSensors > 0)
+	{
+		printk("%u broadcasting sensors allowlisted\n", nbrSensors);
+	}
+
+	// all advertisements of the scans of the DeviceManager, independent of its filters
+	bt_le_scan_cb_register(&scanCallbacks);
+	return 0;
+}
+
+/*---------------------------------------------------------------------------
+ * SHELL
+ *--------------------------------------------------------------------------*/
+#if defined(CONFIG_SHELL)
+
+static int cmd_list(const struct shell *shell, size_t argc, char **argv)
+{
+	char addr[BT_ADDR_LE_STR_LEN];
+
+	for (uint8_t i = 0; i < nbrSensors; i++)
+	{
+		bt_addr_le_to_str(&sensors[i].addr, addr, sizeof(addr));
+		shell_print(shell, "%2u %s profile %u, rssi %d, accepted %u, duplicates %u, out of order %u, ignored %u, "
+			    "last %u ms ago", i, addr, sensors[i].profile, sensors[i].rssi, sensors[i].accepted,
+			    sensors[i].duplicates, sensors[i].outOfOrder, sensors[i].ignored,
+			    sensors[i].accepted ? k_uptime_get_32() - sensors[i].lastAcceptMs : 0);
+	}
+	return 0;
+}
+
+static int cmd_allow(const struct shell *shell, size_t argc, char **argv)
+{
+	bt_addr_le_t addr;
+
+	if (bt_addr_le_from_str(argv[1], argc > 2 ? argv[2] : "random", &addr))
+	{
+		shell_error(shell, "invalid address %s", argv[1]);
+		return -EINVAL;
+	}
+	return adv_ingest_allow(&addr);
+}
+
+static int cmd_clear(const struct shell *shell, size_t argc, char **argv)
+{
+	adv_ingest_clear();
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(ingest_cmds,
+	SHELL_CMD(list, NULL, "Allowlisted sensors and their statistics", cmd_list),
+	SHELL_CMD_ARG(allow, NULL, "Allowlist a sensor: <address> [random|public]", cmd_allow, 2, 1),
+	SHELL_CMD(clear, NULL, "Clear the allowlist", cmd_clear),
+	SHELL_SUBCMD_SET_END
+);
+SHELL_CMD_REGISTER(ingest, &ingest_cmds, "Broadcasting sensors", NULL);
+
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,102 @@
+/**
+ * @file    AdvIngest.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Passive ingestion of sensor measurements broadcast in the
+ *          advertising of allowlisted sensors. The service data of a
+ *          sensor profile (SensorProfile.h) carries the same measurement
+ *          as a notification, repeated and older measurements are dropped.
+ *          The sensors use no connection slot.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef ADV_INGEST_H_
+#define ADV_INGEST_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+#include <bluetooth/addr.h>
+#include <errno.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// an unchanged measurement is taken again after this time (e.g. a steady heart rate)
+#define ADV_INGEST_REPEAT_MS        2000
+
+// the event time of a sensor is followed again after this time without measurement
+// (e.g. the sensor restarted), another sensor of the same profile can take over
+#define ADV_INGEST_RESYNC_MS        5000
+
+/**
+ * @brief callback for a new measurement of an allowlisted sensor,
+ *        called in the Bluetooth RX thread. Only one sensor per profile
+ *        is taken at a time, the measurements of the other sensors of
+ *        this profile are ignored until it is silent for ADV_INGEST_RESYNC_MS.
+ *
+ * @param profile SENSOR_PROFILE_* of the service data
+ * @param data measurement, same format as the notification of the profile
+ * @param length length of the measurement
+ * @param sensor index of the sensor in the allowlist
+ * @param resync true for the first measurement since the sensor took the
+ *               profile, the previous counters of the profile are of another
+ *               sensor or too old
+ */
+typedef void (*adv_ingest_cb_t)(uint8_t profile, const uint8_t *data, uint8_t length, uint8_t sensor,
+				bool resync);
+
+#if defined(CONFIG_APP_ADV_INGEST)
+
+/**
+ * @brief register the scan listener and load the allowlist
+ *        of CONFIG_APP_ADV_INGEST_ALLOWLIST
+ *
+ * @param cb callback for the measurements
+ * @return int error code, 0 if success
+ */
+int adv_ingest_init(adv_ingest_cb_t cb);
+
+/**
+ * @brief add a sensor to the allowlist
+ *
+ * @param addr address of the sensor
+ * @return int 0 if added or already in the list, -ENOMEM if the list is full
+ */
+int adv_ingest_allow(const bt_addr_le_t *addr);
+
+/**
+ * @brief remove all sensors from the allowlist
+ */
+void adv_ingest_clear(void);
+
+/**
+ * @brief command RX_CMD_ADV_ALLOW of the application
+ *
+ * @param data command without the opcode
+ * @param length length without the opcode
+ */
+void adv_ingest_command(const uint8_t *data, uint16_t length);
+
+/**
+ * @brief number of sensors in the allowlist
+ *
+ * @return uint8_t number of sensors
+ */
+uint8_t adv_ingest_count(void);
+
+#else
+
+static inline int adv_ingest_init(adv_ingest_cb_t cb) { return 0; }
+static inline int adv_ingest_allow(const bt_addr_le_t *addr) { return -ENOTSUP; }
+static inline void adv_ingest_clear(void) {}
+static inline void adv_ingest_command(const uint8_t *data, uint16_t length) {}
+static inline uint8_t adv_ingest_count(void) { return 0; }
+
+#endif /* CONFIG_APP_ADV_INGEST */
+
+#endif /* ADV_INGEST_H_ */
@@ -0,0 +1,233 @@
+#include "AdvertisingManager.h"
+
+#include <kernel.h>
+#include <bluetooth/hci.h>
+#include <settings/settings.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// high duty directed advertising is stopped by the controller after 1.28 s
+#define DIRECTED_TIMEOUT_MS 1500
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+static const struct bt_data *advData;
+static size_t advDataLen;
+static const struct bt_data *scanData;
+static size_t scanDataLen;
+
+static uint8_t phase = ADV_PHASE_OFF;
+
+// identity address of the last application, saved in the settings
+static bt_addr_le_t lastPeer;
+static bool lastPeerValid = false;
+
+// uptime of the last disconnect of an application, 0 if none pending
+static int64_t disconnectTime = 0;
+
+static struct adv_reconnect_stats stats;
+
+static struct k_delayed_work phaseWork;
+
+/*---------------------------------------------------------------------------
+ * SETTINGS
+ *--------------------------------------------------------------------------*/
+static int settings_set(const char *key, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+	const char *next;
+
+	if (settings_name_steq(key, "peer", &next) && !next)
+	{
+		if (len != sizeof(lastPeer))
+		{
+			return -EINVAL;
+		}
+		if (read_cb(cb_arg, &lastPeer, sizeof(lastPeer)) == sizeof(lastPeer))
+		{
+			lastPeerValid = true;
+		}
+		return 0;
+	}
+	return -ENOENT;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(adv_manager, "adv", NULL, settings_set, NULL, NULL);
+
+/*---------------------------------------------------------------------------
+ * PHASES
+ *--------------------------------------------------------------------------*/
+static int start_undirected(uint16_t intervalMin, uint16_t intervalMax)
+{
+	struct bt_le_adv_param param = BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME,
+							    intervalMin, intervalMax, NULL);
+
+	return bt_le_adv_start(&param, advData, advDataLen, scanData, scanDataLen);
+}
+
+static void start_fast()
+{
+	int err;
+
+	bt_le_adv_stop();
+	err = start_undirected(BT_GAP_ADV_FAST_INT_MIN_1, BT_GAP_ADV_FAST_INT_MAX_1);
+	if (err)
+	{
+		printk("Fast advertising failed to start (err %d)\n", err);
+		return;
+	}
+	phase = ADV_PHASE_FAST;
+	k_delayed_work_submit(&phaseWork, K_SECONDS(CONFIG_APP_ADV_FAST_TIMEOUT_S));
+}
+
+static void start_slow()
+{
+	int err;
+
+	bt_le_adv_stop();
+	err = start_undirected(BT_GAP_ADV_SLOW_INT_MIN, BT_GAP_ADV_SLOW_INT_MAX);
+	if (err)
+	{
+		printk("Slow advertising failed to start (err %d)\n", err);
+		return;
+	}
+	phase = ADV_PHASE_SLOW;
+}
+
+// the directed advertising can only reach an application with a known identity address
+static bool start_directed()
+{
+	int err;
+
+	if (!IS_ENABLED(CONFIG_APP_ADV_DIRECTED) || !lastPeerValid)
+	{
+		return false;
+	}
+
+	struct bt_le_adv_param param = BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME,
+							    0, 0, &lastPeer);
+
+	bt_le_adv_stop();
+	err = bt_le_adv_start(&param, NULL, 0, NULL, 0);
+	if (err)
+	{
+		printk("Directed advertising failed to start (err %d)\n", err);
+		return false;
+	}
+	phase = ADV_PHASE_DIRECTED;
+	k_delayed_work_submit(&phaseWork, K_MSEC(DIRECTED_TIMEOUT_MS));
+	return true;
+}
+
+// directed -> fast -> slow
+static void phase_work_handler(struct k_work *work)
+{
+	switch (phase)
+	{
+	case ADV_PHASE_DIRECTED:
+		start_fast();
+		break;
+	case ADV_PHASE_FAST:
+		start_slow();
+		break;
+	default:
+		break;
+	}
+}
+
+/*---------------------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ *--------------------------------------------------------------------------*/
+void adv_manager_init(const struct bt_data *ad, size_t adLen,
+		      const struct bt_data *sd, size_t sdLen)
+{
+	advData = ad;
+	advDataLen = adLen;
+	scanData = sd;
+	scanDataLen = sdLen;
+	k_delayed_work_init(&phaseWork, phase_work_handler);
+}
+
+void adv_manager_start(bool reconnect)
+{
+	k_delayed_work_cancel(&phaseWork);
+
+	if (reconnect && start_directed())
+	{
+		printk("Directed advertising to the last application\n");
+		return;
+	}
+
+	start_fast();
+	printk("Advertising successfully started\n");
+}
+
+void adv_manager_start_slow()
+{
+	k_delayed_work_cancel(&phaseWork);
+	start_slow();
+}
+
+void adv_manager_connected(struct bt_conn *conn)
+{
+	const bt_addr_le_t *dst = bt_conn_get_dst(conn);
+
+	k_delayed_work_cancel(&phaseWork);
+	phase = ADV_PHASE_OFF;
+
+	if (disconnectTime != 0)
+	{
+		uint32_t delta = (uint32_t) (k_uptime_get() - disconnectTime);
+
+		disconnectTime = 0;
+		stats.count++;
+		stats.lastMs = delta;
+		stats.sumMs += delta;
+		if (stats.count == 1 || delta < stats.minMs)
+		{
+			stats.minMs = delta;
+		}
+		if (delta > stats.maxMs)
+		{
+			stats.maxMs = delta;
+		}
+		printk("Application reconnected after %u ms (avg %u ms)\n", delta, stats.sumMs / stats.count);
+	}
+
+	// a resolvable private address changes, it can not be used for directed advertising
+	if (bt_addr_le_is_identity(dst) && bt_addr_le_cmp(dst, &lastPeer) != 0)
+	{
+		bt_addr_le_copy(&lastPeer, dst);
+		lastPeerValid = true;
+		if (IS_ENABLED(CONFIG_SETTINGS))
+		{
+			settings_save_one("adv/peer", &lastPeer, sizeof(lastPeer));
+		}
+	}
+}
+
+void adv_manager_connect_failed(uint8_t err)
+{
+	// high duty directed advertising ended without connection
+	if (err == BT_HCI_ERR_ADV_TIMEOUT && phase == ADV_PHASE_DIRECTED)
+	{
+		k_delayed_work_cancel(&phaseWork);
+		start_fast();
+	}
+}
+
+void adv_manager_disconnected(struct bt_conn *conn)
+{
+	disconnectTime = k_uptime_get();
+}
+
+uint8_t adv_manager_phase()
+{
+	return phase;
+}
+
+const struct adv_reconnect_stats *adv_manager_stats()
+{
+	return &stats;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file    AdvertisingManager.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Connectable advertising towards the android application:
+ *          directed burst to the last application, fast phase and
+ *          decay to a slow interval, measures the reconnect times
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef ADVERTISING_MANAGER_H_
+#define ADVERTISING_MANAGER_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// advertising phases
+#define ADV_PHASE_OFF       0
+#define ADV_PHASE_DIRECTED  1
+#define ADV_PHASE_FAST      2
+#define ADV_PHASE_SLOW      3
+
+/**
+ * @brief reconnect times of the application, measured from the
+ *        disconnect to the next connection in ms
+ */
+struct adv_reconnect_stats
+{
+    uint16_t count;
+    uint32_t lastMs;
+    uint32_t minMs;
+    uint32_t maxMs;
+    uint32_t sumMs;
+};
+
+/**
+ * @brief initialize the advertising manager
+ *
+ * @param ad advertising data
+ * @param adLen number of elements in ad
+ * @param sd scan response data
+ * @param sdLen number of elements in sd
+ */
+void adv_manager_init(const struct bt_data *ad, size_t adLen,
+                      const struct bt_data *sd, size_t sdLen);
+
+/**
+ * @brief start advertising
+ *
+ * @param reconnect true after an application disconnected:
+ *        directed burst to this application when possible, then fast
+ *        false at start up: fast phase
+ *        both decay to the slow interval
+ */
+void adv_manager_start(bool reconnect);
+
+/**
+ * @brief start advertising with the slow interval,
+ *        used to accept further applications
+ */
+void adv_manager_start_slow();
+
+/**
+ * @brief inform the manager about a new connection of an application
+ *
+ * @param conn the connection structure
+ */
+void adv_manager_connected(struct bt_conn *conn);
+
+/**
+ * @brief inform the manager about a failed connection of an application,
+ *        e.g. the directed advertising timed out
+ *
+ * @param err error code of the connected callback
+ */
+void adv_manager_connect_failed(uint8_t err);
+
+/**
+ * @brief inform the manager that an application disconnected
+ *
+ * @param conn the connection structure
+ */
+void adv_manager_disconnected(struct bt_conn *conn);
+
+/**
+ * @brief get the current advertising phase
+ *
+ * @return uint8_t one of ADV_PHASE_*
+ */
+uint8_t adv_manager_phase();
+
+/**
+ * @brief get the measured reconnect times
+ *
+ * @return const struct adv_reconnect_stats* the statistics
+ */
+const struct adv_reconnect_stats *adv_manager_stats();
+
+#endif /* ADVERTISING_MANAGER_H_ */
@@ -5,128 +5,76 @@
  *--------------------------------------------------------------------------*/ 
 static struct bt_bas_client clients[3]; // the battery clients
 static uint8_t batteryLevels[4];    // the battery levels of all sensors
-static uint8_t cntDevices = 0;
-static bool free = true;
 static bool readyValues[3];
-static bool service_found = true;
-/*
-* sensor infos has the following information about which sensors the user wants to connect:
-* 1 -> just one speed sensor 
-* 2 -> just one cadence sensor
-* 3 -> one speed and one cadence sensor
-* 4 -> one speed, one cadence and one heart rate sensor 
-* 5 -> one speed and one heart rate sensor
-* 6 -> one cadence and one heart rate sensor
-* 7 -> just one heart rate sensor
-*/
-static uint8_t infoSensors = 0;
+static bool assigned[3];       // the battery service of the sensor is discovered
 
-void discovery_completed_cb(struct bt_gatt_dm *dm, void *context)
+// index of the sensor type, DEFAULT if the sensor has no managed battery
+static uint8_t index_of(uint8_t type)
 {
-	printk("The discovery procedure succeeded\n");
-	service_found = true;
-	bt_gatt_dm_data_print(dm);
-
-	// subscribe battery service for the correct sensor
-	switch (infoSensors)
+	switch (type)
 	{
 	case 1:
-		subscribeBatterySpeed(dm);
-		break;
+		return SPEED;
 	case 2:
-		subscribeBatteryCadence(dm);
-		break;
+		return CADENCE;
 	case 3:
-		if (cntDevices == 1)
-		{
-			subscribeBatterySpeed(dm);
-		}
-		else
-		{
-			subscribeBatteryCadence(dm);
-		}
-		break;
-	case 4:
-		if (cntDevices == 1)
-		{
-			subscribeBatterySpeed(dm);
-		}
-		else if (cntDevices == 2)
-		{
-			subscribeBatteryCadence(dm);
-		}		
-		else 
-		{
-			subscribeBatteryHeartRate(dm);
-		}
-		break;
-	case 5:
-		if (cntDevices == 1)
-		{
-			subscribeBatterySpeed(dm);
-		}
-		else
-		{
-			subscribeBatteryHeartRate(dm);
-		}
-		break;
-	case 6:
-		if (cntDevices == 1)
-		{
-			subscribeBatteryCadence(dm);
-		}
-		else
-		{
-			subscribeBatteryHeartRate(dm);
-		}		
-		break;		
-	case 7:
-			subscribeBatteryHeartRate(dm);
-		break;							
+		return HEARTRATE;
 	default:
-		break;
+		return DEFAULT;
 	}
 }
 
-void discovery_service_not_found_cb(struct bt_conn *conn, void *context)
+int battery_client_assign(uint8_t type, struct bt_gatt_dm *dm)
 {
-	printk("The service could not be found during the discovery\n");
-	service_found = false;
-	cntDevices--;
-	free = true;
+	uint8_t index = index_of(type);
+	int err;
+
+	if (index == DEFAULT)
+	{
+		return -EINVAL;
+	}
+
+	// the client of a reconnected sensor gets the handles of its new connection
+	bt_bas_client_init(&clients[index]);
+	err = bt_bas_handles_assign(dm, &clients[index]);
+	if (err) 
+	{
+		printk("Could not init BAS client object of sensor type %d, error: %d\n", type, err);
+		return err;
+	}
+
+	readyValues[index] = false;
+	assigned[index] = true;
+	return 0;
 }
 
-void discovery_error_found_cb(struct bt_conn *conn,
-				     int err,
-				     void *context)
+void battery_client_remove(uint8_t type)
 {
-	printk("The discovery procedure failed with %d\n", err);
-	cntDevices--;
-	free = true;
+	uint8_t index = index_of(type);
+
+	if (index != DEFAULT)
+	{
+		assigned[index] = false;
+		readyValues[index] = false;
+	}
 }
 
-uint8_t gatt_discover_battery_service(struct bt_conn *conn)
+bool battery_client_ready(uint8_t type)
 {
-	uint8_t err;
-	free = false;
-	static uint8_t cnt = 0;
-	cnt++;
-	
-    static struct bt_gatt_dm_cb discovery_cb = {
-        .completed = discovery_completed_cb,
-        .service_not_found = discovery_service_not_found_cb,
-        .error_found = discovery_error_found_cb,
-    };
+	uint8_t index = index_of(type);
 
-	err = bt_gatt_dm_start(conn, BT_UUID_BAS, &discovery_cb, NULL);
-	if (err) 
+	return index != DEFAULT && assigned[index];
+}
+
+void battery_level_set(uint8_t type, uint8_t level)
+{
+	uint8_t index = index_of(type);
+
+	if (index != DEFAULT)
 	{
-		printk("Could not start the discovery procedure, error "
-		       "code: %d\n", err);
-		cnt--;
-		cntDevices--;
+		batteryLevels[index] = level;
+		readyValues[index] = true;
 	}
-	return err;
 }
 
 void read_battery_level_cb_speed(struct bt_bas_client *bas,
@@ -186,79 +134,6 @@ void read_battery_level_cb_heartRate(struct bt_bas_client *bas,
 	batteryLevels[HEARTRATE] = battery_level;
 }
 
-void initBatteryManager(uint8_t sensorInfos)
-{
-	for (uint8_t i = 0; i <= 2; i++)
-	{
-		readyValues[i] = false;
-		batteryLevels[i] = 0;
-	}
-	
-	free = false;
-	infoSensors = sensorInfos;
-	cntDevices++;
-	printk("Initialize battery manager: # %d\n", cntDevices);
-
-	switch (sensorInfos)
-	{
-	case 1:
-		bt_bas_client_init(&clients[SPEED]);
-		break;
-	case 2:
-		bt_bas_client_init(&clients[CADENCE]);
-		break;
-	case 3:
-		if (cntDevices == 1)
-		{
-			bt_bas_client_init(&clients[SPEED]);
-		}
-		else
-		{
-			bt_bas_client_init(&clients[CADENCE]);
-		}
-		break;
-	case 4:
-		if (cntDevices == 1)
-		{
-			bt_bas_client_init(&clients[SPEED]);
-		}
-		else if (cntDevices == 2)
-		{
-			bt_bas_client_init(&clients[CADENCE]);
-		}	
-		else
-		{
-			bt_bas_client_init(&clients[HEARTRATE]);
-		}
-		break;
-	case 5:
-		if (cntDevices == 1)
-		{
-			bt_bas_client_init(&clients[SPEED]);
-		}
-		else
-		{
-			bt_bas_client_init(&clients[HEARTRATE]);
-		}
-		break;
-	case 6:
-		if (cntDevices == 1)
-		{
-			bt_bas_client_init(&clients[CADENCE]);
-		}
-		else
-		{
-			bt_bas_client_init(&clients[HEARTRATE]);
-		}	
-		break;
-	case 7:
-		bt_bas_client_init(&clients[HEARTRATE]);
-		break;				
-	default:
-		break;
-	}
-}
-
 uint8_t getBatteryLevel(uint8_t nbrSensor) 
 {
     uint8_t defaultValue = 0;
@@ -282,72 +157,14 @@ uint8_t getBatteryLevel(uint8_t nbrSensor)
     return defaultValue;
 }
 
-void subscribeBatterySpeed(struct bt_gatt_dm *dm) 
-{
-	uint8_t err = 0;
-
-	err = bt_bas_handles_assign(dm, &clients[SPEED]);
-	if (err) 
-	{
-		printk("Could not init BAS client object from speed sensor, error: %d\n", err);
-	}
-
-	err = bt_gatt_dm_data_release(dm);
-	if (err) 
-	{
-		printk("Could not release the discovery data, error "
-		       "code: %d\n", err);
-	}
-	free = true;
-}
-
-void subscribeBatteryCadence(struct bt_gatt_dm *dm) 
-{
-	uint8_t err = 0;
-
-	err = bt_bas_handles_assign(dm, &clients[CADENCE]);
-	if (err) 
-	{
-		printk("Could not init BAS client object from cadence sensor, error: %d\n", err);
-	}
-
-	err = bt_gatt_dm_data_release(dm);
-	if (err) 
-	{
-		printk("Could not release the discovery data, error "
-		       "code: %d\n", err);
-	}
-
-	free = true;
-}
-
-void subscribeBatteryHeartRate(struct bt_gatt_dm *dm) 
+void askForBatteryLevel(uint8_t type)
 {
-	uint8_t err = 0;
-
-	err = bt_bas_handles_assign(dm, &clients[HEARTRATE]);
-	if (err) 
+	if (!battery_client_ready(type))
 	{
-		printk("Could not init BAS client object from heart rate sensor, error: %d\n", err);
+		// no battery service, the level is never ready
+		return;
 	}
 
-	err = bt_gatt_dm_data_release(dm);
-	if (err) 
-	{
-		printk("Could not release the discovery data, error "
-		       "code: %d\n", err);
-	}	
-	
-	free = true;
-}
-
-bool isFree()
-{
-	return free;
-}
-
-void askForBatteryLevel(uint8_t type)
-{
 	switch (type)
 	{
 	case 1:
@@ -403,8 +220,3 @@ void resetReadyValue(uint8_t type)
 		break;
 	}		
 }
-
-bool serviceFound()
-{
-	return service_found;
-}
\ No newline at end of file
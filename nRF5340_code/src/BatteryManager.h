@@ -23,36 +23,37 @@
 #define DEFAULT 3
 
 /**
- * @brief callback function, is called when discovery is completed
+ * @brief take the handles of the battery service of a sensor, called with
+ *        the discovery data of its battery service (GattOps)
  * 
- * @param dm holds the address of the connected device, user context and discover parameter 
- * @param context context, not used in this case
+ * @param type TYPE_CSC_SPEED, TYPE_CSC_CADENCE or TYPE_HEARTRATE
+ * @param dm discovery data of the battery service, released by the caller
+ * @return int error code, 0 if success
  */
-void discovery_completed_cb(struct bt_gatt_dm *dm, void *context);
+int battery_client_assign(uint8_t type, struct bt_gatt_dm *dm);
 
 /**
- * @brief callback function, is called when the battery service was not found
+ * @brief the sensor is disconnected, its battery level is not asked any more
  * 
- * @param conn connection structure which does not include the service
- * @param context context, not used in this case
+ * @param type TYPE_CSC_SPEED, TYPE_CSC_CADENCE or TYPE_HEARTRATE
  */
-void discovery_service_not_found_cb(struct bt_conn *conn, void *context);
+void battery_client_remove(uint8_t type);
 
 /**
- * @brief callback function, is called when an error occurs while discovering the battery service
+ * @brief check if the battery service of a sensor is known
  * 
- * @param conn connection structure which the error occurs
- * @param err error code, 0 if success
- * @param context context, not used in this case
+ * @param type TYPE_CSC_SPEED, TYPE_CSC_CADENCE or TYPE_HEARTRATE
+ * @return true if the battery level can be asked
  */
-void discovery_error_found_cb(struct bt_conn *conn, int err, void *context);
+bool battery_client_ready(uint8_t type);
 
 /**
- * @brief start discovering the battery service
+ * @brief battery level read after the discovery, ready to be sent like an asked one
  * 
- * @param conn the connection to search the battery service 
+ * @param type TYPE_CSC_SPEED, TYPE_CSC_CADENCE or TYPE_HEARTRATE
+ * @param level the battery level (0-100%)
  */
-uint8_t gatt_discover_battery_service(struct bt_conn *conn);
+void battery_level_set(uint8_t type, uint8_t level);
 
 /**
  * @brief callback function, is called when user requests the battery level of speed sensor
@@ -89,42 +90,6 @@ void read_battery_level_cb_heartRate(struct bt_bas_client *bas, uint8_t battery_
  */
 uint8_t getBatteryLevel(uint8_t nbrSensor);
 
-/**
- * @brief initialize the battery manager
- * 
- * @param sensorInfos info about which sensors are connected
- */
-void initBatteryManager(uint8_t sensorInfos);
-
-/**
- * @brief subscribe the battery service for speed sensor
- * 
- * @param dm holds the address of the connected device, user context and discover parameter 
- */
-void subscribeBatterySpeed(struct bt_gatt_dm *dm);
-
-/**
- * @brief subscribe the battery service for cadence sensor
- * 
- * @param dm holds the address of the connected device, user context and discover parameter  
- */
-void subscribeBatteryCadence(struct bt_gatt_dm *dm);
-
-/**
- * @brief subscribe the battery service for heart rate sensor
- * 
- * @param dm holds the address of the connected device, user context and discover parameter  
- */
-void subscribeBatteryHeartRate(struct bt_gatt_dm *dm);
-
-/**
- * @brief check if battery service client is busy
- * 
- * @return true if its free
- * @return false if its busy
- */
-bool isFree();
-
 /**
  * @brief ask heart rate sensor for the battery level
  * 
@@ -147,11 +112,3 @@ bool isValueReady(uint8_t type);
  * @param type which sensor wants to reset ready attribute
  */
 void resetReadyValue(uint8_t type);
-
-/**
- * @brief get information if service was not found
- * 
- * @return true when service found
- * @return false when service not found
- */
-bool serviceFound();
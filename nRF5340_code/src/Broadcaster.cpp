@@ -0,0 +1,174 @@
+#include "Broadcaster.h"
+#include "dataService.h"
+
+#include <bluetooth/bluetooth.h>
+#include <sys/byteorder.h>
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+// the extended advertising set used for the broadcast
+static struct bt_le_ext_adv *adv;
+
+// snapshot of the last values, written from the BT RX thread
+static uint8_t payload[BROADCAST_PAYLOAD_LEN];
+
+// copy handed to the host stack, only touched in the work handler
+static uint8_t payloadSent[BROADCAST_PAYLOAD_LEN];
+
+static bool started = false;
+
+static struct k_work updateWork;
+
+// the name is added by the host stack (BT_LE_EXT_ADV_NCONN_NAME)
+static struct bt_data ad[] = {
+	BT_DATA(BT_DATA_MANUFACTURER_DATA, payloadSent, sizeof(payloadSent)),
+};
+
+static struct bt_data perAd[] = {
+	BT_DATA(BT_DATA_MANUFACTURER_DATA, payloadSent, sizeof(payloadSent)),
+};
+
+// push the snapshot to the extended and to the periodic advertising data
+static void update_work_handler(struct k_work *work)
+{
+	int err;
+
+	// the setters run in the BT RX thread, both threads are cooperative
+	// and can not preempt each other while copying
+	payload[3]++;
+	memcpy(payloadSent, payload, sizeof(payloadSent));
+
+	err = bt_le_ext_adv_set_data(adv, ad, ARRAY_SIZE(ad), NULL, 0);
+	if (err)
+	{
+		printk("Failed to update broadcast data (err %d)\n", err);
+		return;
+	}
+
+	err = bt_le_per_adv_set_data(adv, perAd, ARRAY_SIZE(perAd));
+	if (err)
+	{
+		printk("Failed to update periodic broadcast data (err %d)\n", err);
+	}
+}
+
+// the set of a failed start is deleted, the broadcast stays off
+static int abort_init(int err)
+{
+	bt_le_ext_adv_delete(adv);
+	adv = NULL;
+	return err;
+}
+
+// schedule a refresh, several updates before the work runs are coalesced
+static void schedule_update()
+{
+	if (started)
+	{
+		k_work_submit(&updateWork);
+	}
+}
+
+int broadcast_init(void)
+{
+	int err;
+
+	k_work_init(&updateWork, update_work_handler);
+
+	sys_put_le16(BROADCAST_COMPANY_ID, &payload[0]);
+	payload[2] = BROADCAST_VERSION;
+	memcpy(payloadSent, payload, sizeof(payloadSent));
+
+	// non connectable, non scannable extended advertising -> carries the periodic train
+	err = bt_le_ext_adv_create(BT_LE_EXT_ADV_NCONN_NAME, NULL, &adv);
+	if (err)
+	{
+		printk("Failed to create broadcast advertising set (err %d)\n", err);
+		return err;
+	}
+
+	err = bt_le_ext_adv_set_data(adv, ad, ARRAY_SIZE(ad), NULL, 0);
+	if (err)
+	{
+		printk("Failed to set broadcast data (err %d)\n", err);
+		return abort_init(err);
+	}
+
+	// interval in units of 1.25 ms
+	uint16_t interval = (CONFIG_APP_BROADCAST_INTERVAL_MS * 4) / 5;
+	err = bt_le_per_adv_set_param(adv, BT_LE_PER_ADV_PARAM(interval, interval,
+							       BT_LE_PER_ADV_OPT_NONE));
+	if (err)
+	{
+		printk("Failed to set periodic advertising parameters (err %d)\n", err);
+		return abort_init(err);
+	}
+
+	err = bt_le_per_adv_set_data(adv, perAd, ARRAY_SIZE(perAd));
+	if (err)
+	{
+		printk("Failed to set periodic advertising data (err %d)\n", err);
+		return abort_init(err);
+	}
+
+	err = bt_le_per_adv_start(adv);
+	if (err)
+	{
+		printk("Failed to start periodic advertising (err %d)\n", err);
+		return abort_init(err);
+	}
+
+	err = bt_le_ext_adv_start(adv, BT_LE_EXT_ADV_START_DEFAULT);
+	if (err)
+	{
+		printk("Failed to start broadcast advertising (err %d)\n", err);
+		bt_le_per_adv_stop(adv);
+		return abort_init(err);
+	}
+
+	started = true;
+	printk("Broadcast started\n");
+
+	return 0;
+}
+
+void broadcast_set_speed(uint16_t speed)
+{
+	sys_put_le16(speed, &payload[5]);
+	payload[4] |= BROADCAST_FLAG_SPEED;
+	schedule_update();
+}
+
+void broadcast_set_cadence(uint16_t rpm)
+{
+	sys_put_le16(rpm, &payload[7]);
+	payload[4] |= BROADCAST_FLAG_CADENCE;
+	schedule_update();
+}
+
+void broadcast_set_heart_rate(uint8_t bpm)
+{
+	payload[9] = bpm;
+	payload[4] |= BROADCAST_FLAG_HEARTRATE;
+	schedule_update();
+}
+
+void broadcast_set_battery(uint8_t type, uint8_t level)
+{
+	switch (type)
+	{
+	case TYPE_CSC_SPEED:
+		payload[10] = level;
+		break;
+	case TYPE_CSC_CADENCE:
+		payload[11] = level;
+		break;
+	case TYPE_HEARTRATE:
+		payload[12] = level;
+		break;
+	default:
+		return;
+	}
+	schedule_update();
+}
@@ -0,0 +1,99 @@
+/**
+ * @file    Broadcaster.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Connectionless broadcast of the live metrics in
+ *          extended and periodic advertising
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef BROADCASTER_H_
+#define BROADCASTER_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// company identifier used in the manufacturer specific data (Nordic Semiconductor)
+#define BROADCAST_COMPANY_ID        0x0059
+
+// version of the payload layout, increment on every incompatible change
+#define BROADCAST_VERSION           1
+
+// flags -> which values of the snapshot are valid
+#define BROADCAST_FLAG_SPEED        0x01
+#define BROADCAST_FLAG_CADENCE      0x02
+#define BROADCAST_FLAG_HEARTRATE    0x04
+
+/*
+ * layout of the manufacturer specific data (little endian):
+ * 0-1  company identifier
+ * 2    payload version
+ * 3    sequence number, incremented on every refresh
+ * 4    flags, see BROADCAST_FLAG_*
+ * 5-6  speed in km/h * 100
+ * 7-8  cadence in rpm
+ * 9    heart rate in bpm
+ * 10   battery level speed sensor in %
+ * 11   battery level cadence sensor in %
+ * 12   battery level heart rate sensor in %
+ */
+#define BROADCAST_PAYLOAD_LEN       13
+
+#if defined(CONFIG_APP_BROADCAST)
+
+/**
+ * @brief create the extended advertising set and start
+ *        the periodic advertising train
+ *
+ * @return int error code, 0 if success
+ */
+int broadcast_init(void);
+
+/**
+ * @brief update the speed in the broadcast snapshot
+ *
+ * @param speed speed in km/h * 100
+ */
+void broadcast_set_speed(uint16_t speed);
+
+/**
+ * @brief update the cadence in the broadcast snapshot
+ *
+ * @param rpm cadence in rounds per minute
+ */
+void broadcast_set_cadence(uint16_t rpm);
+
+/**
+ * @brief update the heart rate in the broadcast snapshot
+ *
+ * @param bpm heart rate in beats per minute
+ */
+void broadcast_set_heart_rate(uint8_t bpm);
+
+/**
+ * @brief update a battery level in the broadcast snapshot
+ *
+ * @param type sensor type (TYPE_CSC_SPEED, TYPE_CSC_CADENCE or TYPE_HEARTRATE)
+ * @param level battery level (0-100%)
+ */
+void broadcast_set_battery(uint8_t type, uint8_t level);
+
+#else
+
+static inline int broadcast_init(void) { return 0; }
+static inline void broadcast_set_speed(uint16_t speed) {}
+static inline void broadcast_set_cadence(uint16_t rpm) {}
+static inline void broadcast_set_heart_rate(uint8_t bpm) {}
+static inline void broadcast_set_battery(uint8_t type, uint8_t level) {}
+
+#endif /* CONFIG_APP_BROADCAST */
+
+#endif /* BROADCASTER_H_ */
@@ -0,0 +1,151 @@
+#include "CpuStats.h"
+
+#include <string.h>
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+static struct cpu_subsys_stats subsystems[CPU_SUBSYS_COUNT];
+
+// thread samples, the threads are identified by their pointer
+static const struct k_thread *sampledThreads[CPU_STATS_MAX_THREADS];
+static uint32_t threadSamples[CPU_STATS_MAX_THREADS];
+static uint32_t totalSamples;
+
+static struct k_timer sampleTimer;
+
+/*
+ * The timer expires in interrupt context, k_current_get() returns the
+ * thread which was interrupted -> statistical CPU share of every thread.
+ */
+static void sample_handler(struct k_timer *timer)
+{
+	const struct k_thread *current = k_current_get();
+
+	totalSamples++;
+	for (uint8_t i = 0; i < CPU_STATS_MAX_THREADS; i++)
+	{
+		if (sampledThreads[i] == current)
+		{
+			threadSamples[i]++;
+			return;
+		}
+		if (sampledThreads[i] == NULL)
+		{
+			sampledThreads[i] = current;
+			threadSamples[i] = 1;
+			return;
+		}
+	}
+}
+
+void cpu_stats_init(void)
+{
+#if defined(CONFIG_APP_CPU_STATS_DWT)
+	// enable the cycle counter of the data watchpoint and trace unit
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+	k_timer_init(&sampleTimer, sample_handler, NULL);
+	k_timer_start(&sampleTimer, K_MSEC(CONFIG_APP_CPU_STATS_SAMPLE_MS),
+		      K_MSEC(CONFIG_APP_CPU_STATS_SAMPLE_MS));
+}
+
+void cpu_stats_end(uint8_t subsys, uint32_t start)
+{
+	uint32_t cycles = cpu_stats_begin() - start;
+	struct cpu_subsys_stats *s = &subsystems[subsys];
+
+	s->calls++;
+	s->totalCycles += cycles;
+	if (cycles > s->maxCycles)
+	{
+		s->maxCycles = cycles;
+	}
+}
+
+const struct cpu_subsys_stats *cpu_stats_subsys(uint8_t subsys)
+{
+	if (subsys >= CPU_SUBSYS_COUNT)
+	{
+		return NULL;
+	}
+	return &subsystems[subsys];
+}
+
+struct thread_lookup
+{
+	uint8_t index;
+	uint8_t cnt;
+	struct cpu_thread_stats *out;
+	bool found;
+};
+
+static void thread_cb(const struct k_thread *thread, void *user_data)
+{
+	struct thread_lookup *lookup = (struct thread_lookup *) user_data;
+	const char *name;
+	size_t unused = 0;
+
+	if (lookup->cnt++ != lookup->index)
+	{
+		return;
+	}
+
+	lookup->found = true;
+	memset(lookup->out, 0, sizeof(*lookup->out));
+
+	name = k_thread_name_get((k_tid_t) thread);
+	strncpy(lookup->out->name, name != NULL ? name : "?", sizeof(lookup->out->name) - 1);
+	lookup->out->stackSize = thread->stack_info.size;
+	if (k_thread_stack_space_get(thread, &unused) == 0)
+	{
+		lookup->out->stackUnused = unused;
+	}
+	lookup->out->priority = thread->base.prio;
+
+	for (uint8_t i = 0; i < CPU_STATS_MAX_THREADS; i++)
+	{
+		if (sampledThreads[i] == thread)
+		{
+			lookup->out->samples = threadSamples[i];
+			break;
+		}
+	}
+}
+
+bool cpu_stats_thread(uint8_t index, struct cpu_thread_stats *out)
+{
+	struct thread_lookup lookup = {index, 0, out, false};
+
+	// the scan of the stacks is long, the interrupts are not locked during it
+	k_thread_foreach_unlocked(thread_cb, &lookup);
+	return lookup.found;
+}
+
+uint32_t cpu_stats_total_samples(void)
+{
+	return totalSamples;
+}
+
+uint32_t cpu_stats_cycles_per_sec(void)
+{
+#if defined(CONFIG_APP_CPU_STATS_DWT)
+	return SystemCoreClock;
+#else
+	return sys_clock_hw_cycles_per_sec();
+#endif
+}
+
+void cpu_stats_reset(void)
+{
+	unsigned int key = irq_lock();
+
+	memset(subsystems, 0, sizeof(subsystems));
+	memset(sampledThreads, 0, sizeof(sampledThreads));
+	memset(threadSamples, 0, sizeof(threadSamples));
+	totalSamples = 0;
+	irq_unlock(key);
+}
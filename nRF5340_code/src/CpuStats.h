@@ -0,0 +1,171 @@
+/**
+ * @file    CpuStats.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   CPU accounting: cycles spent in the logical subsystems,
+ *          sampled CPU share and stack high-water mark of every thread
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef CPU_STATS_H_
+#define CPU_STATS_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <kernel.h>
+#if defined(CONFIG_APP_CPU_STATS_DWT)
+#include <arch/arm/aarch32/cortex_m/cmsis.h>
+#endif
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// logical subsystems, the cycles of a subsystem include the nested calls
+// (e.g. the uplink of a heart rate value is also counted in CPU_SUBSYS_HEARTRATE)
+#define CPU_SUBSYS_CSC          0   // CSC parsing and speed/cadence computation
+#define CPU_SUBSYS_HEARTRATE    1   // heart rate handling
+#define CPU_SUBSYS_BATTERY      2   // battery management
+#define CPU_SUBSYS_UPLINK       3   // encoding and queueing for the application
+#define CPU_SUBSYS_SCAN         4   // scanning callbacks
+#define CPU_SUBSYS_POWER        5   // cycling power parsing and computation
+#define CPU_SUBSYS_COUNT        6
+
+// maximum number of threads in the statistics
+#define CPU_STATS_MAX_THREADS   16
+
+/**
+ * @brief cycles spent in one subsystem
+ */
+struct cpu_subsys_stats
+{
+    uint32_t calls;
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+};
+
+/**
+ * @brief statistics of one thread
+ */
+struct cpu_thread_stats
+{
+    char name[16];
+    uint32_t stackSize;
+    uint32_t stackUnused;   // never used bytes of the stack -> high-water mark
+    uint32_t samples;       // timer samples in which this thread was running
+    int8_t priority;
+};
+
+#if defined(CONFIG_APP_CPU_STATS)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief initialize the cycle counter and start the sampling of the threads
+ */
+void cpu_stats_init(void);
+
+/**
+ * @brief add the cycles of one call of a subsystem, use cpu_stats_begin()
+ *        or the CpuScope class
+ *
+ * @param subsys one of CPU_SUBSYS_*
+ * @param start value of cpu_stats_begin() at the start of the call
+ */
+void cpu_stats_end(uint8_t subsys, uint32_t start);
+
+/**
+ * @brief get the statistics of a subsystem
+ *
+ * @param subsys one of CPU_SUBSYS_*
+ * @return const struct cpu_subsys_stats* the statistics, NULL if invalid
+ */
+const struct cpu_subsys_stats *cpu_stats_subsys(uint8_t subsys);
+
+/**
+ * @brief get the statistics of a thread, the stack usage is measured in this call
+ *
+ * @param index thread index, starting at 0
+ * @param out statistics of the thread
+ * @return true if the thread exists
+ */
+bool cpu_stats_thread(uint8_t index, struct cpu_thread_stats *out);
+
+/**
+ * @brief total number of thread samples
+ *
+ * @return uint32_t number of samples since the last reset
+ */
+uint32_t cpu_stats_total_samples(void);
+
+/**
+ * @brief frequency of the cycle counter
+ *
+ * @return uint32_t cycles per second
+ */
+uint32_t cpu_stats_cycles_per_sec(void);
+
+/**
+ * @brief clear the subsystem cycles and the thread samples
+ */
+void cpu_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @brief current value of the cycle counter
+ *
+ * @return uint32_t cycles
+ */
+static inline uint32_t cpu_stats_begin(void)
+{
+#if defined(CONFIG_APP_CPU_STATS_DWT)
+    return DWT->CYCCNT;
+#else
+    return k_cycle_get_32();
+#endif
+}
+
+#ifdef __cplusplus
+/**
+ * @brief accounts the cycles of the enclosing scope to a subsystem
+ */
+class CpuScope {
+public:
+    explicit CpuScope(uint8_t subsys) : subsys(subsys), start(cpu_stats_begin()) {}
+    ~CpuScope() { cpu_stats_end(subsys, start); }
+
+private:
+    uint8_t subsys;
+    uint32_t start;
+};
+#endif
+
+#else
+
+static inline void cpu_stats_init(void) {}
+static inline uint32_t cpu_stats_begin(void) { return 0; }
+static inline void cpu_stats_end(uint8_t subsys, uint32_t start) {}
+static inline const struct cpu_subsys_stats *cpu_stats_subsys(uint8_t subsys) { return NULL; }
+static inline bool cpu_stats_thread(uint8_t index, struct cpu_thread_stats *out) { return false; }
+static inline uint32_t cpu_stats_total_samples(void) { return 0; }
+static inline uint32_t cpu_stats_cycles_per_sec(void) { return 1; }
+static inline void cpu_stats_reset(void) {}
+
+#ifdef __cplusplus
+class CpuScope {
+public:
+    explicit CpuScope(uint8_t subsys) {}
+};
+#endif
+
+#endif /* CONFIG_APP_CPU_STATS */
+
+#endif /* CPU_STATS_H_ */
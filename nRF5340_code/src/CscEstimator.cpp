@@ -0,0 +1,81 @@
+#include "CscEstimator.h"
+
+void CscEstimator::reset()
+{
+    running = false;
+    x = 0;
+    v = 0;
+    lastEventTime = 0;
+    lastReceived = 0;
+    lastPeriodUs = 0;
+}
+
+void CscEstimator::addNotification(uint16_t revolutions, uint16_t ticks, uint64_t eventTime, uint64_t received)
+{
+    lastReceived = received;
+    if (revolutions == 0 || ticks == 0)
+    {
+        return;
+    }
+
+    uint32_t dt = (uint32_t) ticks * 15625 / 16;
+    int32_t measured = (int32_t) (((uint64_t) revolutions << 16) * 1024 / ticks);
+
+    if (!running || eventTime - lastEventTime > CSC_ESTIMATOR_STOP_US)
+    {
+        // first event after a stop: no history for the filter
+        running = true;
+        x = measured;
+        v = 0;
+    }
+    else
+    {
+        int32_t predicted = x + (int32_t) ((int64_t) v * dt / 1000000);
+        int32_t residual = measured - predicted;
+
+        x = predicted + residual * CSC_ESTIMATOR_ALPHA / 256;
+        v += (int32_t) ((int64_t) residual * CSC_ESTIMATOR_BETA / 256 * 1000000 / dt);
+        if (x < 0)
+        {
+            x = 0;
+        }
+    }
+    lastEventTime = eventTime;
+    lastPeriodUs = dt;
+}
+
+uint32_t CscEstimator::rate(uint64_t now) const
+{
+    if (!running || now < lastEventTime)
+    {
+        return running ? (uint32_t) x : 0;
+    }
+
+    // time without events, known from the notifications
+    uint64_t quiet = lastReceived > lastEventTime ? lastReceived - lastEventTime : 0;
+    if (quiet > CSC_ESTIMATOR_STOP_US || now - lastReceived > CSC_ESTIMATOR_STOP_US)
+    {
+        // stopped or no more notifications
+        return 0;
+    }
+
+    // extrapolate with the change of the rate, at most for one period
+    uint64_t elapsed = now - lastEventTime;
+    uint32_t horizon = elapsed < lastPeriodUs ? (uint32_t) elapsed : lastPeriodUs;
+    int64_t estimate = x + (int64_t) v * horizon / 1000000;
+    if (estimate < 0)
+    {
+        estimate = 0;
+    }
+
+    // no event for 'quiet' -> the rate is at most one revolution in 'quiet'
+    if (quiet > 0)
+    {
+        int64_t bound = ((int64_t) 1 << 16) * 1000000 / (int64_t) quiet;
+        if (estimate > bound)
+        {
+            estimate = bound;
+        }
+    }
+    return (uint32_t) estimate;
+}
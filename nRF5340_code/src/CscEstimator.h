@@ -0,0 +1,68 @@
+/**
+ * @file    CscEstimator.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Alpha-beta filter of the revolution rate of a CSC sensor in
+ *          fixed point. Updated with every notification, the estimate can
+ *          be read at any time: between the events it is extrapolated, and
+ *          it is bounded by the time without events known from the
+ *          notifications, so it decays towards zero when the events stop.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef CSC_ESTIMATOR_H_
+#define CSC_ESTIMATOR_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// gains of the filter in 1/256
+#define CSC_ESTIMATOR_ALPHA     128
+#define CSC_ESTIMATOR_BETA      26
+
+// no event for this time -> stopped (3 s: ~2.5 km/h with a 28" wheel, 20 rpm)
+#define CSC_ESTIMATOR_STOP_US   3000000
+
+class CscEstimator {
+public:
+    /**
+     * @brief forget the sensor, no constructor (static objects)
+     */
+    void reset();
+
+    /**
+     * @brief add a notification of the sensor
+     *
+     * @param revolutions revolutions since the last notification, 0 if no new event
+     * @param ticks time between the last two events in 1/1024 s
+     * @param eventTime time of the last event on the board timeline in us
+     * @param received time of the notification on the board timeline in us
+     */
+    void addNotification(uint16_t revolutions, uint16_t ticks, uint64_t eventTime, uint64_t received);
+
+    /**
+     * @brief estimate of the revolution rate at a time
+     *
+     * @param now time on the board timeline in us
+     * @return uint32_t revolutions per second in Q16, 0 if stopped
+     */
+    uint32_t rate(uint64_t now) const;
+
+private:
+    bool running;
+    int32_t x;                  // revolutions per second, Q16
+    int32_t v;                  // change of x per second, Q16
+    uint64_t lastEventTime;
+    uint64_t lastReceived;      // no events between lastEventTime and lastReceived
+    uint32_t lastPeriodUs;      // time between the last two events
+};
+
+#endif /* CSC_ESTIMATOR_H_ */
@@ -1,4 +1,5 @@
 #include "Data.h"
+#include "EventLog.h"
 
 Data::Data() 
 {
@@ -13,6 +14,7 @@ Data::Data()
     type = 0;
     wheelDiameter = 0.0;
     heartRate = 0;
+    energyExpended = 0;
     battValue_speed = 0;
     battValue_cadence = 0;
     battValue_heartRate = 0;
@@ -43,7 +45,7 @@ void Data::saveData(const void *data)
 		lastEventCadence  = sys_get_le16(&((uint8_t*)data)[3]);
         break;
     default:
-        printk("Unknown type\n");
+        ELOG1(UNKNOWN_TYPE, type);
         break;
     }
 }
@@ -82,8 +84,6 @@ uint16_t Data::calcSpeed()
     uint32_t maxVal = 0xffffffff;   // 32 bit
     double wheelCircumference = 0;
     double rpm_speed = 0;
-    static uint16_t totalTime = 0;
-    static uint8_t cntNbr = 0;
     
     if (nbrRevSpeed < 0)
     {
@@ -95,15 +95,6 @@ uint16_t Data::calcSpeed()
         wheelCircumference = wheelDiameter;
         wheelCircumference = (wheelDiameter) * PI;
         double time = (lastEventSpeed - oldLastEventSpeed)/1024.0;
-        cntNbr++;
-        totalTime += time;
-        if (cntNbr == 30)
-        {
-            cntNbr = 0;
-            printk("Total time is: %d\n",totalTime);
-            totalTime = 0;
-        }
-        
         double oldSpeed = speed;
 
         if (time < 0)
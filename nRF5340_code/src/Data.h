@@ -11,6 +11,9 @@
  * 
  */
 
+#ifndef DATA_H_
+#define DATA_H_
+
 /*---------------------------------------------------------------------------
  * INCLUDES
  *--------------------------------------------------------------------------*/ 
@@ -65,6 +68,7 @@ public:
 
     // received data from heart rate sensor
     uint8_t heartRate;
+    uint16_t energyExpended;    // kJ, 0 if not sent by the sensor
 
     // received battery values from the sensors
     uint8_t battValue_speed;
@@ -75,4 +79,6 @@ public:
 private:
     double speed;
     double rpm;
-};
\ No newline at end of file
+};
+
+#endif /* DATA_H_ */
\ No newline at end of file
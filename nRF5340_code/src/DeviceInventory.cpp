@@ -0,0 +1,509 @@
+#include "DeviceInventory.h"
+#include "EventLog.h"
+#include "MotionClient.h"
+#include "Protocol.h"
+#include "SensorProfile.h"
+#include "dataService.h"
+
+#include <kernel.h>
+#include <bluetooth/bluetooth.h>
+#include <sys/byteorder.h>
+#include <string.h>
+#if defined(CONFIG_SHELL)
+#include <shell/shell.h>
+#endif
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+#define TABLE_MASK (CONFIG_APP_INVENTORY_SIZE - 1)
+
+// aged out devices waiting for their INVENTORY_GONE record
+#define GONE_QUEUE_LEN 8
+
+BUILD_ASSERT((CONFIG_APP_INVENTORY_SIZE & TABLE_MASK) == 0, "CONFIG_APP_INVENTORY_SIZE must be a power of 2");
+BUILD_ASSERT(INVENTORY_CSC == 1 << (SENSOR_PROFILE_CSC - 1) && INVENTORY_HRS == 1 << (SENSOR_PROFILE_HRS - 1) &&
+	     INVENTORY_CPS == 1 << (SENSOR_PROFILE_CPS - 1), "INVENTORY_* must follow the SENSOR_PROFILE_* ids");
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+// one advertiser, open addressing with linear probing
+struct inventory_entry
+{
+	bt_addr_le_t addr;
+	uint32_t lastSeenMs;
+	int16_t rssi;               // smoothed RSSI in 1/2^INVENTORY_RSSI_SHIFT dBm
+	int8_t rssiSent;            // RSSI of the last frame
+	uint8_t flags;              // INVENTORY_*
+	uint8_t home;               // slot of the hash of the address
+	uint8_t nameLen;
+	char name[INVENTORY_NAME_LEN];
+	bool used;
+	bool changed;               // to be sent in the next frame
+	bool nameSent;
+};
+
+// what the advertising of a device tells, collected by bt_data_parse()
+struct adv_summary
+{
+	uint8_t flags;
+	uint8_t nameLen;
+	char name[INVENTORY_NAME_LEN];
+};
+
+// the table is written in the BT RX thread and read by the work queue and the shell
+static struct k_spinlock lock;
+static struct inventory_entry table[CONFIG_APP_INVENTORY_SIZE];
+static uint8_t nbrDevices;
+
+static bt_addr_le_t goneQueue[GONE_QUEUE_LEN];
+static uint8_t goneHead;
+static uint8_t goneCount;
+
+// first slot looked at by the next frame, the frames go round the table
+static uint8_t cursor;
+
+static bool sending;
+static uint8_t lastSubscribers;
+static uint32_t evicted;
+static uint32_t goneLost;
+
+static struct k_delayed_work tickWork;
+
+static uint8_t home_slot(const bt_addr_le_t *addr)
+{
+	// FNV-1a of the address type and the address
+	uint32_t h = (2166136261u ^ addr->type) * 16777619u;
+
+	for (uint8_t i = 0; i < BT_ADDR_SIZE; i++)
+	{
+		h = (h ^ addr->a.val[i]) * 16777619u;
+	}
+	return (uint8_t) (h & TABLE_MASK);
+}
+
+static int find_slot(const bt_addr_le_t *addr)
+{
+	uint8_t slot = home_slot(addr);
+
+	for (uint16_t i = 0; i < CONFIG_APP_INVENTORY_SIZE && table[slot].used; i++)
+	{
+		if (bt_addr_le_cmp(&table[slot].addr, addr) == 0)
+		{
+			return slot;
+		}
+		slot = (slot + 1) & TABLE_MASK;
+	}
+	return -1;
+}
+
+// backward shift deletion: the entries behind the slot are moved up, no tombstones
+static void remove_slot(uint8_t slot)
+{
+	uint8_t next = slot;
+
+	nbrDevices--;
+	while (true)
+	{
+		table[slot].used = false;
+		while (true)
+		{
+			next = (next + 1) & TABLE_MASK;
+			if (!table[next].used)
+			{
+				return;
+			}
+
+			// the entry stays if its home is cyclically in (slot, next]
+			uint8_t home = table[next].home;
+			bool stays = slot <= next ? (slot < home && home <= next) : (slot < home || home <= next);
+			if (!stays)
+			{
+				break;
+			}
+		}
+		table[slot] = table[next];
+		slot = next;
+	}
+}
+
+static void queue_gone(const bt_addr_le_t *addr)
+{
+	if (goneCount == GONE_QUEUE_LEN)
+	{
+		// the oldest record is lost, the application ages the device out itself
+		goneHead = (goneHead + 1) % GONE_QUEUE_LEN;
+		goneCount--;
+		goneLost++;
+	}
+	bt_addr_le_copy(&goneQueue[(goneHead + goneCount) % GONE_QUEUE_LEN], addr);
+	goneCount++;
+}
+
+static void mark_all_changed(void)
+{
+	for (uint16_t i = 0; i < CONFIG_APP_INVENTORY_SIZE; i++)
+	{
+		table[i].changed = table[i].used;
+		table[i].nameSent = false;
+	}
+	goneCount = 0;
+}
+
+// slot of a new device, the weakest device makes room for a stronger one
+static int insert_slot(const bt_addr_le_t *addr, int8_t rssi)
+{
+	if (nbrDevices == CONFIG_APP_INVENTORY_SIZE)
+	{
+		uint8_t weakest = 0;
+
+		for (uint16_t i = 1; i < CONFIG_APP_INVENTORY_SIZE; i++)
+		{
+			if (table[i].rssi < table[weakest].rssi)
+			{
+				weakest = i;
+			}
+		}
+		if (table[weakest].rssi >= rssi * (1 << INVENTORY_RSSI_SHIFT))
+		{
+			ELOG1(INVENTORY_FULL, rssi);
+			return -1;
+		}
+		if (sending)
+		{
+			queue_gone(&table[weakest].addr);
+		}
+		remove_slot(weakest);
+		evicted++;
+	}
+
+	uint8_t home = home_slot(addr);
+	uint8_t slot = home;
+
+	while (table[slot].used)
+	{
+		slot = (slot + 1) & TABLE_MASK;
+	}
+
+	memset(&table[slot], 0, sizeof(table[slot]));
+	bt_addr_le_copy(&table[slot].addr, addr);
+	table[slot].home = home;
+	table[slot].rssi = rssi * (1 << INVENTORY_RSSI_SHIFT);
+	table[slot].rssiSent = rssi;
+	table[slot].used = true;
+	table[slot].changed = true;
+	nbrDevices++;
+	return slot;
+}
+
+/*---------------------------------------------------------------------------
+ * SCAN
+ *--------------------------------------------------------------------------*/
+static void add_services(struct adv_summary *summary, const uint8_t *uuids, uint8_t length)
+{
+	for (uint8_t pos = 0; pos + 2 <= length; pos += 2)
+	{
+		uint8_t profile = SensorProfiles::idOfService(sys_get_le16(&uuids[pos]));
+		summary->flags |= profile != SENSOR_PROFILE_NONE ? 1 << (profile - 1) : INVENTORY_OTHER;
+	}
+}
+
+static bool parse_ad(struct bt_data *ad, void *user_data)
+{
+	struct adv_summary *summary = (struct adv_summary *) user_data;
+
+	switch (ad->type)
+	{
+	case BT_DATA_NAME_SHORTENED:
+	case BT_DATA_NAME_COMPLETE:
+		summary->nameLen = MIN(ad->data_len, INVENTORY_NAME_LEN);
+		memcpy(summary->name, ad->data, summary->nameLen);
+		break;
+	case BT_DATA_UUID16_SOME:
+	case BT_DATA_UUID16_ALL:
+		add_services(summary, ad->data, ad->data_len);
+		break;
+	case BT_DATA_UUID128_SOME:
+	case BT_DATA_UUID128_ALL:
+		for (uint8_t pos = 0; pos + 16 <= ad->data_len; pos += 16)
+		{
+			bool thingy = memcmp(&ad->data[pos], BT_UUID_128(BT_UUID_THINGY)->val, 16) == 0;
+			summary->flags |= thingy ? INVENTORY_THINGY : INVENTORY_OTHER;
+		}
+		break;
+	case BT_DATA_SVC_DATA16:
+		if (ad->data_len >= 2)
+		{
+			// the measurement of a broadcasting sensor follows the UUID
+			add_services(summary, ad->data, 2);
+			summary->flags |= ad->data_len > 2 ? INVENTORY_BROADCAST : 0;
+		}
+		break;
+	default:
+		break;
+	}
+	return true;
+}
+
+static void scan_recv(const struct bt_le_scan_recv_info *info, struct net_buf_simple *buf)
+{
+	struct adv_summary summary;
+
+	summary.flags = 0;
+	summary.nameLen = 0;
+	bt_data_parse(buf, parse_ad, &summary);
+	if (info->addr->type == BT_ADDR_LE_RANDOM || info->addr->type == BT_ADDR_LE_RANDOM_ID)
+	{
+		summary.flags |= INVENTORY_RANDOM;
+	}
+	if (info->adv_props & BT_GAP_ADV_PROP_CONNECTABLE)
+	{
+		summary.flags |= INVENTORY_CONNECTABLE;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	int slot = find_slot(info->addr);
+	if (slot < 0)
+	{
+		slot = insert_slot(info->addr, info->rssi);
+	}
+	if (slot >= 0)
+	{
+		struct inventory_entry *entry = &table[slot];
+
+		entry->lastSeenMs = k_uptime_get_32();
+		entry->rssi += (info->rssi * (1 << INVENTORY_RSSI_SHIFT) - entry->rssi) >> INVENTORY_RSSI_SHIFT;
+
+		// the advertising and the scan response carry different parts,
+		// the services of both are kept
+		if ((entry->flags | summary.flags) != entry->flags)
+		{
+			entry->flags |= summary.flags;
+			entry->changed = true;
+		}
+		if (summary.nameLen > 0 &&
+		    (summary.nameLen != entry->nameLen || memcmp(summary.name, entry->name, summary.nameLen) != 0))
+		{
+			memcpy(entry->name, summary.name, summary.nameLen);
+			entry->nameLen = summary.nameLen;
+			entry->nameSent = false;
+			entry->changed = true;
+		}
+		int16_t delta = (entry->rssi >> INVENTORY_RSSI_SHIFT) - entry->rssiSent;
+		if (delta >= INVENTORY_RSSI_STEP || delta <= -INVENTORY_RSSI_STEP)
+		{
+			entry->changed = true;
+		}
+	}
+	k_spin_unlock(&lock, key);
+}
+
+static struct bt_le_scan_cb scanCallbacks = {
+	.recv = scan_recv,
+};
+
+/*---------------------------------------------------------------------------
+ * FRAMES
+ *--------------------------------------------------------------------------*/
+// one TYPE_INVENTORY frame of the gone devices and of the changed devices,
+// must be called with the lock held, returns its length or 0 if nothing to send
+static uint16_t encode_frame(uint8_t *frame, uint16_t maxLen, uint32_t now)
+{
+	uint16_t pos = 2;
+	uint8_t count = 0;
+
+	if (maxLen < 2 + INVENTORY_ENTRY_LEN)
+	{
+		return 0;
+	}
+
+	while (goneCount > 0 && pos + INVENTORY_ENTRY_LEN <= maxLen)
+	{
+		memcpy(&frame[pos], goneQueue[goneHead].a.val, BT_ADDR_SIZE);
+		frame[pos + 6] = 0;
+		frame[pos + 7] = 0;
+		frame[pos + 8] = INVENTORY_GONE;
+		frame[pos + 9] = 0;
+		pos += INVENTORY_ENTRY_LEN;
+		count++;
+		goneHead = (goneHead + 1) % GONE_QUEUE_LEN;
+		goneCount--;
+	}
+
+	for (uint16_t i = 0; i < CONFIG_APP_INVENTORY_SIZE; i++)
+	{
+		uint8_t slot = (cursor + i) & TABLE_MASK;
+		struct inventory_entry *entry = &table[slot];
+
+		if (!entry->used || !entry->changed)
+		{
+			continue;
+		}
+
+		uint16_t nameLen = entry->nameSent ? 0 : entry->nameLen;
+		if (pos + INVENTORY_ENTRY_LEN + nameLen > maxLen)
+		{
+			if (count > 0)
+			{
+				// first device of the next frame
+				cursor = slot;
+				break;
+			}
+			// alone in the frame: the name is cut to the frame
+			nameLen = maxLen - pos - INVENTORY_ENTRY_LEN;
+		}
+
+		uint32_t age = (now - entry->lastSeenMs) / 1000;
+		int8_t rssi = entry->rssi >> INVENTORY_RSSI_SHIFT;
+
+		memcpy(&frame[pos], entry->addr.a.val, BT_ADDR_SIZE);
+		frame[pos + 6] = entry->flags;
+		frame[pos + 7] = (uint8_t) rssi;
+		frame[pos + 8] = (uint8_t) MIN(age, INVENTORY_GONE - 1);
+		frame[pos + 9] = nameLen;
+		memcpy(&frame[pos + INVENTORY_ENTRY_LEN], entry->name, nameLen);
+		pos += INVENTORY_ENTRY_LEN + nameLen;
+		count++;
+
+		entry->changed = false;
+		entry->nameSent = true;
+		entry->rssiSent = rssi;
+	}
+
+	if (count == 0)
+	{
+		return 0;
+	}
+	frame[0] = TYPE_INVENTORY;
+	frame[1] = count;
+	return pos;
+}
+
+static void age_out(uint32_t now)
+{
+	uint16_t i = 0;
+
+	while (i < CONFIG_APP_INVENTORY_SIZE)
+	{
+		if (table[i].used && now - table[i].lastSeenMs > CONFIG_APP_INVENTORY_AGE_S * 1000U)
+		{
+			if (sending)
+			{
+				queue_gone(&table[i].addr);
+			}
+			// an entry behind is moved into this slot, it is checked again
+			remove_slot(i);
+			continue;
+		}
+		i++;
+	}
+}
+
+static void tick(struct k_work *work)
+{
+	uint8_t frame[CONFIG_APP_UPLINK_FRAME_SIZE];
+	uint8_t subscribers = data_service_nbr_subscribers();
+	uint32_t now = k_uptime_get_32();
+
+	k_delayed_work_submit(&tickWork, K_MSEC(CONFIG_APP_INVENTORY_INTERVAL_MS));
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	age_out(now);
+	if (subscribers > lastSubscribers)
+	{
+		// a new application gets the whole inventory
+		mark_all_changed();
+	}
+	lastSubscribers = subscribers;
+	k_spin_unlock(&lock, key);
+
+	if (!sending || subscribers == 0)
+	{
+		return;
+	}
+
+	// at most CONFIG_APP_INVENTORY_FRAMES per interval, the rest waits for the next one
+	uint16_t maxLen = data_service_max_frame_len();
+	for (uint8_t i = 0; i < CONFIG_APP_INVENTORY_FRAMES; i++)
+	{
+		key = k_spin_lock(&lock);
+		uint16_t len = encode_frame(frame, maxLen, now);
+		k_spin_unlock(&lock, key);
+
+		if (len == 0)
+		{
+			break;
+		}
+		ELOG1(INVENTORY_FRAME, frame[1]);
+		data_service_send(frame, len);
+	}
+}
+
+/*---------------------------------------------------------------------------
+ * INTERFACE
+ *--------------------------------------------------------------------------*/
+int device_inventory_init(void)
+{
+	sending = true;
+	k_delayed_work_init(&tickWork, tick);
+	k_delayed_work_submit(&tickWork, K_MSEC(CONFIG_APP_INVENTORY_INTERVAL_MS));
+
+	// all advertisements of the scans of the DeviceManager, independent of its filters
+	bt_le_scan_cb_register(&scanCallbacks);
+	return 0;
+}
+
+void device_inventory_command(uint8_t mode)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	sending = (mode == RX_INVENTORY_START);
+	if (sending)
+	{
+		mark_all_changed();
+	}
+	k_spin_unlock(&lock, key);
+}
+
+uint8_t device_inventory_count(void)
+{
+	return nbrDevices;
+}
+
+/*---------------------------------------------------------------------------
+ * SHELL
+ *--------------------------------------------------------------------------*/
+#if defined(CONFIG_SHELL)
+
+static int cmd_list(const struct shell *shell, size_t argc, char **argv)
+{
+	char addr[BT_ADDR_LE_STR_LEN];
+	char name[INVENTORY_NAME_LEN + 1];
+	uint32_t now = k_uptime_get_32();
+
+	// a copy of every entry, the shell output is too slow for the lock
+	for (uint16_t i = 0; i < CONFIG_APP_INVENTORY_SIZE; i++)
+	{
+		struct inventory_entry entry;
+
+		k_spinlock_key_t key = k_spin_lock(&lock);
+		entry = table[i];
+		k_spin_unlock(&lock, key);
+
+		if (!entry.used)
+		{
+			continue;
+		}
+		bt_addr_le_to_str(&entry.addr, addr, sizeof(addr));
+		memcpy(name, entry.name, entry.nameLen);
+		name[entry.nameLen] = '\0';
+		shell_print(shell, "%s %-12s flags 0x%02x, rssi %d dBm, seen %u ms ago",
+			    addr, name, entry.flags, entry.rssi >> INVENTORY_RSSI_SHIFT, now - entry.lastSeenMs);
+	}
+	shell_print(shell, "%u devices, %u evicted, %u gone records lost", nbrDevices, evicted, goneLost);
+	return 0;
+}
+
+SHELL_CMD_REGISTER(inventory, NULL, "Nearby devices seen by the scans", cmd_list);
+
+#endif /* CONFIG_SHELL */
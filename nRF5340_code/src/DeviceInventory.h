@@ -0,0 +1,68 @@
+/**
+ * @file    DeviceInventory.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Inventory of the nearby advertisers, filled by every scan of
+ *          the central: address, name, advertised sensor services and
+ *          smoothed RSSI in a fixed size hash table, aged out when not
+ *          seen any more. The changes are sent to the application in
+ *          TYPE_INVENTORY frames at a bounded rate, the application picks
+ *          its sensors without a scan of its own.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef DEVICE_INVENTORY_H_
+#define DEVICE_INVENTORY_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// longest name kept of a device, longer names are cut
+#define INVENTORY_NAME_LEN          12
+
+// smoothing of the RSSI: new = old + (rssi - old) / 2^INVENTORY_RSSI_SHIFT
+#define INVENTORY_RSSI_SHIFT        3
+
+// a device is sent again when its smoothed RSSI changed by this many dBm
+#define INVENTORY_RSSI_STEP         4
+
+#if defined(CONFIG_APP_INVENTORY)
+
+/**
+ * @brief register the scan listener and start the frames to the application
+ *
+ * @return int error code, 0 if success
+ */
+int device_inventory_init(void);
+
+/**
+ * @brief command RX_CMD_INVENTORY of the application
+ *
+ * @param mode RX_INVENTORY_*
+ */
+void device_inventory_command(uint8_t mode);
+
+/**
+ * @brief number of devices in the inventory
+ *
+ * @return uint8_t number of devices
+ */
+uint8_t device_inventory_count(void);
+
+#else
+
+static inline int device_inventory_init(void) { return 0; }
+static inline void device_inventory_command(uint8_t mode) {}
+static inline uint8_t device_inventory_count(void) { return 0; }
+
+#endif /* CONFIG_APP_INVENTORY */
+
+#endif /* DEVICE_INVENTORY_H_ */
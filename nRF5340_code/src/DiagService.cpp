@@ -0,0 +1,327 @@
+#include "DiagService.h"
+#include "Latency.h"
+#include "CpuStats.h"
+#include "LinkMonitor.h"
+
+#include <string.h>
+#include <sys/byteorder.h>
+#if defined(CONFIG_APP_DIAG_SHELL)
+#include <shell/shell.h>
+#endif
+
+#if !defined(CONFIG_APP_ROLE_CENTRAL) || defined(CONFIG_APP_DIAG_SHELL)
+static void reset_all()
+{
+	latency_reset();
+	cpu_stats_reset();
+	link_monitor_reset();
+}
+#endif
+
+// the GATT service needs the peripheral role, a central only board has the shell commands
+#if !defined(CONFIG_APP_ROLE_CENTRAL)
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+// selected page and its arguments
+static uint8_t page = DIAG_PAGE_INFO;
+static uint8_t arg0 = 0;
+static uint8_t arg1 = 0;
+
+// page content, built at offset 0 and kept for the following long reads
+static uint8_t pageData[DIAG_PAGE_MAX_SIZE];
+static uint16_t pageLen = 0;
+
+static uint16_t build_info(uint8_t *buf)
+{
+	buf[0] = DIAG_VERSION;
+	buf[1] = LATENCY_SENSOR_COUNT;
+	buf[2] = LATENCY_STAGE_COUNT;
+	buf[3] = LATENCY_BUCKETS;
+	buf[4] = LATENCY_FIRST_BUCKET_LOG2;
+	buf[5] = CPU_SUBSYS_COUNT;
+	return 6;
+}
+
+static uint16_t build_latency(uint8_t *buf, uint8_t sensor, uint8_t stage)
+{
+	const struct latency_histogram *h = latency_get(sensor, stage);
+	uint16_t len = 0;
+
+	if (h == NULL)
+	{
+		return 0;
+	}
+
+	sys_put_le32(h->count, &buf[len]);
+	len += 4;
+	sys_put_le32(h->maxUs, &buf[len]);
+	len += 4;
+	for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		sys_put_le32(h->buckets[i], &buf[len]);
+		len += 4;
+	}
+	return len;
+}
+
+static uint16_t build_cpu(uint8_t *buf)
+{
+	uint16_t len = 0;
+
+	sys_put_le32(cpu_stats_cycles_per_sec(), &buf[len]);
+	len += 4;
+	sys_put_le32(cpu_stats_total_samples(), &buf[len]);
+	len += 4;
+	for (uint8_t i = 0; i < CPU_SUBSYS_COUNT; i++)
+	{
+		const struct cpu_subsys_stats *s = cpu_stats_subsys(i);
+
+		if (s == NULL)
+		{
+			return 0;
+		}
+		sys_put_le32(s->calls, &buf[len]);
+		len += 4;
+		sys_put_le32(s->maxCycles, &buf[len]);
+		len += 4;
+		sys_put_le64(s->totalCycles, &buf[len]);
+		len += 8;
+	}
+	return len;
+}
+
+static uint16_t build_thread(uint8_t *buf, uint8_t index)
+{
+	struct cpu_thread_stats t;
+	uint16_t len = 0;
+
+	if (!cpu_stats_thread(index, &t))
+	{
+		return 0;
+	}
+
+	memcpy(&buf[len], t.name, sizeof(t.name));
+	len += sizeof(t.name);
+	sys_put_le32(t.stackSize, &buf[len]);
+	len += 4;
+	sys_put_le32(t.stackUnused, &buf[len]);
+	len += 4;
+	sys_put_le32(t.samples, &buf[len]);
+	len += 4;
+	buf[len++] = (uint8_t) t.priority;
+	return len;
+}
+
+static uint16_t build_page()
+{
+	switch (page)
+	{
+	case DIAG_PAGE_INFO:
+		return build_info(pageData);
+	case DIAG_PAGE_LATENCY:
+		return build_latency(pageData, arg0, arg1);
+	case DIAG_PAGE_CPU:
+		return build_cpu(pageData);
+	case DIAG_PAGE_THREAD:
+		return build_thread(pageData, arg0);
+	case DIAG_PAGE_LINKS:
+		return link_monitor_page(arg0, pageData);
+	default:
+		return 0;
+	}
+}
+
+/*---------------------------------------------------------------------------
+ * GATT SERVICE
+ *--------------------------------------------------------------------------*/
+static ssize_t on_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+		       void *buf, uint16_t len, uint16_t offset)
+{
+	if (offset == 0)
+	{
+		pageLen = build_page();
+	}
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, pageData, pageLen);
+}
+
+static ssize_t on_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	const uint8_t *buffer = (const uint8_t *) buf;
+
+	if (offset != 0 || len == 0 || len > 3)
+	{
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	if (buffer[0] == DIAG_CMD_RESET)
+	{
+		reset_all();
+		return len;
+	}
+
+	page = buffer[0];
+	arg0 = len > 1 ? buffer[1] : 0;
+	arg1 = len > 2 ? buffer[2] : 0;
+	return len;
+}
+
+BT_GATT_SERVICE_DEFINE(diag_service,
+BT_GATT_PRIMARY_SERVICE(BT_UUID_DIAG_SERVICE),
+BT_GATT_CHARACTERISTIC(BT_UUID_DIAG_PAGE,
+		       BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+		       BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+		       on_read, on_write, NULL),
+);
+#endif /* !CONFIG_APP_ROLE_CENTRAL */
+
+/*---------------------------------------------------------------------------
+ * SHELL COMMANDS
+ *--------------------------------------------------------------------------*/
+#if defined(CONFIG_APP_DIAG_SHELL)
+
+static const char *const sensorNames[LATENCY_SENSOR_COUNT] = {"speed", "cadence", "heartrate", "power"};
+static const char *const stageNames[LATENCY_STAGE_COUNT] = {"compute", "queue", "tx", "total"};
+
+static int cmd_latency(const struct shell *shell, size_t argc, char **argv)
+{
+	for (uint8_t sensor = 0; sensor < LATENCY_SENSOR_COUNT; sensor++)
+	{
+		for (uint8_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+		{
+			const struct latency_histogram *h = latency_get(sensor, stage);
+
+			if (h->count == 0)
+			{
+				continue;
+			}
+			shell_print(shell, "%s/%s: %u samples, max %u us",
+				    sensorNames[sensor], stageNames[stage], h->count, h->maxUs);
+			for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+			{
+				if (h->buckets[i] == 0)
+				{
+					continue;
+				}
+				if (latency_bucket_limit(i) != 0)
+				{
+					shell_print(shell, "  < %7u us: %u", latency_bucket_limit(i), h->buckets[i]);
+				}
+				else
+				{
+					shell_print(shell, "  >= %6u us: %u", latency_bucket_limit(i - 1), h->buckets[i]);
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+static const char *const subsysNames[CPU_SUBSYS_COUNT] = {"csc", "heartrate", "battery", "uplink", "scan", "power"};
+
+static uint32_t cycles_to_us(uint64_t cycles)
+{
+	return (uint32_t) (cycles * 1000000U / cpu_stats_cycles_per_sec());
+}
+
+static int cmd_cpu(const struct shell *shell, size_t argc, char **argv)
+{
+	uint32_t total = cpu_stats_total_samples();
+	struct cpu_thread_stats t;
+
+	shell_print(shell, "cycle counter: %u Hz", cpu_stats_cycles_per_sec());
+	for (uint8_t i = 0; i < CPU_SUBSYS_COUNT; i++)
+	{
+		const struct cpu_subsys_stats *s = cpu_stats_subsys(i);
+
+		if (s == NULL || s->calls == 0)
+		{
+			continue;
+		}
+		shell_print(shell, "%-10s %8u calls, avg %6u us, max %6u us, total %u ms",
+			    subsysNames[i], s->calls, cycles_to_us(s->totalCycles / s->calls),
+			    cycles_to_us(s->maxCycles), cycles_to_us(s->totalCycles) / 1000U);
+	}
+
+	if (total == 0)
+	{
+		return 0;
+	}
+	shell_print(shell, "thread share of %u samples:", total);
+	for (uint8_t i = 0; cpu_stats_thread(i, &t); i++)
+	{
+		uint32_t permille = (uint32_t) ((uint64_t) t.samples * 1000U / total);
+
+		if (t.samples != 0)
+		{
+			shell_print(shell, "  %-16s %3u.%u %%", t.name, permille / 10U, permille % 10U);
+		}
+	}
+	return 0;
+}
+
+static int cmd_stacks(const struct shell *shell, size_t argc, char **argv)
+{
+	struct cpu_thread_stats t;
+
+	for (uint8_t i = 0; cpu_stats_thread(i, &t); i++)
+	{
+		uint32_t used = t.stackSize - t.stackUnused;
+
+		shell_print(shell, "%-16s prio %3d: %4u / %4u bytes used (%u %%)", t.name, t.priority,
+			    used, t.stackSize, t.stackSize != 0 ? used * 100U / t.stackSize : 0);
+	}
+	return 0;
+}
+
+// memory slabs of the application, "west build -t ram_budget" gives the static RAM of all subsystems
+#if !defined(CONFIG_APP_ROLE_CENTRAL)
+extern struct k_mem_slab frameSlab;
+#endif
+extern struct k_mem_slab linkSlab;
+extern struct k_mem_slab sensorSlab;
+
+static int cmd_ram(const struct shell *shell, size_t argc, char **argv)
+{
+	static const struct
+	{
+		const char *name;
+		struct k_mem_slab *slab;
+	} pools[] = {
+#if !defined(CONFIG_APP_ROLE_CENTRAL)
+		{"uplink frames", &frameSlab},
+#endif
+		{"gatt links", &linkSlab},
+		{"sensors", &sensorSlab},
+	};
+
+	for (uint8_t i = 0; i < ARRAY_SIZE(pools); i++)
+	{
+		struct k_mem_slab *slab = pools[i].slab;
+
+		shell_print(shell, "%-14s %2u / %2u blocks of %4u bytes used", pools[i].name,
+			    k_mem_slab_num_used_get(slab), slab->num_blocks, (uint32_t) slab->block_size);
+	}
+	return 0;
+}
+
+static int cmd_reset(const struct shell *shell, size_t argc, char **argv)
+{
+	reset_all();
+	shell_print(shell, "statistics cleared");
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(diag_cmds,
+	SHELL_CMD(latency, NULL, "Latency histograms sensor -> application", cmd_latency),
+	SHELL_CMD(cpu, NULL, "Cycles of the subsystems and CPU share of the threads", cmd_cpu),
+	SHELL_CMD(stacks, NULL, "Stack high-water mark of all threads", cmd_stacks),
+	SHELL_CMD(ram, NULL, "Use of the memory slabs of the application", cmd_ram),
+	SHELL_CMD(reset, NULL, "Clear all statistics", cmd_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(diag, &diag_cmds, "Diagnostics of the board", NULL);
+
+#endif /* CONFIG_APP_DIAG_SHELL */
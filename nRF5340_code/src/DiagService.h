@@ -0,0 +1,65 @@
+/**
+ * @file    DiagService.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Diagnostic GATT service and shell commands,
+ *          exposes the profiling data of the running board
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef DIAG_SERVICE_H_
+#define DIAG_SERVICE_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <bluetooth/gatt.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+#define DIAG_SERVICE_UUID       0xd4, 0x86, 0x48, 0x24, 0x54, 0xB3, 0x43, 0xA1, \
+                                0xBC, 0x20, 0x97, 0x8F, 0x00, 0xD1, 0xC2, 0x75
+
+#define DIAG_CHARACTERISTIC_UUID 0xd4, 0x86, 0x48, 0x24, 0x54, 0xB3, 0x43, 0xA1, \
+                                0xBC, 0x20, 0x97, 0x8F, 0x01, 0xD1, 0xC2, 0x75
+
+#define BT_UUID_DIAG_SERVICE    BT_UUID_DECLARE_128(DIAG_SERVICE_UUID)
+#define BT_UUID_DIAG_PAGE       BT_UUID_DECLARE_128(DIAG_CHARACTERISTIC_UUID)
+
+#define DIAG_VERSION            3
+
+/*
+ * The client writes the page to read: [page, arg0, arg1]
+ * and reads the page afterwards (long read for pages > MTU - 1).
+ * All values are little endian.
+ *
+ * DIAG_PAGE_INFO:      version, sensors, stages, buckets, log2 of the first bucket limit in us,
+ *                      subsystems
+ * DIAG_PAGE_LATENCY:   arg0 sensor, arg1 stage (see Latency.h)
+ *                      count (4), max in us (4), buckets (4 each)
+ * DIAG_PAGE_CPU:       cycles per second (4), thread samples (4),
+ *                      per subsystem (see CpuStats.h): calls (4), max cycles (4), total cycles (8)
+ * DIAG_PAGE_THREAD:    arg0 thread index, empty if the thread does not exist
+ *                      name (16), stack size (4), unused stack (4), samples (4), priority (1)
+ * DIAG_PAGE_LINKS:     arg0 index of the connection, empty if not monitored (LinkMonitor.h)
+ *                      TYPE_* of the sensor or 0 for an application (1), central (1),
+ *                      state (1), RSSI and lowest RSSI in dBm (1 + 1), PHY (1),
+ *                      interval, latency, timeout (2 each), notifications received,
+ *                      lost, gaps, longest gap in ms, period in us (4 each), loss in 1/1000 (2)
+ * DIAG_CMD_RESET:      write only, clears all statistics
+ */
+#define DIAG_PAGE_INFO          0x00
+#define DIAG_PAGE_LATENCY       0x01
+#define DIAG_PAGE_CPU           0x02
+#define DIAG_PAGE_THREAD        0x03
+#define DIAG_PAGE_LINKS         0x04
+#define DIAG_CMD_RESET          0xFF
+
+// largest page
+#define DIAG_PAGE_MAX_SIZE      128
+
+#endif /* DIAG_SERVICE_H_ */
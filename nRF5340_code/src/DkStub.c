@@ -0,0 +1,31 @@
+/*
+ * Buttons and LEDs for boards without them (nrf52_bsim), used when
+ * CONFIG_DK_LIBRARY is disabled. The LEDs only show the connection state.
+ */
+
+#include <dk_buttons_and_leds.h>
+
+int dk_leds_init(void)
+{
+	return 0;
+}
+
+int dk_buttons_init(button_handler_t button_handler)
+{
+	return 0;
+}
+
+int dk_set_led(uint8_t led_idx, uint32_t val)
+{
+	return 0;
+}
+
+int dk_set_led_on(uint8_t led_idx)
+{
+	return 0;
+}
+
+int dk_set_led_off(uint8_t led_idx)
+{
+	return 0;
+}
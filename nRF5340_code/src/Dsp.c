@@ -0,0 +1,73 @@
+#include "Dsp.h"
+
+#include <string.h>
+
+/*---------------------------------------------------------------------------
+ * square root
+ *--------------------------------------------------------------------------*/
+uint32_t dsp_isqrt64(uint64_t value)
+{
+	uint64_t result = 0;
+	uint64_t bit = (uint64_t) 1 << 62;
+
+	while (bit > value)
+	{
+		bit >>= 2;
+	}
+	while (bit != 0)
+	{
+		if (value >= result + bit)
+		{
+			value -= result + bit;
+			result = (result >> 1) + bit;
+		}
+		else
+		{
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint32_t) result;
+}
+
+/*---------------------------------------------------------------------------
+ * median
+ *--------------------------------------------------------------------------*/
+void dsp_median_init_q15(struct dsp_median_q15 *m, uint8_t len)
+{
+	memset(m, 0, sizeof(*m));
+	m->len = len > DSP_MEDIAN_MAX ? DSP_MEDIAN_MAX : len;
+}
+
+void dsp_median_q15(struct dsp_median_q15 *m, const int16_t *in, int16_t *out, uint16_t n)
+{
+	for (uint16_t i = 0; i < n; i++)
+	{
+		int16_t sample = in[i];
+		uint8_t j;
+
+		if (m->count == m->len)
+		{
+			// remove the oldest sample from the sorted window
+			int16_t oldest = m->history[m->pos];
+			for (j = 0; m->sorted[j] != oldest; j++)
+			{
+			}
+			memmove(&m->sorted[j], &m->sorted[j + 1], (m->count - j - 1) * sizeof(int16_t));
+			m->count--;
+		}
+
+		// insert the new sample
+		for (j = m->count; j > 0 && m->sorted[j - 1] > sample; j--)
+		{
+			m->sorted[j] = m->sorted[j - 1];
+		}
+		m->sorted[j] = sample;
+		m->count++;
+
+		m->history[m->pos] = sample;
+		m->pos = m->pos + 1 == m->len ? 0 : m->pos + 1;
+
+		out[i] = m->sorted[m->count / 2];
+	}
+}
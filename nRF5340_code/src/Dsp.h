@@ -0,0 +1,72 @@
+/**
+ * @file    Dsp.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Fixed point kernels of the sensor streams: integer square root
+ *          (RMS, RMSSD, SDNN) and the median of the last N samples
+ *          (rejection of the artifacts of the RR intervals). The results
+ *          are checked against known answers on the board ("dsp check"
+ *          shell command) and on the host (tools/dsp_bench).
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef DSP_H_
+#define DSP_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// maximum length of the median filter
+#define DSP_MEDIAN_MAX 15
+
+/**
+ * @brief median of the last 'len' samples (odd, at most DSP_MEDIAN_MAX),
+ *        the sorted window is updated with every sample, O(len)
+ */
+struct dsp_median_q15
+{
+	int16_t history[DSP_MEDIAN_MAX];
+	int16_t sorted[DSP_MEDIAN_MAX];
+	uint8_t len;
+	uint8_t pos;
+	uint8_t count;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief integer square root
+ *
+ * @param value radicand
+ * @return uint32_t floor of the square root
+ */
+uint32_t dsp_isqrt64(uint64_t value);
+
+/**
+ * @brief initialize a median filter
+ *
+ * @param m median filter
+ * @param len window length, odd, at most DSP_MEDIAN_MAX
+ */
+void dsp_median_init_q15(struct dsp_median_q15 *m, uint8_t len);
+
+/**
+ * @brief median of the window after each sample, in and out may be the same buffer
+ */
+void dsp_median_q15(struct dsp_median_q15 *m, const int16_t *in, int16_t *out, uint16_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DSP_H_ */
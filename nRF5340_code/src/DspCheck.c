@@ -0,0 +1,229 @@
+#include "DspCheck.h"
+#include "Dsp.h"
+
+#if defined(CONFIG_APP_DSP_CHECK)
+#include <kernel.h>
+#include <shell/shell.h>
+#include "CpuStats.h"
+#endif
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+#define KNOWN_ISQRT     15
+#define KNOWN_MEDIAN    17
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+static const char *const names[DSP_CHECK_KERNELS] = {
+	"isqrt", "median5"
+};
+
+// hashes of dsp_check_run() of the correct kernels, a change of a kernel
+// which changes its results has to change these values on purpose
+static const uint32_t expectedHashes[DSP_CHECK_KERNELS] = {
+	0x7ae9af5b, 0xc94f4dda
+};
+
+// exact roots, around the squares and at the limits of 64 bits
+static const uint64_t isqrtIn[KNOWN_ISQRT] = {
+	0, 1, 2, 3, 4, 15, 16, 17, 99, 100,
+	0xFFFFFFFFull, 0x100000000ull, 0xFFFFFFFE00000000ull, 0xFFFFFFFE00000001ull,
+	0xFFFFFFFFFFFFFFFFull
+};
+static const uint32_t isqrtOut[KNOWN_ISQRT] = {
+	0, 1, 1, 1, 2, 3, 4, 4, 9, 10,
+	65535, 65536, 4294967294u, 4294967295u,
+	4294967295u
+};
+
+// median of 5: growing window, outliers and the limits of Q15
+static const int16_t medianIn[KNOWN_MEDIAN] = {
+	5, 1, 4, 2, 3, 9, -7, 8, 8, 0,
+	INT16_MAX, INT16_MIN, INT16_MAX, INT16_MIN, INT16_MAX, INT16_MIN, INT16_MIN
+};
+static const int16_t medianOut[KNOWN_MEDIAN] = {
+	5, 5, 4, 4, 3, 3, 3, 3, 8, 8,
+	8, 8, 8, 0, INT16_MAX, INT16_MIN, INT16_MIN
+};
+
+// block sizes of the runs, the state must be carried over correctly
+static const uint8_t blocks[] = {1, 7, 32, 64, 3, 85, 64};
+
+static int16_t input[DSP_CHECK_SAMPLES];
+static int16_t output[DSP_CHECK_SAMPLES];
+static struct dsp_median_q15 median;
+
+static void make_input(void)
+{
+	uint32_t x = 12345;
+
+	// ramp, square wave and noise, with some saturated samples
+	for (uint16_t i = 0; i < DSP_CHECK_SAMPLES; i++)
+	{
+		x = x * 1664525u + 1013904223u;
+		int32_t value = (int32_t) (i * 64) - 8192 + ((i / 16) % 2 ? 12000 : -12000)
+				+ ((int32_t) (x >> 16) - 32768) / 4;
+		input[i] = value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t) value;
+	}
+}
+
+static uint32_t hash_byte(uint32_t hash, uint8_t byte)
+{
+	return (hash ^ byte) * 16777619u;
+}
+
+static uint32_t hash_samples(uint32_t hash, const int16_t *samples, uint16_t n)
+{
+	for (uint16_t i = 0; i < n; i++)
+	{
+		hash = hash_byte(hash, (uint8_t) samples[i]);
+		hash = hash_byte(hash, (uint8_t) ((uint16_t) samples[i] >> 8));
+	}
+	return hash;
+}
+
+// square roots of all magnitudes up to 64 bits
+static uint32_t run_isqrt(uint32_t hash)
+{
+	uint64_t x = 12345;
+
+	for (uint16_t i = 0; i < DSP_CHECK_SAMPLES; i++)
+	{
+		x = x * 6364136223846793005ull + 1442695040888963407ull;
+		uint32_t root = dsp_isqrt64(x >> (i % 64));
+
+		for (uint8_t b = 0; b < 4; b++)
+		{
+			hash = hash_byte(hash, (uint8_t) (root >> (8 * b)));
+		}
+	}
+	return hash;
+}
+
+static uint32_t run_median(uint32_t hash)
+{
+	uint16_t done = 0;
+	uint8_t b = 0;
+
+	make_input();
+	dsp_median_init_q15(&median, 5);
+	while (done < DSP_CHECK_SAMPLES)
+	{
+		uint16_t n = blocks[b++ % sizeof(blocks)];
+
+		if (n > DSP_CHECK_SAMPLES - done)
+		{
+			n = DSP_CHECK_SAMPLES - done;
+		}
+		dsp_median_q15(&median, &input[done], output, n);
+		hash = hash_samples(hash, output, n);
+		done += n;
+	}
+	return hash;
+}
+
+const char *dsp_check_name(uint8_t kernel)
+{
+	return kernel < DSP_CHECK_KERNELS ? names[kernel] : "?";
+}
+
+uint32_t dsp_check_run(uint8_t kernel, uint32_t hash)
+{
+	switch (kernel)
+	{
+	case 0:
+		return run_isqrt(hash);
+	case 1:
+		return run_median(hash);
+	default:
+		return hash;
+	}
+}
+
+uint32_t dsp_check_expected(uint8_t kernel)
+{
+	return kernel < DSP_CHECK_KERNELS ? expectedHashes[kernel] : 0;
+}
+
+int dsp_check_known(uint8_t kernel)
+{
+	if (kernel == 0)
+	{
+		for (uint8_t i = 0; i < KNOWN_ISQRT; i++)
+		{
+			if (dsp_isqrt64(isqrtIn[i]) != isqrtOut[i])
+			{
+				return i + 1;
+			}
+		}
+	}
+	else if (kernel == 1)
+	{
+		int16_t out[KNOWN_MEDIAN];
+
+		dsp_median_init_q15(&median, 5);
+		dsp_median_q15(&median, medianIn, out, KNOWN_MEDIAN);
+		for (uint8_t i = 0; i < KNOWN_MEDIAN; i++)
+		{
+			if (out[i] != medianOut[i])
+			{
+				return i + 1;
+			}
+		}
+	}
+	else
+	{
+		return 0;
+	}
+	return dsp_check_run(kernel, DSP_CHECK_HASH_INIT) == expectedHashes[kernel] ? 0 : -1;
+}
+
+#if defined(CONFIG_APP_DSP_CHECK)
+static uint32_t run_timed(uint8_t kernel, uint32_t *hash)
+{
+	uint32_t start;
+	uint32_t cycles;
+	unsigned int key;
+
+	key = irq_lock();
+	start = cpu_stats_begin();
+	*hash = dsp_check_run(kernel, DSP_CHECK_HASH_INIT);
+	cycles = cpu_stats_begin() - start;
+	irq_unlock(key);
+	return cycles;
+}
+
+static int cmd_check(const struct shell *shell, size_t argc, char **argv)
+{
+	bool correct = true;
+
+	shell_print(shell, "cycle counter %u Hz", cpu_stats_cycles_per_sec());
+	for (uint8_t k = 0; k < DSP_CHECK_KERNELS; k++)
+	{
+		uint32_t hash;
+		uint32_t cycles = run_timed(k, &hash);
+		int known = dsp_check_known(k);
+
+		correct = correct && known == 0;
+		if (known > 0)
+		{
+			shell_print(shell, "%-8s %7u cycles, known answer %d WRONG", dsp_check_name(k), cycles, known - 1);
+		}
+		else
+		{
+			shell_print(shell, "%-8s %7u cycles, hash %08x expected %08x %s", dsp_check_name(k), cycles,
+				    hash, dsp_check_expected(k), known == 0 ? "" : "MISMATCH");
+		}
+	}
+	shell_print(shell, "%s", correct ? "all kernels correct" : "KERNELS WRONG");
+	return correct ? 0 : -EIO;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(dsp_cmds,
+	SHELL_CMD(check, NULL, "Check and time the DSP kernels with their known answers", cmd_check),
+	SHELL_SUBCMD_SET_END
+);
+SHELL_CMD_REGISTER(dsp, &dsp_cmds, "DSP kernels", NULL);
+#endif /* CONFIG_APP_DSP_CHECK */
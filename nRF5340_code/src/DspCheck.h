@@ -0,0 +1,75 @@
+/**
+ * @file    DspCheck.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Known answers of the DSP kernels: short vectors with their
+ *          expected outputs and the expected hash of the outputs of a
+ *          longer fixed input, checked on the board ("dsp check") and on
+ *          the host (tools/dsp_bench)
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef DSP_CHECK_H_
+#define DSP_CHECK_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+#define DSP_CHECK_KERNELS   2
+#define DSP_CHECK_SAMPLES   256
+
+// start value of the FNV-1a hash
+#define DSP_CHECK_HASH_INIT 2166136261u
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief name of a kernel
+ *
+ * @param kernel 0 to DSP_CHECK_KERNELS - 1
+ * @return const char* name
+ */
+const char *dsp_check_name(uint8_t kernel);
+
+/**
+ * @brief run a kernel over the fixed input (DSP_CHECK_SAMPLES samples
+ *        in blocks of different sizes), starting with a cleared state
+ *
+ * @param kernel 0 to DSP_CHECK_KERNELS - 1
+ * @param hash hash of the previous outputs, DSP_CHECK_HASH_INIT at the start
+ * @return uint32_t hash including the outputs of this kernel
+ */
+uint32_t dsp_check_run(uint8_t kernel, uint32_t hash);
+
+/**
+ * @brief expected hash of a kernel
+ *
+ * @param kernel 0 to DSP_CHECK_KERNELS - 1
+ * @return uint32_t dsp_check_run(kernel, DSP_CHECK_HASH_INIT) of a correct kernel
+ */
+uint32_t dsp_check_expected(uint8_t kernel);
+
+/**
+ * @brief compare a kernel with its known answers and its expected hash
+ *
+ * @param kernel 0 to DSP_CHECK_KERNELS - 1
+ * @return int 0 if correct, else the number of the first wrong known answer + 1,
+ *         -1 for a wrong hash
+ */
+int dsp_check_known(uint8_t kernel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DSP_CHECK_H_ */
@@ -0,0 +1,120 @@
+#include "EventLog.h"
+
+#include <kernel.h>
+#include <sys/ring_buffer.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// time stamp + 3 arguments
+#define RECORD_MAX_WORDS 4
+
+// drain period of the log thread
+#define DRAIN_PERIOD_MS 50
+
+#define THREAD_STACK_SIZE 768
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+RING_BUF_ITEM_DECLARE_POW2(elogBuffer, CONFIG_APP_ELOG_BUFFER_POW2);
+
+// several producers (BT RX thread, system workqueue, ...) -> protect the put
+static struct k_spinlock lock;
+
+static atomic_t dropped;
+
+#if !defined(CONFIG_APP_ELOG_BINARY)
+// format strings, only needed when the records are formatted on the board
+static const char *const formats[] = {
+#define ELOG_EVENT(name, level, format) format,
+#include "EventLogEvents.h"
+#undef ELOG_EVENT
+};
+#endif
+
+void elog_write(uint8_t id, uint8_t nargs, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+	uint32_t data[RECORD_MAX_WORDS] = {k_cycle_get_32(), a0, a1, a2};
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	int err = ring_buf_item_put(&elogBuffer, id, nargs, data, nargs + 1);
+
+	k_spin_unlock(&lock, key);
+
+	if (err)
+	{
+		atomic_inc(&dropped);
+	}
+}
+
+#if defined(CONFIG_APP_ELOG_BINARY)
+/*
+ * raw record as hex line for tools/elog_decode.py:
+ * #EL <id> <nargs> <time stamp in cycles> <args>
+ */
+static void output(uint16_t id, uint8_t nargs, const uint32_t *data)
+{
+	printk("#EL %02x %x %08x", id, nargs, data[0]);
+	for (uint8_t i = 1; i <= nargs; i++)
+	{
+		printk(" %08x", data[i]);
+	}
+	printk("\n");
+}
+#else
+static void output(uint16_t id, uint8_t nargs, const uint32_t *data)
+{
+	if (id >= ELOG_EVENT_COUNT)
+	{
+		return;
+	}
+	printk("[%u ms] ", k_cyc_to_ms_floor32(data[0]));
+	printk(formats[id], data[1], data[2], data[3]);
+	printk("\n");
+}
+#endif
+
+static void drain_thread(void *p1, void *p2, void *p3)
+{
+	uint32_t data[RECORD_MAX_WORDS];
+	uint16_t id;
+	uint8_t nargs;
+	uint8_t size;
+
+	while (1)
+	{
+		k_sleep(K_MSEC(DRAIN_PERIOD_MS));
+
+		while (1)
+		{
+			size = RECORD_MAX_WORDS;
+			k_spinlock_key_t key = k_spin_lock(&lock);
+			int err = ring_buf_item_get(&elogBuffer, &id, &nargs, data, &size);
+
+			k_spin_unlock(&lock, key);
+			if (err)
+			{
+				break;
+			}
+
+			// unused arguments are formatted as 0
+			for (uint8_t i = size; i < RECORD_MAX_WORDS; i++)
+			{
+				data[i] = 0;
+			}
+			output(id, nargs, data);
+		}
+
+		atomic_val_t lost = atomic_set(&dropped, 0);
+
+		if (lost)
+		{
+			data[0] = k_cycle_get_32();
+			data[1] = lost;
+			output(ELOG_DROPPED, 1, data);
+		}
+	}
+}
+
+K_THREAD_DEFINE(elog_thread, THREAD_STACK_SIZE, drain_thread, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
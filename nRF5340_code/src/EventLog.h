@@ -0,0 +1,99 @@
+/**
+ * @file    EventLog.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Deferred binary event log for the real time paths:
+ *          a log point stores only the event id, a time stamp and
+ *          up to three arguments in a ring buffer, a low priority
+ *          thread formats the records later
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef EVENT_LOG_H_
+#define EVENT_LOG_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+#define ELOG_LEVEL_NONE 0
+#define ELOG_LEVEL_ERR  1
+#define ELOG_LEVEL_WRN  2
+#define ELOG_LEVEL_INF  3
+#define ELOG_LEVEL_DBG  4
+
+// event ids, ELOG_<name>
+enum elog_event
+{
+#define ELOG_EVENT(name, level, format) ELOG_##name,
+#include "EventLogEvents.h"
+#undef ELOG_EVENT
+	ELOG_EVENT_COUNT
+};
+
+// level of every event, ELOG_LEVEL_OF_<name>
+enum elog_event_level
+{
+#define ELOG_EVENT(name, level, format) ELOG_LEVEL_OF_##name = level,
+#include "EventLogEvents.h"
+#undef ELOG_EVENT
+};
+
+#if defined(CONFIG_APP_ELOG)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief write one record into the ring buffer, use the ELOGx macros
+ *
+ * @param id event id
+ * @param nargs number of valid arguments
+ * @param a0 first argument
+ * @param a1 second argument
+ * @param a2 third argument
+ */
+void elog_write(uint8_t id, uint8_t nargs, uint32_t a0, uint32_t a1, uint32_t a2);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * the level check is a constant expression, log points above
+ * CONFIG_APP_ELOG_LEVEL are removed by the compiler
+ */
+#define ELOG_WRITE(name, nargs, a0, a1, a2)                                     \
+	do {                                                                    \
+		if (ELOG_LEVEL_OF_##name <= CONFIG_APP_ELOG_LEVEL) {            \
+			elog_write(ELOG_##name, nargs, (uint32_t) (a0),         \
+				   (uint32_t) (a1), (uint32_t) (a2));           \
+		}                                                               \
+	} while (0)
+#else
+
+static inline void elog_write(uint8_t id, uint8_t nargs, uint32_t a0, uint32_t a1, uint32_t a2) {}
+
+// production builds: no code, no format strings, arguments are not evaluated
+#define ELOG_WRITE(name, nargs, a0, a1, a2)                                     \
+	do {                                                                    \
+		(void) sizeof(a0);                                              \
+		(void) sizeof(a1);                                              \
+		(void) sizeof(a2);                                              \
+	} while (0)
+#endif
+
+#define ELOG0(name)             ELOG_WRITE(name, 0, 0, 0, 0)
+#define ELOG1(name, a0)         ELOG_WRITE(name, 1, a0, 0, 0)
+#define ELOG2(name, a0, a1)     ELOG_WRITE(name, 2, a0, a1, 0)
+#define ELOG3(name, a0, a1, a2) ELOG_WRITE(name, 3, a0, a1, a2)
+
+#endif /* EVENT_LOG_H_ */
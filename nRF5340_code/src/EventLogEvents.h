@@ -0,0 +1,63 @@
+/**
+ * @file    EventLogEvents.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Table of all event log points
+ *          ELOG_EVENT(name, level, format)
+ *          the index in this table is the id in the binary records,
+ *          append new events at the end -> tools/elog_decode.py reads this file
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+// no include guard, the table is expanded several times
+
+// data service
+ELOG_EVENT(RX_WRITE,            ELOG_LEVEL_DBG, "Received data, handle %u, length %u, first byte 0x%02x")
+ELOG_EVENT(TX_SENT,             ELOG_LEVEL_DBG, "Data sent to subscriber %u")
+ELOG_EVENT(TX_ERROR,            ELOG_LEVEL_ERR, "Error, unable to send notification (err %d)")
+ELOG_EVENT(TX_NO_FRAME,         ELOG_LEVEL_WRN, "Warning, no free uplink frame")
+ELOG_EVENT(TX_TOO_LONG,         ELOG_LEVEL_ERR, "Error, frame too long (%u bytes)")
+
+// sensor data
+ELOG_EVENT(SPEED,               ELOG_LEVEL_INF, "Speed: %u (km/h * 100), event at %u ms")
+ELOG_EVENT(CADENCE,             ELOG_LEVEL_INF, "Cadence rpm: %u, event at %u ms")
+ELOG_EVENT(HEART_RATE,          ELOG_LEVEL_INF, "[NOTIFICATION] Heart Rate %u bpm at %u ms")
+ELOG_EVENT(HR_UNKNOWN_FORMAT,   ELOG_LEVEL_WRN, "[NOTIFICATION] heart rate data length %u")
+ELOG_EVENT(HR_UNSUBSCRIBED,     ELOG_LEVEL_INF, "[UNSUBSCRIBED]")
+// unused since the debug print of calcSpeed() is removed, kept for the ids of the later events
+ELOG_EVENT(SPEED_TOTAL_TIME,    ELOG_LEVEL_DBG, "Total time is: %u")
+ELOG_EVENT(UNKNOWN_TYPE,        ELOG_LEVEL_WRN, "Unknown type %u")
+
+// connection handling
+ELOG_EVENT(SENSOR_FOUND,        ELOG_LEVEL_INF, "Correct sensor found (sensor %u)")
+ELOG_EVENT(BATTERY_DISCOVERY,   ELOG_LEVEL_DBG, "Nbr connections %u")
+
+// event log itself
+ELOG_EVENT(DROPPED,             ELOG_LEVEL_WRN, "Event log overflow, %u records dropped")
+
+// time base
+ELOG_EVENT(SENSOR_CLOCK,        ELOG_LEVEL_DBG, "Sensor clock window: offset %d ms, drift %d ppm")
+
+// cycling power
+ELOG_EVENT(POWER,               ELOG_LEVEL_INF, "Power: %u W, at %u ms")
+
+// passive ingestion of broadcast measurements
+ELOG_EVENT(INGEST_ALLOWLIST,    ELOG_LEVEL_INF, "Broadcasting sensors allowlisted: %u")
+ELOG_EVENT(INGEST_OUT_OF_ORDER, ELOG_LEVEL_DBG, "Older broadcast measurement of sensor %u dropped")
+
+// inventory of the nearby devices
+ELOG_EVENT(INVENTORY_FULL,      ELOG_LEVEL_DBG, "Inventory full, device with %d dBm not added")
+ELOG_EVENT(INVENTORY_FRAME,     ELOG_LEVEL_DBG, "Inventory frame with %u devices")
+
+// streams of the applications
+ELOG_EVENT(STREAMS,             ELOG_LEVEL_INF, "Streams of subscriber %u: 0x%x")
+
+// state of the sensor values by time (SensorWatch)
+ELOG_EVENT(SENSOR_STATE,        ELOG_LEVEL_INF, "Value of type %u is in state %u")
+
+// quality of the connections (LinkMonitor)
+ELOG_EVENT(LINK_STATE,          ELOG_LEVEL_WRN, "Link of type %u in state %u, rssi %d dBm")
+ELOG_EVENT(LINK_LOST,           ELOG_LEVEL_WRN, "Link of type %u lost, reason 0x%x, %u notifications lost")
@@ -0,0 +1,401 @@
+#include "GattOps.h"
+
+#include <kernel.h>
+#include <string.h>
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+// the callbacks run in the BT RX thread and the retry in the system work queue,
+// both threads are cooperative and can not preempt each other
+K_MEM_SLAB_DEFINE(linkSlab, sizeof(struct gatt_link), GATT_MAX_LINKS, 4);
+
+// link of every connection, by the index of the connection
+static struct gatt_link *linkOf[CONFIG_BT_MAX_CONN];
+
+// links waiting for the discovery manager, served in order
+static struct gatt_link *dmQueue[GATT_MAX_LINKS];
+static uint8_t dmCount;
+
+// link of the discovery in progress, NULL if the discovery manager is free
+static struct gatt_link *dmOwner;
+
+static struct k_delayed_work dmRetryWork;
+static bool initialized;
+
+static void advance(struct gatt_link *link);
+
+/*---------------------------------------------------------------------------
+ * STEPS
+ *--------------------------------------------------------------------------*/
+static bool link_idle(const struct gatt_link *link)
+{
+	for (uint8_t op = 0; op < GATT_OP_COUNT; op++)
+	{
+		if (link->running[op] >= 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// step of an operation in progress, NULL if the link has none (e.g. closed)
+static const struct gatt_step *running_step(struct gatt_link *link, uint8_t op)
+{
+	return link->steps != NULL && link->running[op] >= 0 ? &link->steps[link->running[op]] : NULL;
+}
+
+// an operation of the link completed, only the state is updated
+static void step_done(struct gatt_link *link, uint8_t op, int err)
+{
+	int8_t index = link->running[op];
+
+	if (index < 0)
+	{
+		return;
+	}
+	link->running[op] = -1;
+	if (link->waitFor == index)
+	{
+		link->waitFor = -1;
+	}
+	if (err && !(link->steps[index].flags & GATT_STEP_OPTIONAL) && link->err == 0)
+	{
+		link->err = err;
+	}
+}
+
+/*---------------------------------------------------------------------------
+ * DISCOVERY
+ *--------------------------------------------------------------------------*/
+static void dm_remove(struct gatt_link *link)
+{
+	uint8_t j = 0;
+
+	for (uint8_t i = 0; i < dmCount; i++)
+	{
+		if (dmQueue[i] != link)
+		{
+			dmQueue[j++] = dmQueue[i];
+		}
+	}
+	dmCount = j;
+}
+
+// the discovery manager is free, a link closed during its discovery goes back to the slab
+static void dm_release(struct gatt_link *link)
+{
+	dmOwner = NULL;
+	if (link->conn == NULL)
+	{
+		k_mem_slab_free(&linkSlab, (void **) &link);
+	}
+}
+
+static void dm_completed(struct bt_gatt_dm *dm, void *context)
+{
+	struct gatt_link *link = (struct gatt_link *) context;
+	const struct gatt_step *step = running_step(link, GATT_OP_DISCOVER);
+	int err = 0;
+
+	// the handles are taken before the data is released
+	bool current = step != NULL && link->conn == bt_gatt_dm_conn_get(dm);
+	if (current && step->done)
+	{
+		err = step->done(link, dm);
+	}
+	if (bt_gatt_dm_data_release(dm))
+	{
+		printk("Could not release discovery data\n");
+	}
+
+	dm_release(link);
+	if (current)
+	{
+		step_done(link, GATT_OP_DISCOVER, err);
+		advance(link);
+	}
+	else
+	{
+		advance(NULL);
+	}
+}
+
+static void dm_failed(struct bt_conn *conn, struct gatt_link *link, int err)
+{
+	bool current = link->conn == conn && running_step(link, GATT_OP_DISCOVER) != NULL;
+
+	dm_release(link);
+	if (current)
+	{
+		step_done(link, GATT_OP_DISCOVER, err);
+		advance(link);
+	}
+	else
+	{
+		advance(NULL);
+	}
+}
+
+static void dm_service_not_found(struct bt_conn *conn, void *context)
+{
+	dm_failed(conn, (struct gatt_link *) context, -ENOENT);
+}
+
+static void dm_error_found(struct bt_conn *conn, int err, void *context)
+{
+	printk("The discovery procedure failed, err %d\n", err);
+	dm_failed(conn, (struct gatt_link *) context, err);
+}
+
+static struct bt_gatt_dm_cb dmCallbacks = {
+	.completed = dm_completed,
+	.service_not_found = dm_service_not_found,
+	.error_found = dm_error_found,
+};
+
+// start the discovery of the first waiting link
+static void dm_next(void)
+{
+	while (dmOwner == NULL && dmCount > 0)
+	{
+		struct gatt_link *link = dmQueue[0];
+		const struct gatt_step *step = running_step(link, GATT_OP_DISCOVER);
+		int err = bt_gatt_dm_start(link->conn, step->service(), &dmCallbacks, link);
+
+		if (err == -EALREADY)
+		{
+			// discovery of another module (e.g. the motion client)
+			k_delayed_work_submit(&dmRetryWork, K_MSEC(GATT_DM_RETRY_MS));
+			return;
+		}
+
+		dm_remove(link);
+		if (err)
+		{
+			printk("Could not start service discovery, err %d\n", err);
+			step_done(link, GATT_OP_DISCOVER, err);
+			advance(link);
+		}
+		else
+		{
+			dmOwner = link;
+		}
+	}
+}
+
+static void dm_retry(struct k_work *work)
+{
+	dm_next();
+}
+
+/*---------------------------------------------------------------------------
+ * SUBSCRIBE AND READ
+ *--------------------------------------------------------------------------*/
+static void subscribe_written(struct bt_conn *conn, uint8_t err, struct bt_gatt_write_params *params)
+{
+	struct gatt_link *link = gatt_link_find(conn);
+
+	if (link != NULL && running_step(link, GATT_OP_SUBSCRIBE) != NULL)
+	{
+		const struct gatt_step *step = running_step(link, GATT_OP_SUBSCRIBE);
+		int result = err ? -EIO : 0;
+
+		if (!result && step->done)
+		{
+			result = step->done(link, NULL);
+		}
+		step_done(link, GATT_OP_SUBSCRIBE, result);
+		advance(link);
+	}
+}
+
+static uint8_t read_done(struct bt_conn *conn, uint8_t err, struct bt_gatt_read_params *params,
+			 const void *data, uint16_t length)
+{
+	struct gatt_link *link = CONTAINER_OF(params, struct gatt_link, read);
+	const struct gatt_step *step = running_step(link, GATT_OP_READ);
+	int result = err ? -EIO : 0;
+
+	if (link->conn != conn || step == NULL)
+	{
+		return BT_GATT_ITER_STOP;
+	}
+
+	// data is NULL at the end of a read without value
+	if (!result && data != NULL)
+	{
+		link->readLen = MIN(length, sizeof(link->readData));
+		memcpy(link->readData, data, link->readLen);
+		if (step->done)
+		{
+			result = step->done(link, NULL);
+		}
+	}
+	else if (!result)
+	{
+		result = -ENODATA;
+	}
+	step_done(link, GATT_OP_READ, result);
+	advance(link);
+	return BT_GATT_ITER_STOP;
+}
+
+// start the operation of a step, returns an error if it could not be started
+static int start_step(struct gatt_link *link, const struct gatt_step *step)
+{
+	int err;
+
+	switch (step->op)
+	{
+	case GATT_OP_DISCOVER:
+		// started by dm_next() when the discovery manager is free
+		dmQueue[dmCount++] = link;
+		return 0;
+
+	case GATT_OP_SUBSCRIBE:
+		link->subscribe.write = subscribe_written;
+		err = bt_gatt_subscribe(link->conn, &link->subscribe);
+		if (err == -EALREADY)
+		{
+			// subscribed before, no CCC write
+			err = step->done ? step->done(link, NULL) : 0;
+			step_done(link, GATT_OP_SUBSCRIBE, err);
+			return 0;
+		}
+		return err;
+
+	case GATT_OP_READ:
+		if (link->readHandle == 0)
+		{
+			return -ENOENT;
+		}
+		link->read.func = read_done;
+		link->read.handle_count = 1;
+		link->read.single.handle = link->readHandle;
+		link->read.single.offset = 0;
+		return bt_gatt_read(link->conn, &link->read);
+
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * Start the steps which do not wait for another one, finish the sequence when
+ * all started steps completed, then serve the discovery manager. Called after
+ * every completion, also with NULL to serve only the discovery manager.
+ */
+static void advance(struct gatt_link *link)
+{
+	while (link != NULL && link->steps != NULL && link->err == 0 &&
+	       link->next < link->nbrSteps && link->waitFor < 0)
+	{
+		uint8_t index = link->next;
+		const struct gatt_step *step = &link->steps[index];
+
+		if (link->running[step->op] >= 0)
+		{
+			// one operation of a kind at a time per link
+			break;
+		}
+		link->running[step->op] = index;
+		if (!(step->flags & GATT_STEP_PIPELINED))
+		{
+			link->waitFor = index;
+		}
+		link->next++;
+
+		int err = start_step(link, step);
+		if (err)
+		{
+			step_done(link, step->op, err);
+		}
+	}
+
+	if (link != NULL && link->steps != NULL && link_idle(link) &&
+	    (link->err != 0 || link->next == link->nbrSteps))
+	{
+		// the callback may start the next sequence
+		gatt_finished_t finished = link->finished;
+		link->steps = NULL;
+		link->ready = (link->err == 0);
+		finished(link, link->err);
+	}
+
+	dm_next();
+}
+
+/*---------------------------------------------------------------------------
+ * LINKS
+ *--------------------------------------------------------------------------*/
+struct gatt_link *gatt_link_open(struct bt_conn *conn, void *context)
+{
+	struct gatt_link *link;
+
+	if (!initialized)
+	{
+		initialized = true;
+		k_delayed_work_init(&dmRetryWork, dm_retry);
+	}
+
+	if (k_mem_slab_alloc(&linkSlab, (void **) &link, K_NO_WAIT))
+	{
+		return NULL;
+	}
+	memset(link, 0, sizeof(*link));
+	link->conn = conn;
+	link->context = context;
+	linkOf[bt_conn_index(conn)] = link;
+	return link;
+}
+
+void gatt_link_close(struct gatt_link *link)
+{
+	if (link == NULL)
+	{
+		return;
+	}
+
+	linkOf[bt_conn_index(link->conn)] = NULL;
+	dm_remove(link);
+	link->conn = NULL;
+	link->steps = NULL;
+	link->ready = false;
+
+	// a discovery in progress reports its end, it is ignored and the link freed then
+	if (link != dmOwner)
+	{
+		k_mem_slab_free(&linkSlab, (void **) &link);
+	}
+}
+
+struct gatt_link *gatt_link_find(struct bt_conn *conn)
+{
+	return conn != NULL ? linkOf[bt_conn_index(conn)] : NULL;
+}
+
+int gatt_link_run(struct gatt_link *link, const struct gatt_step *steps, uint8_t nbrSteps,
+		  gatt_finished_t finished)
+{
+	if (link->steps != NULL)
+	{
+		return -EBUSY;
+	}
+
+	link->steps = steps;
+	link->nbrSteps = nbrSteps;
+	link->next = 0;
+	link->waitFor = -1;
+	link->err = 0;
+	link->ready = false;
+	link->finished = finished;
+	for (uint8_t op = 0; op < GATT_OP_COUNT; op++)
+	{
+		link->running[op] = -1;
+	}
+
+	advance(link);
+	return 0;
+}
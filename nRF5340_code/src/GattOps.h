@@ -0,0 +1,151 @@
+/**
+ * @file    GattOps.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Asynchronous GATT operations of the central: discovery
+ *          (bt_gatt_dm), subscribe and read run as a sequence of steps
+ *          per connection. A step is started when the step before it
+ *          completed, or at once if the step before is pipelined. The
+ *          discovery manager serves one connection at a time, its
+ *          requests are queued. Every state of an operation is in the
+ *          link of its connection, nothing is shared between sensors.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef GATT_OPS_H_
+#define GATT_OPS_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/gatt.h>
+#include <bluetooth/gatt_dm.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// number of links, one per connected sensor and one of a closed link whose
+// discovery is still in progress, the links are blocks of a memory slab
+#define GATT_MAX_LINKS          (CONFIG_APP_SENSOR_LINKS + 1)
+
+// longest value of a read step
+#define GATT_READ_MAX_LEN       8
+
+// retry of a discovery while the discovery manager is used by another module
+#define GATT_DM_RETRY_MS        200
+
+// operations of a step
+#define GATT_OP_DISCOVER        0   // bt_gatt_dm of a service, done() takes the handles
+#define GATT_OP_SUBSCRIBE       1   // link->subscribe, filled by an earlier step
+#define GATT_OP_READ            2   // link->readHandle, done() gets the value in link->readData
+#define GATT_OP_COUNT           3
+
+// flags of a step
+#define GATT_STEP_PIPELINED     0x01    // the next step is started without waiting
+#define GATT_STEP_OPTIONAL      0x02    // an error does not stop the sequence
+
+struct gatt_link;
+
+/**
+ * @brief result of a step
+ *
+ * @param link link of the step
+ * @param dm discovery data of a GATT_OP_DISCOVER, released after the call, NULL otherwise
+ * @return int error code, 0 if success
+ */
+typedef int (*gatt_done_t)(struct gatt_link *link, struct bt_gatt_dm *dm);
+
+/**
+ * @brief end of a sequence
+ *
+ * @param link link of the sequence
+ * @param err first error of a step without GATT_STEP_OPTIONAL, -ENOENT if a
+ *            service was not found, 0 if success
+ */
+typedef void (*gatt_finished_t)(struct gatt_link *link, int err);
+
+// one step of a sequence, in static memory
+struct gatt_step
+{
+	uint8_t op;                             // GATT_OP_*
+	uint8_t flags;                          // GATT_STEP_*
+	const struct bt_uuid *(*service)(void); // service of a GATT_OP_DISCOVER
+	gatt_done_t done;                       // may be NULL
+};
+
+// the operations of one connection
+struct gatt_link
+{
+	struct bt_conn *conn;
+	void *context;                          // of the owner
+
+	const struct gatt_step *steps;
+	uint8_t nbrSteps;
+	uint8_t next;                           // next step to start
+	int8_t running[GATT_OP_COUNT];          // step of every operation in progress, -1 if none
+	int8_t waitFor;                         // step to complete before the next one, -1 if none
+	int err;
+	bool ready;                             // the sequence completed without error
+	gatt_finished_t finished;
+
+	struct bt_gatt_subscribe_params subscribe;
+	struct bt_gatt_read_params read;
+	uint16_t readHandle;
+	uint8_t readData[GATT_READ_MAX_LEN];
+	uint8_t readLen;
+};
+
+/**
+ * @brief take a link from the slab for a new connection
+ *
+ * @param conn the connection, no reference is taken
+ * @param context of the owner, e.g. the sensor of the connection
+ * @return struct gatt_link* the link, NULL if all links are used
+ */
+struct gatt_link *gatt_link_open(struct bt_conn *conn, void *context);
+
+/**
+ * @brief return the link of a disconnected connection to the slab, the
+ *        steps in progress are dropped and their callbacks ignored
+ *
+ * @param link the link, may be NULL
+ */
+void gatt_link_close(struct gatt_link *link);
+
+/**
+ * @brief link of a connection
+ *
+ * @param conn the connection
+ * @return struct gatt_link* the link, NULL if the connection has none
+ */
+struct gatt_link *gatt_link_find(struct bt_conn *conn);
+
+/**
+ * @brief link of the subscription of a notification
+ *
+ * @param params subscribe parameters of a GATT_OP_SUBSCRIBE
+ * @return struct gatt_link* the link
+ */
+static inline struct gatt_link *gatt_link_of(struct bt_gatt_subscribe_params *params)
+{
+	return CONTAINER_OF(params, struct gatt_link, subscribe);
+}
+
+/**
+ * @brief start a sequence of steps, the sequence before must be finished
+ *
+ * @param link the link
+ * @param steps the steps in static memory
+ * @param nbrSteps number of steps
+ * @param finished called at the end of the sequence, also on error
+ * @return int 0 if started, -EBUSY if a sequence is still running
+ */
+int gatt_link_run(struct gatt_link *link, const struct gatt_step *steps, uint8_t nbrSteps,
+		  gatt_finished_t finished);
+
+#endif /* GATT_OPS_H_ */
@@ -0,0 +1,89 @@
+#include "HrvWindow.h"
+#include "Dsp.h"
+
+static uint32_t squaredDiff(uint16_t a, uint16_t b)
+{
+    int32_t diff = (int32_t) a - (int32_t) b;
+    return (uint32_t) (diff * diff);
+}
+
+void HrvWindow::reset()
+{
+    head = 0;
+    cnt = 0;
+    sum = 0;
+    sumSquares = 0;
+    sumDiffSquares = 0;
+    dsp_median_init_q15(&median, HRV_MEDIAN);
+}
+
+bool HrvWindow::add(uint16_t rr1024)
+{
+    // 1/1024 s -> ms, rounded
+    uint16_t ms = (uint16_t) (((uint32_t) rr1024 * 1000 + 512) / 1024);
+
+    if (ms < HRV_RR_MIN_MS || ms > HRV_RR_MAX_MS)
+    {
+        return false;
+    }
+
+    int16_t sample = (int16_t) ms;
+    int16_t local;
+    dsp_median_q15(&median, &sample, &local, 1);
+    uint16_t limit = (uint16_t) local / HRV_ARTIFACT_DEN;
+    if (median.count == HRV_MEDIAN && (ms > local + limit || ms + limit < local))
+    {
+        return false;
+    }
+
+    if (cnt == HRV_WINDOW)
+    {
+        // remove the oldest interval and its difference to the next one
+        uint16_t oldest = rr[head];
+        sum -= oldest;
+        sumSquares -= (uint32_t) oldest * oldest;
+        sumDiffSquares -= squaredDiff(rr[(head + 1) % HRV_WINDOW], oldest);
+        cnt--;
+    }
+
+    if (cnt > 0)
+    {
+        sumDiffSquares += squaredDiff(ms, interval(0));
+    }
+    sum += ms;
+    sumSquares += (uint32_t) ms * ms;
+
+    rr[head] = ms;
+    head = (head + 1) % HRV_WINDOW;
+    cnt++;
+    return true;
+}
+
+uint16_t HrvWindow::rmssd() const
+{
+    if (cnt < 2)
+    {
+        return 0;
+    }
+    return (uint16_t) dsp_isqrt64(sumDiffSquares / (cnt - 1));
+}
+
+uint16_t HrvWindow::sdnn() const
+{
+    if (cnt < 2)
+    {
+        return 0;
+    }
+    // n * sum(x^2) - sum(x)^2 = n * (n - 1) * sample variance
+    uint64_t spread = (uint64_t) cnt * sumSquares - (uint64_t) sum * sum;
+    return (uint16_t) dsp_isqrt64(spread / ((uint64_t) cnt * (cnt - 1)));
+}
+
+uint16_t HrvWindow::interval(uint8_t age) const
+{
+    if (age >= cnt)
+    {
+        return 0;
+    }
+    return rr[(head + HRV_WINDOW - 1 - age) % HRV_WINDOW];
+}
@@ -0,0 +1,103 @@
+/**
+ * @file    HrvWindow.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Ring buffer of the last RR intervals with the heart rate
+ *          variability (RMSSD, SDNN) of the window. The sums are updated
+ *          with every beat, a new interval costs O(1). An interval far
+ *          from the median of the last ones (ectopic or missed beat) is
+ *          an artifact and not added.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef HRV_WINDOW_H_
+#define HRV_WINDOW_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+#include "Dsp.h"
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// number of RR intervals in the window, the host replay has no Kconfig
+#if defined(CONFIG_APP_HRV_WINDOW)
+#define HRV_WINDOW CONFIG_APP_HRV_WINDOW
+#else
+#define HRV_WINDOW 32
+#endif
+
+// plausible RR intervals in ms (240 to 25 bpm), others are artifacts
+#define HRV_RR_MIN_MS 250
+#define HRV_RR_MAX_MS 2400
+
+// an interval more than 1/HRV_ARTIFACT_DEN (20 %) off the median of the
+// last HRV_MEDIAN plausible intervals is an artifact
+#define HRV_MEDIAN 5
+#define HRV_ARTIFACT_DEN 5
+
+class HrvWindow {
+public:
+    /**
+     * @brief clear the window, no constructor (static objects)
+     */
+    void reset();
+
+    /**
+     * @brief add a RR interval of a heart rate measurement
+     *
+     * @param rr1024 interval in 1/1024 s as sent by the sensor
+     * @return true if the interval was plausible, no artifact and added
+     */
+    bool add(uint16_t rr1024);
+
+    /**
+     * @brief root mean square of the successive differences
+     *
+     * @return uint16_t RMSSD in ms, 0 with less than 2 intervals
+     */
+    uint16_t rmssd() const;
+
+    /**
+     * @brief standard deviation of the intervals
+     *
+     * @return uint16_t SDNN in ms, 0 with less than 2 intervals
+     */
+    uint16_t sdnn() const;
+
+    /**
+     * @brief number of intervals in the window
+     *
+     * @return uint8_t intervals, at most HRV_WINDOW
+     */
+    uint8_t count() const { return cnt; }
+
+    /**
+     * @brief get an interval of the window
+     *
+     * @param age 0 for the newest interval
+     * @return uint16_t interval in ms, 0 if not in the window
+     */
+    uint16_t interval(uint8_t age) const;
+
+private:
+    uint16_t rr[HRV_WINDOW];    // intervals in ms
+    uint8_t head;               // next write position = oldest interval if full
+    uint8_t cnt;
+
+    // running sums of the window, integers -> no drift
+    uint32_t sum;
+    uint64_t sumSquares;
+    uint64_t sumDiffSquares;
+
+    // median of the last plausible intervals, also of the artifacts:
+    // a lasting change of the heart rate moves the median after a few beats
+    struct dsp_median_q15 median;
+};
+
+#endif /* HRV_WINDOW_H_ */
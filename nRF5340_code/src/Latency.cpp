@@ -0,0 +1,98 @@
+#include "Latency.h"
+
+#include <kernel.h>
+#include <string.h>
+#if defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+#include <arch/arm/aarch32/cortex_m/cmsis.h>
+#endif
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+static struct latency_histogram histograms[LATENCY_SENSOR_COUNT][LATENCY_STAGE_COUNT];
+
+static uint8_t bucket_of(uint32_t us)
+{
+	uint8_t bucket = 0;
+
+	us >>= LATENCY_FIRST_BUCKET_LOG2;
+	while (us != 0 && bucket < LATENCY_BUCKETS - 1)
+	{
+		us >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+static void add(uint8_t sensor, uint8_t stage, uint32_t cycles)
+{
+	struct latency_histogram *h = &histograms[sensor][stage];
+#if defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+	uint32_t us = (uint32_t) ((uint64_t) cycles * USEC_PER_SEC / SystemCoreClock);
+#else
+	uint32_t us = k_cyc_to_us_floor32(cycles);
+#endif
+
+	h->count++;
+	h->buckets[bucket_of(us)]++;
+	if (us > h->maxUs)
+	{
+		h->maxUs = us;
+	}
+}
+
+void latency_init(void)
+{
+#if defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+	// enable the cycle counter of the data watchpoint and trace unit,
+	// also when it is not used by CpuStats
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+uint32_t latency_now(void)
+{
+#if defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+	return DWT->CYCCNT;
+#else
+	return k_cycle_get_32();
+#endif
+}
+
+void latency_record(const struct latency_stamps *stamps, uint32_t sent)
+{
+	if (stamps->sensor >= LATENCY_SENSOR_COUNT)
+	{
+		return;
+	}
+
+	// unsigned differences are correct over a wrap of the cycle counter
+	add(stamps->sensor, LATENCY_STAGE_COMPUTE, stamps->computed - stamps->received);
+	add(stamps->sensor, LATENCY_STAGE_QUEUE, stamps->queued - stamps->computed);
+	add(stamps->sensor, LATENCY_STAGE_TX, sent - stamps->queued);
+	add(stamps->sensor, LATENCY_STAGE_TOTAL, sent - stamps->received);
+}
+
+const struct latency_histogram *latency_get(uint8_t sensor, uint8_t stage)
+{
+	if (sensor >= LATENCY_SENSOR_COUNT || stage >= LATENCY_STAGE_COUNT)
+	{
+		return NULL;
+	}
+	return &histograms[sensor][stage];
+}
+
+uint32_t latency_bucket_limit(uint8_t bucket)
+{
+	if (bucket >= LATENCY_BUCKETS - 1)
+	{
+		return 0;
+	}
+	return 1U << (bucket + LATENCY_FIRST_BUCKET_LOG2);
+}
+
+void latency_reset()
+{
+	memset(histograms, 0, sizeof(histograms));
+}
@@ -0,0 +1,116 @@
+/**
+ * @file    Latency.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Latency histograms from the notification of a sensor
+ *          to the notification sent to the application,
+ *          one histogram per sensor and per stage
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// sensors
+#define LATENCY_SENSOR_SPEED        0
+#define LATENCY_SENSOR_CADENCE      1
+#define LATENCY_SENSOR_HEARTRATE    2
+#define LATENCY_SENSOR_POWER        3
+#define LATENCY_SENSOR_COUNT        4
+#define LATENCY_SENSOR_NONE         0xff
+
+/*
+ * stages, each one is the time between two hops:
+ * notify callback entry -> compute done -> data_service_send enqueue -> on_sent
+ */
+#define LATENCY_STAGE_COMPUTE       0   // BT RX thread, Data computation
+#define LATENCY_STAGE_QUEUE         1   // encoding and queueing of the frame
+#define LATENCY_STAGE_TX            2   // subscriber queue, ATT TX queue and radio
+#define LATENCY_STAGE_TOTAL         3   // notify callback entry -> on_sent
+#define LATENCY_STAGE_COUNT         4
+
+/*
+ * logarithmic buckets in us:
+ * bucket 0 < 32 us, bucket i < 2^(i+5) us, last bucket >= 2^19 us (0.5 s)
+ */
+#define LATENCY_BUCKETS             16
+#define LATENCY_FIRST_BUCKET_LOG2   5
+
+/**
+ * @brief histogram of one sensor and one stage
+ */
+struct latency_histogram
+{
+    uint32_t count;
+    uint32_t maxUs;
+    uint32_t buckets[LATENCY_BUCKETS];
+};
+
+/**
+ * @brief time stamps of one sample on its way to the application,
+ *        in cycles of latency_now()
+ */
+struct latency_stamps
+{
+    uint8_t sensor;
+    uint32_t received;
+    uint32_t computed;
+    uint32_t queued;
+};
+
+/**
+ * @brief enable the cycle counter of the time stamps
+ */
+void latency_init(void);
+
+/**
+ * @brief time stamp for the latency, the CPU cycle counter (DWT) if the core
+ *        has one: the 32768 Hz kernel clock is too coarse for the stages
+ *
+ * @return uint32_t the time stamp in cycles
+ */
+uint32_t latency_now(void);
+
+/**
+ * @brief record a sample when its notification was sent to the application,
+ *        once per sample and not once per application
+ *
+ * @param stamps the time stamps of the sample
+ * @param sent time stamp of the first on_sent callback of the sample
+ */
+void latency_record(const struct latency_stamps *stamps, uint32_t sent);
+
+/**
+ * @brief get the histogram of one sensor and one stage
+ *
+ * @param sensor one of LATENCY_SENSOR_*
+ * @param stage one of LATENCY_STAGE_*
+ * @return const struct latency_histogram* the histogram, NULL if invalid
+ */
+const struct latency_histogram *latency_get(uint8_t sensor, uint8_t stage);
+
+/**
+ * @brief upper bound of a bucket
+ *
+ * @param bucket bucket index
+ * @return uint32_t upper bound in us, 0 for the last (open) bucket
+ */
+uint32_t latency_bucket_limit(uint8_t bucket);
+
+/**
+ * @brief clear all histograms
+ */
+void latency_reset();
+
+#endif /* LATENCY_H_ */
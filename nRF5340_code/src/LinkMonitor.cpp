@@ -0,0 +1,439 @@
+#include "LinkMonitor.h"
+#include "LinkStats.h"
+#include "EventLog.h"
+#include "Protocol.h"
+#include "dataService.h"
+
+#include <kernel.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <sys/byteorder.h>
+#if defined(CONFIG_SHELL)
+#include <shell/shell.h>
+#endif
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+// one monitored connection, by the index of the connection
+struct link_entry
+{
+	struct bt_conn *conn;       // reference of the monitor, NULL if not monitored
+	uint8_t type;               // TYPE_* of the sensor, LINK_TYPE_APP
+	bool central;               // the board is the central of the link
+	uint8_t phy;                // BT_GAP_LE_PHY_* of the transmission
+	uint16_t interval;          // 1.25 ms
+	uint16_t latency;           // connection events
+	uint16_t timeout;           // 10 ms
+	uint16_t goodLatency;       // negotiated while the link was good, restored when
+	uint16_t goodTimeout;       // the link is good again
+	LinkStats stats;
+};
+
+// the links are written in the BT RX thread and read by the work queue and the shell
+static struct k_spinlock lock;
+static struct link_entry links[CONFIG_BT_MAX_CONN];
+
+static struct k_delayed_work sampleWork;
+
+static struct link_entry *entry_of(struct bt_conn *conn)
+{
+	struct link_entry *entry = &links[bt_conn_index(conn)];
+
+	return entry->conn == conn ? entry : NULL;
+}
+
+/*
+ * RSSI of a connection from the controller (BT_CTLR_CONN_RSSI of the
+ * network core), waits for the response of the HCI command
+ */
+static int read_rssi(struct bt_conn *conn, int8_t *rssi)
+{
+	struct bt_hci_cp_read_rssi *cp;
+	struct bt_hci_rp_read_rssi *rp;
+	struct net_buf *buf;
+	struct net_buf *rsp = NULL;
+	uint16_t handle;
+
+	int err = bt_hci_get_conn_handle(conn, &handle);
+	if (err)
+	{
+		return err;
+	}
+
+	buf = bt_hci_cmd_create(BT_HCI_OP_READ_RSSI, sizeof(*cp));
+	if (buf == NULL)
+	{
+		return -ENOBUFS;
+	}
+	cp = (struct bt_hci_cp_read_rssi *) net_buf_add(buf, sizeof(*cp));
+	cp->handle = sys_cpu_to_le16(handle);
+
+	err = bt_hci_cmd_send_sync(BT_HCI_OP_READ_RSSI, buf, &rsp);
+	if (err)
+	{
+		return err;
+	}
+
+	rp = (struct bt_hci_rp_read_rssi *) rsp->data;
+	*rssi = rp->rssi;
+	err = rp->status == 0 && rp->rssi != LINK_RSSI_UNKNOWN ? 0 : -EIO;
+	net_buf_unref(rsp);
+	return err;
+}
+
+static void send_state(const struct link_entry *entry, uint8_t state)
+{
+	uint8_t frame[LINK_STATE_FRAME_LEN];
+	uint32_t lost = entry->stats.lost();
+
+	if (entry->type == LINK_TYPE_APP)
+	{
+		// an application knows its own link
+		return;
+	}
+
+	frame[0] = TYPE_LINK_STATE;
+	frame[1] = entry->type;
+	frame[2] = state;
+	frame[3] = (uint8_t) (entry->stats.hasRssi() ? entry->stats.rssi() : LINK_RSSI_UNKNOWN);
+	frame[4] = (uint8_t) (entry->stats.lossPermille() / 10);
+	sys_put_le16(lost > UINT16_MAX ? UINT16_MAX : (uint16_t) lost, &frame[5]);
+	data_service_send(frame, sizeof(frame));
+}
+
+/*
+ * the decisions of a new quality: a weak link gets a longer supervision
+ * timeout without slave latency, a good link its negotiated parameters again,
+ * a critical link to a sensor the coded PHY, a good link to an application
+ * the 2M PHY for its frames
+ */
+static void apply_state(struct bt_conn *conn, const struct link_entry *entry, uint8_t state)
+{
+	uint16_t timeout = entry->goodTimeout;
+	uint16_t latency = entry->goodLatency;
+
+	if (state != LINK_STATE_GOOD)
+	{
+		latency = 0;
+		timeout = timeout > LINK_WEAK_TIMEOUT ? timeout : LINK_WEAK_TIMEOUT;
+	}
+
+	if (entry->interval != 0 && (timeout != entry->timeout || latency != entry->latency))
+	{
+		int err = bt_conn_le_param_update(conn, BT_LE_CONN_PARAM(entry->interval, entry->interval, latency, timeout));
+		if (err)
+		{
+			printk("Link of type %u: parameter update failed (err %d)\n", entry->type, err);
+		}
+	}
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+	uint8_t phy = BT_GAP_LE_PHY_1M;
+	struct bt_conn_le_phy_param param = {};
+
+	if (entry->type == LINK_TYPE_APP && state == LINK_STATE_GOOD)
+	{
+		phy = BT_GAP_LE_PHY_2M;
+	}
+	else if (entry->type != LINK_TYPE_APP && state == LINK_STATE_CRITICAL)
+	{
+		// refused by the sensors without long range, the link stays on 1M
+		phy = BT_GAP_LE_PHY_CODED;
+		param.options = BT_CONN_LE_PHY_OPT_CODED_S8;
+	}
+
+	if (phy != entry->phy)
+	{
+		param.pref_tx_phy = phy;
+		param.pref_rx_phy = phy;
+		int err = bt_conn_le_phy_update(conn, &param);
+		if (err)
+		{
+			printk("Link of type %u: PHY update failed (err %d)\n", entry->type, err);
+		}
+	}
+#endif
+}
+
+static void sample(struct k_work *work)
+{
+	k_delayed_work_submit(&sampleWork, K_MSEC(CONFIG_APP_LINK_MONITOR_PERIOD_MS));
+
+	for (uint8_t i = 0; i < CONFIG_BT_MAX_CONN; i++)
+	{
+		struct link_entry copy;
+		struct bt_conn *conn = NULL;
+		int8_t rssi;
+		uint8_t before;
+		uint8_t after;
+
+		// own reference, the link may be disconnected during the HCI command
+		k_spinlock_key_t key = k_spin_lock(&lock);
+		if (links[i].conn != NULL)
+		{
+			conn = bt_conn_ref(links[i].conn);
+		}
+		k_spin_unlock(&lock, key);
+
+		if (conn == NULL)
+		{
+			continue;
+		}
+		bool measured = read_rssi(conn, &rssi) == 0;
+
+		key = k_spin_lock(&lock);
+		if (links[i].conn != conn)
+		{
+			k_spin_unlock(&lock, key);
+			bt_conn_unref(conn);
+			continue;
+		}
+		if (measured)
+		{
+			links[i].stats.addRssi(rssi);
+		}
+		before = links[i].stats.state();
+		after = links[i].stats.tick();
+		copy = links[i];
+		k_spin_unlock(&lock, key);
+
+		if (after != before)
+		{
+			ELOG3(LINK_STATE, copy.type, after, copy.stats.hasRssi() ? copy.stats.rssi() : LINK_RSSI_UNKNOWN);
+			send_state(&copy, after);
+			apply_state(conn, &copy, after);
+		}
+		bt_conn_unref(conn);
+	}
+}
+
+/*---------------------------------------------------------------------------
+ * INTERFACE
+ *--------------------------------------------------------------------------*/
+void link_monitor_init(void)
+{
+	k_delayed_work_init(&sampleWork, sample);
+	k_delayed_work_submit(&sampleWork, K_MSEC(CONFIG_APP_LINK_MONITOR_PERIOD_MS));
+}
+
+void link_monitor_connected(struct bt_conn *conn, uint8_t type)
+{
+	struct bt_conn_info info;
+	struct bt_conn *old = NULL;
+
+	if (bt_conn_get_info(conn, &info))
+	{
+		return;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct link_entry *entry = &links[bt_conn_index(conn)];
+	if (entry->conn != conn)
+	{
+		old = entry->conn;
+		entry->conn = bt_conn_ref(conn);
+	}
+	entry->type = type;
+	entry->central = info.role == BT_CONN_ROLE_MASTER;
+	entry->phy = BT_GAP_LE_PHY_1M;
+	entry->interval = info.le.interval;
+	entry->latency = info.le.latency;
+	entry->timeout = info.le.timeout;
+	entry->goodLatency = info.le.latency;
+	entry->goodTimeout = info.le.timeout;
+	entry->stats.reset();
+	k_spin_unlock(&lock, key);
+
+	if (old != NULL)
+	{
+		bt_conn_unref(old);
+	}
+}
+
+void link_monitor_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	struct link_entry copy;
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct link_entry *entry = entry_of(conn);
+	if (entry == NULL)
+	{
+		k_spin_unlock(&lock, key);
+		return;
+	}
+	copy = *entry;
+	entry->conn = NULL;
+	k_spin_unlock(&lock, key);
+
+	// the history of the link next to the reason of the disconnection
+	printk("Link of type %u lost (reason 0x%02x): rssi %d dBm (min %d), %u of %u notifications lost, "
+	       "longest gap %u ms\n", copy.type, reason, copy.stats.rssi(), copy.stats.rssiMin(),
+	       copy.stats.lost(), copy.stats.received() + copy.stats.lost(), copy.stats.longestGapMs());
+	ELOG3(LINK_LOST, copy.type, reason, copy.stats.lost());
+	send_state(&copy, LINK_STATE_LOST);
+	bt_conn_unref(copy.conn);
+}
+
+void link_monitor_notified(struct bt_conn *conn, uint64_t time)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct link_entry *entry = entry_of(conn);
+	if (entry != NULL)
+	{
+		entry->stats.notified(time, LINK_ACTIVE_ALWAYS);
+	}
+	k_spin_unlock(&lock, key);
+}
+
+void link_monitor_csc(struct bt_conn *conn, const uint8_t *data, uint16_t length, uint64_t time)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct link_entry *entry = entry_of(conn);
+	if (entry != NULL)
+	{
+		entry->stats.notifiedCsc(data, length, time);
+	}
+	k_spin_unlock(&lock, key);
+}
+
+bool link_monitor_param_req(struct bt_conn *conn, struct bt_le_conn_param *param)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct link_entry *entry = entry_of(conn);
+	if (entry != NULL && entry->stats.state() != LINK_STATE_GOOD)
+	{
+		// the request of the peer is restored when the link is good again,
+		// no supervision timeout shorter than the one of the weak link
+		entry->goodLatency = param->latency;
+		entry->goodTimeout = param->timeout;
+		param->latency = 0;
+		if (param->timeout < LINK_WEAK_TIMEOUT)
+		{
+			param->timeout = LINK_WEAK_TIMEOUT;
+		}
+	}
+	k_spin_unlock(&lock, key);
+	return true;
+}
+
+void link_monitor_params(struct bt_conn *conn, uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct link_entry *entry = entry_of(conn);
+	if (entry != NULL)
+	{
+		entry->interval = interval;
+		entry->latency = latency;
+		entry->timeout = timeout;
+		if (entry->stats.state() == LINK_STATE_GOOD)
+		{
+			// not the parameters of a weak link
+			entry->goodLatency = latency;
+			entry->goodTimeout = timeout;
+		}
+	}
+	k_spin_unlock(&lock, key);
+}
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+void link_monitor_phy(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct link_entry *entry = entry_of(conn);
+	if (entry != NULL)
+	{
+		entry->phy = param->tx_phy;
+	}
+	k_spin_unlock(&lock, key);
+}
+#endif
+
+void link_monitor_reset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	for (uint8_t i = 0; i < CONFIG_BT_MAX_CONN; i++)
+	{
+		links[i].stats.reset();
+	}
+	k_spin_unlock(&lock, key);
+}
+
+uint16_t link_monitor_page(uint8_t index, uint8_t *buf)
+{
+	struct link_entry copy;
+
+	if (index >= CONFIG_BT_MAX_CONN)
+	{
+		return 0;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	copy = links[index];
+	k_spin_unlock(&lock, key);
+
+	if (copy.conn == NULL)
+	{
+		return 0;
+	}
+
+	buf[0] = copy.type;
+	buf[1] = copy.central;
+	buf[2] = copy.stats.state();
+	buf[3] = (uint8_t) (copy.stats.hasRssi() ? copy.stats.rssi() : LINK_RSSI_UNKNOWN);
+	buf[4] = (uint8_t) (copy.stats.hasRssi() ? copy.stats.rssiMin() : LINK_RSSI_UNKNOWN);
+	buf[5] = copy.phy;
+	sys_put_le16(copy.interval, &buf[6]);
+	sys_put_le16(copy.latency, &buf[8]);
+	sys_put_le16(copy.timeout, &buf[10]);
+	sys_put_le32(copy.stats.received(), &buf[12]);
+	sys_put_le32(copy.stats.lost(), &buf[16]);
+	sys_put_le32(copy.stats.gaps(), &buf[20]);
+	sys_put_le32(copy.stats.longestGapMs(), &buf[24]);
+	sys_put_le32(copy.stats.periodUs(), &buf[28]);
+	sys_put_le16(copy.stats.lossPermille(), &buf[32]);
+	return LINK_PAGE_LEN;
+}
+
+/*---------------------------------------------------------------------------
+ * SHELL
+ *--------------------------------------------------------------------------*/
+#if defined(CONFIG_SHELL)
+
+static int cmd_links(const struct shell *shell, size_t argc, char **argv)
+{
+	static const char *const stateNames[] = {"good", "weak", "critical"};
+	char addr[BT_ADDR_LE_STR_LEN];
+	bt_addr_le_t dst;
+
+	// a copy of every entry, the shell output is too slow for the lock
+	for (uint8_t i = 0; i < CONFIG_BT_MAX_CONN; i++)
+	{
+		struct link_entry copy;
+
+		k_spinlock_key_t key = k_spin_lock(&lock);
+		copy = links[i];
+		if (copy.conn != NULL)
+		{
+			bt_addr_le_copy(&dst, bt_conn_get_dst(copy.conn));
+		}
+		k_spin_unlock(&lock, key);
+
+		if (copy.conn == NULL)
+		{
+			continue;
+		}
+		bt_addr_le_to_str(&dst, addr, sizeof(addr));
+		shell_print(shell, "%s type %u (%s) %s: rssi %d dBm (min %d), phy %u, interval %u, latency %u, timeout %u",
+			    addr, copy.type, copy.central ? "central" : "peripheral", stateNames[copy.stats.state()],
+			    copy.stats.rssi(), copy.stats.rssiMin(), copy.phy, copy.interval, copy.latency, copy.timeout);
+		shell_print(shell, "  %u received, %u lost in %u gaps (longest %u ms), loss %u.%u %%, period %u us",
+			    copy.stats.received(), copy.stats.lost(), copy.stats.gaps(), copy.stats.longestGapMs(),
+			    copy.stats.lossPermille() / 10U, copy.stats.lossPermille() % 10U, copy.stats.periodUs());
+	}
+	return 0;
+}
+
+SHELL_CMD_REGISTER(links, NULL, "Quality of the connections", cmd_links);
+
+#endif /* CONFIG_SHELL */
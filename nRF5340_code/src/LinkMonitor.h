@@ -0,0 +1,145 @@
+/**
+ * @file    LinkMonitor.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Quality of every connection of the board: the RSSI of the
+ *          connection is read from the controller periodically and the
+ *          notifications of a sensor are checked for gaps (LinkStats.h).
+ *          A weak link gets a longer supervision timeout and a more
+ *          robust PHY, the application is warned with TYPE_LINK_STATE
+ *          frames before the connection is lost. The statistics are in
+ *          the "links" shell command and in DIAG_PAGE_LINKS.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef LINK_MONITOR_H_
+#define LINK_MONITOR_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+#include <bluetooth/conn.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// type of the link to an application, the links to sensors have their TYPE_*
+#define LINK_TYPE_APP               0
+
+// supervision timeout of a weak link in 10 ms at least, a good link gets
+// the negotiated parameters again
+#define LINK_WEAK_TIMEOUT           600
+
+// size of DIAG_PAGE_LINKS
+#define LINK_PAGE_LEN               34
+
+#if defined(CONFIG_APP_LINK_MONITOR)
+
+/**
+ * @brief start the periodic RSSI samples
+ */
+void link_monitor_init(void);
+
+/**
+ * @brief monitor a new connection, a reference is taken
+ *
+ * @param conn the connection
+ * @param type TYPE_* of the sensor, LINK_TYPE_APP for an application
+ */
+void link_monitor_connected(struct bt_conn *conn, uint8_t type);
+
+/**
+ * @brief end of a connection, its last statistics are logged and sent
+ *        to the application, nothing if the connection is not monitored
+ *
+ * @param conn the connection
+ * @param reason reason code of the disconnection
+ */
+void link_monitor_disconnected(struct bt_conn *conn, uint8_t reason);
+
+/**
+ * @brief a notification of a sensor which notifies periodically
+ *
+ * @param conn connection of the sensor
+ * @param time board time of the reception in us
+ */
+void link_monitor_notified(struct bt_conn *conn, uint64_t time);
+
+/**
+ * @brief a CSC measurement, its counter and event time tell if the sensor
+ *        had something to notify during a gap
+ *
+ * @param conn connection of the sensor
+ * @param data the measurement
+ * @param length the length of the measurement
+ * @param time board time of the reception in us
+ */
+void link_monitor_csc(struct bt_conn *conn, const uint8_t *data, uint16_t length, uint64_t time);
+
+/**
+ * @brief connection parameters requested by the peer, a weak link keeps
+ *        LINK_WEAK_TIMEOUT and no slave latency, the requested parameters
+ *        are restored when the link is good again
+ *
+ * @param conn the connection
+ * @param param requested parameters, adjusted
+ * @return true to accept the (adjusted) parameters
+ */
+bool link_monitor_param_req(struct bt_conn *conn, struct bt_le_conn_param *param);
+
+/**
+ * @brief the parameters of a connection have been updated
+ *
+ * @param conn the connection
+ * @param interval connection interval in 1.25 ms
+ * @param latency slave latency in connection events
+ * @param timeout supervision timeout in 10 ms
+ */
+void link_monitor_params(struct bt_conn *conn, uint16_t interval, uint16_t latency, uint16_t timeout);
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+/**
+ * @brief the PHY of a connection has been updated
+ *
+ * @param conn the connection
+ * @param param the new PHY
+ */
+void link_monitor_phy(struct bt_conn *conn, struct bt_conn_le_phy_info *param);
+#endif
+
+/**
+ * @brief clear the statistics of all links, the connections are kept
+ */
+void link_monitor_reset(void);
+
+/**
+ * @brief DIAG_PAGE_LINKS of a connection (DiagService.h)
+ *
+ * @param index index of the connection
+ * @param buf buffer of LINK_PAGE_LEN bytes
+ * @return uint16_t length of the page, 0 if the connection is not monitored
+ */
+uint16_t link_monitor_page(uint8_t index, uint8_t *buf);
+
+#else
+
+static inline void link_monitor_init(void) {}
+static inline void link_monitor_connected(struct bt_conn *conn, uint8_t type) {}
+static inline void link_monitor_disconnected(struct bt_conn *conn, uint8_t reason) {}
+static inline void link_monitor_notified(struct bt_conn *conn, uint64_t time) {}
+static inline void link_monitor_csc(struct bt_conn *conn, const uint8_t *data, uint16_t length, uint64_t time) {}
+static inline bool link_monitor_param_req(struct bt_conn *conn, struct bt_le_conn_param *param) { return true; }
+static inline void link_monitor_params(struct bt_conn *conn, uint16_t interval, uint16_t latency, uint16_t timeout) {}
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+static inline void link_monitor_phy(struct bt_conn *conn, struct bt_conn_le_phy_info *param) {}
+#endif
+static inline void link_monitor_reset(void) {}
+static inline uint16_t link_monitor_page(uint8_t index, uint8_t *buf) { return 0; }
+
+#endif /* CONFIG_APP_LINK_MONITOR */
+
+#endif /* LINK_MONITOR_H_ */
@@ -0,0 +1,193 @@
+#include "LinkStats.h"
+#include "Data.h"
+#include "Protocol.h"
+
+static uint32_t saturate32(uint64_t value)
+{
+    return value > UINT32_MAX ? UINT32_MAX : (uint32_t) value;
+}
+
+static void add16(uint16_t &counter, uint32_t value)
+{
+    counter = counter + value > UINT16_MAX ? UINT16_MAX : (uint16_t) (counter + value);
+}
+
+void LinkStats::reset()
+{
+    current = LINK_STATE_GOOD;
+
+    rssiSmooth = 0;
+    lowest = INT8_MAX;
+    rssiSamples = 0;
+
+    notifiedOnce = false;
+    lastNotified = 0;
+    period = 0;
+    totalReceived = 0;
+    totalLost = 0;
+    totalGaps = 0;
+    longestGap = 0;
+
+    cscValid = false;
+    cscRevs = 0;
+    cscEventTime = 0;
+    cscRevUs = 0;
+
+    periodReceived = 0;
+    periodLost = 0;
+    loss = 0;
+}
+
+void LinkStats::addRssi(int8_t dbm)
+{
+    int16_t sample = (int16_t) (dbm * (1 << LINK_RSSI_FRACTION));
+
+    if (rssiSamples == 0)
+    {
+        rssiSmooth = sample;
+    }
+    else
+    {
+        rssiSmooth += (sample - rssiSmooth) >> LINK_STATS_SHIFT;
+    }
+    if (dbm < lowest)
+    {
+        lowest = dbm;
+    }
+    rssiSamples++;
+}
+
+void LinkStats::notified(uint64_t time, uint32_t activeUs)
+{
+    totalReceived++;
+    add16(periodReceived, 1);
+
+    if (notifiedOnce && time > lastNotified)
+    {
+        uint64_t interval = time - lastNotified;
+
+        if (period == 0)
+        {
+            period = saturate32(interval);
+        }
+        else if (interval * LINK_GAP_DEN > (uint64_t) period * LINK_GAP_NUM)
+        {
+            // the periods of the gap in which the device had something to notify,
+            // the received notification ends the last one
+            uint64_t active = interval < activeUs ? interval : activeUs;
+            uint32_t periods = saturate32((active + period / 2) / period);
+
+            if (periods > 1)
+            {
+                totalLost += periods - 1;
+                add16(periodLost, periods - 1);
+                totalGaps++;
+                if (interval / 1000 > longestGap)
+                {
+                    longestGap = saturate32(interval / 1000);
+                }
+            }
+        }
+        else
+        {
+            // the time of a gap is not a period
+            period = (uint32_t) ((int64_t) period + (((int64_t) interval - period) >> LINK_STATS_SHIFT));
+        }
+    }
+    notifiedOnce = true;
+    lastNotified = time;
+}
+
+void LinkStats::notifiedCsc(const uint8_t *data, uint16_t length, uint64_t time)
+{
+    uint32_t activeUs = 0;
+    uint32_t revs = 0;
+    uint16_t eventTime = 0;
+    uint32_t revsMask = UINT32_MAX;
+    bool valid = false;
+
+    // the wheel of a speed sensor, else the crank of a cadence sensor
+    if (length >= 7 && (data[0] & CSC_SPEED))
+    {
+        revs = sys_get_le32(&data[1]);
+        eventTime = sys_get_le16(&data[5]);
+        valid = true;
+    }
+    else if (length >= 5 && data[0] == CSC_CADENCE)
+    {
+        revs = sys_get_le16(&data[1]);
+        eventTime = sys_get_le16(&data[3]);
+        revsMask = UINT16_MAX;
+        valid = true;
+    }
+
+    // the sensor was active in a gap when its counter went on, for the time of
+    // these revolutions: the time between its last events (1/1024 s, wraps
+    // around after 64 s) also contains a stop of the wheel or the crank
+    if (valid && cscValid && revs != cscRevs)
+    {
+        uint32_t spanUs = (uint32_t) ((uint64_t) (uint16_t) (eventTime - cscEventTime) * 1000000 / 1024);
+        uint32_t delta = (revs - cscRevs) & revsMask;
+        uint64_t revsUs = cscRevUs ? (uint64_t) delta * cscRevUs : spanUs;
+
+        activeUs = revsUs < spanUs ? (uint32_t) revsUs : spanUs;
+
+        // a slower revolution is learned in steps, a stop is not a revolution
+        uint32_t sample = spanUs / delta;
+        if (cscRevUs == 0)
+        {
+            cscRevUs = sample;
+        }
+        else
+        {
+            sample = sample > 2 * cscRevUs ? 2 * cscRevUs : sample;
+            cscRevUs = (uint32_t) ((int64_t) cscRevUs + (((int64_t) sample - cscRevUs) >> LINK_STATS_SHIFT));
+        }
+    }
+    if (valid)
+    {
+        cscValid = true;
+        cscRevs = revs;
+        cscEventTime = eventTime;
+    }
+    notified(time, activeUs);
+}
+
+uint8_t LinkStats::level(int16_t rssiMargin, uint16_t lossMargin) const
+{
+    int16_t dbm = rssiSmooth >> LINK_RSSI_FRACTION;
+
+    if ((hasRssi() && dbm < LINK_RSSI_CRITICAL + rssiMargin) || loss + lossMargin >= LINK_LOSS_CRITICAL)
+    {
+        return LINK_STATE_CRITICAL;
+    }
+    if ((hasRssi() && dbm < LINK_RSSI_WEAK + rssiMargin) || loss + lossMargin >= LINK_LOSS_WEAK)
+    {
+        return LINK_STATE_WEAK;
+    }
+    return LINK_STATE_GOOD;
+}
+
+uint8_t LinkStats::tick()
+{
+    uint32_t count = (uint32_t) periodReceived + periodLost;
+
+    // a period without notifications tells nothing about the loss
+    if (count > 0)
+    {
+        int32_t sample = (int32_t) ((uint32_t) periodLost * 1000 / count);
+        loss = (uint16_t) (loss + ((sample - loss) >> LINK_STATS_SHIFT));
+    }
+    periodReceived = 0;
+    periodLost = 0;
+
+    // worse at once, better only with the margins of the hysteresis
+    uint8_t next = level(0, 0);
+    if (next < current)
+    {
+        uint8_t strict = level(LINK_RSSI_HYSTERESIS, LINK_LOSS_HYSTERESIS);
+        next = strict < current ? strict : current;
+    }
+    current = next;
+    return current;
+}
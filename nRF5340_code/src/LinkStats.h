@@ -0,0 +1,141 @@
+/**
+ * @file    LinkStats.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Rolling statistics of the connection to one device: smoothed
+ *          and lowest RSSI, notifications lost in the gaps of the
+ *          reception (a CSC sensor only counts the gaps in which its
+ *          cumulative counter went on, for the time of its revolutions) and the
+ *          smoothed share of lost notifications. The quality of the link
+ *          follows from both, with a hysteresis, and warns before the
+ *          connection is lost.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef LINK_STATS_H_
+#define LINK_STATS_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// smoothing of the RSSI, the period and the loss:
+// new = old + (sample - old) / 2^LINK_STATS_SHIFT
+#define LINK_STATS_SHIFT            2
+
+// the RSSI is kept in 1/2^LINK_RSSI_FRACTION dBm
+#define LINK_RSSI_FRACTION          4
+
+// a reception interval longer than LINK_GAP_NUM / LINK_GAP_DEN periods is a gap
+#define LINK_GAP_NUM                3
+#define LINK_GAP_DEN                2
+
+// limits of the quality in dBm and in 1/1000 of the notifications lost,
+// a better quality needs the margins of the hysteresis in addition
+#define LINK_RSSI_WEAK              -80
+#define LINK_RSSI_CRITICAL          -90
+#define LINK_RSSI_HYSTERESIS        4
+#define LINK_LOSS_WEAK              100
+#define LINK_LOSS_CRITICAL          300
+#define LINK_LOSS_HYSTERESIS        50
+
+// sensor active during the whole reception interval (no event times)
+#define LINK_ACTIVE_ALWAYS          UINT32_MAX
+
+class LinkStats {
+public:
+    /**
+     * @brief forget the history (new connection), no constructor (static objects)
+     */
+    void reset();
+
+    /**
+     * @brief a RSSI sample of the connection
+     *
+     * @param dbm RSSI in dBm
+     */
+    void addRssi(int8_t dbm);
+
+    /**
+     * @brief a notification was received, a gap since the last one is
+     *        counted as lost notifications
+     *
+     * @param time board time of the reception in us
+     * @param activeUs time of the gap during which the device had something
+     *                 to notify, LINK_ACTIVE_ALWAYS if it notifies periodically
+     */
+    void notified(uint64_t time, uint32_t activeUs);
+
+    /**
+     * @brief a CSC measurement was received, the revolutions since the last
+     *        measurement times the learned time of a revolution are the
+     *        active time of a gap (a stop between the events is not active)
+     *
+     * @param data the measurement
+     * @param length the length of the measurement
+     * @param time board time of the reception in us
+     */
+    void notifiedCsc(const uint8_t *data, uint16_t length, uint64_t time);
+
+    /**
+     * @brief end of a sample period: the notifications received and lost in
+     *        the period go into the smoothed loss, then the quality is updated
+     *
+     * @return uint8_t the quality, LINK_STATE_* (Protocol.h)
+     */
+    uint8_t tick();
+
+    uint8_t state() const { return current; }
+    bool hasRssi() const { return rssiSamples > 0; }
+    int8_t rssi() const { return (int8_t) (rssiSmooth >> LINK_RSSI_FRACTION); }
+    int8_t rssiMin() const { return lowest; }
+    uint32_t received() const { return totalReceived; }
+    uint32_t lost() const { return totalLost; }
+    uint32_t gaps() const { return totalGaps; }
+    uint32_t longestGapMs() const { return longestGap; }
+    uint32_t periodUs() const { return period; }
+
+    /**
+     * @brief smoothed share of the lost notifications
+     *
+     * @return uint16_t 1/1000 of the notifications
+     */
+    uint16_t lossPermille() const { return loss; }
+
+private:
+    uint8_t level(int16_t rssiMargin, uint16_t lossMargin) const;
+
+    uint8_t current;
+
+    int16_t rssiSmooth;
+    int8_t lowest;
+    uint32_t rssiSamples;
+
+    bool notifiedOnce;
+    uint64_t lastNotified;
+    uint32_t period;            // expected time between two notifications in us
+    uint32_t totalReceived;
+    uint32_t totalLost;
+    uint32_t totalGaps;
+    uint32_t longestGap;
+
+    // counter and event time of the last CSC measurement
+    bool cscValid;
+    uint32_t cscRevs;
+    uint16_t cscEventTime;
+    uint32_t cscRevUs;          // smoothed time of one revolution in us, 0 if not known yet
+
+    // notifications of the sample period in progress
+    uint16_t periodReceived;
+    uint16_t periodLost;
+    uint16_t loss;
+};
+
+#endif /* LINK_STATS_H_ */
@@ -0,0 +1,313 @@
+#include "MotionClient.h"
+#include "MotionFeatures.h"
+#include "dataService.h"
+
+#include <kernel.h>
+#include <string.h>
+#include <sys/atomic.h>
+#include <sys/byteorder.h>
+#include <bluetooth/gatt.h>
+#include <bluetooth/gatt_dm.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+#define THREAD_STACK_SIZE 1024
+
+// retry of the discovery while the DeviceManager discovers a sensor
+#define DISCOVERY_RETRY_MS 200
+
+// feature frames of the thread waiting for the system workqueue
+#define FRAME_QUEUE 4
+
+#if defined(CONFIG_APP_MOTION_QUATERNION)
+#define MOTION_SOURCE MOTION_SOURCE_QUATERNION
+#define BT_UUID_THINGY_DATA BT_UUID_THINGY_QUATERNION
+#else
+#define MOTION_SOURCE MOTION_SOURCE_RAW
+#define BT_UUID_THINGY_DATA BT_UUID_THINGY_RAW
+#endif
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+// the samples are copied in the Bluetooth callback and processed in batches
+K_MSGQ_DEFINE(motionQueue, MOTION_RAW_SIZE, CONFIG_APP_MOTION_QUEUE, 2);
+static atomic_t dropped;
+static atomic_t restart;
+
+// the queues of the data service are only changed by cooperative threads,
+// the preemptible motion thread hands its frames to the system workqueue
+K_MSGQ_DEFINE(frameQueue, MOTION_FRAME_SIZE, FRAME_QUEUE, 1);
+static struct k_work sendWork;
+
+static struct bt_conn *thingyConn;
+static struct bt_gatt_dm_cb discoveryCallbacks;
+static struct bt_gatt_subscribe_params subscribeParams;
+static struct bt_gatt_write_params writeParams;
+static uint8_t motionConfig[9];
+static struct k_delayed_work discoveryWork;
+
+static MotionFeatures features;
+
+static uint8_t on_motion(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+			 const void *data, uint16_t length)
+{
+	uint8_t sample[MOTION_RAW_SIZE] = {0};
+
+	if (data == NULL)
+	{
+		params->value_handle = 0U;
+		return BT_GATT_ITER_STOP;
+	}
+
+	// no processing in the Bluetooth thread -> the sensors are not delayed
+	memcpy(sample, data, MIN(length, sizeof(sample)));
+	if (k_msgq_put(&motionQueue, sample, K_NO_WAIT) != 0)
+	{
+		atomic_inc(&dropped);
+	}
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static void config_written(struct bt_conn *conn, uint8_t err, struct bt_gatt_write_params *params)
+{
+	if (err)
+	{
+		printk("Thingy motion configuration failed (err %u)\n", err);
+	}
+}
+
+static void discovery_completed(struct bt_gatt_dm *dm, void *context)
+{
+	const struct bt_gatt_dm_attr *chrc;
+	const struct bt_gatt_dm_attr *desc;
+	int err;
+
+	// motion processing rate of the Thingy, the other intervals are its defaults:
+	// step counter, temperature compensation, magnetometer compensation (ms),
+	// motion processing frequency (Hz), wake on motion
+	chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_THINGY_MOTION_CONFIG);
+	desc = chrc ? bt_gatt_dm_desc_by_uuid(dm, chrc, BT_UUID_THINGY_MOTION_CONFIG) : NULL;
+	if (desc)
+	{
+		sys_put_le16(100, &motionConfig[0]);
+		sys_put_le16(500, &motionConfig[2]);
+		sys_put_le16(500, &motionConfig[4]);
+		sys_put_le16(CONFIG_APP_MOTION_RATE_HZ, &motionConfig[6]);
+		motionConfig[8] = 1;
+		writeParams.func = config_written;
+		writeParams.handle = desc->handle;
+		writeParams.offset = 0;
+		writeParams.data = motionConfig;
+		writeParams.length = sizeof(motionConfig);
+		err = bt_gatt_write(bt_gatt_dm_conn_get(dm), &writeParams);
+		if (err)
+		{
+			printk("Thingy motion configuration not written (err %d)\n", err);
+		}
+	}
+
+	chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_THINGY_DATA);
+	if (!chrc)
+	{
+		printk("No Thingy motion characteristic found\n");
+		bt_gatt_dm_data_release(dm);
+		return;
+	}
+	desc = bt_gatt_dm_desc_by_uuid(dm, chrc, BT_UUID_THINGY_DATA);
+	subscribeParams.value_handle = desc ? desc->handle : 0;
+	desc = bt_gatt_dm_desc_by_uuid(dm, chrc, BT_UUID_GATT_CCC);
+	if (!desc || subscribeParams.value_handle == 0)
+	{
+		printk("No Thingy motion CCC found\n");
+		bt_gatt_dm_data_release(dm);
+		return;
+	}
+	subscribeParams.ccc_handle = desc->handle;
+	subscribeParams.notify = on_motion;
+	subscribeParams.value = BT_GATT_CCC_NOTIFY;
+
+	err = bt_gatt_subscribe(bt_gatt_dm_conn_get(dm), &subscribeParams);
+	if (err && err != -EALREADY)
+	{
+		printk("Thingy subscribe failed (err %d)\n", err);
+	}
+	else
+	{
+		printk("[THINGY SUBSCRIBED]\n");
+	}
+	bt_gatt_dm_data_release(dm);
+}
+
+static void discovery_not_found(struct bt_conn *conn, void *context)
+{
+	printk("Thingy motion service not found\n");
+}
+
+static void discovery_error(struct bt_conn *conn, int err, void *context)
+{
+	printk("Thingy discovery failed (err %d)\n", err);
+}
+
+static void discovery_work_handler(struct k_work *work)
+{
+	int err;
+
+	if (thingyConn == NULL)
+	{
+		return;
+	}
+	err = bt_gatt_dm_start(thingyConn, BT_UUID_THINGY_MOTION, &discoveryCallbacks, NULL);
+	if (err == -EALREADY)
+	{
+		// only one discovery at a time
+		k_delayed_work_submit(&discoveryWork, K_MSEC(DISCOVERY_RETRY_MS));
+	}
+	else if (err)
+	{
+		printk("Thingy discovery not started (err %d)\n", err);
+	}
+}
+
+void motion_client_connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err)
+	{
+		printk("Failed to connect to the Thingy (%u)\n", err);
+		bt_conn_unref(thingyConn);
+		thingyConn = NULL;
+		return;
+	}
+
+	printk("Thingy connected\n");
+	// the features are owned by the motion thread, it starts a new window
+	atomic_set(&restart, 1);
+	k_delayed_work_submit(&discoveryWork, K_NO_WAIT);
+}
+
+void motion_client_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	printk("Thingy disconnected (reason %u)\n", reason);
+	k_delayed_work_cancel(&discoveryWork);
+	bt_conn_unref(thingyConn);
+	thingyConn = NULL;
+
+	// search the Thingy again, its filter is always part of the scan filters
+	bt_scan_start(BT_SCAN_TYPE_SCAN_ACTIVE);
+}
+
+void motion_client_init(void)
+{
+	k_delayed_work_init(&discoveryWork, discovery_work_handler);
+
+	discoveryCallbacks.completed = discovery_completed;
+	discoveryCallbacks.service_not_found = discovery_not_found;
+	discoveryCallbacks.error_found = discovery_error;
+}
+
+void motion_client_add_scan_filter(void)
+{
+	// also while connected: the filters are not changed after a disconnection
+	int err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_THINGY);
+	if (err)
+	{
+		printk("Thingy scanning filter cannot be set (err %d)\n", err);
+	}
+}
+
+bool motion_client_scan_match(struct bt_scan_device_info *device_info,
+			      struct bt_scan_filter_match *filter_match)
+{
+	char addr[BT_ADDR_LE_STR_LEN];
+	int err;
+
+	if (thingyConn != NULL || !filter_match->uuid.match ||
+	    bt_uuid_cmp(filter_match->uuid.uuid[0], BT_UUID_THINGY) != 0)
+	{
+		return false;
+	}
+
+	// a configured address selects one of several Thingys
+	bt_addr_le_to_str(device_info->recv_info->addr, addr, sizeof(addr));
+	if (strlen(CONFIG_APP_MOTION_ADDR) > 0 &&
+	    strncmp(addr, CONFIG_APP_MOTION_ADDR, strlen(CONFIG_APP_MOTION_ADDR)) != 0)
+	{
+		return false;
+	}
+
+	bt_scan_stop();
+	// the motion samples need more bandwidth than the CSC and HRS sensors:
+	// 30 to 50 ms connection interval, several notifications per event
+	err = bt_conn_le_create(device_info->recv_info->addr, BT_CONN_LE_CREATE_CONN,
+				BT_LE_CONN_PARAM(24, 40, 0, 400), &thingyConn);
+	if (err)
+	{
+		printk("Thingy connection not created (err %d)\n", err);
+		thingyConn = NULL;
+		bt_scan_start(BT_SCAN_TYPE_SCAN_ACTIVE);
+	}
+	return true;
+}
+
+bool motion_client_owns(struct bt_conn *conn)
+{
+	return conn != NULL && conn == thingyConn;
+}
+
+static void send_work_handler(struct k_work *work)
+{
+	uint8_t frame[MOTION_FRAME_SIZE];
+
+	while (k_msgq_get(&frameQueue, frame, K_NO_WAIT) == 0)
+	{
+		data_service_send(frame, sizeof(frame));
+	}
+}
+
+static void motion_thread(void)
+{
+	uint8_t sample[MOTION_RAW_SIZE];
+	uint8_t frame[MOTION_FRAME_SIZE];
+	uint16_t length = MOTION_SOURCE == MOTION_SOURCE_RAW ? MOTION_RAW_SIZE : MOTION_QUATERNION_SIZE;
+
+	k_work_init(&sendWork, send_work_handler);
+	features.init(MOTION_SOURCE, CONFIG_APP_MOTION_WINDOW);
+	while (1)
+	{
+		// wake up once per batch, not per sample
+		k_sleep(K_MSEC(CONFIG_APP_MOTION_BATCH_MS));
+
+		if (atomic_set(&restart, 0))
+		{
+			// new connection: samples of the last connection are not used
+			k_msgq_purge(&motionQueue);
+			atomic_set(&dropped, 0);
+			features.init(MOTION_SOURCE, CONFIG_APP_MOTION_WINDOW);
+		}
+
+		if (!(data_service_streams() & STREAM_BIT(TYPE_MOTION)))
+		{
+			// no application shows the features, the window starts again when one does
+			k_msgq_purge(&motionQueue);
+			atomic_set(&restart, 1);
+			continue;
+		}
+
+		while (k_msgq_get(&motionQueue, sample, K_NO_WAIT) == 0)
+		{
+			if (features.add(sample, length))
+			{
+				atomic_val_t lost = atomic_set(&dropped, 0);
+				features.frame(frame, (uint8_t) MIN(lost, UINT8_MAX));
+				if (k_msgq_put(&frameQueue, frame, K_NO_WAIT) == 0)
+				{
+					k_work_submit(&sendWork);
+				}
+			}
+		}
+	}
+}
+
+K_THREAD_DEFINE(motion_thread_id, THREAD_STACK_SIZE, motion_thread, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
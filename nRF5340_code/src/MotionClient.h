@@ -0,0 +1,112 @@
+/**
+ * @file    MotionClient.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Client of the Thingy:52 motion service on the central side.
+ *          The motion samples are queued in the Bluetooth callback and
+ *          aggregated in batches by a low priority thread, only the
+ *          features of a window (TYPE_MOTION) are sent to the application.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef MOTION_CLIENT_H_
+#define MOTION_CLIENT_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <bluetooth/conn.h>
+#include <bluetooth/uuid.h>
+#include <bluetooth/scan.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// Thingy advertisement UUID 
+#define BT_UUID_THINGY                                                         \
+	BT_UUID_DECLARE_128(0x42, 0x00, 0x74, 0xA9, 0xFF, 0x52, 0x10, 0x9B,    \
+			    0x33, 0x49, 0x35, 0x9B, 0x00, 0x01, 0x68, 0xEF)
+
+// Thingy motion service UUID
+#define BT_UUID_THINGY_MOTION                                                  \
+	BT_UUID_DECLARE_128(0x42, 0x00, 0x74, 0xA9, 0xFF, 0x52, 0x10, 0x9B,    \
+			    0x33, 0x49, 0x35, 0x9B, 0x00, 0x04, 0x68, 0xEF)
+
+// Thingy motion configuration characteristic UUID
+#define BT_UUID_THINGY_MOTION_CONFIG                                           \
+	BT_UUID_DECLARE_128(0x42, 0x00, 0x74, 0xA9, 0xFF, 0x52, 0x10, 0x9B,    \
+			    0x33, 0x49, 0x35, 0x9B, 0x01, 0x04, 0x68, 0xEF)
+
+// Thingy quaternion characteristic UUID
+#define BT_UUID_THINGY_QUATERNION                                              \
+	BT_UUID_DECLARE_128(0x42, 0x00, 0x74, 0xA9, 0xFF, 0x52, 0x10, 0x9B,    \
+			    0x33, 0x49, 0x35, 0x9B, 0x04, 0x04, 0x68, 0xEF)
+
+// Thingy raw motion data characteristic UUID
+#define BT_UUID_THINGY_RAW                                                     \
+	BT_UUID_DECLARE_128(0x42, 0x00, 0x74, 0xA9, 0xFF, 0x52, 0x10, 0x9B,    \
+			    0x33, 0x49, 0x35, 0x9B, 0x06, 0x04, 0x68, 0xEF)
+
+#if defined(CONFIG_APP_MOTION)
+
+/**
+ * @brief initialize the motion client
+ */
+void motion_client_init(void);
+
+/**
+ * @brief add the Thingy to the scan filters, called by the DeviceManager
+ *        when it sets its filters
+ */
+void motion_client_add_scan_filter(void);
+
+/**
+ * @brief check a device of the scan, connects to it if it is the Thingy
+ *
+ * @param device_info device of the scan
+ * @param filter_match matching filters
+ * @return true if the device is the Thingy, the scan was stopped
+ */
+bool motion_client_scan_match(struct bt_scan_device_info *device_info,
+			      struct bt_scan_filter_match *filter_match);
+
+/**
+ * @brief check if a connection belongs to the motion client
+ *
+ * @param conn connection
+ * @return true if it is the connection of the Thingy
+ */
+bool motion_client_owns(struct bt_conn *conn);
+
+/**
+ * @brief connection of the Thingy established, called by the DeviceManager
+ *
+ * @param conn connection of the Thingy
+ * @param err error code of the connection
+ */
+void motion_client_connected(struct bt_conn *conn, uint8_t err);
+
+/**
+ * @brief connection of the Thingy lost, called by the DeviceManager
+ *
+ * @param conn connection of the Thingy
+ * @param reason reason of the disconnection
+ */
+void motion_client_disconnected(struct bt_conn *conn, uint8_t reason);
+
+#else
+
+static inline void motion_client_init(void) {}
+static inline void motion_client_add_scan_filter(void) {}
+static inline bool motion_client_scan_match(struct bt_scan_device_info *device_info,
+					    struct bt_scan_filter_match *filter_match) { return false; }
+static inline bool motion_client_owns(struct bt_conn *conn) { return false; }
+static inline void motion_client_connected(struct bt_conn *conn, uint8_t err) {}
+static inline void motion_client_disconnected(struct bt_conn *conn, uint8_t reason) {}
+
+#endif /* CONFIG_APP_MOTION */
+
+#endif /* MOTION_CLIENT_H_ */
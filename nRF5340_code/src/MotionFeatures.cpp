@@ -0,0 +1,143 @@
+#include "MotionFeatures.h"
+#include "Dsp.h"
+#include "Protocol.h"
+
+#include <sys/byteorder.h>
+
+int16_t MotionFeatures::atan2Deci(int64_t y, int64_t x)
+{
+    int64_t ax = x < 0 ? -x : x;
+    int64_t ay = y < 0 ? -y : y;
+    int32_t angle;
+
+    if (ax == 0 && ay == 0)
+    {
+        return 0;
+    }
+
+    // atan(z) ~ z * (45 + 15.6 * (1 - z)) degrees for 0 <= z <= 1, z in Q15
+    if (ay <= ax)
+    {
+        int32_t z = (int32_t) ((ay << 15) / ax);
+        angle = (int32_t) (((int64_t) z * (450 * 32768 + 156 * (32768 - z))) >> 30);
+    }
+    else
+    {
+        int32_t z = (int32_t) ((ax << 15) / ay);
+        angle = 900 - (int32_t) (((int64_t) z * (450 * 32768 + 156 * (32768 - z))) >> 30);
+    }
+
+    if (x < 0)
+    {
+        angle = 1800 - angle;
+    }
+    return (int16_t) (y < 0 ? -angle : angle);
+}
+
+void MotionFeatures::init(uint8_t source, uint16_t window)
+{
+    this->source = source;
+    this->window = window;
+    count = 0;
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        sum[i] = 0;
+        sumSquares[i] = 0;
+    }
+    sumLean = 0;
+    maxLean = 0;
+}
+
+void MotionFeatures::addAccel(int16_t x, int16_t y, int16_t z)
+{
+    int16_t axis[3] = {x, y, z};
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        sum[i] += axis[i];
+        sumSquares[i] += (int32_t) axis[i] * axis[i];
+    }
+}
+
+void MotionFeatures::addLean(int16_t lean)
+{
+    sumLean += lean;
+    if ((lean < 0 ? -lean : lean) > (maxLean < 0 ? -maxLean : maxLean))
+    {
+        maxLean = lean;
+    }
+}
+
+bool MotionFeatures::add(const uint8_t *sample, uint16_t length)
+{
+    if (source == MOTION_SOURCE_RAW)
+    {
+        if (length < MOTION_RAW_SIZE)
+        {
+            return false;
+        }
+        int16_t ax = (int16_t) sys_get_le16(&sample[0]);
+        int16_t ay = (int16_t) sys_get_le16(&sample[2]);
+        int16_t az = (int16_t) sys_get_le16(&sample[4]);
+        addAccel(ax, ay, az);
+        // lean from the direction of the gravity, only valid without curves
+        addLean(atan2Deci(ay, az));
+    }
+    else
+    {
+        if (length < MOTION_QUATERNION_SIZE)
+        {
+            return false;
+        }
+        int64_t w = (int32_t) sys_get_le32(&sample[0]);
+        int64_t x = (int32_t) sys_get_le32(&sample[4]);
+        int64_t y = (int32_t) sys_get_le32(&sample[8]);
+        int64_t z = (int32_t) sys_get_le32(&sample[12]);
+        // roll = atan2(2 (wx + yz), 1 - 2 (x^2 + y^2)), Q30
+        int64_t sinRoll = (2 * (w * x + y * z)) >> 30;
+        int64_t cosRoll = ((int64_t) 1 << 30) - ((2 * (x * x + y * y)) >> 30);
+        addLean(atan2Deci(sinRoll, cosRoll));
+    }
+    count++;
+    return count >= window;
+}
+
+void MotionFeatures::frame(uint8_t *out, uint8_t dropped)
+{
+    uint16_t vibration = 0;
+    int16_t lean = 0;
+
+    if (count > 0)
+    {
+        if (source == MOTION_SOURCE_RAW)
+        {
+            // RMS of the vibration = square root of the summed variances of the axes
+            uint64_t variance = 0;
+            for (uint8_t i = 0; i < 3; i++)
+            {
+                variance += (uint64_t) (count * sumSquares[i] - (int64_t) sum[i] * sum[i]) / count;
+            }
+            // Q10 g -> mg: (1000 / 1024)^2 = 15625 / 16384
+            uint32_t rms = dsp_isqrt64(variance * 15625 / 16384 / count);
+            vibration = rms > UINT16_MAX ? UINT16_MAX : (uint16_t) rms;
+        }
+        lean = (int16_t) (sumLean / count);
+    }
+
+    // 1. value: type -> motion
+    // 2. value: source of the samples
+    // 3./4. value: RMS of the vibration in mg (raw samples only)
+    // 5./6. value: mean lean angle in 0.1 degree
+    // 7./8. value: largest lean angle in 0.1 degree
+    // 9. value: samples in the window
+    // 10. value: dropped samples
+    out[0] = TYPE_MOTION;
+    out[1] = source;
+    sys_put_le16(vibration, &out[2]);
+    sys_put_le16((uint16_t) lean, &out[4]);
+    sys_put_le16((uint16_t) maxLean, &out[6]);
+    out[8] = count > UINT8_MAX ? UINT8_MAX : (uint8_t) count;
+    out[9] = dropped;
+
+    init(source, window);
+}
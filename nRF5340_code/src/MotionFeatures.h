@@ -0,0 +1,88 @@
+/**
+ * @file    MotionFeatures.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Aggregation of the Thingy:52 motion samples into features of a
+ *          window: vibration of the frame (raw accelerometer) and lean
+ *          angle (roll, x axis of the Thingy in driving direction).
+ *          Integer arithmetic only, every sample costs O(1), without
+ *          Bluetooth dependencies.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef MOTION_FEATURES_H_
+#define MOTION_FEATURES_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// sources of the samples
+#define MOTION_SOURCE_RAW           0   // accel (Q10 g), gyro, compass: 9 x int16, 18 bytes
+#define MOTION_SOURCE_QUATERNION    1   // w, x, y, z: 4 x int32 in Q30, 16 bytes
+
+#define MOTION_RAW_SIZE             18
+#define MOTION_QUATERNION_SIZE      16
+
+// length of the TYPE_MOTION frame
+#define MOTION_FRAME_SIZE           10
+
+class MotionFeatures {
+public:
+    /**
+     * @brief start with an empty window, no constructor (static objects)
+     *
+     * @param source MOTION_SOURCE_RAW or MOTION_SOURCE_QUATERNION
+     * @param window number of samples in one window
+     */
+    void init(uint8_t source, uint16_t window);
+
+    /**
+     * @brief add a sample of the Thingy
+     *
+     * @param sample raw or quaternion sample, little endian
+     * @param length length of the sample
+     * @return true if the window is complete -> frame()
+     */
+    bool add(const uint8_t *sample, uint16_t length);
+
+    /**
+     * @brief build the frame of the completed window and start the next one
+     *
+     * @param out frame, MOTION_FRAME_SIZE bytes
+     * @param dropped samples lost before the processing since the last frame
+     */
+    void frame(uint8_t *out, uint8_t dropped);
+
+    /**
+     * @brief atan2 in integer arithmetic, error < 0.3 degrees
+     *
+     * @return int16_t angle in 0.1 degree, -1800 to 1800
+     */
+    static int16_t atan2Deci(int64_t y, int64_t x);
+
+private:
+    void addAccel(int16_t x, int16_t y, int16_t z);
+    void addLean(int16_t lean);
+
+    uint8_t source;
+    uint16_t window;
+    uint16_t count;
+
+    // accelerometer sums of the window (Q10 g)
+    int32_t sum[3];
+    int64_t sumSquares[3];
+
+    // lean angles of the window (0.1 degree)
+    int32_t sumLean;
+    int16_t maxLean;
+};
+
+#endif /* MOTION_FEATURES_H_ */
@@ -0,0 +1,44 @@
+#include "PowerWindow.h"
+
+void PowerWindow::reset()
+{
+    head = 0;
+    cnt = 0;
+    sum = 0;
+}
+
+void PowerWindow::removeOldest()
+{
+    sum -= power[head];
+    head = (head + 1) % POWER_WINDOW_SAMPLES;
+    cnt--;
+}
+
+void PowerWindow::add(uint16_t watts, uint32_t timeMs)
+{
+    if (cnt == POWER_WINDOW_SAMPLES)
+    {
+        removeOldest();
+    }
+
+    uint8_t pos = (head + cnt) % POWER_WINDOW_SAMPLES;
+    power[pos] = watts;
+    time[pos] = timeMs;
+    sum += watts;
+    cnt++;
+
+    // the newest sample stays, also after a pause longer than the window
+    while (cnt > 1 && timeMs - time[head] > POWER_WINDOW_MS)
+    {
+        removeOldest();
+    }
+}
+
+uint16_t PowerWindow::average() const
+{
+    if (cnt == 0)
+    {
+        return 0;
+    }
+    return (uint16_t) ((sum + cnt / 2) / cnt);
+}
@@ -0,0 +1,70 @@
+/**
+ * @file    PowerWindow.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Average power of a cycling power meter over the last seconds,
+ *          the sum is updated with every sample, a new sample costs O(1)
+ *          amortized.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef POWER_WINDOW_H_
+#define POWER_WINDOW_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// duration of the average, 3 s like the displays of bike computers
+#define POWER_WINDOW_MS 3000
+
+// samples in the window, power meters notify with up to 8 Hz
+#define POWER_WINDOW_SAMPLES 32
+
+class PowerWindow {
+public:
+    /**
+     * @brief clear the window, no constructor (static objects)
+     */
+    void reset();
+
+    /**
+     * @brief add a power sample, the samples older than POWER_WINDOW_MS are removed
+     *
+     * @param watts instantaneous power in W
+     * @param timeMs board time of the sample in ms
+     */
+    void add(uint16_t watts, uint32_t timeMs);
+
+    /**
+     * @brief average of the samples in the window
+     *
+     * @return uint16_t power in W, 0 without samples
+     */
+    uint16_t average() const;
+
+    /**
+     * @brief number of samples in the window
+     *
+     * @return uint8_t samples, at most POWER_WINDOW_SAMPLES
+     */
+    uint8_t count() const { return cnt; }
+
+private:
+    void removeOldest();
+
+    uint16_t power[POWER_WINDOW_SAMPLES];
+    uint32_t time[POWER_WINDOW_SAMPLES];
+    uint8_t head;
+    uint8_t cnt;
+    uint32_t sum;
+};
+
+#endif /* POWER_WINDOW_H_ */
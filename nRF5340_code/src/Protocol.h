@@ -0,0 +1,150 @@
+/**
+ * @file    Protocol.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Frames exchanged with the application over the data service,
+ *          without dependencies -> also used by the host tools
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// Type definitions -> first byte of every data frame sent to the application
+#define TYPE_CSC_SPEED 1
+#define TYPE_CSC_CADENCE 2
+#define TYPE_HEARTRATE 3
+#define TYPE_BATTERY 4
+#define TYPE_HRV 5
+#define TYPE_MOTION 6
+#define TYPE_POWER 7
+#define TYPE_INVENTORY 8
+#define TYPE_RIDE_STATS 9
+#define TYPE_BENCH 0xB0
+#define TYPE_SENSOR_STATE 0xC0      // outside of the message codes (10 to 24)
+#define TYPE_LINK_STATE 0xC1
+
+/*
+ * Commands of the application: frames with an opcode in the first byte,
+ * the lengths 1 (diameter) and 19 (address) are reserved.
+ *
+ * RX_CMD_BENCH:    opcode, rate in frames/s (2, 0 stops), payload length
+ *                  -> TYPE_BENCH frames: type, sequence (2), time stamp in us (4), padding
+ *
+ * RX_CMD_ADV_ALLOW: opcode, flags (RX_ADV_ALLOW_*), for every sensor its
+ *                  address type and address (6, little endian)
+ *                  -> allowlist of the broadcasting sensors (CONFIG_APP_ADV_INGEST)
+ *
+ * RX_CMD_INVENTORY: opcode, mode (RX_INVENTORY_*)
+ *                  -> TYPE_INVENTORY frames of the nearby devices (CONFIG_APP_INVENTORY)
+ *
+ * RX_CMD_STREAMS:  opcode, for every metric shown by the application its type
+ *                  (TYPE_CSC_SPEED to TYPE_POWER), minimum interval in ms (2,
+ *                  little endian) and resolution, or opcode, RX_STREAMS_ALL
+ *                  or opcode, RX_STREAMS_NONE (a single byte would be a diameter)
+ *                  -> only these metrics are sent to this application (STREAM_*)
+ *
+ * RX_CMD_RIDE_STATS: opcode, mode (RX_RIDE_STATS_*), for RX_RIDE_STATS_RESET
+ *                  optionally the maximum heart rate of the rider in bpm
+ *                  -> TYPE_RIDE_STATS frames of the statistics of the ride
+ */
+#define RX_CMD_BENCH 0xB0
+#define RX_CMD_ADV_ALLOW 0xA1
+#define RX_CMD_INVENTORY 0xA2
+#define RX_CMD_STREAMS 0xA3
+#define RX_CMD_RIDE_STATS 0xA4
+
+#define RX_ADV_ALLOW_CLEAR 0x01     // clear the allowlist before adding the sensors
+
+#define RX_INVENTORY_STOP 0         // no more inventory frames
+#define RX_INVENTORY_START 1        // the whole inventory, then only the changes
+
+#define RX_STREAMS_ALL 0xff         // all metrics at the rate of the sensors (default)
+#define RX_STREAMS_NONE 0x00        // no metric, only the frames without a type
+
+#define RX_RIDE_STATS_READ 0        // the frames of all pages
+#define RX_RIDE_STATS_RESET 1       // start a new ride, then the frames
+
+/*
+ * Streams of RX_CMD_STREAMS: a frame of a metric is sent to the application at
+ * most once per minimum interval (0 = every frame) and only when its value
+ * changed by the resolution since the last frame sent (0 = every frame).
+ * Unit of the resolution: speed 0.01 km/h, cadence rpm, heart rate bpm,
+ * power W. The frames without a type (message codes) are always sent. The
+ * battery levels of all sensors share TYPE_BATTERY, they have no minimum interval.
+ */
+#define STREAM_TYPES            (TYPE_POWER + 1)    // types 1 to TYPE_POWER
+#define STREAM_BIT(type)        (1U << (type))
+#define STREAM_ALL              ((STREAM_BIT(STREAM_TYPES) - 1) & ~1U)
+#define STREAM_ENTRY_LEN        4
+
+/*
+ * TYPE_INVENTORY frame: type, number of devices, then for every device:
+ *   address (6, little endian), flags (INVENTORY_*), smoothed RSSI in dBm (int8),
+ *   seconds since last seen (INVENTORY_GONE if aged out), name length, name
+ * The name is sent once, its length is 0 in the later updates of a device.
+ */
+#define INVENTORY_CSC           0x01    // advertises the Cycling Speed and Cadence Service
+#define INVENTORY_HRS           0x02    // advertises the Heart Rate Service
+#define INVENTORY_CPS           0x04    // advertises the Cycling Power Service
+#define INVENTORY_THINGY        0x08    // Thingy:52
+#define INVENTORY_OTHER         0x10    // advertises other services
+#define INVENTORY_RANDOM        0x20    // random address, public if not set
+#define INVENTORY_CONNECTABLE   0x40
+#define INVENTORY_BROADCAST     0x80    // measurements in the service data (CONFIG_APP_ADV_INGEST)
+
+#define INVENTORY_GONE          0xff
+#define INVENTORY_ENTRY_LEN     10      // without the name
+
+/*
+ * TYPE_RIDE_STATS frame: type, page, then little endian
+ *   RIDE_STATS_PAGE_SPEED:  distance in m (4), elapsed time in s (4), moving
+ *                           time in s (4), average and maximum speed in
+ *                           km/h * 100 (2 + 2), average and maximum cadence
+ *                           in rpm (1 + 1)
+ *   RIDE_STATS_PAGE_EFFORT: average and maximum heart rate in bpm (1 + 1),
+ *                           average and maximum power in W (2 + 2), energy
+ *                           in kJ (2), time in the heart rate zones 1 to 5
+ *                           in s (5 x 2)
+ * The values saturate at the maximum of their field.
+ */
+#define RIDE_STATS_PAGE_SPEED   0
+#define RIDE_STATS_PAGE_EFFORT  1
+#define RIDE_STATS_PAGES        2
+#define RIDE_STATS_FRAME_LEN    20
+
+/*
+ * TYPE_SENSOR_STATE frame: type, TYPE_* of the value (TYPE_CSC_SPEED,
+ * TYPE_CSC_CADENCE, TYPE_HEARTRATE or TYPE_POWER), state (SENSOR_STATE_*)
+ * Sent when the state of a value changed, a stopped speed or cadence is
+ * sent as 0 before its state.
+ */
+#define SENSOR_STATE_IDLE       0       // no notification since the connection
+#define SENSOR_STATE_LIVE       1       // events at the expected period
+#define SENSOR_STATE_STOPPED    2       // notifications without new event (wheel or crank stopped)
+#define SENSOR_STATE_STALE      3       // the notifications are overdue, the value is old
+#define SENSOR_STATE_FRAME_LEN  3
+
+/*
+ * TYPE_LINK_STATE frame: type, TYPE_* of the sensor, state (LINK_STATE_*),
+ * smoothed RSSI in dBm (signed, LINK_RSSI_UNKNOWN if not measured),
+ * smoothed share of the lost notifications in %, lost notifications since
+ * the connection (2, little endian, saturates)
+ * Sent when the quality of the connection to a sensor changed, a weak or
+ * critical link is a warning before the connection is lost. LINK_STATE_LOST
+ * is sent once at the disconnection with the last statistics.
+ */
+#define LINK_STATE_GOOD         0
+#define LINK_STATE_WEAK         1       // low RSSI or notifications lost
+#define LINK_STATE_CRITICAL     2       // the connection may be lost soon
+#define LINK_STATE_LOST         3       // disconnected
+#define LINK_RSSI_UNKNOWN       127
+#define LINK_STATE_FRAME_LEN    7
+
+#endif /* PROTOCOL_H_ */
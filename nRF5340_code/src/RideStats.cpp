@@ -0,0 +1,237 @@
+#include "RideStats.h"
+#include "Protocol.h"
+
+#include <sys/byteorder.h>
+
+static uint16_t saturate16(uint32_t value)
+{
+    return value > UINT16_MAX ? UINT16_MAX : (uint16_t) value;
+}
+
+static uint8_t saturate8(uint32_t value)
+{
+    return value > UINT8_MAX ? UINT8_MAX : (uint8_t) value;
+}
+
+void RideStats::reset()
+{
+    started = false;
+    startUs = 0;
+    lastUs = 0;
+
+    wheelValid = false;
+    distanceMm = 0;
+
+    speed.valid = false;
+    speed.value = 0;
+    movingMs = 0;
+    speedMax = 0;
+
+    cadence.valid = false;
+    cadence.value = 0;
+    cadenceSum = 0;
+    pedalingMs = 0;
+    cadenceMax = 0;
+
+    heartRate.valid = false;
+    heartRate.value = 0;
+    heartRateSum = 0;
+    heartRateMs = 0;
+    heartRateMax = 0;
+    for (uint8_t zone = 0; zone < RIDE_HR_ZONES; zone++)
+    {
+        zoneMs[zone] = 0;
+    }
+
+    power.valid = false;
+    power.value = 0;
+    powerSum = 0;
+    powerMs = 0;
+    powerMax = 0;
+}
+
+void RideStats::setHeartRateMax(uint8_t bpm)
+{
+    // zone 0 starts at 0 bpm, zone n at 50 + 10 * n %
+    zoneMin[0] = 0;
+    for (uint8_t zone = 1; zone < RIDE_HR_ZONES; zone++)
+    {
+        zoneMin[zone] = (uint8_t) ((uint32_t) bpm * (50 + 10 * zone) / 100);
+    }
+}
+
+void RideStats::touch(uint64_t time)
+{
+    if (!started)
+    {
+        started = true;
+        startUs = time;
+        lastUs = time;
+    }
+    else if (time > lastUs)
+    {
+        lastUs = time;
+    }
+}
+
+/*
+ * time in ms during which the last value of a sensor held, 0 after a gap
+ * longer than RIDE_MAX_GAP_MS or for an older value, then the new value holds
+ */
+uint32_t RideStats::hold(Held &held, uint16_t value, uint64_t time)
+{
+    uint32_t ms = 0;
+
+    touch(time);
+    if (held.valid && time < held.time)
+    {
+        // mapped from another sensor clock, the newer value is kept
+        return 0;
+    }
+    if (held.valid && time - held.time <= (uint64_t) RIDE_MAX_GAP_MS * 1000)
+    {
+        ms = (uint32_t) ((time - held.time) / 1000);
+    }
+    held.value = value;
+    held.time = time;
+    held.valid = true;
+    return ms;
+}
+
+void RideStats::addWheel(uint32_t revs, uint32_t circumferenceMm, uint64_t time)
+{
+    touch(time);
+    if (wheelValid && time >= wheelUs)
+    {
+        // the counter wraps around, a jump faster than the wheel can turn is a new counter
+        uint32_t delta = revs - wheelRevs;
+        if ((uint64_t) delta * 1000000 <= (time - wheelUs + 1000000) * RIDE_MAX_WHEEL_RPS)
+        {
+            distanceMm += (uint64_t) delta * circumferenceMm;
+        }
+    }
+    wheelValid = true;
+    wheelRevs = revs;
+    wheelUs = time;
+}
+
+void RideStats::addSpeed(uint16_t value, uint64_t time)
+{
+    uint16_t last = speed.value;
+    uint32_t ms = hold(speed, value, time);
+
+    if (last >= RIDE_MOVING_SPEED)
+    {
+        movingMs += ms;
+    }
+    if (value > speedMax)
+    {
+        speedMax = value;
+    }
+}
+
+void RideStats::addCadence(uint16_t rpm, uint64_t time)
+{
+    uint16_t last = cadence.value;
+    uint32_t ms = hold(cadence, rpm, time);
+
+    if (last > 0)
+    {
+        cadenceSum += (uint64_t) last * ms;
+        pedalingMs += ms;
+    }
+    if (rpm > cadenceMax)
+    {
+        cadenceMax = rpm;
+    }
+}
+
+void RideStats::addHeartRate(uint8_t bpm, uint64_t time)
+{
+    uint16_t last = heartRate.value;
+    uint32_t ms = hold(heartRate, bpm, time);
+
+    if (last > 0 && ms > 0)
+    {
+        uint8_t zone = RIDE_HR_ZONES - 1;
+        while (zone > 0 && last < zoneMin[zone])
+        {
+            zone--;
+        }
+        zoneMs[zone] += ms;
+        heartRateSum += (uint64_t) last * ms;
+        heartRateMs += ms;
+    }
+    if (bpm > heartRateMax)
+    {
+        heartRateMax = bpm;
+    }
+}
+
+void RideStats::addPower(uint16_t watts, uint64_t time)
+{
+    uint16_t last = power.value;
+    uint32_t ms = hold(power, watts, time);
+
+    powerSum += (uint64_t) last * ms;
+    powerMs += ms;
+    if (watts > powerMax)
+    {
+        powerMax = watts;
+    }
+}
+
+uint16_t RideStats::averageSpeed() const
+{
+    // mm/ms = m/s -> * 3.6 km/h * 100
+    return movingMs > 0 ? saturate16((uint32_t) (distanceMm * 360 / movingMs)) : 0;
+}
+
+uint16_t RideStats::averageCadence() const
+{
+    return pedalingMs > 0 ? (uint16_t) (cadenceSum / pedalingMs) : 0;
+}
+
+uint8_t RideStats::averageHeartRate() const
+{
+    return heartRateMs > 0 ? (uint8_t) (heartRateSum / heartRateMs) : 0;
+}
+
+uint16_t RideStats::averagePower() const
+{
+    return powerMs > 0 ? (uint16_t) (powerSum / powerMs) : 0;
+}
+
+uint8_t RideStats::frame(uint8_t page, uint8_t *frame) const
+{
+    frame[0] = TYPE_RIDE_STATS;
+    frame[1] = page;
+
+    switch (page)
+    {
+    case RIDE_STATS_PAGE_SPEED:
+        sys_put_le32(distanceM(), &frame[2]);
+        sys_put_le32(elapsedS(), &frame[6]);
+        sys_put_le32(movingS(), &frame[10]);
+        sys_put_le16(averageSpeed(), &frame[14]);
+        sys_put_le16(speedMax, &frame[16]);
+        frame[18] = saturate8(averageCadence());
+        frame[19] = saturate8(cadenceMax);
+        return RIDE_STATS_FRAME_LEN;
+
+    case RIDE_STATS_PAGE_EFFORT:
+        frame[2] = averageHeartRate();
+        frame[3] = heartRateMax;
+        sys_put_le16(averagePower(), &frame[4]);
+        sys_put_le16(powerMax, &frame[6]);
+        sys_put_le16(saturate16(energyKj()), &frame[8]);
+        for (uint8_t zone = 0; zone < RIDE_HR_ZONES; zone++)
+        {
+            sys_put_le16(saturate16(zoneS(zone)), &frame[10 + 2 * zone]);
+        }
+        return RIDE_STATS_FRAME_LEN;
+
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,208 @@
+/**
+ * @file    RideStats.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Statistics of the ride, kept on the board from every value of
+ *          the sensor timeline: distance from the cumulative wheel
+ *          revolutions, moving time, averages and maxima of speed,
+ *          cadence, heart rate and power and the time in the heart rate
+ *          zones. A sample costs O(1) in constant memory, the totals do
+ *          not depend on the frames the application received.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef RIDE_STATS_H_
+#define RIDE_STATS_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// a value holds until the next one, at most this long (sensor gone or stopped)
+#define RIDE_MAX_GAP_MS         5000
+
+// moving from this speed on, in km/h * 100
+#define RIDE_MOVING_SPEED       300
+
+// more wheel revolutions per second are a new counter of the sensor (reset, other sensor)
+#define RIDE_MAX_WHEEL_RPS      25
+
+// heart rate zones, zone n from 50 + 10 * n % of the maximum heart rate,
+// zone 0 also below
+#define RIDE_HR_ZONES           5
+#define RIDE_HR_MAX_DEFAULT     190
+
+class RideStats {
+public:
+    /**
+     * @brief start a new ride, the maximum heart rate is kept,
+     *        no constructor (static objects)
+     */
+    void reset();
+
+    /**
+     * @brief set the maximum heart rate for the zones
+     *
+     * @param bpm maximum heart rate of the rider
+     */
+    void setHeartRateMax(uint8_t bpm);
+
+    /**
+     * @brief add the cumulative wheel revolutions of a CSC measurement,
+     *        the revolutions since the last one are added to the distance
+     *
+     * @param revs cumulative wheel revolutions of the sensor (32 bit)
+     * @param circumferenceMm wheel circumference, 0 if unknown (not counted)
+     * @param time board time of the reception in us
+     */
+    void addWheel(uint32_t revs, uint32_t circumferenceMm, uint64_t time);
+
+    /**
+     * @brief the next wheel revolutions are of another counter
+     *        (e.g. another sensor), no distance to the last ones
+     */
+    void restartWheel() { wheelValid = false; }
+
+    /**
+     * @brief add a speed value
+     *
+     * @param speed speed in km/h * 100
+     * @param time board time of the value in us
+     */
+    void addSpeed(uint16_t speed, uint64_t time);
+
+    /**
+     * @brief add a cadence value
+     *
+     * @param rpm cadence in rpm
+     * @param time board time of the value in us
+     */
+    void addCadence(uint16_t rpm, uint64_t time);
+
+    /**
+     * @brief add a heart rate value
+     *
+     * @param bpm heart rate in bpm
+     * @param time board time of the value in us
+     */
+    void addHeartRate(uint8_t bpm, uint64_t time);
+
+    /**
+     * @brief add a power value
+     *
+     * @param watts instantaneous power in W
+     * @param time board time of the value in us
+     */
+    void addPower(uint16_t watts, uint64_t time);
+
+    uint32_t distanceM() const { return (uint32_t) (distanceMm / 1000); }
+    uint32_t elapsedS() const { return started ? (uint32_t) ((lastUs - startUs) / 1000000) : 0; }
+    uint32_t movingS() const { return movingMs / 1000; }
+    uint16_t maxSpeed() const { return speedMax; }
+    uint16_t maxCadence() const { return cadenceMax; }
+    uint8_t maxHeartRate() const { return heartRateMax; }
+    uint16_t maxPower() const { return powerMax; }
+
+    /**
+     * @brief average speed over the moving time
+     *
+     * @return uint16_t speed in km/h * 100, 0 before the first movement
+     */
+    uint16_t averageSpeed() const;
+
+    /**
+     * @brief average cadence over the time with pedaling
+     *
+     * @return uint16_t cadence in rpm
+     */
+    uint16_t averageCadence() const;
+
+    /**
+     * @brief average heart rate over the time with a heart rate
+     *
+     * @return uint8_t heart rate in bpm
+     */
+    uint8_t averageHeartRate() const;
+
+    /**
+     * @brief average power over the time with a power meter, zeros included
+     *
+     * @return uint16_t power in W
+     */
+    uint16_t averagePower() const;
+
+    /**
+     * @brief work of the power meter
+     *
+     * @return uint32_t energy in kJ
+     */
+    uint32_t energyKj() const { return (uint32_t) (powerSum / 1000000); }
+
+    /**
+     * @brief time in a heart rate zone
+     *
+     * @param zone 0 to RIDE_HR_ZONES - 1
+     * @return uint32_t time in s
+     */
+    uint32_t zoneS(uint8_t zone) const { return zone < RIDE_HR_ZONES ? zoneMs[zone] / 1000 : 0; }
+
+    /**
+     * @brief encode a TYPE_RIDE_STATS frame (Protocol.h)
+     *
+     * @param page RIDE_STATS_PAGE_*
+     * @param frame buffer of RIDE_STATS_FRAME_LEN bytes
+     * @return uint8_t length of the frame, 0 if unknown page
+     */
+    uint8_t frame(uint8_t page, uint8_t *frame) const;
+
+private:
+    // last value of a sensor, it holds until the next one
+    struct Held
+    {
+        uint16_t value;
+        uint64_t time;
+        bool valid;
+    };
+
+    uint32_t hold(Held &held, uint16_t value, uint64_t time);
+    void touch(uint64_t time);
+
+    bool started;
+    uint64_t startUs;
+    uint64_t lastUs;
+
+    bool wheelValid;
+    uint32_t wheelRevs;
+    uint64_t wheelUs;
+    uint64_t distanceMm;
+
+    Held speed;
+    uint32_t movingMs;
+    uint16_t speedMax;
+
+    Held cadence;
+    uint64_t cadenceSum;        // rpm * ms
+    uint32_t pedalingMs;
+    uint16_t cadenceMax;
+
+    Held heartRate;
+    uint64_t heartRateSum;      // bpm * ms
+    uint32_t heartRateMs;
+    uint8_t heartRateMax;
+    uint8_t zoneMin[RIDE_HR_ZONES];
+    uint32_t zoneMs[RIDE_HR_ZONES];
+
+    Held power;
+    uint64_t powerSum;          // W * ms
+    uint32_t powerMs;
+    uint16_t powerMax;
+};
+
+#endif /* RIDE_STATS_H_ */
@@ -0,0 +1,124 @@
+#include "SensorClock.h"
+
+#include "EventLog.h"
+
+void SensorClock::reset()
+{
+    started = false;
+    lastEvent = 0;
+    lastBoardUs = 0;
+    eventTicks = 0;
+    lastStamp = 0;
+    offset = 0;
+    drift = 0;
+    refSensorUs = 0;
+    baseOffset = 0;
+    baseSensorUs = 0;
+    windowMin = 0;
+    windowStartUs = 0;
+    windows = 0;
+}
+
+uint64_t SensorClock::update(uint16_t eventTime, uint64_t boardUs)
+{
+    if (started)
+    {
+        if (eventTime == lastEvent)
+        {
+            // same event as in the last notification
+            return lastStamp;
+        }
+
+        // the 16 bit counter can wrap between two events (no events for > 64 s),
+        // the new event was at most SENSOR_CLOCK_MAX_DELAY before the reception
+        // -> the elapsed board time gives the number of wraps
+        uint16_t delta = (uint16_t) (eventTime - lastEvent);
+        uint64_t elapsed = (boardUs - lastBoardUs) * 1024 / 1000000 + SENSOR_CLOCK_MAX_DELAY;
+        if (delta <= elapsed)
+        {
+            eventTicks += delta + (((elapsed - delta) >> 16) << 16);
+        }
+        else
+        {
+            // sensor time faster than the board time -> sensor restarted
+            uint64_t stamp = lastStamp;
+            reset();
+            lastStamp = stamp;
+        }
+    }
+
+    if (!started)
+    {
+        started = true;
+        windowStartUs = 0;
+        windowMin = (int64_t) boardUs;
+        offset = (int64_t) boardUs;
+    }
+    lastEvent = eventTime;
+    lastBoardUs = boardUs;
+
+    // 1/1024 s -> us
+    uint64_t sensorUs = eventTicks * 15625 / 16;
+    int64_t diff = (int64_t) boardUs - (int64_t) sensorUs;
+
+    if (diff < windowMin)
+    {
+        windowMin = diff;
+    }
+    if (windows == 0 && diff < offset)
+    {
+        // first window: best offset until now
+        offset = diff;
+    }
+
+    if (sensorUs - windowStartUs >= SENSOR_CLOCK_WINDOW_US)
+    {
+        if (windows == 1)
+        {
+            // the first window includes the start of the sensor -> only the
+            // following windows are used for the drift
+            baseOffset = windowMin;
+            baseSensorUs = sensorUs;
+        }
+        else if (windows > 1)
+        {
+            // the baseline grows with every window -> the noise of the
+            // minimum has less and less influence
+            int64_t ppm = (windowMin - baseOffset) * 1000000 / (int64_t) (sensorUs - baseSensorUs);
+            if (ppm > SENSOR_CLOCK_MAX_PPM)
+            {
+                ppm = SENSOR_CLOCK_MAX_PPM;
+            }
+            else if (ppm < -SENSOR_CLOCK_MAX_PPM)
+            {
+                ppm = -SENSOR_CLOCK_MAX_PPM;
+            }
+            drift = (int32_t) ppm;
+        }
+        offset = windowMin;
+        refSensorUs = sensorUs;
+        windowStartUs = sensorUs;
+        windowMin = diff;
+        if (windows < UINT8_MAX)
+        {
+            windows++;
+        }
+        ELOG2(SENSOR_CLOCK, (int32_t) (offset / 1000), drift);
+    }
+
+    // board time of the event, extrapolated from the last offset with the drift
+    int64_t elapsed = (int64_t) (sensorUs - refSensorUs);
+    int64_t stamp = (int64_t) sensorUs + offset + elapsed * drift / 1000000;
+
+    // the event was not after the reception and the timeline is monotonic
+    if (stamp > (int64_t) boardUs)
+    {
+        stamp = (int64_t) boardUs;
+    }
+    if (stamp < (int64_t) lastStamp)
+    {
+        stamp = (int64_t) lastStamp;
+    }
+    lastStamp = (uint64_t) stamp;
+    return lastStamp;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file    SensorClock.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Time base of a CSC sensor: unwraps the 16 bit event time
+ *          (1/1024 s, wraps every 64 s) and estimates the offset and the
+ *          drift of the sensor clock against the board uptime. The events
+ *          of all sensors are mapped onto the monotonic board timeline.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef SENSOR_CLOCK_H_
+#define SENSOR_CLOCK_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// length of one offset window in sensor time, the drift is computed from
+// the offsets of the second and the last window
+#define SENSOR_CLOCK_WINDOW_US  (120 * 1000000ULL)
+
+// maximum time between a sensor event and its notification in 1/1024 s
+#define SENSOR_CLOCK_MAX_DELAY  1024
+
+// drift of a crystal is some 10 ppm, larger values are errors of the estimation
+#define SENSOR_CLOCK_MAX_PPM    1000
+
+class SensorClock {
+public:
+    /**
+     * @brief forget the sensor clock (new connection), no constructor (static objects)
+     */
+    void reset();
+
+    /**
+     * @brief add the event time of a notification
+     *
+     * @param eventTime last event time of the sensor in 1/1024 s
+     * @param boardUs board uptime at the reception of the notification in us
+     * @return uint64_t time of the event on the board timeline in us
+     */
+    uint64_t update(uint16_t eventTime, uint64_t boardUs);
+
+    /**
+     * @brief event counter of the sensor without wraps
+     *
+     * @return uint64_t event time in 1/1024 s since the first notification
+     */
+    uint64_t ticks() const { return eventTicks; }
+
+    /**
+     * @brief offset of the sensor clock, board time = sensor time + offset
+     *
+     * @return int64_t offset in us, the minimum of the current window
+     */
+    int64_t offsetUs() const { return offset; }
+
+    /**
+     * @brief drift of the sensor clock against the board clock
+     *
+     * @return int32_t drift in ppm, positive if the sensor clock is slower
+     */
+    int32_t driftPpm() const { return drift; }
+
+    /**
+     * @brief true if the drift was estimated, after three windows
+     */
+    bool synced() const { return windows >= 3; }
+
+private:
+    bool started;
+    uint16_t lastEvent;
+    uint64_t lastBoardUs;
+    uint64_t eventTicks;
+    uint64_t lastStamp;
+
+    // lower envelope of (board time - sensor time): the notification is
+    // received after the event, the smallest difference has the shortest delay
+    int64_t offset;
+    int32_t drift;
+    uint64_t refSensorUs;       // sensor time of the offset
+    int64_t baseOffset;         // offset and sensor time of the drift baseline
+    uint64_t baseSensorUs;
+    int64_t windowMin;
+    uint64_t windowStartUs;
+    uint8_t windows;
+};
+
+#endif /* SENSOR_CLOCK_H_ */
@@ -0,0 +1,498 @@
+#include "SensorPipeline.h"
+
+void SensorPipeline::init(Data *data, pipeline_output_t output)
+{
+    this->data = data;
+    this->output = output;
+    diameterSet = false;
+    speedWatch.init(true);
+    cadenceWatch.init(true);
+    heartRateWatch.init(false);
+    powerWatch.init(false);
+    hrvWindow.reset();
+    speedClock.reset();
+    cadenceClock.reset();
+    speedValid = false;
+    cadenceValid = false;
+    circumferenceMm = 0;
+    setEstimator(false);
+    hrvUplinkBeats = 0;
+    cntBeats = 0;
+    powerWindow.reset();
+    crankValid = false;
+    crankRpm = 0;
+    rideStats.setHeartRateMax(RIDE_HR_MAX_DEFAULT);
+    rideStats.reset();
+}
+
+double SensorPipeline::diameterFromCode(uint8_t code)
+{
+    // check if last bit is '1', then add 0.5 to dia and convert it to cm
+    if ((code & 0b10000000) == 0b10000000)
+    {
+        return (code + 0.5) * 2.54;
+    }
+    return code * 2.54;
+}
+
+void SensorPipeline::setDiameter(double diameter)
+{
+    // only called when the settings changed, the circumference is kept for every sample
+    if (diameter != 0)
+    {
+        diameterSet = true;
+        data->wheelDiameter = diameter;
+        circumferenceMm = (uint32_t) (diameter * PI * 10);
+    }
+    else
+    {
+        // reset button was pressed
+        diameterSet = false;
+    }
+}
+
+void SensorPipeline::resetClock(uint8_t type)
+{
+    if (type == TYPE_POWER)
+    {
+        powerWindow.reset();
+        crankValid = false;
+        crankRpm = 0;
+    }
+    else if (type == CSC_CADENCE)
+    {
+        cadenceClock.reset();
+        cadenceEstimator.reset();
+        cadenceValid = false;
+    }
+    else
+    {
+        speedClock.reset();
+        speedEstimator.reset();
+        speedValid = false;
+        rideStats.restartWheel();
+    }
+}
+
+void SensorPipeline::stopWatch(uint8_t type)
+{
+    switch (type)
+    {
+    case TYPE_CSC_SPEED:
+        speedWatch.reset();
+        break;
+    case TYPE_CSC_CADENCE:
+        cadenceWatch.reset();
+        break;
+    case TYPE_HEARTRATE:
+        heartRateWatch.reset();
+        break;
+    case TYPE_POWER:
+        powerWatch.reset();
+        break;
+    default:
+        break;
+    }
+}
+
+void SensorPipeline::setEstimator(bool enabled)
+{
+    estimatorEnabled = enabled;
+    speedEstimator.reset();
+    cadenceEstimator.reset();
+    // nothing to send before the first event
+    speedZeroSent = true;
+    cadenceZeroSent = true;
+}
+
+void SensorPipeline::sendSpeed(uint16_t speed, uint64_t time)
+{
+    uint8_t dataToSend[3];
+
+    // 1. value: type -> speed
+    // 2. value: 8 bit on the left side of comma
+    // 3. value: 8 bit on the right side of comma
+    dataToSend[0] = TYPE_CSC_SPEED;
+    dataToSend[1] = (uint8_t) (speed/100);
+    dataToSend[2] = (uint8_t) (speed);
+    rideStats.addSpeed(speed, time);
+    output(LATENCY_SENSOR_SPEED, speed, time, dataToSend, sizeof(dataToSend));
+}
+
+void SensorPipeline::sendCadence(uint16_t rpm, uint64_t time)
+{
+    uint8_t dataToSend[3];
+
+    // 1. value: type -> cadence
+    // 2. value: 8 lsb of cadence value
+    // 3. value: 8 msb of cadence value
+    dataToSend[0] = TYPE_CSC_CADENCE;
+    dataToSend[1] = (uint8_t) rpm;
+    dataToSend[2] = (uint8_t) (rpm >> 8);
+    rideStats.addCadence(rpm, time);
+    output(LATENCY_SENSOR_CADENCE, rpm, time, dataToSend, sizeof(dataToSend));
+}
+
+uint8_t SensorPipeline::processCsc(const void *notification, uint16_t length, uint64_t now)
+{
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    // save the new received data
+    data->saveData(notification);
+
+    // the distance is counted from the 32 bit wheel revolutions, not from the speed
+    if (data->type == CSC_SPEED && length >= 7)
+    {
+        rideStats.addWheel(sys_get_le32(&((const uint8_t *) notification)[1]),
+                           diameterSet ? circumferenceMm : 0, now);
+    }
+
+    if (data->type == CSC_SPEED)
+    {
+        // no rate against the counters of before resetClock()
+        bool previous = speedValid;
+        speedValid = true;
+
+        uint64_t time = speedClock.update(data->lastEventSpeed, now);
+        watchCsc(speedWatch, TYPE_CSC_SPEED, !previous || data->sumRevSpeed != data->oldSumRevSpeed, time, now);
+
+        if (!previous)
+        {
+            return data->type;
+        }
+        if (estimatorEnabled)
+        {
+            // the values are sent by estimate() at a steady rate
+            speedEstimator.addNotification(data->sumRevSpeed - data->oldSumRevSpeed,
+                                           data->lastEventSpeed - data->oldLastEventSpeed, time, now);
+        }
+        else if (diameterSet)
+        {
+            // a stopped wheel is sent by checkDeadlines() when its next event is overdue
+            uint16_t speed = data->calcSpeed();
+            if (speed > 0)
+            {
+                sendSpeed(speed, time);
+            }
+        }
+    }
+    else if (data->type == CSC_CADENCE)
+    {
+        bool previous = cadenceValid;
+        cadenceValid = true;
+
+        uint64_t time = cadenceClock.update(data->lastEventCadence, now);
+        watchCsc(cadenceWatch, TYPE_CSC_CADENCE, !previous || data->sumRevCadence != data->oldSumRevCadence, time, now);
+
+        if (!previous)
+        {
+            return data->type;
+        }
+        if (estimatorEnabled)
+        {
+            cadenceEstimator.addNotification(data->sumRevCadence - data->oldSumRevCadence,
+                                             data->lastEventCadence - data->oldLastEventCadence, time, now);
+        }
+        else
+        {
+            // calculate rpm (rounds per minute), a stopped crank is sent by checkDeadlines()
+            uint16_t rpm = data->calcRPM();
+            if (rpm > 0 && rpm < 500)
+            {
+                sendCadence(rpm, time);
+            }
+        }
+    }
+    return data->type;
+}
+
+void SensorPipeline::watchCsc(SensorWatch &watch, uint8_t type, bool newEvent, uint64_t eventTime, uint64_t now)
+{
+    uint8_t before = watch.state();
+
+    watch.notified(now);
+    if (newEvent)
+    {
+        watch.event(eventTime);
+    }
+    stateChanged(watch, type, before, now);
+}
+
+void SensorPipeline::stateChanged(const SensorWatch &watch, uint8_t type, uint8_t before, uint64_t now)
+{
+    uint8_t dataToSend[SENSOR_STATE_FRAME_LEN];
+
+    if (watch.state() == before)
+    {
+        return;
+    }
+
+    // overdue -> zero at once, also instead of the decay of the estimator
+    if (before == SENSOR_STATE_LIVE && type == TYPE_CSC_SPEED)
+    {
+        speedEstimator.reset();
+        speedZeroSent = true;
+        if (diameterSet)
+        {
+            sendSpeed(0, now);
+        }
+    }
+    else if (before == SENSOR_STATE_LIVE && type == TYPE_CSC_CADENCE)
+    {
+        cadenceEstimator.reset();
+        cadenceZeroSent = true;
+        sendCadence(0, now);
+    }
+
+    // 1. value: type -> sensor state
+    // 2. value: type of the value
+    // 3. value: state
+    dataToSend[0] = TYPE_SENSOR_STATE;
+    dataToSend[1] = type;
+    dataToSend[2] = watch.state();
+    output(PIPELINE_OUTPUT_STATE, watch.state(), now, dataToSend, sizeof(dataToSend));
+}
+
+void SensorPipeline::checkDeadlines(uint64_t now)
+{
+    SensorWatch *watches[] = {&speedWatch, &cadenceWatch, &heartRateWatch, &powerWatch};
+    static const uint8_t types[] = {TYPE_CSC_SPEED, TYPE_CSC_CADENCE, TYPE_HEARTRATE, TYPE_POWER};
+
+    for (uint8_t i = 0; i < sizeof(watches) / sizeof(watches[0]); i++)
+    {
+        uint8_t before = watches[i]->state();
+        watches[i]->check(now);
+        stateChanged(*watches[i], types[i], before, now);
+    }
+}
+
+uint64_t SensorPipeline::nextDeadline() const
+{
+    const SensorWatch *watches[] = {&speedWatch, &cadenceWatch, &heartRateWatch, &powerWatch};
+    uint64_t deadline = SENSOR_WATCH_NEVER;
+
+    for (uint8_t i = 0; i < sizeof(watches) / sizeof(watches[0]); i++)
+    {
+        if (watches[i]->deadline() < deadline)
+        {
+            deadline = watches[i]->deadline();
+        }
+    }
+    return deadline;
+}
+
+void SensorPipeline::estimate(uint64_t now)
+{
+    if (!estimatorEnabled)
+    {
+        return;
+    }
+
+    if (diameterSet)
+    {
+        // rev/s * circumference in mm * 3600 s/h / 10^6 mm/km * 100
+        uint64_t speed = ((uint64_t) speedEstimator.rate(now) * circumferenceMm * 36 / 100) >> 16;
+        if (speed > UINT16_MAX)
+        {
+            speed = UINT16_MAX;
+        }
+        // a stopped bike is sent once
+        if (speed > 0 || !speedZeroSent)
+        {
+            speedZeroSent = (speed == 0);
+            sendSpeed((uint16_t) speed, now);
+        }
+    }
+
+    uint32_t rpm = (uint32_t) (((uint64_t) cadenceEstimator.rate(now) * 60) >> 16);
+    if (rpm < 500 && (rpm > 0 || !cadenceZeroSent))
+    {
+        cadenceZeroSent = (rpm == 0);
+        sendCadence((uint16_t) rpm, now);
+    }
+}
+
+void SensorPipeline::setHrvUplink(uint8_t beats)
+{
+    hrvUplinkBeats = beats;
+    cntBeats = 0;
+}
+
+bool SensorPipeline::processHeartRate(const void *notification, uint16_t length, uint64_t now)
+{
+    const uint8_t *bytes = (const uint8_t *) notification;
+    uint8_t dataToSend[2];
+    uint8_t hrvToSend[8];
+    uint16_t hr_bpm;
+    uint16_t pos;
+    bool newBeats = false;
+
+    if (length < 2)
+    {
+        return false;
+    }
+
+    uint8_t flags = bytes[0];
+    if (flags & HRM_FLAG_HR_16BIT)
+    {
+        if (length < 3)
+        {
+            return false;
+        }
+        hr_bpm = sys_get_le16(&bytes[1]);
+        pos = 3;
+    }
+    else
+    {
+        hr_bpm = bytes[1];
+        pos = 2;
+    }
+
+    if (flags & HRM_FLAG_ENERGY)
+    {
+        if (length < pos + 2)
+        {
+            return false;
+        }
+        data->energyExpended = sys_get_le16(&bytes[pos]);
+        pos += 2;
+    }
+
+    if (flags & HRM_FLAG_RR)
+    {
+        // all remaining fields are RR intervals, oldest first
+        for (; pos + 2 <= length; pos += 2)
+        {
+            if (hrvWindow.add(sys_get_le16(&bytes[pos])))
+            {
+                cntBeats++;
+                newBeats = true;
+            }
+        }
+    }
+
+    // the frame of the application has 8 bit, heart rates > 255 bpm are not realistic
+    if (hr_bpm > UINT8_MAX)
+    {
+        hr_bpm = UINT8_MAX;
+    }
+    data->heartRate = (uint8_t) hr_bpm;
+    dataToSend[0] = TYPE_HEARTRATE;
+    dataToSend[1] = (uint8_t) hr_bpm;
+    rideStats.addHeartRate((uint8_t) hr_bpm, now);
+    output(LATENCY_SENSOR_HEARTRATE, hr_bpm, now, dataToSend, sizeof(dataToSend));
+
+    uint8_t before = heartRateWatch.state();
+    heartRateWatch.event(now);
+    stateChanged(heartRateWatch, TYPE_HEARTRATE, before, now);
+
+    if (newBeats && hrvUplinkBeats > 0 && cntBeats >= hrvUplinkBeats && hrvWindow.count() >= 2)
+    {
+        // 1. value: type -> heart rate variability
+        // 2./3. value: RMSSD in ms, little endian
+        // 4./5. value: SDNN in ms, little endian
+        // 6. value: number of RR intervals in the window
+        // 7./8. value: energy expended in kJ, little endian
+        uint16_t rmssd = hrvWindow.rmssd();
+        cntBeats = 0;
+        hrvToSend[0] = TYPE_HRV;
+        sys_put_le16(rmssd, &hrvToSend[1]);
+        sys_put_le16(hrvWindow.sdnn(), &hrvToSend[3]);
+        hrvToSend[5] = hrvWindow.count();
+        sys_put_le16(data->energyExpended, &hrvToSend[6]);
+        output(PIPELINE_OUTPUT_HRV, rmssd, now, hrvToSend, sizeof(hrvToSend));
+    }
+    return true;
+}
+
+bool SensorPipeline::processPower(const void *notification, uint16_t length, uint64_t now)
+{
+    // size of the optional fields, flag bit n -> fieldSize[n]
+    static const uint8_t fieldSize[] = {1, 0, 2, 0, 6, 4, 4, 4, 3, 2, 2, 2};
+    const uint8_t *bytes = (const uint8_t *) notification;
+    uint8_t dataToSend[7];
+    uint8_t balance = UINT8_MAX;
+    uint16_t pos = 4;
+
+    if (length < 4)
+    {
+        return false;
+    }
+
+    uint16_t flags = sys_get_le16(&bytes[0]);
+    int16_t watts = (int16_t) sys_get_le16(&bytes[2]);
+
+    for (uint8_t bit = 0; bit < sizeof(fieldSize); bit++)
+    {
+        uint16_t flag = 1 << bit;
+
+        if (!(flags & flag) || fieldSize[bit] == 0)
+        {
+            continue;
+        }
+        if (length < pos + fieldSize[bit])
+        {
+            return false;
+        }
+
+        if (flag == CPM_FLAG_BALANCE)
+        {
+            balance = bytes[pos];
+        }
+        else if (flag == CPM_FLAG_CRANK)
+        {
+            uint16_t revs = sys_get_le16(&bytes[pos]);
+            uint16_t time = sys_get_le16(&bytes[pos + 2]);
+
+            // same computation as the CSC crank data, the counters wrap around
+            if (crankValid && time != crankTime)
+            {
+                uint32_t rpm = (uint32_t) (uint16_t) (revs - crankRevs) * 60 * 1024 / (uint16_t) (time - crankTime);
+                crankRpm = rpm > UINT8_MAX ? UINT8_MAX : (uint8_t) rpm;
+                crankEventUs = now;
+            }
+            else if (!crankValid)
+            {
+                crankEventUs = now;
+            }
+            crankValid = true;
+            crankRevs = revs;
+            crankTime = time;
+        }
+        pos += fieldSize[bit];
+    }
+
+    if (crankValid && now - crankEventUs > POWER_CRANK_STOP_US)
+    {
+        crankRpm = 0;
+    }
+
+    // negative power (pedaling backwards) is not shown
+    uint16_t power = watts > 0 ? (uint16_t) watts : 0;
+    powerWindow.add(power, (uint32_t) (now / 1000));
+    rideStats.addPower(power, now);
+    if (crankValid)
+    {
+        rideStats.addCadence(crankRpm, now);
+    }
+
+    // 1. value: type -> power
+    // 2./3. value: instantaneous power in W, little endian
+    // 4./5. value: average power of the last POWER_WINDOW_MS in W, little endian
+    // 6. value: cadence in rpm from the crank data, 0 without crank data
+    // 7. value: pedal power balance in 1/2 %, 0xff if not measured
+    dataToSend[0] = TYPE_POWER;
+    sys_put_le16(power, &dataToSend[1]);
+    sys_put_le16(powerWindow.average(), &dataToSend[3]);
+    dataToSend[5] = crankRpm;
+    dataToSend[6] = balance;
+    output(LATENCY_SENSOR_POWER, power, now, dataToSend, sizeof(dataToSend));
+
+    uint8_t before = powerWatch.state();
+    powerWatch.event(now);
+    stateChanged(powerWatch, TYPE_POWER, before, now);
+    return true;
+}
@@ -0,0 +1,254 @@
+/**
+ * @file    SensorPipeline.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Processing of the sensor notifications into the values for the
+ *          application, without Bluetooth dependencies. Used by the
+ *          DeviceManager and by the host replay (tools/replay).
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef SENSOR_PIPELINE_H_
+#define SENSOR_PIPELINE_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+#include "CscEstimator.h"
+#include "Data.h"
+#include "HrvWindow.h"
+#include "Latency.h"
+#include "PowerWindow.h"
+#include "Protocol.h"
+#include "RideStats.h"
+#include "SensorClock.h"
+#include "SensorWatch.h"
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// flags of the heart rate measurement (Heart Rate Service 1.0, 3.1.1.1)
+#define HRM_FLAG_HR_16BIT       0x01    // heart rate in 16 bit, else 8 bit
+#define HRM_FLAG_CONTACT_OK     0x02    // sensor contact detected
+#define HRM_FLAG_CONTACT_SUPP   0x04    // sensor contact supported
+#define HRM_FLAG_ENERGY         0x08    // energy expended in kJ (16 bit) present
+#define HRM_FLAG_RR             0x10    // one or more RR intervals in 1/1024 s (16 bit)
+
+// flags of the cycling power measurement (Cycling Power Service 1.1, 3.2.1),
+// the optional fields follow the instantaneous power in the order of the flags
+#define CPM_FLAG_BALANCE        0x0001  // pedal power balance in 1/2 % (8 bit)
+#define CPM_FLAG_BALANCE_LEFT   0x0002  // the balance is the share of the left pedal
+#define CPM_FLAG_TORQUE         0x0004  // accumulated torque in 1/32 Nm (16 bit)
+#define CPM_FLAG_WHEEL          0x0010  // wheel revolutions (32 bit), event time in 1/2048 s (16 bit)
+#define CPM_FLAG_CRANK          0x0020  // crank revolutions (16 bit), event time in 1/1024 s (16 bit)
+#define CPM_FLAG_FORCE          0x0040  // maximum and minimum force in N (2 x 16 bit)
+#define CPM_FLAG_TORQUE_EXTREME 0x0080  // maximum and minimum torque in 1/32 Nm (2 x 16 bit)
+#define CPM_FLAG_ANGLES         0x0100  // angles of the extremes in degrees (2 x 12 bit)
+#define CPM_FLAG_TOP_DEAD       0x0200  // top dead spot angle in degrees (16 bit)
+#define CPM_FLAG_BOTTOM_DEAD    0x0400  // bottom dead spot angle in degrees (16 bit)
+#define CPM_FLAG_ENERGY         0x0800  // accumulated energy in kJ (16 bit)
+
+// the crank of a power meter stopped without a crank event for this time
+#define POWER_CRANK_STOP_US     3000000
+
+// output of derived values, not a sample of a sensor -> no latency
+#define PIPELINE_OUTPUT_HRV     0x10
+#define PIPELINE_OUTPUT_STATE   0x11
+
+/**
+ * @brief callback for a new value of a sensor
+ *
+ * @param sensor LATENCY_SENSOR_SPEED, LATENCY_SENSOR_CADENCE, LATENCY_SENSOR_HEARTRATE,
+ *               LATENCY_SENSOR_POWER, PIPELINE_OUTPUT_HRV or PIPELINE_OUTPUT_STATE
+ * @param value speed in km/h * 100, rpm, bpm, W, RMSSD in ms or SENSOR_STATE_*
+ * @param time time of the value on the board timeline in us: the wheel or crank
+ *             event for speed and cadence, the reception for the heart rate
+ * @param frame frame for the application
+ * @param len length of the frame
+ */
+typedef void (*pipeline_output_t)(uint8_t sensor, uint16_t value, uint64_t time,
+                                  const uint8_t *frame, uint16_t len);
+
+class SensorPipeline {
+public:
+    /**
+     * @brief initialize the pipeline, no constructor (static objects)
+     *
+     * @param data object with the saved sensor values
+     * @param output callback for the computed values
+     */
+    void init(Data *data, pipeline_output_t output);
+
+    /**
+     * @brief set the wheel diameter when the settings changed,
+     *        0 stops the speed computation
+     *
+     * @param diameter diameter in cm
+     */
+    void setDiameter(double diameter);
+
+    /**
+     * @brief process a notification of a CSC measurement
+     *
+     * @param data notification data
+     * @param length length of the data
+     * @param now board uptime at the reception in us
+     * @return uint8_t type of the measurement (CSC_SPEED or CSC_CADENCE), 0 if invalid
+     */
+    uint8_t processCsc(const void *data, uint16_t length, uint64_t now);
+
+    /**
+     * @brief with the estimator, the CSC notifications only update the
+     *        estimators of the revolution rates, the speed and the cadence
+     *        are sent by estimate() instead
+     *
+     * @param enabled true to use the estimator
+     */
+    void setEstimator(bool enabled);
+
+    /**
+     * @brief send the estimated speed and cadence for a time, called at a
+     *        steady rate. A stopped bike or crank is sent once.
+     *
+     * @param now board uptime in us
+     */
+    void estimate(uint64_t now);
+
+    /**
+     * @brief apply the deadlines of the sensors which passed: a speed or
+     *        cadence whose next event is overdue is sent as 0, a changed
+     *        state as TYPE_SENSOR_STATE frame. Called at nextDeadline().
+     *
+     * @param now board uptime in us
+     */
+    void checkDeadlines(uint64_t now);
+
+    /**
+     * @brief earliest deadline of the sensors, changed by every notification
+     *
+     * @return uint64_t board uptime in us, SENSOR_WATCH_NEVER if none
+     */
+    uint64_t nextDeadline() const;
+
+    /**
+     * @brief send the heart rate variability every n RR intervals
+     *        as TYPE_HRV frame
+     *
+     * @param beats number of intervals between two frames, 0 disables the frames
+     */
+    void setHrvUplink(uint8_t beats);
+
+    /**
+     * @brief process a notification of a heart rate measurement, all fields
+     *        given by the flags are parsed, the RR intervals are added to the
+     *        heart rate variability window
+     *
+     * @param data notification data
+     * @param length length of the data
+     * @param now board uptime at the reception in us
+     * @return true if the measurement was valid
+     */
+    bool processHeartRate(const void *data, uint16_t length, uint64_t now);
+
+    /**
+     * @brief process a notification of a cycling power measurement: the
+     *        instantaneous power, its average over POWER_WINDOW_MS, the
+     *        cadence from the crank data and the pedal balance are sent
+     *        as TYPE_POWER frame
+     *
+     * @param data notification data
+     * @param length length of the data
+     * @param now board uptime at the reception in us
+     * @return true if the measurement was valid
+     */
+    bool processPower(const void *data, uint16_t length, uint64_t now);
+
+    /**
+     * @brief get the window of the last RR intervals
+     *
+     * @return const HrvWindow& intervals and heart rate variability
+     */
+    const HrvWindow &hrv() const { return hrvWindow; }
+
+    /**
+     * @brief get the statistics of the ride, fed with every value sent
+     *        and with the wheel revolutions of the CSC measurements
+     *
+     * @return RideStats& statistics, reset by the owner for a new ride
+     */
+    RideStats &stats() { return rideStats; }
+
+    /**
+     * @brief get the time base of a CSC sensor
+     *
+     * @param type CSC_SPEED or CSC_CADENCE
+     * @return const SensorClock& clock of the sensor
+     */
+    const SensorClock &clock(uint8_t type) const { return type == CSC_CADENCE ? cadenceClock : speedClock; }
+
+    /**
+     * @brief forget the clock, the estimated rate and the last counters of a
+     *        sensor after a disconnection or when another sensor takes over
+     *
+     * @param type CSC_SPEED, CSC_CADENCE or TYPE_POWER (crank data and average power)
+     */
+    void resetClock(uint8_t type);
+
+    /**
+     * @brief stop the watch of a metric which is no longer processed, without
+     *        notifications it would be reported stale. The state is
+     *        SENSOR_STATE_IDLE until the next notification, no frame is sent.
+     *
+     * @param type TYPE_CSC_SPEED, TYPE_CSC_CADENCE, TYPE_HEARTRATE or TYPE_POWER
+     */
+    void stopWatch(uint8_t type);
+
+    /**
+     * @brief convert the diameter coding of the application
+     *
+     * @param code inches, bit 7 adds 0.5 inch
+     * @return double diameter in cm
+     */
+    static double diameterFromCode(uint8_t code);
+
+private:
+    void sendSpeed(uint16_t speed, uint64_t time);
+    void sendCadence(uint16_t rpm, uint64_t time);
+    void watchCsc(SensorWatch &watch, uint8_t type, bool newEvent, uint64_t eventTime, uint64_t now);
+    void stateChanged(const SensorWatch &watch, uint8_t type, uint8_t before, uint64_t now);
+
+    Data *data;
+    pipeline_output_t output;
+    bool diameterSet;
+    SensorWatch speedWatch;
+    SensorWatch cadenceWatch;
+    SensorWatch heartRateWatch;
+    SensorWatch powerWatch;
+    HrvWindow hrvWindow;
+    SensorClock speedClock;
+    SensorClock cadenceClock;
+    bool speedValid;
+    bool cadenceValid;
+    bool estimatorEnabled;
+    CscEstimator speedEstimator;
+    CscEstimator cadenceEstimator;
+    uint32_t circumferenceMm;
+    bool speedZeroSent;
+    bool cadenceZeroSent;
+    uint8_t hrvUplinkBeats;
+    uint8_t cntBeats;
+    PowerWindow powerWindow;
+    bool crankValid;
+    uint16_t crankRevs;
+    uint16_t crankTime;
+    uint64_t crankEventUs;
+    uint8_t crankRpm;
+    RideStats rideStats;
+};
+
+#endif /* SENSOR_PIPELINE_H_ */
@@ -0,0 +1,349 @@
+/**
+ * @file    SensorProfile.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Sensor profiles: every profile declares its service, its
+ *          measurement characteristic and the processing of a notification
+ *          (parser, derived values and encoding for the application in the
+ *          SensorPipeline). The profiles are resolved at compile time, a
+ *          dispatch by the profile id is a chain of compares like a switch.
+ *          Without Bluetooth dependencies, used by the DeviceManager and by
+ *          the host replay (tools/replay).
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef SENSOR_PROFILE_H_
+#define SENSOR_PROFILE_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+#include <sys/byteorder.h>
+
+#include "Protocol.h"
+#include "SensorPipeline.h"
+#include "TraceRecorder.h"
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+#define SENSOR_PROFILE_NONE     0
+#define SENSOR_PROFILE_CSC      1
+#define SENSOR_PROFILE_HRS      2
+#define SENSOR_PROFILE_CPS      3
+
+// sensors of one sensor info code of the application
+#define SENSOR_PLAN_SLOTS       3
+
+/*
+ * A profile is an empty type with:
+ *   id             SENSOR_PROFILE_*
+ *   name           for the console
+ *   service        16 bit UUID of the service, also used as scan filter
+ *   measurement    16 bit UUID of the notified characteristic
+ *   traceKind      TRACE_KIND_* of its notifications
+ *   streams        STREAM_BIT() of the TYPE_* of its values (Protocol.h)
+ *   process()      notification -> values for the application,
+ *                  returns the TYPE_* of the values or 0 if invalid
+ *   sequence()     event time of a measurement, a 16 bit counter which wraps
+ *                  around, only compared for the order of the measurements:
+ *                  1/1024 s, except the wheel event time of a power meter
+ *                  in 1/2048 s (scaled it would not wrap at 16 bits),
+ *                  -1 if the measurement has no event time
+ */
+
+// Cycling Speed and Cadence Service
+struct CscProfile
+{
+    static constexpr uint8_t id = SENSOR_PROFILE_CSC;
+    static constexpr const char *name = "CSC";
+    static constexpr uint16_t service = 0x1816;
+    static constexpr uint16_t measurement = 0x2a5b;
+    static constexpr uint8_t traceKind = TRACE_KIND_CSC;
+    static constexpr uint16_t streams = STREAM_BIT(TYPE_CSC_SPEED) | STREAM_BIT(TYPE_CSC_CADENCE);
+
+    static uint8_t process(SensorPipeline &pipeline, const void *data, uint16_t length, uint64_t now)
+    {
+        return pipeline.processCsc(data, length, now);
+    }
+
+    static int32_t sequence(const uint8_t *data, uint16_t length)
+    {
+        // flags, wheel revolutions (4) and time (2), crank revolutions (2) and time (2)
+        if (length < 1)
+        {
+            return -1;
+        }
+        uint16_t pos = (data[0] & 0x01) ? 7 : 1;
+
+        if ((data[0] & 0x02) && length >= pos + 4)
+        {
+            return sys_get_le16(&data[pos + 2]);
+        }
+        if ((data[0] & 0x01) && length >= 7)
+        {
+            return sys_get_le16(&data[5]);
+        }
+        return -1;
+    }
+};
+
+// Heart Rate Service
+struct HeartRateProfile
+{
+    static constexpr uint8_t id = SENSOR_PROFILE_HRS;
+    static constexpr const char *name = "HRS";
+    static constexpr uint16_t service = 0x180d;
+    static constexpr uint16_t measurement = 0x2a37;
+    static constexpr uint8_t traceKind = TRACE_KIND_HEARTRATE;
+    static constexpr uint16_t streams = STREAM_BIT(TYPE_HEARTRATE) | STREAM_BIT(TYPE_HRV);
+
+    static uint8_t process(SensorPipeline &pipeline, const void *data, uint16_t length, uint64_t now)
+    {
+        return pipeline.processHeartRate(data, length, now) ? TYPE_HEARTRATE : 0;
+    }
+
+    static int32_t sequence(const uint8_t *, uint16_t) { return -1; }
+};
+
+// Cycling Power Service
+struct CyclingPowerProfile
+{
+    static constexpr uint8_t id = SENSOR_PROFILE_CPS;
+    static constexpr const char *name = "CPS";
+    static constexpr uint16_t service = 0x1818;
+    static constexpr uint16_t measurement = 0x2a63;
+    static constexpr uint8_t traceKind = TRACE_KIND_POWER;
+    static constexpr uint16_t streams = STREAM_BIT(TYPE_POWER);
+
+    static uint8_t process(SensorPipeline &pipeline, const void *data, uint16_t length, uint64_t now)
+    {
+        return pipeline.processPower(data, length, now) ? TYPE_POWER : 0;
+    }
+
+    static int32_t sequence(const uint8_t *data, uint16_t length)
+    {
+        // flags (2), power (2), pedal balance (1), torque (2), wheel data (6), crank data (4)
+        if (length < 4)
+        {
+            return -1;
+        }
+        uint16_t flags = sys_get_le16(data);
+        uint16_t pos = 4 + ((flags & CPM_FLAG_BALANCE) ? 1 : 0) + ((flags & CPM_FLAG_TORQUE) ? 2 : 0);
+
+        if ((flags & CPM_FLAG_WHEEL) && length >= pos + 6 && !(flags & CPM_FLAG_CRANK))
+        {
+            // wheel event time in 1/2048 s
+            return sys_get_le16(&data[pos + 4]);
+        }
+        pos += (flags & CPM_FLAG_WHEEL) ? 6 : 0;
+        if ((flags & CPM_FLAG_CRANK) && length >= pos + 4)
+        {
+            return sys_get_le16(&data[pos + 2]);
+        }
+        return -1;
+    }
+};
+
+/**
+ * @brief list of profiles, the functions unroll into a compare per profile
+ */
+template <typename... Profiles>
+struct ProfileList;
+
+template <>
+struct ProfileList<>
+{
+    template <typename F>
+    static bool visit(uint8_t, F &&) { return false; }
+
+    template <typename F>
+    static bool visitTraceKind(uint8_t, F &&) { return false; }
+
+    static uint8_t process(uint8_t, SensorPipeline &, const void *, uint16_t, uint64_t)
+    {
+        return 0;
+    }
+
+    static uint8_t idOfService(uint16_t) { return SENSOR_PROFILE_NONE; }
+
+    static int32_t sequence(uint8_t, const uint8_t *, uint16_t) { return -1; }
+
+    static uint8_t traceKindOf(uint8_t) { return TRACE_KIND_SKIPPED; }
+
+    static uint16_t streamsOf(uint8_t) { return 0; }
+};
+
+template <typename Head, typename... Tail>
+struct ProfileList<Head, Tail...>
+{
+    /**
+     * @brief call f with an object of the profile with this id
+     *
+     * @param id SENSOR_PROFILE_*
+     * @param f generic callable, f(Profile())
+     * @return true if the profile exists
+     */
+    template <typename F>
+    static bool visit(uint8_t id, F &&f)
+    {
+        if (id == Head::id)
+        {
+            f(Head());
+            return true;
+        }
+        return ProfileList<Tail...>::visit(id, f);
+    }
+
+    /**
+     * @brief call f with an object of the profile of a trace record
+     *
+     * @param kind TRACE_KIND_* without TRACE_KIND_SKIPPED
+     * @param f generic callable, f(Profile())
+     * @return true if a profile has this kind
+     */
+    template <typename F>
+    static bool visitTraceKind(uint8_t kind, F &&f)
+    {
+        if (kind == Head::traceKind)
+        {
+            f(Head());
+            return true;
+        }
+        return ProfileList<Tail...>::visitTraceKind(kind, f);
+    }
+
+    /**
+     * @brief process a notification with the profile of this id
+     *
+     * @return uint8_t TYPE_* of the values, 0 if invalid or unknown profile
+     */
+    static uint8_t process(uint8_t id, SensorPipeline &pipeline, const void *data, uint16_t length, uint64_t now)
+    {
+        if (id == Head::id)
+        {
+            return Head::process(pipeline, data, length, now);
+        }
+        return ProfileList<Tail...>::process(id, pipeline, data, length, now);
+    }
+
+    /**
+     * @brief profile of a service, e.g. of the service data of an advertisement
+     *
+     * @param service 16 bit UUID of the service
+     * @return uint8_t SENSOR_PROFILE_*, SENSOR_PROFILE_NONE if unknown
+     */
+    static uint8_t idOfService(uint16_t service)
+    {
+        return service == Head::service ? Head::id : ProfileList<Tail...>::idOfService(service);
+    }
+
+    /**
+     * @brief event time of a measurement with the profile of this id
+     *
+     * @param data measurement, at least the flags
+     * @return int32_t event time in 1/1024 s, -1 without event time or unknown profile
+     */
+    static int32_t sequence(uint8_t id, const uint8_t *data, uint16_t length)
+    {
+        if (id == Head::id)
+        {
+            return Head::sequence(data, length);
+        }
+        return ProfileList<Tail...>::sequence(id, data, length);
+    }
+
+    /**
+     * @brief TRACE_KIND_* of the measurements of the profile of this id
+     *
+     * @return uint8_t trace kind, TRACE_KIND_SKIPPED if unknown profile
+     */
+    static uint8_t traceKindOf(uint8_t id)
+    {
+        return id == Head::id ? Head::traceKind : ProfileList<Tail...>::traceKindOf(id);
+    }
+
+    /**
+     * @brief STREAM_BIT() of the values of the profile of this id
+     *
+     * @return uint16_t streams, 0 if unknown profile
+     */
+    static uint16_t streamsOf(uint8_t id)
+    {
+        return id == Head::id ? Head::streams : ProfileList<Tail...>::streamsOf(id);
+    }
+};
+
+// all profiles of the application, a new profile is added here
+typedef ProfileList<CscProfile, HeartRateProfile, CyclingPowerProfile> SensorProfiles;
+
+/**
+ * @brief profile of a sensor of the application
+ *
+ * The sensor info code of the application gives the sensors in the order of
+ * their connection (see getSensorInfos()):
+ *   1 speed, 2 cadence, 3 speed + cadence, 4 speed + cadence + heart rate,
+ *   5 speed + heart rate, 6 cadence + heart rate, 7 heart rate,
+ *   8 power meter, 9 power meter + heart rate
+ *
+ * @param info sensor info code
+ * @param slot number of the sensor, 0 for the first connected one
+ * @return uint8_t SENSOR_PROFILE_*, SENSOR_PROFILE_NONE if no sensor
+ */
+static inline uint8_t sensor_plan(uint8_t info, uint8_t slot)
+{
+    static const uint8_t plan[][SENSOR_PLAN_SLOTS] = {
+        {SENSOR_PROFILE_NONE, SENSOR_PROFILE_NONE, SENSOR_PROFILE_NONE},
+        {SENSOR_PROFILE_CSC, SENSOR_PROFILE_NONE, SENSOR_PROFILE_NONE},
+        {SENSOR_PROFILE_CSC, SENSOR_PROFILE_NONE, SENSOR_PROFILE_NONE},
+        {SENSOR_PROFILE_CSC, SENSOR_PROFILE_CSC, SENSOR_PROFILE_NONE},
+        {SENSOR_PROFILE_CSC, SENSOR_PROFILE_CSC, SENSOR_PROFILE_HRS},
+        {SENSOR_PROFILE_CSC, SENSOR_PROFILE_HRS, SENSOR_PROFILE_NONE},
+        {SENSOR_PROFILE_CSC, SENSOR_PROFILE_HRS, SENSOR_PROFILE_NONE},
+        {SENSOR_PROFILE_HRS, SENSOR_PROFILE_NONE, SENSOR_PROFILE_NONE},
+        {SENSOR_PROFILE_CPS, SENSOR_PROFILE_NONE, SENSOR_PROFILE_NONE},
+        {SENSOR_PROFILE_CPS, SENSOR_PROFILE_HRS, SENSOR_PROFILE_NONE},
+    };
+
+    if (info >= sizeof(plan) / sizeof(plan[0]) || slot >= SENSOR_PLAN_SLOTS)
+    {
+        return SENSOR_PROFILE_NONE;
+    }
+    return plan[info][slot];
+}
+
+/**
+ * @brief measured value of a sensor of the application, separates the speed
+ *        and the cadence sensors of the CSC profile
+ *
+ * @param info sensor info code
+ * @param slot number of the sensor, 0 for the first connected one
+ * @return uint8_t TYPE_* of the sensor, 0 if no sensor
+ */
+static inline uint8_t sensor_type(uint8_t info, uint8_t slot)
+{
+    static const uint8_t types[][SENSOR_PLAN_SLOTS] = {
+        {0, 0, 0},
+        {TYPE_CSC_SPEED, 0, 0},
+        {TYPE_CSC_CADENCE, 0, 0},
+        {TYPE_CSC_SPEED, TYPE_CSC_CADENCE, 0},
+        {TYPE_CSC_SPEED, TYPE_CSC_CADENCE, TYPE_HEARTRATE},
+        {TYPE_CSC_SPEED, TYPE_HEARTRATE, 0},
+        {TYPE_CSC_CADENCE, TYPE_HEARTRATE, 0},
+        {TYPE_HEARTRATE, 0, 0},
+        {TYPE_POWER, 0, 0},
+        {TYPE_POWER, TYPE_HEARTRATE, 0},
+    };
+
+    if (info >= sizeof(types) / sizeof(types[0]) || slot >= SENSOR_PLAN_SLOTS)
+    {
+        return 0;
+    }
+    return types[info][slot];
+}
+
+#endif /* SENSOR_PROFILE_H_ */
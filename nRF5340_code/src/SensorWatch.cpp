@@ -0,0 +1,127 @@
+#include "SensorWatch.h"
+#include "Protocol.h"
+
+// smoothed period with a new interval, the first interval is taken as it is
+static uint32_t smooth(uint32_t period, uint64_t interval)
+{
+    uint32_t us = interval > UINT32_MAX ? UINT32_MAX : (uint32_t) interval;
+
+    if (period == 0)
+    {
+        return us;
+    }
+    return (uint32_t) ((int64_t) period + (((int64_t) us - period) >> SENSOR_WATCH_SHIFT));
+}
+
+void SensorWatch::init(bool events)
+{
+    hasEvents = events;
+    reset();
+}
+
+void SensorWatch::reset()
+{
+    current = SENSOR_STATE_IDLE;
+    notifiedOnce = false;
+    eventOnce = false;
+    lastNotified = 0;
+    lastEvent = 0;
+    notifyPeriod = 0;
+    eventPeriod = 0;
+}
+
+void SensorWatch::notified(uint64_t time)
+{
+    if (notifiedOnce && time > lastNotified && current != SENSOR_STATE_STALE)
+    {
+        // the time without notifications of a stale sensor is not its period
+        notifyPeriod = smooth(notifyPeriod, time - lastNotified);
+    }
+    notifiedOnce = true;
+    lastNotified = time;
+
+    if (hasEvents && (current == SENSOR_STATE_IDLE || current == SENSOR_STATE_STALE))
+    {
+        // alive, moving again with the next event
+        current = SENSOR_STATE_STOPPED;
+    }
+}
+
+void SensorWatch::event(uint64_t time)
+{
+    if (!hasEvents)
+    {
+        notified(time);
+    }
+
+    if (eventOnce && time > lastEvent && current == SENSOR_STATE_LIVE)
+    {
+        // the time of a stop is not a period
+        eventPeriod = smooth(eventPeriod, time - lastEvent);
+    }
+    eventOnce = true;
+    if (time > lastEvent || current != SENSOR_STATE_LIVE)
+    {
+        lastEvent = time;
+    }
+    current = SENSOR_STATE_LIVE;
+}
+
+uint64_t SensorWatch::stopDeadline() const
+{
+    // the next event is reported with the next notification at the earliest
+    uint64_t period = (uint64_t) SENSOR_WATCH_PERIODS * (eventPeriod > notifyPeriod ? eventPeriod : notifyPeriod);
+
+    if (period == 0 || period > SENSOR_WATCH_STOP_MAX_US)
+    {
+        period = SENSOR_WATCH_STOP_MAX_US;
+    }
+    return lastEvent + period;
+}
+
+uint64_t SensorWatch::staleDeadline() const
+{
+    uint64_t period = (uint64_t) SENSOR_WATCH_PERIODS * notifyPeriod;
+
+    if (period < SENSOR_WATCH_STALE_MIN_US)
+    {
+        period = SENSOR_WATCH_STALE_MIN_US;
+    }
+    else if (period > SENSOR_WATCH_STALE_MAX_US)
+    {
+        period = SENSOR_WATCH_STALE_MAX_US;
+    }
+    return lastNotified + period;
+}
+
+uint64_t SensorWatch::deadline() const
+{
+    switch (current)
+    {
+    case SENSOR_STATE_LIVE:
+        if (hasEvents)
+        {
+            uint64_t stop = stopDeadline();
+            uint64_t stale = staleDeadline();
+            return stop < stale ? stop : stale;
+        }
+        return staleDeadline();
+    case SENSOR_STATE_STOPPED:
+        return staleDeadline();
+    default:
+        return SENSOR_WATCH_NEVER;
+    }
+}
+
+uint8_t SensorWatch::check(uint64_t now)
+{
+    if (current == SENSOR_STATE_LIVE && hasEvents && now >= stopDeadline())
+    {
+        current = SENSOR_STATE_STOPPED;
+    }
+    if ((current == SENSOR_STATE_LIVE || current == SENSOR_STATE_STOPPED) && now >= staleDeadline())
+    {
+        current = SENSOR_STATE_STALE;
+    }
+    return current;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file    SensorWatch.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   State of the values of one sensor by time: the expected period
+ *          of its events and notifications is learned from their history,
+ *          a value is stopped when the next event is overdue and stale
+ *          when the next notification is overdue, also when the sensor
+ *          does not notify any more. The owner checks the deadlines with
+ *          a timer at deadline().
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef SENSOR_WATCH_H_
+#define SENSOR_WATCH_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// a deadline is this many expected periods after the last event or notification
+#define SENSOR_WATCH_PERIODS        2
+
+// smoothing of the periods: new = old + (interval - old) / 2^SENSOR_WATCH_SHIFT
+#define SENSOR_WATCH_SHIFT          2
+
+// stopped at the latest after this time without event (~2.5 km/h with a 28" wheel, 20 rpm)
+#define SENSOR_WATCH_STOP_MAX_US    3000000
+
+// stale after this time without notification, at least and at most
+#define SENSOR_WATCH_STALE_MIN_US   2000000
+#define SENSOR_WATCH_STALE_MAX_US   10000000
+
+// no deadline
+#define SENSOR_WATCH_NEVER          UINT64_MAX
+
+class SensorWatch {
+public:
+    /**
+     * @brief set the kind of the sensor and reset it, no constructor (static objects)
+     *
+     * @param events true if the notifications carry event times (CSC), a
+     *               notification without new event is a stopped sensor,
+     *               else every notification is an event (heart rate, power)
+     */
+    void init(bool events);
+
+    /**
+     * @brief forget the history (new connection), the state is SENSOR_STATE_IDLE
+     */
+    void reset();
+
+    /**
+     * @brief a notification of the sensor was received
+     *
+     * @param time board time of the reception in us
+     */
+    void notified(uint64_t time);
+
+    /**
+     * @brief a new event of the sensor (wheel or crank revolution, value),
+     *        called after notified() for its notification
+     *
+     * @param time board time of the event in us
+     */
+    void event(uint64_t time);
+
+    /**
+     * @brief apply the deadlines which passed
+     *
+     * @param now board time in us
+     * @return uint8_t the state, SENSOR_STATE_* (Protocol.h)
+     */
+    uint8_t check(uint64_t now);
+
+    /**
+     * @brief next deadline of the state
+     *
+     * @return uint64_t board time in us, SENSOR_WATCH_NEVER if none
+     */
+    uint64_t deadline() const;
+
+    uint8_t state() const { return current; }
+
+    /**
+     * @brief expected time between two events
+     *
+     * @return uint32_t period in us, 0 if not known yet
+     */
+    uint32_t periodUs() const { return eventPeriod; }
+
+private:
+    uint64_t stopDeadline() const;
+    uint64_t staleDeadline() const;
+
+    bool hasEvents;
+    uint8_t current;
+    bool notifiedOnce;
+    bool eventOnce;
+    uint64_t lastNotified;
+    uint64_t lastEvent;
+    uint32_t notifyPeriod;
+    uint32_t eventPeriod;
+};
+
+#endif /* SENSOR_WATCH_H_ */
@@ -0,0 +1,78 @@
+#include "SimReport.h"
+#include "Protocol.h"
+
+#include <kernel.h>
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+// received notifications: speed, cadence, heart rate
+static uint32_t rx[3];
+static uint32_t connects;
+static uint32_t disconnects;
+
+// uptime of the scan start, 0 if no scan pending
+static int64_t scanStart;
+static uint32_t ttcLast;
+static uint32_t ttcMax;
+
+static struct k_delayed_work reportWork;
+
+static void report_work_handler(struct k_work *work)
+{
+	printk("#SIM hub {\"t_ms\":%u,\"rx\":[%u,%u,%u],\"connects\":%u,\"disconnects\":%u,"
+	       "\"ttc_last_ms\":%u,\"ttc_max_ms\":%u}\n",
+	       k_uptime_get_32(), rx[0], rx[1], rx[2], connects, disconnects, ttcLast, ttcMax);
+	k_delayed_work_submit(&reportWork, K_SECONDS(CONFIG_APP_SIM_REPORT_INTERVAL_S));
+}
+
+void sim_report_init(void)
+{
+	k_delayed_work_init(&reportWork, report_work_handler);
+	k_delayed_work_submit(&reportWork, K_SECONDS(CONFIG_APP_SIM_REPORT_INTERVAL_S));
+}
+
+void sim_report_rx(uint8_t type)
+{
+	switch (type)
+	{
+	case TYPE_CSC_SPEED:
+		rx[0]++;
+		break;
+	case TYPE_CSC_CADENCE:
+		rx[1]++;
+		break;
+	case TYPE_HEARTRATE:
+		rx[2]++;
+		break;
+	default:
+		break;
+	}
+}
+
+void sim_report_scan_started(void)
+{
+	if (scanStart == 0)
+	{
+		scanStart = k_uptime_get();
+	}
+}
+
+void sim_report_sensor_connected(void)
+{
+	connects++;
+	if (scanStart != 0)
+	{
+		ttcLast = (uint32_t) (k_uptime_get() - scanStart);
+		scanStart = 0;
+		if (ttcLast > ttcMax)
+		{
+			ttcMax = ttcLast;
+		}
+	}
+}
+
+void sim_report_sensor_disconnected(void)
+{
+	disconnects++;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file    SimReport.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Machine readable statistics of the central role for the
+ *          BabbleSim sensor fleet (sim/run_fleet.sh)
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef SIM_REPORT_H_
+#define SIM_REPORT_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*
+ * Every CONFIG_APP_SIM_REPORT_INTERVAL_S one line is printed:
+ * #SIM hub {"t_ms":..,"rx":[speed,cadence,hr],"connects":..,"disconnects":..,
+ *           "ttc_last_ms":..,"ttc_max_ms":..}
+ * The time to connect is measured from the start of the scan to the
+ * connection with the sensor.
+ */
+
+#if defined(CONFIG_APP_SIM_REPORT)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief start the periodic report
+ */
+void sim_report_init(void);
+
+/**
+ * @brief count a received notification
+ *
+ * @param type TYPE_CSC_SPEED, TYPE_CSC_CADENCE or TYPE_HEARTRATE
+ */
+void sim_report_rx(uint8_t type);
+
+/**
+ * @brief the scan for a sensor started
+ */
+void sim_report_scan_started(void);
+
+/**
+ * @brief a sensor is connected
+ */
+void sim_report_sensor_connected(void);
+
+/**
+ * @brief a sensor disconnected
+ */
+void sim_report_sensor_disconnected(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+static inline void sim_report_init(void) {}
+static inline void sim_report_rx(uint8_t type) {}
+static inline void sim_report_scan_started(void) {}
+static inline void sim_report_sensor_connected(void) {}
+static inline void sim_report_sensor_disconnected(void) {}
+
+#endif /* CONFIG_APP_SIM_REPORT */
+
+#endif /* SIM_REPORT_H_ */
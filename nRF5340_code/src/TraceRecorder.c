@@ -0,0 +1,91 @@
+#include "TraceRecorder.h"
+
+#include <kernel.h>
+#include <sys/byteorder.h>
+#include <sys/ring_buffer.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+#define DRAIN_PERIOD_MS 20
+
+#define THREAD_STACK_SIZE 768
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+RING_BUF_DECLARE(traceBuffer, CONFIG_APP_TRACE_BUFFER_SIZE);
+
+// records are put as a whole, the drain thread always gets complete records
+static struct k_spinlock lock;
+
+static atomic_t dropped;
+
+void trace_record(uint8_t kind, uint32_t timestamp, uint8_t connIndex, uint16_t handle,
+		  const void *data, uint16_t len)
+{
+	uint8_t header[TRACE_HEADER_SIZE];
+	k_spinlock_key_t key;
+
+	len = MIN(len, TRACE_MAX_PAYLOAD);
+	sys_put_le32(timestamp, &header[0]);
+	header[4] = kind;
+	header[5] = connIndex;
+	sys_put_le16(handle, &header[6]);
+	header[8] = (uint8_t) len;
+
+	key = k_spin_lock(&lock);
+	if (ring_buf_space_get(&traceBuffer) < sizeof(header) + len)
+	{
+		k_spin_unlock(&lock, key);
+		atomic_inc(&dropped);
+		return;
+	}
+	ring_buf_put(&traceBuffer, header, sizeof(header));
+	ring_buf_put(&traceBuffer, (const uint8_t *) data, len);
+	k_spin_unlock(&lock, key);
+}
+
+static void drain_thread(void *p1, void *p2, void *p3)
+{
+	uint8_t record[TRACE_HEADER_SIZE + TRACE_MAX_PAYLOAD];
+
+	while (1)
+	{
+		k_sleep(K_MSEC(DRAIN_PERIOD_MS));
+
+		while (1)
+		{
+			k_spinlock_key_t key = k_spin_lock(&lock);
+			uint32_t size = ring_buf_get(&traceBuffer, record, TRACE_HEADER_SIZE);
+
+			if (size == TRACE_HEADER_SIZE)
+			{
+				size += ring_buf_get(&traceBuffer, &record[TRACE_HEADER_SIZE], record[8]);
+			}
+			k_spin_unlock(&lock, key);
+
+			if (size == 0)
+			{
+				break;
+			}
+
+			printk("#TR ");
+			for (uint32_t i = 0; i < size; i++)
+			{
+				printk("%02x", record[i]);
+			}
+			printk("\n");
+		}
+
+		atomic_val_t lost = atomic_set(&dropped, 0);
+
+		if (lost)
+		{
+			printk("#TR-DROP %u\n", (uint32_t) lost);
+		}
+	}
+}
+
+K_THREAD_DEFINE(trace_thread, THREAD_STACK_SIZE, drain_thread, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
@@ -0,0 +1,75 @@
+/**
+ * @file    TraceRecorder.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Records the sensor notifications and the diameter of the
+ *          application into a compact binary trace for the host replay
+ *          (tools/trace_extract.py, tools/replay)
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef TRACE_RECORDER_H_
+#define TRACE_RECORDER_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+/*
+ * record, little endian:
+ * 0-3  time stamp in cycles of k_cycle_get_32()
+ * 4    kind
+ * 5    connection index
+ * 6-7  attribute handle
+ * 8    payload length
+ * 9-   payload
+ * The records are written to the console as "#TR <hex>" lines.
+ */
+#define TRACE_HEADER_SIZE       9
+#define TRACE_MAX_PAYLOAD       32
+
+#define TRACE_KIND_CSC          0   // CSC measurement, processed by the pipeline
+#define TRACE_KIND_HEARTRATE    1   // heart rate measurement, processed by the pipeline
+#define TRACE_KIND_DIAMETER     2   // diameter code written by the application
+#define TRACE_KIND_POWER        3   // cycling power measurement, processed by the pipeline
+// the notification arrived before the subscriptions were done and was not processed
+#define TRACE_KIND_SKIPPED      0x80
+
+#if defined(CONFIG_APP_TRACE)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief add a record to the trace, dropped when the buffer is full
+ *
+ * @param kind TRACE_KIND_*
+ * @param timestamp cycles of k_cycle_get_32() at the reception
+ * @param connIndex index of the connection
+ * @param handle attribute handle
+ * @param data payload
+ * @param len length of the payload, cut to TRACE_MAX_PAYLOAD
+ */
+void trace_record(uint8_t kind, uint32_t timestamp, uint8_t connIndex, uint16_t handle,
+                  const void *data, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+static inline void trace_record(uint8_t kind, uint32_t timestamp, uint8_t connIndex, uint16_t handle,
+                                const void *data, uint16_t len) {}
+
+#endif /* CONFIG_APP_TRACE */
+
+#endif /* TRACE_RECORDER_H_ */
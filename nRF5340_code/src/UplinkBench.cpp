@@ -0,0 +1,92 @@
+#include "UplinkBench.h"
+#include "dataService.h"
+
+#include <kernel.h>
+#include <sys/byteorder.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/
+// type, sequence, time stamp
+#define HEADER_SIZE 7
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+static uint16_t frameRate = 0;
+static uint8_t frameLen = HEADER_SIZE;
+static uint16_t sequence = 0;
+
+// frames sent since the start, the generator catches up with the rate every tick
+static int64_t startTime;
+static uint32_t framesSent;
+
+// frames dropped by the data service before the run
+static uint32_t droppedAtStart;
+static bool running = false;
+
+static struct k_delayed_work benchWork;
+static bool initialized = false;
+
+static void bench_work_handler(struct k_work *work)
+{
+	uint8_t frame[CONFIG_APP_UPLINK_FRAME_SIZE] = {0};
+	uint32_t due;
+
+	if (frameRate == 0)
+	{
+		return;
+	}
+
+	due = (uint32_t) ((k_uptime_get() - startTime) * frameRate / 1000);
+	while (framesSent < due)
+	{
+		frame[0] = TYPE_BENCH;
+		sys_put_le16(sequence++, &frame[1]);
+		sys_put_le32(k_cyc_to_us_floor32(k_cycle_get_32()), &frame[3]);
+		data_service_send(frame, frameLen);
+		framesSent++;
+	}
+
+	k_delayed_work_submit(&benchWork, K_MSEC(1));
+}
+
+// frames of the run which did not reach the application (yet)
+static void report(void)
+{
+	uint32_t queued;
+	uint32_t dropped;
+
+	data_service_queue_stats(&queued, &dropped);
+	printk("#BENCH_BOARD {\"generated\":%u,\"queued\":%u,\"dropped\":%u}\n",
+	       framesSent, queued, dropped - droppedAtStart);
+}
+
+void uplink_bench_start(uint16_t rate, uint8_t len)
+{
+	uint32_t queued;
+
+	if (!initialized)
+	{
+		initialized = true;
+		k_delayed_work_init(&benchWork, bench_work_handler);
+	}
+
+	k_delayed_work_cancel(&benchWork);
+	if (running)
+	{
+		report();
+	}
+	running = rate != 0;
+	data_service_queue_stats(&queued, &droppedAtStart);
+	frameRate = rate;
+	frameLen = MIN(MAX(len, HEADER_SIZE), CONFIG_APP_UPLINK_FRAME_SIZE);
+	startTime = k_uptime_get();
+	framesSent = 0;
+	printk("Uplink benchmark: %u frames/s, %u bytes\n", frameRate, frameLen);
+
+	if (frameRate != 0)
+	{
+		k_delayed_work_submit(&benchWork, K_NO_WAIT);
+	}
+}
@@ -0,0 +1,39 @@
+/**
+ * @file    UplinkBench.h
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Load generator for the uplink to the application, started by
+ *          the RX_CMD_BENCH command (sim/run_uplink_bench.sh)
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef UPLINK_BENCH_H_
+#define UPLINK_BENCH_H_
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <zephyr/types.h>
+
+#if defined(CONFIG_APP_UPLINK_BENCH)
+
+/**
+ * @brief send TYPE_BENCH frames through data_service_send() at a fixed rate,
+ *        the frames of the last run which are still queued or were dropped
+ *        are printed when it stops ("#BENCH_BOARD" line)
+ *
+ * @param rate frames per second, 0 stops the generator
+ * @param len length of the frames, at least 7 bytes
+ */
+void uplink_bench_start(uint16_t rate, uint8_t len);
+
+#else
+
+static inline void uplink_bench_start(uint16_t rate, uint8_t len) {}
+
+#endif /* CONFIG_APP_UPLINK_BENCH */
+
+#endif /* UPLINK_BENCH_H_ */
@@ -1,23 +1,184 @@
 
-#include "DataService.h"
+#include "dataService.h"
+#include "EventLog.h"
+#include "CpuStats.h"
+#include "UplinkBench.h"
+#include "AdvIngest.h"
+#include "DeviceInventory.h"
+#include "TraceRecorder.h"
+
+#include <kernel.h>
+#include <sys/atomic.h>
+#include <bluetooth/hci.h>
+#include <sys/byteorder.h>
+
+/*---------------------------------------------------------------------------
+ * DEFINES
+ *--------------------------------------------------------------------------*/ 
+// number of notifications handed to the host stack per subscriber at the same time
+#define MAX_IN_FLIGHT 2
+
+/*---------------------------------------------------------------------------
+ * TYPES
+ *--------------------------------------------------------------------------*/ 
+/*
+ * one encoded frame, shared by all subscriber queues
+ * the frame goes back to the slab when the last queue has sent it
+ */
+struct uplink_frame
+{
+    atomic_t ref;
+    uint16_t len;
+    struct latency_stamps stamps;
+    uint8_t data[CONFIG_APP_UPLINK_FRAME_SIZE];
+};
+
+// rate and resolution of one metric of an application
+struct stream
+{
+    uint16_t minIntervalMs;
+    uint8_t resolution;
+    bool sent;              // lastMs and lastValue are valid
+    uint32_t lastMs;
+    uint16_t lastValue;
+};
+
+/*
+ * state of one connected application
+ * all fields are accessed from the BT RX thread and the system workqueue,
+ * both are cooperative threads -> no locking needed
+ */
+struct subscriber
+{
+    struct bt_conn *conn;
+    uint16_t mtu;
+    uint8_t inFlight;
+    uint8_t head;
+    uint8_t count;
+    uint32_t dropped;
+    uint16_t streamMask;    // STREAM_BIT() of the metrics of the application
+    struct stream streams[STREAM_TYPES];
+    struct uplink_frame *queue[CONFIG_APP_SUBSCRIBER_QUEUE_LEN];
+};
 
 /*---------------------------------------------------------------------------
  * GLOBAL VARIABLES
  *--------------------------------------------------------------------------*/ 
 uint8_t cntAddresses = 0;
-uint8_t diameter;
-double dia;
-uint8_t nbrAddresses = 0;
-char address1[17];
-char address2[17];
-char address3[17];
-uint8_t infoSensors = 0;
 bool notificationsOn = false;
 
+/*
+ * settings of the application, double buffered: snapshot n is in configs[n & 1]
+ * configSeq is 2 * n while snapshot n is published and 2 * n + 1 while
+ * snapshot n + 1 is written to the other buffer, readers never wait for the writer
+ */
+static struct app_config configs[2];
+static atomic_t configSeq;
+
+// next snapshot, only written from the BT RX thread (and at init)
+static struct app_config configDraft;
+
+// the GATT service and the uplink need the peripheral role, a central only
+// board keeps the settings of the application (CONFIG_APP_SENSOR_PRESET)
+#if !defined(CONFIG_APP_ROLE_CENTRAL)
+// connected applications
+static struct subscriber subscribers[CONFIG_APP_MAX_SUBSCRIBERS];
+
+// handler of RX_CMD_RIDE_STATS, owner of the sensor pipeline
+static data_ride_stats_cb_t rideStatsCb;
+
+// union of the streams of the subscribers, read by the sensor threads
+static atomic_t streamUnion = ATOMIC_INIT(STREAM_ALL);
+
+// frames not sent to any application because the pool was empty
+static uint32_t noFrame;
+
+// frames dropped for the applications which disconnected, the total stays monotonic
+static uint32_t droppedGone;
+
+// pool of encoded frames
+K_MEM_SLAB_DEFINE(frameSlab, sizeof(struct uplink_frame), CONFIG_APP_UPLINK_FRAME_COUNT, 4);
+
+// drains the subscriber queues
+static void tx_work_handler(struct k_work *work);
+K_WORK_DEFINE(txWork, tx_work_handler);
+
 // data arrays
 uint8_t data_rx[MAX_TRANSMIT_SIZE];
 uint8_t data_tx[MAX_TRANSMIT_SIZE];
+#endif /* !CONFIG_APP_ROLE_CENTRAL */
 
+// publish configDraft as the next snapshot
+static void publish_config(void)
+{
+    atomic_val_t seq = atomic_inc(&configSeq) + 1;
+
+    configDraft.version = (uint32_t) (seq / 2 + 1);
+    configs[configDraft.version & 1] = configDraft;
+    atomic_inc(&configSeq);
+}
+
+uint32_t data_service_config(struct app_config *out)
+{
+    atomic_val_t seq;
+
+    do
+    {
+        seq = atomic_get(&configSeq) & ~1;
+        *out = configs[(seq / 2) & 1];
+        // the copy must be complete before the sequence is checked again
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        // the buffer was overwritten when the writer started the second snapshot after it
+    } while (atomic_get(&configSeq) - seq > 2);
+    return out->version;
+}
+
+uint32_t data_service_config_version(void)
+{
+    return (uint32_t) (atomic_get(&configSeq) / 2);
+}
+
+// address string of a received frame or the preset
+static void save_address(uint8_t nbr, const char *address)
+{
+    if (nbr < APP_CONFIG_MAX_ADDRESSES)
+    {
+        memcpy(configDraft.addresses[nbr], address, APP_CONFIG_ADDRESS_LEN);
+    }
+}
+
+#if defined(CONFIG_APP_SENSOR_PRESET_INFO)
+// addresses of CONFIG_APP_SENSOR_PRESET, like the address frames of the application
+static void load_sensor_preset(void)
+{
+    const char *preset = CONFIG_APP_SENSOR_PRESET;
+
+    configDraft.nbrAddresses = 0;
+    while (configDraft.nbrAddresses < APP_CONFIG_MAX_ADDRESSES && strlen(preset) >= APP_CONFIG_ADDRESS_LEN)
+    {
+        save_address(configDraft.nbrAddresses++, preset);
+        preset += APP_CONFIG_ADDRESS_LEN;
+        if (*preset == ',')
+        {
+            preset++;
+        }
+    }
+    configDraft.sensorInfos = CONFIG_APP_SENSOR_PRESET_INFO;
+    configDraft.diameterCode = CONFIG_APP_SENSOR_PRESET_DIAMETER;
+    publish_config();
+    trace_record(TRACE_KIND_DIAMETER, k_cycle_get_32(), 0xff, 0, &configDraft.diameterCode, 1);
+    printk("%d sensor addresses preset\n", configDraft.nbrAddresses);
+}
+#endif
+
+void data_service_config_init(void)
+{
+#if defined(CONFIG_APP_SENSOR_PRESET_INFO)
+    load_sensor_preset();
+#endif
+}
+
+#if !defined(CONFIG_APP_ROLE_CENTRAL)
 // must be called befor sending/receiving data
 uint8_t data_service_init(void)
 {
@@ -26,9 +187,69 @@ uint8_t data_service_init(void)
     memset(&data_rx, 0, MAX_TRANSMIT_SIZE);
     memset(&data_tx, 0, MAX_TRANSMIT_SIZE);
 
+    data_service_config_init();
+
     return err;
 }
 
+static struct subscriber *find_subscriber(struct bt_conn *conn);
+
+// the metrics needed by any application, all of them if none is connected
+static void update_streams(void)
+{
+    uint16_t mask = 0;
+    bool any = false;
+
+    for (uint8_t i = 0; i < CONFIG_APP_MAX_SUBSCRIBERS; i++)
+    {
+        if (subscribers[i].conn != NULL)
+        {
+            mask |= subscribers[i].streamMask;
+            any = true;
+        }
+    }
+    atomic_set(&streamUnion, any ? mask : STREAM_ALL);
+}
+
+// RX_CMD_STREAMS of an application
+static void set_streams(struct bt_conn *conn, const uint8_t *data, uint16_t len)
+{
+    struct subscriber *sub = find_subscriber(conn);
+
+    if (sub == NULL)
+    {
+        return;
+    }
+
+    memset(sub->streams, 0, sizeof(sub->streams));
+    if (len == 1 && data[0] == RX_STREAMS_ALL)
+    {
+        sub->streamMask = STREAM_ALL;
+    }
+    else if (len == 1 && data[0] == RX_STREAMS_NONE)
+    {
+        sub->streamMask = 0;
+    }
+    else
+    {
+        sub->streamMask = 0;
+        for (; len >= STREAM_ENTRY_LEN; data += STREAM_ENTRY_LEN, len -= STREAM_ENTRY_LEN)
+        {
+            uint8_t type = data[0];
+
+            if (type == 0 || type >= STREAM_TYPES)
+            {
+                continue;
+            }
+            sub->streamMask |= STREAM_BIT(type);
+            sub->streams[type].minIntervalMs = sys_get_le16(&data[1]);
+            sub->streams[type].resolution = data[3];
+        }
+    }
+    update_streams();
+    ELOG2(STREAMS, sub - subscribers, sub->streamMask);
+}
+
 // This function is called whenever the RX Characteristic has been written to by a Client 
 static ssize_t on_receive(struct bt_conn *conn,
 			  const struct bt_gatt_attr *attr,
@@ -42,115 +263,113 @@ static ssize_t on_receive(struct bt_conn *conn,
     // len = 1 -> new diameter received - or diameter reset (when 0)
     if (len == 1)
     {
-        diameter = (uint8_t ) *buffer;
-
-        // check if last bit is '1', then add 0.5 to dia and convert it to cm
-        if ((diameter & 0b10000000) == 0b10000000)
-        {
-            dia = (diameter + 0.5) * 2.54;
-        }
-        else 
-        {
-            dia = diameter * 2.54;
-        }
+        setDiameter((uint8_t) *buffer);
+        trace_record(TRACE_KIND_DIAMETER, k_cycle_get_32(), bt_conn_index(conn), attr->handle, buffer, len);
     }   
     
     // len = 19 -> addresses of one or more sensors to connect, received
     // bits 0-17 address, bit 18 nbr of total addresses, bit 19 info about which sensors to connect
+    // the addresses are published together after the last one
     if (len == 19)
     {
-        nbrAddresses = (uint8_t) buffer[17];
-        infoSensors = (uint8_t) buffer[18];
+        configDraft.nbrAddresses = (uint8_t) buffer[17];
+        configDraft.sensorInfos = (uint8_t) buffer[18];
 
-        switch (nbrAddresses)
+        if (configDraft.nbrAddresses >= 1 && configDraft.nbrAddresses <= APP_CONFIG_MAX_ADDRESSES)
         {
-        case 1:
-            for (uint8_t i=0; i<17; i++)
-            {
-                uint8_t val = (uint8_t) buffer[i];
-                char charToSave = (char) val;
-                address1[i] = charToSave;
-            } 
-            break;
-        case 2:
-            cntAddresses++;
-            if (cntAddresses == 1)
+            save_address(cntAddresses++, (const char *) buffer);
+            if (cntAddresses >= configDraft.nbrAddresses)
             {
-                for (uint8_t i=0; i<17; i++)
-                {
-                    uint8_t val = (uint8_t) buffer[i];
-                    char charToSave = (char) val;
-                    address1[i] = charToSave;
-                } 
+                cntAddresses = 0;
+                publish_config();
             }
-            else if (cntAddresses == 2)
+        }
+    }
+    
+    // commands with opcode
+    if (len >= 2 && len != 19)
+    {
+        switch (buffer[0])
+        {
+        case RX_CMD_BENCH:
+            if (len == 4)
             {
-                for (uint8_t i=0; i<17; i++)
-                {
-                    uint8_t val = (uint8_t) buffer[i];
-                    char charToSave = (char) val;
-                    address2[i] = charToSave;
-                } 
-                cntAddresses = 0;
+                uplink_bench_start(sys_get_le16(&buffer[1]), buffer[3]);
             }
             break;
-        case 3:
-            cntAddresses++;
-            if (cntAddresses == 1)
+        case RX_CMD_ADV_ALLOW:
+            adv_ingest_command(&buffer[1], len - 1);
+            break;
+        case RX_CMD_INVENTORY:
+            device_inventory_command(buffer[1]);
+            break;
+        case RX_CMD_STREAMS:
+            set_streams(conn, &buffer[1], len - 1);
+            break;
+        case RX_CMD_RIDE_STATS:
+            if (rideStatsCb != NULL)
             {
-                for (uint8_t i=0; i<17; i++)
-                {
-                    uint8_t val = (uint8_t) buffer[i];
-                    char charToSave = (char) val;
-                    address1[i] = charToSave;
-                } 
+                rideStatsCb(&buffer[1], len - 1);
             }
-            else if (cntAddresses == 2)
-            {
-                for (uint8_t i=0; i<17; i++)
-                {
-                    uint8_t val = (uint8_t) buffer[i];
-                    char charToSave = (char) val;
-                    address2[i] = charToSave;
-                } 
-            } else if (cntAddresses == 3)
-            {
-                for (uint8_t i=0; i<17; i++)
-                {
-                    uint8_t val = (uint8_t) buffer[i];
-                    char charToSave = (char) val;
-                    address3[i] = charToSave;
-                } 
-                cntAddresses = 0;
-            }     
             break;
         default:
             break;
         }
     }
-    
-	printk("Received data, handle %d, conn %p, data: 0x", attr->handle, conn);
- 
-    for(uint8_t i = 0; i < len; i++)
+
+    ELOG3(RX_WRITE, attr->handle, len, len > 0 ? buffer[0] : 0);
+ 	return len;
+}
+
+static void frame_unref(struct uplink_frame *frame)
+{
+    // atomic_dec returns the value before the decrement
+    if (atomic_dec(&frame->ref) == 1)
     {
-        printk("%02X", buffer[i]);
+        k_mem_slab_free(&frameSlab, (void **) &frame);
     }
-    printk("\n");
- 	return len;
+}
+
+static struct subscriber *find_subscriber(struct bt_conn *conn)
+{
+    for (uint8_t i = 0; i < CONFIG_APP_MAX_SUBSCRIBERS; i++)
+    {
+        if (subscribers[i].conn == conn)
+        {
+            return &subscribers[i];
+        }
+    }
+    return NULL;
+}
+
+static void queue_pop(struct subscriber *sub)
+{
+    sub->head = (sub->head + 1) % CONFIG_APP_SUBSCRIBER_QUEUE_LEN;
+    sub->count--;
 }
 
 // This function is called whenever a notification has been sent by the TX Characteristic 
 static void on_sent(struct bt_conn *conn, void *user_data)
 {
-	ARG_UNUSED(user_data);
+    struct uplink_frame *frame = (struct uplink_frame *) user_data;
+    struct subscriber *sub = find_subscriber(conn);
 
-    const bt_addr_le_t * addr = bt_conn_get_dst(conn);
-    printk("Data sent to Address 0x %02X %02X %02X %02X %02X %02X \n", addr->a.val[0]
-                                                                , addr->a.val[1]
-                                                                , addr->a.val[2]
-                                                                , addr->a.val[3]
-                                                                , addr->a.val[4]
-                                                                , addr->a.val[5]);
+    if (sub != NULL && sub->inFlight > 0)
+    {
+        sub->inFlight--;
+    }
+    // the first subscriber which has sent the frame records its latency
+    if (frame->stamps.sensor != LATENCY_SENSOR_NONE)
+    {
+        latency_record(&frame->stamps, latency_now());
+        frame->stamps.sensor = LATENCY_SENSOR_NONE;
+    }
+    frame_unref(frame);
+
+    // continue with the next queued frame of this subscriber
+    k_work_submit(&txWork);
+
+    ELOG1(TX_SENT, sub != NULL ? (sub - subscribers) : 0xff);
 }
 
 // This function is called whenever the CCCD register has been changed by the client
@@ -198,88 +417,328 @@ BT_GATT_CCC(on_cccd_changed,
         BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
 );
 
-/* This function sends a notification to a Client with the provided data,
- * given that the Client Characteristic Control Descripter has been set to Notify (0x1).
- * It also calls the on_sent() callback if successful
+/*
+ * The attribute for the TX characteristic is used with bt_gatt_is_subscribed 
+ * to check whether notification has been enabled by the peer or not.
+ * Attribute table: 0 = Service, 1 = Primary service, 2 = RX, 3 = TX, 4 = CCC.
+ */
+static const struct bt_gatt_attr *tx_attr(void)
+{
+    return &data_service.attrs[3];
+}
+
+/* This function hands the queued frames of every subscriber to the host stack,
+ * at most MAX_IN_FLIGHT per connection. It runs again from on_sent().
  */
-void data_service_send(struct bt_conn *conn, const uint8_t *data, uint16_t len)
+static void tx_work_handler(struct k_work *work)
 {
-    /* 
-     * The attribute for the TX characteristic is used with bt_gatt_is_subscribed 
-     * to check whether notification has been enabled by the peer or not.
-     * Attribute table: 0 = Service, 1 = Primary service, 2 = RX, 3 = TX, 4 = CCC.
-     */
-    const struct bt_gatt_attr *attr = &data_service.attrs[3]; 
+    CpuScope scope(CPU_SUBSYS_UPLINK);
 
-    struct bt_gatt_notify_params params = 
+    for (uint8_t i = 0; i < CONFIG_APP_MAX_SUBSCRIBERS; i++)
     {
-        .uuid   = BT_UUID_DATA_SERVICE_TX,
-        .attr   = attr,
-        .data   = data,
-        .len    = len,
-        .func   = on_sent
-    };
+        struct subscriber *sub = &subscribers[i];
+
+        if (sub->conn == NULL)
+        {
+            continue;
+        }
+
+        // negotiated ATT MTU of this connection, payload is MTU - 3
+        sub->mtu = bt_gatt_get_mtu(sub->conn);
+
+        while (sub->count > 0 && sub->inFlight < MAX_IN_FLIGHT)
+        {
+            struct uplink_frame *frame = sub->queue[sub->head];
 
-    // Check whether notifications are enabled or not
-    if(bt_gatt_is_subscribed(conn, attr, BT_GATT_CCC_NOTIFY)) 
+            if (frame->len > sub->mtu - 3)
+            {
+                // does not fit into a notification of this connection
+                queue_pop(sub);
+                sub->dropped++;
+                frame_unref(frame);
+                continue;
+            }
+
+            struct bt_gatt_notify_params params = 
+            {
+                .uuid   = BT_UUID_DATA_SERVICE_TX,
+                .attr   = tx_attr(),
+                .data   = frame->data,
+                .len    = frame->len,
+                .func   = on_sent,
+                .user_data = frame
+            };
+
+            int err = bt_gatt_notify_cb(sub->conn, &params);
+            if (err == -ENOMEM)
+            {
+                // no buffer left in the host stack, retry when a notification was sent
+                break;
+            }
+
+            queue_pop(sub);
+            if (err)
+            {
+                ELOG1(TX_ERROR, err);
+                sub->dropped++;
+                frame_unref(frame);
+                continue;
+            }
+            sub->inFlight++;
+        }
+    }
+}
+
+void data_service_set_ride_stats_cb(data_ride_stats_cb_t cb)
+{
+    rideStatsCb = cb;
+}
+
+/*
+ * true if the stream of the application takes this frame now: the frames
+ * without a metric (message codes, inventory, bench) are always taken.
+ * The battery levels of all sensors share their type, each one is read
+ * only every 60 s -> no minimum interval.
+ */
+static bool stream_accept(const struct subscriber *sub, uint8_t type, uint16_t value, uint32_t now)
+{
+    if (type == 0 || type >= STREAM_TYPES)
     {
-        // Send the notification
-	    if(bt_gatt_notify_cb(conn, &params))
+        return true;
+    }
+    if (!(sub->streamMask & STREAM_BIT(type)))
+    {
+        return false;
+    }
+
+    const struct stream *stream = &sub->streams[type];
+    if (stream->sent && type != TYPE_BATTERY)
+    {
+        if (now - stream->lastMs < stream->minIntervalMs)
+        {
+            return false;
+        }
+        if (value != STREAM_NO_VALUE && stream->resolution > 0 &&
+            (value > stream->lastValue ? value - stream->lastValue : stream->lastValue - value) < stream->resolution)
         {
-            printk("Error, unable to send notification\n");
+            return false;
         }
     }
+    return true;
+}
+
+// a frame of the stream is queued for the application
+static void stream_sent(struct subscriber *sub, uint8_t type, uint16_t value, uint32_t now)
+{
+    if (type == 0 || type >= STREAM_TYPES)
+    {
+        return;
+    }
+
+    struct stream *stream = &sub->streams[type];
+    stream->sent = true;
+    stream->lastMs = now;
+    stream->lastValue = value;
+}
+
+/* This function encodes the data once into a shared frame and queues a reference to it
+ * for every client which has set the Client Characteristic Control Descripter to Notify (0x1).
+ */
+void data_service_send(const uint8_t *data, uint16_t len)
+{
+    data_service_send_sample(data, len, NULL, STREAM_NO_VALUE);
+}
+
+void data_service_send_sample(const uint8_t *data, uint16_t len, struct latency_stamps *stamps,
+                              uint16_t value)
+{
+    CpuScope scope(CPU_SUBSYS_UPLINK);
+    struct uplink_frame *frame;
+    bool queued = false;
+    uint32_t now = k_uptime_get_32();
+
+    if (len > CONFIG_APP_UPLINK_FRAME_SIZE)
+    {
+        ELOG1(TX_TOO_LONG, len);
+        return;
+    }
+
+    if (k_mem_slab_alloc(&frameSlab, (void **) &frame, K_NO_WAIT))
+    {
+        ELOG0(TX_NO_FRAME);
+        noFrame++;
+        return;
+    }
+
+    // reference of the sender, released at the end of this function
+    atomic_set(&frame->ref, 1);
+    frame->len = len;
+    memcpy(frame->data, data, len);
+
+    if (stamps != NULL)
+    {
+        stamps->queued = latency_now();
+        frame->stamps = *stamps;
+    }
     else
     {
-        printk("Warning, notification not enabled on the selected attribute\n");
+        frame->stamps.sensor = LATENCY_SENSOR_NONE;
+    }
+
+    for (uint8_t i = 0; i < CONFIG_APP_MAX_SUBSCRIBERS; i++)
+    {
+        struct subscriber *sub = &subscribers[i];
+
+        // Check whether notifications are enabled or not
+        if (sub->conn == NULL || !bt_gatt_is_subscribed(sub->conn, tx_attr(), BT_GATT_CCC_NOTIFY))
+        {
+            continue;
+        }
+
+        // only a frame the application takes counts as dropped
+        if (len == 0 || !stream_accept(sub, data[0], value, now))
+        {
+            continue;
+        }
+
+        if (sub->count == CONFIG_APP_SUBSCRIBER_QUEUE_LEN)
+        {
+            // queue full -> the slow subscriber loses this frame, the others are not affected
+            sub->dropped++;
+            continue;
+        }
+
+        stream_sent(sub, data[0], value, now);
+        atomic_inc(&frame->ref);
+        sub->queue[(sub->head + sub->count) % CONFIG_APP_SUBSCRIBER_QUEUE_LEN] = frame;
+        sub->count++;
+        queued = true;
+    }
+
+    frame_unref(frame);
+
+    if (queued)
+    {
+        k_work_submit(&txWork);
     }
 }
 
-double getDiameter() 
+int data_service_add_subscriber(struct bt_conn *conn)
 {
-    return dia;
+    struct subscriber *sub = find_subscriber(NULL);
+
+    if (sub == NULL)
+    {
+        return -ENOMEM;
+    }
+
+    memset(sub, 0, sizeof(*sub));
+    sub->conn = bt_conn_ref(conn);
+    sub->mtu = bt_gatt_get_mtu(conn);
+    // all metrics until the application sends its streams
+    sub->streamMask = STREAM_ALL;
+    update_streams();
+
+    return 0;
 }
 
-void setDiameter(uint8_t diameter) 
+void data_service_remove_subscriber(struct bt_conn *conn)
+{
+    struct subscriber *sub = find_subscriber(conn);
+
+    if (sub == NULL)
+    {
+        return;
+    }
+
+    // release the frames which were not sent any more
+    while (sub->count > 0)
+    {
+        frame_unref(sub->queue[sub->head]);
+        queue_pop(sub);
+    }
+
+    droppedGone += sub->dropped;
+    bt_conn_unref(sub->conn);
+    sub->conn = NULL;
+    update_streams();
+}
+
+uint16_t data_service_streams(void)
 {
-    dia = diameter;
+    return (uint16_t) atomic_get(&streamUnion);
 }
 
-uint8_t getNbrOfAddresses() 
+uint8_t data_service_nbr_subscribers()
 {
-    return nbrAddresses;
+    uint8_t cnt = 0;
+
+    for (uint8_t i = 0; i < CONFIG_APP_MAX_SUBSCRIBERS; i++)
+    {
+        if (subscribers[i].conn != NULL)
+        {
+            cnt++;
+        }
+    }
+    return cnt;
 }
 
-void getAddress(char* outArray, uint8_t nbr) 
+void data_service_queue_stats(uint32_t *queued, uint32_t *dropped)
 {
-    switch (nbr)
+    *queued = 0;
+    *dropped = noFrame + droppedGone;
+
+    for (uint8_t i = 0; i < CONFIG_APP_MAX_SUBSCRIBERS; i++)
     {
-    case 1:
-        for (uint8_t i=0; i<17; i++)
+        if (subscribers[i].conn != NULL)
         {
-            outArray[i] = address1[i];
-        }    
-        break;
-    case 2:
-        for (uint8_t i=0; i<17; i++)
+            *queued += subscribers[i].count + subscribers[i].inFlight;
+            *dropped += subscribers[i].dropped;
+        }
+    }
+}
+
+uint16_t data_service_max_frame_len(void)
+{
+    uint16_t len = 0;
+
+    for (uint8_t i = 0; i < CONFIG_APP_MAX_SUBSCRIBERS; i++)
+    {
+        if (subscribers[i].conn == NULL)
         {
-            outArray[i] = address2[i];
-        }    
-        break;
-    case 3:
-        for (uint8_t i=0; i<17; i++)
+            continue;
+        }
+
+        uint16_t payload = bt_gatt_get_mtu(subscribers[i].conn) - 3;
+        if (len == 0 || payload < len)
         {
-            outArray[i] = address3[i];
-        }    
-        break;
-    default:
-        break;
+            len = payload;
+        }
     }
+    return MIN(len, CONFIG_APP_UPLINK_FRAME_SIZE);
+}
+#endif /* !CONFIG_APP_ROLE_CENTRAL */
+
+void setDiameter(uint8_t diameter) 
+{
+    configDraft.diameterCode = diameter;
+    publish_config();
+}
+
+uint8_t getNbrOfAddresses() 
+{
+    struct app_config config;
+
+    data_service_config(&config);
+    return config.nbrAddresses;
 }
 
 uint8_t getSensorInfos() 
 {
-    return infoSensors;
+    struct app_config config;
+
+    data_service_config(&config);
+    return config.sensorInfos;
 }
 
 bool areNotificationsOn()
@@ -9,11 +9,17 @@
  * 
  */
 
+#ifndef DATA_SERVICE_H_
+#define DATA_SERVICE_H_
+
 /*---------------------------------------------------------------------------
  * INCLUDES
  *--------------------------------------------------------------------------*/ 
 #include <bluetooth/gatt.h>
 
+#include "Latency.h"
+#include "Protocol.h"
+
 /*---------------------------------------------------------------------------
  * DEFINES
  *--------------------------------------------------------------------------*/ 
@@ -33,12 +39,42 @@
 
 #define MAX_TRANSMIT_SIZE 240	
 
+// value of a frame without a value for the resolution of its stream
+#define STREAM_NO_VALUE 0xffff
+
+// number of sensor addresses the application can send
+#define APP_CONFIG_MAX_ADDRESSES 3
+// length of an address string without terminating 0 ("xx:xx:xx:xx:xx:xx")
+#define APP_CONFIG_ADDRESS_LEN 17
+
+/**
+ * @brief settings of the application, read as one consistent snapshot
+ * 
+ */
+struct app_config
+{
+	// incremented with every published snapshot, 0 before the first one
+	uint32_t version;
+	// as sent by the application: inches, bit 7 adds 0.5 inch, 0 = reset
+	uint8_t diameterCode;
+	uint8_t nbrAddresses;
+	// see getSensorInfos()
+	uint8_t sensorInfos;
+	char addresses[APP_CONFIG_MAX_ADDRESSES][APP_CONFIG_ADDRESS_LEN];
+};
+
 /**
  * @brief Callback type for when new data is received
  * 
  */
 typedef void (*data_rx_cb_t)(uint8_t *data, uint8_t length);
 
+/**
+ * @brief Callback type for the command RX_CMD_RIDE_STATS, called in the BT RX thread
+ * 
+ */
+typedef void (*data_ride_stats_cb_t)(const uint8_t *data, uint16_t length);
+
 /** 
  * @brief Callback struct used by the data_service Service 
  * 
@@ -49,33 +85,139 @@ struct data_service_cb
 	data_rx_cb_t data_rx_cb;
 };
 
+/**
+ * @brief load the settings preset at build time (CONFIG_APP_SENSOR_PRESET),
+ *        also on a central only board without the data service
+ */
+void data_service_config_init(void);
+
+#if !defined(CONFIG_APP_ROLE_CENTRAL)
+
 /** 
- * @brief initialize service 
+ * @brief initialize service, also loads the preset settings
  * 
  *  @return uint8_t error code
 */
 uint8_t data_service_init(void);
 
+/**
+ * @brief set the handler of the command RX_CMD_RIDE_STATS
+ * 
+ * @param cb handler, gets the command without the opcode
+ */
+void data_service_set_ride_stats_cb(data_ride_stats_cb_t cb);
+
 /** 
- * @brief  send data to the device given by connection parameter
+ * @brief  send data to all connected applications which enabled notifications,
+ *         the data is copied once and shared by the queues of all subscribers
  * 
- * @param conn connection to send the data
  * @param data the data to send
  * @param len length of the data to send
 */
-void data_service_send(struct bt_conn *conn, const uint8_t *data, uint16_t len);
+void data_service_send(const uint8_t *data, uint16_t len);
 
 /** 
- *  @brief get the diameter value
+ * @brief  send a sensor value like data_service_send(), the latency of the sample
+ *         is recorded when its notification was sent, the frame is only queued
+ *         for the applications whose streams (RX_CMD_STREAMS) take it now
  * 
- *  @return the diameter value in cm
+ * @param data the data to send
+ * @param len length of the data to send
+ * @param stamps time stamps of the sample, the enqueue time is set by this function
+ * @param value value for the resolution of the stream, STREAM_NO_VALUE if none
 */
-double getDiameter();
+void data_service_send_sample(const uint8_t *data, uint16_t len, struct latency_stamps *stamps,
+                              uint16_t value);
+
+/**
+ * @brief metrics needed by at least one connected application, cheap enough
+ *        to be checked for every notification of a sensor
+ * 
+ * @return uint16_t STREAM_BIT() of the types, STREAM_ALL without applications
+ */
+uint16_t data_service_streams(void);
+
+/**
+ * @brief add a connected application to the subscribers
+ * 
+ * @param conn connection of the application, a reference is taken
+ * @return int error code, 0 if success, -ENOMEM if all subscriber slots are used
+ */
+int data_service_add_subscriber(struct bt_conn *conn);
 
 /**
- * @brief Set the diameter value
+ * @brief remove a disconnected application from the subscribers,
+ *        drops its queued frames and releases the connection reference
  * 
- * @param diameter value 
+ * @param conn connection of the application
+ */
+void data_service_remove_subscriber(struct bt_conn *conn);
+
+/**
+ * @brief get number of connected applications
+ * 
+ * @return uint8_t number of subscribers
+ */
+uint8_t data_service_nbr_subscribers();
+
+/**
+ * @brief frames of the uplink which are not sent yet, summed over the
+ *        connected applications, and which were lost since the start
+ * 
+ * @param queued frames in the queues and in the host stack
+ * @param dropped frames dropped since the start, also for the applications
+ *                which disconnected (never decreases)
+ */
+void data_service_queue_stats(uint32_t *queued, uint32_t *dropped);
+
+/**
+ * @brief longest frame every connected application can receive:
+ *        smallest ATT MTU - 3 of the subscribers, at most CONFIG_APP_UPLINK_FRAME_SIZE
+ * 
+ * @return uint16_t length in bytes, 0 without subscribers
+ */
+uint16_t data_service_max_frame_len(void);
+
+#else
+
+// no application can connect to a central only board, the GATT service is not linked
+static inline uint8_t data_service_init(void) { return 0; }
+static inline void data_service_set_ride_stats_cb(data_ride_stats_cb_t cb) {}
+static inline void data_service_send(const uint8_t *data, uint16_t len) {}
+static inline void data_service_send_sample(const uint8_t *data, uint16_t len, struct latency_stamps *stamps,
+                                            uint16_t value) {}
+static inline uint16_t data_service_streams(void) { return STREAM_ALL; }
+static inline int data_service_add_subscriber(struct bt_conn *conn) { return -ENOTSUP; }
+static inline void data_service_remove_subscriber(struct bt_conn *conn) {}
+static inline uint8_t data_service_nbr_subscribers() { return 0; }
+static inline void data_service_queue_stats(uint32_t *queued, uint32_t *dropped) { *queued = 0; *dropped = 0; }
+static inline uint16_t data_service_max_frame_len(void) { return 0; }
+
+#endif /* !CONFIG_APP_ROLE_CENTRAL */
+
+/**
+ * @brief copy the current settings of the application, lock free:
+ *        the settings are double buffered, a new snapshot is written
+ *        to the buffer not in use and published by the version
+ * 
+ * @param out consistent copy of the settings
+ * @return uint32_t version of the copy
+ */
+uint32_t data_service_config(struct app_config *out);
+
+/**
+ * @brief version of the current settings, cheap enough to be checked
+ *        for every sample, the snapshot only has to be copied again
+ *        (and derived values recomputed) when it changed
+ * 
+ * @return uint32_t version, see struct app_config
+ */
+uint32_t data_service_config_version(void);
+
+/**
+ * @brief Set the diameter value, must be called from the BT RX thread
+ * 
+ * @param diameter code like sent by the application, 0 = reset
  */
 void setDiameter(uint8_t diameter);
 
@@ -86,14 +228,6 @@ void setDiameter(uint8_t diameter);
 */
 uint8_t getNbrOfAddresses();
 
-/** 
- * @brief save the address with the corresponing number at the given array
- * 
- * @param outArray the address to save the searched array
- * @param nbr the nbr of the array to save
-*/
-void getAddress(char* outArray, uint8_t nbr);
-
 /**
  * @brief Get informations about which sensors 
  * 		  the user wants to connect
@@ -106,13 +240,17 @@ void getAddress(char* outArray, uint8_t nbr);
  * 		   speed and heart rate sensor: 5
  * 		   cadence and heart rate sensor: 6
  * 		   just one heart rate sensor: 7
+ * 		   power meter: 8
+ * 		   power meter and heart rate sensor: 9
  */
 uint8_t getSensorInfos();
 
 /**
- * @brief get information if notifications are enabled in application
+ * @brief get information if notifications are enabled in an application
  * 
- * @return true if enabled
+ * @return true if enabled by at least one application
  * @return false if is not enabled
  */
 bool areNotificationsOn();
+
+#endif /* DATA_SERVICE_H_ */
@@ -1,34 +1,34 @@
-#include "DeviceManager.h"
-
-// data service definition
+#include "deviceManager.h"
+#include "EventLog.h"
+#include "CpuStats.h"
+#include "SimReport.h"
+#include "TraceRecorder.h"
+
+// data service definition, a central only board has no GATT server
+#if !defined(CONFIG_APP_ROLE_CENTRAL)
 BT_GATT_SERVICE_DEFINE(csc_srv,
 	BT_GATT_PRIMARY_SERVICE(BT_UUID_CSC),
 	BT_GATT_CHARACTERISTIC(BT_UUID_CSC_MEASUREMENT, BT_GATT_CHRC_NOTIFY,
 			       0x00, NULL, NULL, NULL),			   
 );
+#endif
 
 // initialize static attributes
-bool DeviceManager::isCentral = false;
-bool DeviceManager::isPeripheral = false;
+#if defined(CONFIG_APP_LBS)
 bool DeviceManager::app_button_state = false;
+#endif
 bool DeviceManager::subscriptionDone = false;
-bool DeviceManager::diameterSet = false;
 bool DeviceManager::once_sensor1 = true;
 bool DeviceManager::once_sensor2 = true;
 bool DeviceManager::once_sensor3 = true;
-bool DeviceManager::batterySubscriptionDone = false;
-bool DeviceManager::serviceNotFound = false;
 bool DeviceManager::reconnectedHeartRate = false;
 bool DeviceManager::peripheralDisconnected = false;
 bool DeviceManager::connectedPeripheral = false;
 bool DeviceManager::cscDisconnected = false;
 bool DeviceManager::hrDisconnected = false;
-bool DeviceManager::disconnectOnce = true;
 uint8_t DeviceManager::nbrAddresses = 0;
 uint8_t DeviceManager::nbrConnectionsCentral = 0;
 uint8_t DeviceManager::sensorInfos = 0;
-uint8_t DeviceManager::cntBatterySubscriptions = 0;
-uint8_t DeviceManager::cntFirstHR = 0;
 char DeviceManager::sensor1[];
 char DeviceManager::sensor2[];
 char DeviceManager::sensor3[];
@@ -39,26 +39,73 @@ const bt_data DeviceManager::ad[] = {
     BT_DATA(BT_DATA_NAME_COMPLETE, DEVICE_NAME, DEVICE_NAME_LEN),
 };
 
-bt_conn* DeviceManager::peripheralConn;
-bt_conn* DeviceManager::centralConnections[];
-bt_gatt_subscribe_params DeviceManager::subscribe_params[];
+struct sensor_link *DeviceManager::sensorOf[];
 Data DeviceManager::data;
+SensorPipeline DeviceManager::pipeline;
+struct latency_stamps *DeviceManager::currentStamps = nullptr;
+struct k_mutex DeviceManager::pipelineLock;
+uint32_t DeviceManager::pipelineConfigVersion = 0;
+uint16_t DeviceManager::pipelineStreams = STREAM_ALL;
+uint32_t DeviceManager::scanConfigVersion = 0;
+struct k_delayed_work DeviceManager::estimatorWork;
+struct k_delayed_work DeviceManager::deadlineWork;
+uint64_t DeviceManager::scheduledDeadline = SENSOR_WATCH_NEVER;
+struct k_delayed_work DeviceManager::ingestWork;
+
+// pool of the contexts of the connected sensors
+K_MEM_SLAB_DEFINE(sensorSlab, sizeof(struct sensor_link), CONFIG_APP_SENSOR_LINKS, 4);
+
+// the CSC and heart rate sensors keep their own messages to the application
+// and their battery handling, the other profiles use the generic templates
+template <>
+void DeviceManager::subscribed<CscProfile>();
+template <>
+void DeviceManager::subscribed<HeartRateProfile>();
+template <>
+uint8_t DeviceManager::notify<CscProfile>(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+										  const void *data, uint16_t length);
+template <>
+uint8_t DeviceManager::notify<HeartRateProfile>(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+												const void *data, uint16_t length);
+
+// the BatteryManager knows the sensor info codes of the CSC and heart rate sensors
+static inline bool batteryManaged(uint8_t info)
+{
+	return info <= 7;
+}
+
+// next battery read of every sensor by TYPE_*, in ms of uptime, odd, 0 = not scheduled
+static uint32_t batteryReadMs[TYPE_HEARTRATE + 1];
 
-// define discovery callback for the CSC sensors
-static struct bt_gatt_dm_cb discovery_cb_CSC = 
+// the first battery read of a sensor after BATTERY_FIRST_READ_MS, e.g. after a reconnection
+static inline void batteryRestart(uint8_t type)
 {
-	.completed = DeviceManager::discoveryCompletedCSC,
-	.service_not_found = DeviceManager::discovery_service_not_found,
-	.error_found = DeviceManager::discovery_error_found,
-};
+	batteryReadMs[type] = 0;
+}
 
-// define discovery callback for the heart rate sensor
-static struct bt_gatt_dm_cb discovery_cb_HR = 
+// true when the battery level of a sensor is to be asked, by time and not by notifications
+static bool batteryDue(uint8_t type)
 {
-	.completed = DeviceManager::discoveryCompletedHR,
-	.service_not_found = DeviceManager::discovery_service_not_found,
-	.error_found = DeviceManager::discovery_error_found,
-};
+	uint32_t now = k_uptime_get_32();
+
+	if (batteryReadMs[type] == 0)
+	{
+		batteryReadMs[type] = (now + BATTERY_FIRST_READ_MS) | 1;
+		return false;
+	}
+	if ((int32_t) (now - batteryReadMs[type]) >= 0)
+	{
+		batteryReadMs[type] = (now + BATTERY_READ_PERIOD_MS) | 1;
+		return true;
+	}
+	return false;
+}
+
+// metrics to process: the ones of the applications, all of them for the broadcast
+static inline uint16_t wantedStreams(void)
+{
+	return IS_ENABLED(CONFIG_APP_BROADCAST) ? STREAM_ALL : data_service_streams();
+}
 
 /*-----------------------------------------------------------------------------------------------------
  * GENERAL METHODS
@@ -66,51 +113,53 @@ static struct bt_gatt_dm_cb discovery_cb_HR =
 
 DeviceManager::DeviceManager()
 {
-	for (uint8_t i = 0; i <= MAX_CONNECTIONS_CENTRAL-1; i++)
-	{
-		centralConnections[i] = nullptr;
-	}
 }
 
-uint8_t DeviceManager::getDevice()
+void DeviceManager::start()
 {
-    if (isCentral && isPeripheral)
-	{
-        return 3;
-    } 
-	else if (!isCentral && isPeripheral)
-	{
-        return 2;
-    } 
-	else if (isCentral && !isPeripheral)
+	// processing of the sensor notifications
+	k_mutex_init(&pipelineLock);
+	pipeline.init(&data, pipelineOutput);
+	pipeline.stats().setHeartRateMax(CONFIG_APP_RIDE_HR_MAX);
+	k_delayed_work_init(&deadlineWork, deadlineTick);
+	data_service_set_ride_stats_cb(rideStatsCommand);
+	link_monitor_init();
+#if defined(CONFIG_APP_HRV_UPLINK)
+	pipeline.setHrvUplink(CONFIG_APP_HRV_UPLINK_BEATS);
+#endif
+#if defined(CONFIG_APP_CSC_ESTIMATOR)
+	pipeline.setEstimator(true);
+	k_delayed_work_init(&estimatorWork, estimatorTick);
+	k_delayed_work_submit(&estimatorWork, K_MSEC(CONFIG_APP_CSC_ESTIMATOR_PERIOD_MS));
+#endif
+
+	if (isCentral)
 	{
-        return 1;
-    } 
-	else 
-	{
-        return 0;
-    }
-}
-
-void DeviceManager::setDevice(bool c, bool p)
-{
-    isPeripheral = p;
-    isCentral = c;  
+		motion_client_init();
+		adv_ingest_init(ingestMeasurement);
+		device_inventory_init();
+#if defined(CONFIG_APP_ADV_INGEST)
+		k_delayed_work_init(&ingestWork, ingestScanTick);
+		k_delayed_work_submit(&ingestWork, K_MSEC(ADV_INGEST_REPEAT_MS));
+#endif
+	}
 
-	if (isCentral == true && isPeripheral == true)
+	if (isPeripheral)
 	{
+		// the central role of a hybrid board starts with the first application
 		initPeripheral();
 	}
-	else if (isCentral == true && isPeripheral == false)
+	else
 	{
 		initCentral();
 	}
-	else if (isCentral == false && isPeripheral == true)
-	{
-		initPeripheral();
-	}
+
+	// connectionless broadcast of the live values, once Bluetooth is enabled by a role
+	broadcast_init();
+	printk("Ready after %u us (roles %u)\n", (uint32_t) boardTimeUs(), getDevice());
 }
 
+#if defined(CONFIG_APP_LBS)
 void DeviceManager::app_led_cb(bool led_state)
 {
 	// set led on board to led_state
@@ -144,6 +193,7 @@ uint8_t DeviceManager::initButton()
 
     return err;
 }
+#endif /* CONFIG_APP_LBS */
 
 /*-----------------------------------------------------------------------------------------------------
  * PERIPHERAL ROLE
@@ -152,75 +202,77 @@ uint8_t DeviceManager::initButton()
 void DeviceManager::initPeripheral()
 {
     uint8_t err;
-    if(getDevice() == 3 || getDevice() == 2)
-	{
-		// initialize leds
-        err = dk_leds_init();
-        if (err) 
-		{
-            printk("LEDs init failed (err %d)\n", err);
-            return;
-        }
-
-		// initialize buttons
-        err = initButton();
-        if (err) 
-		{
-            printk("Button init failed (err %d)\n", err);
-            return;
-        }
 
-		// enable bluetooth
-        err = bt_enable(NULL);
-        if (err) 
-		{
-            printk("Bluetooth init failed (err %d)\n", err);
-            return;
-        }
+	// initialize leds
+	err = dk_leds_init();
+	if (err) 
+	{
+		printk("LEDs init failed (err %d)\n", err);
+		return;
+	}
 
-        printk("Bluetooth initialized\n");
+#if defined(CONFIG_APP_LBS)
+	// initialize buttons
+	err = initButton();
+	if (err) 
+	{
+		printk("Button init failed (err %d)\n", err);
+		return;
+	}
+#endif
 
-		// register callback functions
-		bt_conn_cb_register(&conn_callbacks);
+	// enable bluetooth
+	err = bt_enable(NULL);
+	if (err) 
+	{
+		printk("Bluetooth init failed (err %d)\n", err);
+		return;
+	}
 
-		// config settings
-        if (IS_ENABLED(CONFIG_SETTINGS)) 
-		{
-            settings_load();
-        }
+	printk("Bluetooth initialized\n");
 
-		// initialize Led Button Service
-        err = bt_lbs_init(&lbs_callbacs);
-        if (err) 
-		{
-            printk("Failed to init LBS (err:%d)\n", err);
-            return;
-        }
+	// register callback functions
+	bt_conn_cb_register(&conn_callbacks);
 
-		// initialize data service
-		err = data_service_init();
-		if (err) 
-		{
-			printk("Failed to init LBS (err:%d)\n", err);
-			return;
-		}
+	// config settings
+	if (IS_ENABLED(CONFIG_SETTINGS)) 
+	{
+		settings_load();
+	}
 
-		startAdvertising();
-    }
-}
+#if defined(CONFIG_APP_LBS)
+	// initialize Led Button Service
+	err = bt_lbs_init(&lbs_callbacs);
+	if (err) 
+	{
+		printk("Failed to init LBS (err:%d)\n", err);
+		return;
+	}
+#endif
 
-void DeviceManager::startAdvertising() 
-{
-	uint8_t err;
-	err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad),
-			sd, ARRAY_SIZE(sd));
+	// initialize data service
+	err = data_service_init();
 	if (err) 
 	{
-		printk("Advertising failed to start (err %d)\n", err);
+		printk("Failed to init data service (err:%d)\n", err);
 		return;
 	}
 
-	printk("Advertising successfully started\n");
+	adv_manager_init(ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+	startAdvertising();
+
+	// sensors preset at build time (simulation) -> connect them without application
+	if (isCentral && getNbrOfAddresses() != 0)
+	{
+		sim_report_init();
+		initScan();
+	}
+}
+
+void DeviceManager::startAdvertising() 
+{
+	// fast advertising at start up, decays to the slow interval
+	adv_manager_start(false);
 	printk("Waiting for connection with application...\n");
 }
 
@@ -231,58 +283,47 @@ void DeviceManager::startAdvertising()
 void DeviceManager::initCentral()
 {
 	printk("Init Central\n");
-	if (getDevice() == 1 || getDevice() == 3)
+	if (!isCentral)
 	{
-	    uint8_t err;
-		// when device = 3, initPeripheral is already called, most inits are already done
-		if (getDevice() != 3)
-		{
-			// enable bluetooth
-			err = bt_enable(nullptr);
-			if (err)
-			{
-				printk("Bluetooth init failed (err %d)\n", err);
-				return;
-			}
-			printk("Bluetooth ready\n");
-
-			// initialize leds
-			err = dk_leds_init();
-			if (err) 
-			{
-				printk("LEDs init failed (err %d)\n", err);
-				return;
-			}
-
-			// initialize buttons
-			err = initButton();
-			if (err) 
-			{
-				printk("Button init failed (err %d)\n", err);
-				return;
-			}
+		return;
+	}
 
-			// initialize Led Button Service
-			err = bt_lbs_init(&lbs_callbacs);
-			if (err) 
-			{
-				printk("Failed to init LBS (err:%d)\n", err);
-				return;
-			}
+	uint8_t err;
+	// on a hybrid board, initPeripheral is already called, most inits are already done
+	if (!isPeripheral)
+	{
+		// enable bluetooth
+		err = bt_enable(nullptr);
+		if (err)
+		{
+			printk("Bluetooth init failed (err %d)\n", err);
+			return;
+		}
+		printk("Bluetooth ready\n");
 
-			// config settings
-			if (IS_ENABLED(CONFIG_SETTINGS)) 
-			{
-				settings_load();
-				printk("Settings loaded\n");
-			}
+		// initialize leds
+		err = dk_leds_init();
+		if (err) 
+		{
+			printk("LEDs init failed (err %d)\n", err);
+			return;
+		}
 
-			bt_conn_cb_register(&conn_callbacks);
+		// config settings
+		if (IS_ENABLED(CONFIG_SETTINGS)) 
+		{
+			settings_load();
+			printk("Settings loaded\n");
 		}
 
-		initScan();
-		startScan();	
+		bt_conn_cb_register(&conn_callbacks);
+
+		// no application can connect, the sensors are preset at build time
+		data_service_config_init();
 	}
+
+	initScan();
+	startScan();	
 }
 
 void DeviceManager::initScan() 
@@ -292,9 +333,12 @@ void DeviceManager::initScan()
 	sensorInfos = getSensorInfos();
 	
 	// scan parameter
+	// the broadcasting sensors advertise every measurement with the same address,
+	// the inventory follows the RSSI and the last advertisement of every device
 	struct bt_le_scan_param scanParam = {
         .type = BT_LE_SCAN_TYPE_ACTIVE,
-        .options = BT_LE_SCAN_OPT_FILTER_DUPLICATE,
+        .options = IS_ENABLED(CONFIG_APP_ADV_INGEST) || IS_ENABLED(CONFIG_APP_INVENTORY) ?
+                   BT_LE_SCAN_OPT_NONE : BT_LE_SCAN_OPT_FILTER_DUPLICATE,
         .interval = BT_GAP_SCAN_FAST_INTERVAL,
         .window = BT_GAP_SCAN_FAST_WINDOW,
         .timeout = 0
@@ -320,114 +364,17 @@ void DeviceManager::initScan()
 		}
 		
 		bt_scan_filter_remove_all();
-		switch (sensorInfos)
+		// search the next sensor, they are connected in the order of sensor_plan()
+		err = addScanFilter(sensor_plan(sensorInfos, nbrConnectionsCentral));
+		if (err) 
 		{
-			case 1:
-				// search just 1 speed sensor
-				// add CSC UUID filter
-				err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_CSC);
-				if (err) 
-				{
-					printk("Scanning filters cannot be set\n");
-					return;
-				}
-				break;
-			case 2:
-				// search just 1 cadence sensor
-				// add CSC UUID filter
-				err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_CSC);
-				if (err) 
-				{
-					printk("Scanning filters cannot be set\n");
-					return;
-				}		
-				break;
-			case 3:
-				// search just for CSC sensors
-				// add CSC UUID filter
-				err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_CSC);
-				if (err) 
-				{
-					printk("Scanning filters cannot be set\n");
-					return;
-				}
-				break;
-			case 4:
-				// first search 2 CSC sensors, after a heart rate sensor
-				if (nbrConnectionsCentral == 0 || nbrConnectionsCentral == 1)
-				{
-					err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_CSC);
-					if (err) 
-					{
-						printk("Scanning filters cannot be set\n");
-						return;
-					}
-				}
-				else if (nbrConnectionsCentral == 2)
-				{
-					err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_HRS);
-					if (err) 
-					{
-						printk("Scanning filters cannot be set\n");
-						return;
-					}
-				}
-				break;
-			case 5:
-				// first search for a speed sensor, after a heart rate sensor
-				if (nbrConnectionsCentral == 0)
-				{
-					err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_CSC);
-					if (err) 
-					{
-						printk("Scanning filters cannot be set\n");
-						return;
-					}			
-				}
-				else if (nbrConnectionsCentral == 1)
-				{
-					err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_HRS);
-					if (err) 
-					{
-						printk("Scanning filters cannot be set\n");
-						return;
-					}
-				}
-				break;
-			case 6:
-				// first search for a cadence sensor, after a heart rate sensor
-				if (nbrConnectionsCentral == 0)
-				{
-					err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_CSC);
-					if (err) 
-					{
-						printk("Scanning filters cannot be set\n");
-						return;
-					}			
-				}
-				else if (nbrConnectionsCentral == 1)
-				{
-					err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_HRS);
-					if (err) 
-					{
-						printk("Scanning filters cannot be set\n");
-						return;
-					}
-				}
-				break;			
-			case 7:
-				// just a heart rate sensor to connect
-				err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_HRS);
-				if (err) 
-				{
-					printk("Scanning filters cannot be set\n");
-					return;
-				}	
-				break;	
-			default:
-				break;
+			printk("Scanning filters cannot be set\n");
+			return;
 		}
 		
+		// the Thingy is searched together with the sensors
+		motion_client_add_scan_filter();
+
 		// enable filters
 		err = bt_scan_filter_enable(BT_SCAN_UUID_FILTER, false);
 		if (err) 
@@ -451,41 +398,22 @@ void DeviceManager::startScan()
 	{
 		printk("Scanning failed to start, err %d\n", err);
 	}
+	sim_report_scan_started();
 	printk("Scanning...\n");
 }
 
-void DeviceManager::reScan(uint8_t type)
+void DeviceManager::reScan(uint8_t profile)
 {
 	uint8_t err = 0;
 
 	bt_scan_filter_remove_all();	
-	// start scan with type of disconnected sensor
-	switch (type)
+	// start scan with the profile of the disconnected sensor
+	err = addScanFilter(profile);
+	if (err) 
 	{
-	case 1:
-		err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_CSC);
-		if (err) 
-		{
-			printk("Scanning filters cannot be set\n");
-		}
-		break;
-	case 2:
-		err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_CSC);
-		if (err) 
-		{
-			printk("Scanning filters cannot be set\n");
-		}
-		break;
-	case 3:
-		err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, BT_UUID_HRS);
-		if (err) 
-		{
-			printk("Scanning filters cannot be set\n");
-		}	
-		break;		
-	default:
-		break;
+		printk("Scanning filters cannot be set\n");
 	}
+	motion_client_add_scan_filter();
 
 	err = bt_scan_filter_enable(BT_SCAN_UUID_FILTER, false);
 	if (err) 
@@ -495,34 +423,70 @@ void DeviceManager::reScan(uint8_t type)
 	startScan();
 }
 
+template <typename P>
+void DeviceManager::ScanFilterVisitor::operator()(P profile)
+{
+	err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, serviceUuid<P>());
+}
+
+template <typename P>
+const struct bt_uuid *DeviceManager::serviceUuid()
+{
+	static const struct bt_uuid_16 uuid = BT_UUID_INIT_16(P::service);
+	return &uuid.uuid;
+}
+
+template <typename P>
+const struct bt_uuid *DeviceManager::measurementUuid()
+{
+	static const struct bt_uuid_16 uuid = BT_UUID_INIT_16(P::measurement);
+	return &uuid.uuid;
+}
+
+int DeviceManager::addScanFilter(uint8_t profile)
+{
+	ScanFilterVisitor visitor = {0};
+
+	SensorProfiles::visit(profile, visitor);
+	return visitor.err;
+}
+
 void DeviceManager::scanFilterMatch(struct bt_scan_device_info *device_info,
 			      struct bt_scan_filter_match *filter_match,
 			      bool connectable) {
 
+	CpuScope scope(CPU_SUBSYS_SCAN);
 	static bool ready = false;
-	nbrAddresses = getNbrOfAddresses();
+
+	if (motion_client_scan_match(device_info, filter_match))
+	{
+		// Thingy found, the scan continues after its connection
+		return;
+	}
+
+	if (subscriptionDone)
+	{
+		// all sensors connected, the scan only runs for the broadcasting sensors
+		return;
+	}
+
+	// get addresses from data service, copied again only when the application sent new ones
+	if (data_service_config_version() != scanConfigVersion)
+	{
+		struct app_config config;
+		char *sensors[] = {sensor1, sensor2, sensor3};
+
+		scanConfigVersion = data_service_config(&config);
+		nbrAddresses = config.nbrAddresses;
+		for (uint8_t i = 0; i < nbrAddresses && i < ARRAY_SIZE(sensors); i++)
+		{
+			memcpy(sensors[i], config.addresses[i], sizeof(config.addresses[i]));
+		}
+	}
 	
 	if (nbrAddresses != 0)
 	{
 		ready = true;
-		// get addresses from data service
-		switch (nbrAddresses)
-		{
-		case 1:
-			getAddress(sensor1,1);
-			break;
-		case 2:
-			getAddress(sensor1,1);
-			getAddress(sensor2,2);
-			break;
-		case 3:
-			getAddress(sensor1,1);
-			getAddress(sensor2,2);
-			getAddress(sensor3,3);
-			break;
-		default:
-			break;
-		}	
 	}
 	else 
 	{
@@ -532,6 +496,8 @@ void DeviceManager::scanFilterMatch(struct bt_scan_device_info *device_info,
 	
     char addr[BT_ADDR_LE_STR_LEN];
 	uint8_t err;
+	// the reference of the connection is released by connected()
+	struct bt_conn *conn = nullptr;
 	bt_addr_le_to_str(device_info->recv_info->addr, addr, sizeof(addr));
 	char addrShort[18];
 	bt_addr_le_to_str(device_info->recv_info->addr, addrShort, sizeof(addrShort));
@@ -542,28 +508,28 @@ void DeviceManager::scanFilterMatch(struct bt_scan_device_info *device_info,
 		// search first for the sensor 1 and then the sensor 2 and at the end sensor 3
 		if (checkAddresses(addrShort,sensor1) && once_sensor1)
 		{
-			printk("Correct sensor found\n");
+			ELOG1(SENSOR_FOUND, 1);
 			once_sensor1 = false;
 			err = bt_conn_le_create(device_info->recv_info->addr,
 									BT_CONN_LE_CREATE_CONN,
-									device_info->conn_param, &centralConnections[nbrConnectionsCentral]);
+									device_info->conn_param, &conn);
 		}
 		else if (checkAddresses(addrShort,sensor2) && once_sensor2 && !once_sensor1)
 		{
-			printk("Correct sensor found\n");
+			ELOG1(SENSOR_FOUND, 2);
 			once_sensor2 = false;
 			err = bt_conn_le_create(device_info->recv_info->addr,
 									BT_CONN_LE_CREATE_CONN,
-									device_info->conn_param, &centralConnections[nbrConnectionsCentral]);
+									device_info->conn_param, &conn);
 		}
 		else if (checkAddresses(addrShort,sensor3) && once_sensor3)
 		{
-			printk("Correct sensor found\n");
+			ELOG1(SENSOR_FOUND, 3);
 			once_sensor3 = false;
 			bt_scan_stop();
 			err = bt_conn_le_create(device_info->recv_info->addr,
 									BT_CONN_LE_CREATE_CONN,
-									device_info->conn_param, &centralConnections[nbrConnectionsCentral]);
+									device_info->conn_param, &conn);
 		}
 		else 
 		{
@@ -580,6 +546,7 @@ void DeviceManager::scanConnectionError(struct bt_scan_device_info *device_info)
 
 void DeviceManager::scanFilterNoMatch(struct bt_scan_device_info *device_info, bool connectable)
 {
+	CpuScope scope(CPU_SUBSYS_SCAN);
 	// not used in this project
 	bt_scan_stop();
 	initScan();
@@ -587,7 +554,23 @@ void DeviceManager::scanFilterNoMatch(struct bt_scan_device_info *device_info, b
 
 void DeviceManager::deviceFound(const bt_addr_le_t *addr, int8_t rssi, uint8_t type, struct net_buf_simple *ad)
 {
-	initScan();
+	CpuScope scope(CPU_SUBSYS_SCAN);
+	static uint32_t configVersion = 0;
+
+	// the scan without filters runs until the application selected its sensors,
+	// the settings are only read again when a new version was published
+	uint32_t version = data_service_config_version();
+	if (version == configVersion)
+	{
+		return;
+	}
+	configVersion = version;
+
+	if (getSensorInfos() != 0)
+	{
+		bt_le_scan_stop();
+		initScan();
+	}
 }
 
 void DeviceManager::connected(struct bt_conn *conn, uint8_t err) 
@@ -599,10 +582,25 @@ void DeviceManager::connected(struct bt_conn *conn, uint8_t err)
 		printk("Cannot get info of connection object\n");
 		return;
 	}
-	if (info.role == BT_CONN_ROLE_MASTER)	// master -> central role
+	if (isCentral && info.role == BT_CONN_ROLE_MASTER)	// master -> central role
 	{
 		char addr[BT_ADDR_LE_STR_LEN];
 
+		if (motion_client_owns(conn))
+		{
+			// Thingy, continue with the missing sensors
+			motion_client_connected(conn, err);
+			if (!err)
+			{
+				link_monitor_connected(conn, TYPE_MOTION);
+			}
+			if (err || nbrConnectionsCentral < getNbrOfAddresses())
+			{
+				startScan();
+			}
+			return;
+		}
+
 		bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
 		if (err) 
@@ -613,16 +611,21 @@ void DeviceManager::connected(struct bt_conn *conn, uint8_t err)
 		}
 
 		printk("Connected: %s\n", addr);
+		sim_report_sensor_connected();
 
-		// save connection at the first free place in the array
-		for (uint8_t i=0; i <= MAX_CONNECTIONS_CENTRAL-1; i++)
+		// context of the sensor from the slab, found by the index of the connection
+		struct sensor_link *sensor;
+		if (k_mem_slab_alloc(&sensorSlab, (void **) &sensor, K_NO_WAIT))
 		{
-			if (centralConnections[i] == nullptr)
-			{
-				centralConnections[i] = bt_conn_ref(conn);
-				break;
-			}		 
+			printk("No context free for %s\n", addr);
+			bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+			bt_conn_unref(conn);
+			return;
 		}
+		sensor->conn = bt_conn_ref(conn);
+		sensor->slot = slotOf(addr);
+		sensor->profile = SENSOR_PROFILE_NONE;
+		sensorOf[bt_conn_index(conn)] = sensor;
 
 		bt_conn_unref(conn);
 		nbrConnectionsCentral++;
@@ -632,71 +635,39 @@ void DeviceManager::connected(struct bt_conn *conn, uint8_t err)
 			cscDisconnected = false;
 		}
 
-		// discover service 
-		switch (sensorInfos)
-		{
-		case 1:
-			discoverCSC();
-			break;
-		case 2:
-			discoverCSC();
-			break;
-		case 3:
-			discoverCSC();
-			break;
-		case 4:
-			if (nbrConnectionsCentral <= 2)
-			{
-				discoverCSC();
-			}
-			else
-			{
-				discoverHR();	
-			}
-			break;
-		case 5:
-			if (nbrConnectionsCentral == 1)
-			{
-				discoverCSC();
-			}
-			else
-			{
-				discoverHR();
-			}
-			break;
-		case 6:
-			if (nbrConnectionsCentral == 1)
-			{
-				discoverCSC();
-			}
-			else
-			{
-				discoverHR();
-			}
-			break;			
-		case 7:
-			discoverHR();
-			break;
-		default:
-			break;
-		}
+		// discover service of the profile of this sensor
+		discover(sensor);
 	}
-	else if (info.role == BT_CONN_ROLE_SLAVE)	// slave -> peripheral role
+	else if (isPeripheral && info.role == BT_CONN_ROLE_SLAVE)	// slave -> peripheral role
 	{
 		if (err) 
 		{
 			printk("Connection failed (err %u)\n", err);
+			adv_manager_connect_failed(err);
+			return;
+		}
+		adv_manager_connected(conn);
+
+		// the reference is released again in disconnected()
+		if (data_service_add_subscriber(conn))
+		{
+			printk("No free application slot\n");
+			bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
 			return;
 		}
-		disconnectOnce = true;
 		connectedPeripheral = true;
-		printk("Connected with application\n");
-		peripheralConn = bt_conn_ref(conn);
-		bt_conn_unref(conn);
+		link_monitor_connected(conn, LINK_TYPE_APP);
+		printk("Connected with application (%d connected)\n", data_service_nbr_subscribers());
 		dk_set_led_on(CON_STATUS_LED_PERIPHERAL);			
 
-		// when its in central and peripheral mode -> begin scanning
-		if (getDevice() == 3 && nbrConnectionsCentral == 0) 
+		// advertising stops with a connection, keep advertising slowly for further applications
+		if (data_service_nbr_subscribers() < CONFIG_APP_MAX_SUBSCRIBERS)
+		{
+			adv_manager_start_slow();
+		}
+
+		// when its in central and peripheral mode -> begin scanning with the first application
+		if (isCentral && nbrConnectionsCentral == 0 && data_service_nbr_subscribers() == 1) 
 		{
 			initScan();
 		}	
@@ -709,6 +680,7 @@ void DeviceManager::disconnected(struct bt_conn *conn, uint8_t reason)
 	uint8_t err = bt_conn_get_info(conn,&info);
 	uint8_t disconnectedCode[1];
 	uint8_t typeToReconnect = 0;
+	uint8_t profileToReconnect = SENSOR_PROFILE_NONE;
 
 	if (err)
 	{
@@ -716,30 +688,68 @@ void DeviceManager::disconnected(struct bt_conn *conn, uint8_t reason)
 		return;
 	}
 
-	if (info.role == BT_CONN_ROLE_SLAVE)	// slave -> peripheral role
+	// the statistics of the link next to the reason
+	link_monitor_disconnected(conn, reason);
+
+	if (isPeripheral && info.role == BT_CONN_ROLE_SLAVE)	// slave -> peripheral role
 	{
-		peripheralDisconnected = true;
-		connectedPeripheral = false;
-		setDiameter(0);
+		data_service_remove_subscriber(conn);
 		printk("Disconnected from Application (reason %u)\n", reason);		
-		dk_set_led_off(CON_STATUS_LED_PERIPHERAL);
-		startAdvertising();
+
+		// reset the application settings only when the last application is gone
+		if (data_service_nbr_subscribers() == 0)
+		{
+			peripheralDisconnected = true;
+			connectedPeripheral = false;
+			setDiameter(0);
+			dk_set_led_off(CON_STATUS_LED_PERIPHERAL);
+		}
+
+		// short directed/fast burst so the application can reconnect quickly
+		adv_manager_disconnected(conn);
+		adv_manager_start(true);
 	}
-	else if (info.role == BT_CONN_ROLE_MASTER)	// master -> central role
+	else if (isCentral && info.role == BT_CONN_ROLE_MASTER && motion_client_owns(conn))
+	{
+		// Thingy, the motion client searches it again
+		motion_client_disconnected(conn, reason);
+	}
+	else if (isCentral && info.role == BT_CONN_ROLE_MASTER)	// master -> central role
 	{
 		char addr[BT_ADDR_LE_STR_LEN];
-		char addrToFind[18];
+		struct sensor_link *sensor = sensorOf[bt_conn_index(conn)];
 		subscriptionDone = false;
 		bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
+		if (sensor == nullptr)
+		{
+			// disconnected by connected(), no context was free
+			return;
+		}
+
+		// the operations of the connection are dropped, the application gets
+		// no message for a sensor without the service of its profile
+		struct gatt_link *link = gatt_link_find(conn);
+		bool serviceNotFound = link != NULL && link->err == -ENOENT;
+		battery_client_remove(sensor->type);
+		gatt_link_close(link);
+
 		printk("Disconnected from Sensor: %s (reason 0x%02x)\n", addr, reason);
+		sim_report_sensor_disconnected();
 		
 		if (checkAddresses(addr,sensor1))
 		{
+			profileToReconnect = sensor_plan(sensorInfos, 0);
 			once_sensor1 = true;
 			subscriptionDone = false;
 			dk_set_led_off(CON_STATUS_LED_CENTRAL);
-			if (sensorInfos == 7)
+			if (profileToReconnect == SENSOR_PROFILE_CPS)
+			{
+				// power meter disconnected, the application has no message for it
+				typeToReconnect = TYPE_POWER;
+				pipeline.resetClock(typeToReconnect);
+			}
+			else if (sensorInfos == 7)
 			{
 				// disconnected from heart rate sensor
 				hrDisconnected = true;
@@ -748,12 +758,8 @@ void DeviceManager::disconnected(struct bt_conn *conn, uint8_t reason)
 				if (!serviceNotFound)	// don't show disconnected message to user when service not found
 				{
 					disconnectedCode[0] = 13;
-					data_service_send(peripheralConn,disconnectedCode, sizeof(disconnectedCode));
+					data_service_send(disconnectedCode, sizeof(disconnectedCode));
 				}
-				else
-				{
-					serviceNotFound = false;
-				}		
 			}
 			else 
 			{
@@ -762,36 +768,31 @@ void DeviceManager::disconnected(struct bt_conn *conn, uint8_t reason)
 					// cadence sensor disconneted
 					cscDisconnected = true;
 					typeToReconnect = TYPE_CSC_CADENCE;
+					pipeline.resetClock(typeToReconnect);
 					if (!serviceNotFound)	// don't show disconnected message to user when service not found
 					{
 						disconnectedCode[0] = 12;
-						data_service_send(peripheralConn,disconnectedCode, sizeof(disconnectedCode));
+						data_service_send(disconnectedCode, sizeof(disconnectedCode));
 					}
-					else
-					{
-						serviceNotFound = false;
-					}						
 				}
 				else
 				{
 					// speed sensor disconnected 
 					cscDisconnected = true;
 					typeToReconnect = TYPE_CSC_SPEED;
+					pipeline.resetClock(typeToReconnect);
 					if (!serviceNotFound)	// don't show disconnected message to user when service not found
 					{
 						disconnectedCode[0] = 11;
-						data_service_send(peripheralConn,disconnectedCode, sizeof(disconnectedCode));
+						data_service_send(disconnectedCode, sizeof(disconnectedCode));
 					}
-					else
-					{
-						serviceNotFound = false;
-					}						
 				}
 			}			
 		}
 
 		if (checkAddresses(addr,sensor2))
 		{
+			profileToReconnect = sensor_plan(sensorInfos, 1);
 			once_sensor2 = true;
 			subscriptionDone = false;
 			dk_set_led_off(CON_STATUS_LED_CENTRAL);
@@ -800,15 +801,12 @@ void DeviceManager::disconnected(struct bt_conn *conn, uint8_t reason)
 				// cadence sensor disconnected
 				cscDisconnected = true;
 				typeToReconnect = TYPE_CSC_CADENCE;
+				pipeline.resetClock(typeToReconnect);
 				if (!serviceNotFound)	// don't show disconnected message to user when service not found
 				{
 					disconnectedCode[0] = 12;
-					data_service_send(peripheralConn,disconnectedCode, sizeof(disconnectedCode));
+					data_service_send(disconnectedCode, sizeof(disconnectedCode));
 				}
-				else
-				{
-					serviceNotFound = false;
-				}			
 			}
 			else
 			{
@@ -818,17 +816,14 @@ void DeviceManager::disconnected(struct bt_conn *conn, uint8_t reason)
 				if (!serviceNotFound)	// don't show disconnected message to user when service not found
 				{
 					disconnectedCode[0] = 13;
-					data_service_send(peripheralConn,disconnectedCode, sizeof(disconnectedCode));
+					data_service_send(disconnectedCode, sizeof(disconnectedCode));
 				}
-				else
-				{
-					serviceNotFound = false;
-				}			
 			}
 		}
 
 		if (checkAddresses(addr,sensor3))
 		{
+			profileToReconnect = sensor_plan(sensorInfos, 2);
 			hrDisconnected = true;
 			reconnectedHeartRate = true;
 			typeToReconnect = TYPE_HEARTRATE;
@@ -838,125 +833,209 @@ void DeviceManager::disconnected(struct bt_conn *conn, uint8_t reason)
 			if (!serviceNotFound)	// don't show disconnected message to user when service not found
 			{
 				disconnectedCode[0] = 13;
-				data_service_send(peripheralConn,disconnectedCode, sizeof(disconnectedCode));
+				data_service_send(disconnectedCode, sizeof(disconnectedCode));
 			}
-			else
-			{
-				serviceNotFound = false;
-			}	
 		}
 
-		// delete the correct connection in the array
-		for (uint8_t i = 0; i <= nbrConnectionsCentral-1; i++)
-		{
-			bt_addr_le_to_str(bt_conn_get_dst(centralConnections[i]), addrToFind, sizeof(addrToFind));
-
-			if (checkAddresses(addr,addrToFind))
-			{
-				bt_conn_unref(centralConnections[i]);
-				centralConnections[i] = nullptr;
-				nbrConnectionsCentral--;
-			}
-		}
+		// return the context of the sensor to the slab
+		sensorOf[bt_conn_index(conn)] = nullptr;
+		bt_conn_unref(sensor->conn);
+		k_mem_slab_free(&sensorSlab, (void **) &sensor);
+		nbrConnectionsCentral--;
 
 		// start scanning again -> search for the same sensor type which has disconnected
-		reScan(typeToReconnect);
+		reScan(profileToReconnect);
 	}
 }
 
 bool DeviceManager::le_param_req(struct bt_conn *conn, struct bt_le_conn_param *param)
 {
-	return true;
+	return link_monitor_param_req(conn, param);
 }
 
 void DeviceManager::le_param_updated(struct bt_conn *conn, uint16_t interval,
 				 uint16_t latency, uint16_t timeout)
-{}
+{
+	link_monitor_params(conn, interval, latency, timeout);
+}
 
-void DeviceManager::discoverCSC()
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+void DeviceManager::le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+	link_monitor_phy(conn, param);
+}
+#endif
+
+void DeviceManager::discover(struct sensor_link *sensor)
 {
 	printk("nbr conn: %d\n", nbrConnectionsCentral);
-	uint8_t err = bt_gatt_dm_start(centralConnections[nbrConnectionsCentral-1], BT_UUID_CSC, &discovery_cb_CSC, NULL);
-	if (err) 
+
+	sensor->profile = sensor_plan(sensorInfos, sensor->slot);
+	sensor->type = sensor_type(sensorInfos, sensor->slot);
+	if (sensor->profile == SENSOR_PROFILE_NONE)
 	{
-		printk("Could not start service discovery, err %d\n", err);
+		printk("No sensor planned in slot %u\n", sensor->slot);
+		bt_conn_disconnect(sensor->conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+		return;
 	}
+	link_monitor_connected(sensor->conn, sensor->type);
+
+	// the last counters of its metric may be of a broadcasting sensor
+	k_mutex_lock(&pipelineLock, K_FOREVER);
+	resetStreams(STREAM_BIT(sensor->type));
+	k_mutex_unlock(&pipelineLock);
+
+	struct gatt_link *link = gatt_link_open(sensor->conn, sensor);
+	if (link == NULL)
+	{
+		// disconnected() frees the context and scans again
+		printk("No GATT link free\n");
+		bt_conn_disconnect(sensor->conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+		return;
+	}
+	SensorProfiles::visit(sensor->profile, DiscoverVisitor{link});
 }
 
-void DeviceManager::discoverHR()
+template <typename P>
+void DeviceManager::DiscoverVisitor::operator()(P profile)
 {
-	uint8_t err = bt_gatt_dm_start(centralConnections[nbrConnectionsCentral-1], BT_UUID_HRS, &discovery_cb_HR, NULL);
+	// the battery level is read while the CCC descriptor is written
+	static const struct gatt_step steps[] =
+	{
+		{ GATT_OP_DISCOVER, 0, serviceUuid<P>, measurementFound<P> },
+		{ GATT_OP_SUBSCRIBE, GATT_STEP_PIPELINED, nullptr, nullptr },
+		{ GATT_OP_DISCOVER, GATT_STEP_OPTIONAL, batteryUuid, batteryFound },
+		{ GATT_OP_READ, GATT_STEP_OPTIONAL, nullptr, batteryRead },
+	};
+	uint8_t nbrSteps = batteryManaged(sensorInfos) && P::id != SENSOR_PROFILE_CPS ? ARRAY_SIZE(steps) : 2;
+
+	int err = gatt_link_run(link, steps, nbrSteps, linkFinished<P>);
 	if (err) 
 	{
 		printk("Could not start service discovery, err %d\n", err);
 	}
 }
 
-void DeviceManager::discoveryCompletedCSC(struct bt_gatt_dm *dm, void *ctx) 
+template <typename P>
+int DeviceManager::measurementFound(struct gatt_link *link, struct bt_gatt_dm *dm)
 {
-	uint8_t err;
-	uint8_t connectedCode[1];
-	if (!subscriptionDone)
-	{	
-		subscribe_params[nbrConnectionsCentral-1].value = BT_GATT_CCC_NOTIFY;
-		subscribe_params[nbrConnectionsCentral-1].notify = onReceived;
+	const struct bt_gatt_dm_attr *chrc;
+	const struct bt_gatt_dm_attr *desc;
+	struct bt_gatt_subscribe_params *params = &link->subscribe;
 
-		const struct bt_gatt_dm_attr *chrc;
-		const struct bt_gatt_dm_attr *desc;
+	printk("The %s discovery procedure succeeded\n", P::name);
 
-		// Get the characteristic by its UUID
-		chrc = bt_gatt_dm_char_by_uuid(dm,BT_UUID_CSC_MEASUREMENT);
-		if (!chrc) 
-		{
-			printk("Missing CSC measurement characteristic\n");
-			err = bt_gatt_dm_data_release(dm);
-			if (err) 
-			{
-				printk("Could not release discovery data, err: %d\n", err);
-			}
-			return;
-		}
+	// Get the characteristic by its UUID
+	chrc = bt_gatt_dm_char_by_uuid(dm, measurementUuid<P>());
+	if (!chrc) 
+	{
+		printk("Missing %s measurement characteristic\n", P::name);
+		return -EINVAL;
+	}
+	// Search the descriptor by its UUID
+	desc = bt_gatt_dm_desc_by_uuid(dm, chrc, measurementUuid<P>());
+	if (!desc)
+	{
+		printk("Missing %s measurement characteristic value\n", P::name);
+		return -EINVAL;
+	}
+	params->value_handle = desc->handle;
 
-		// Search the descriptor by its UUID
-		desc = bt_gatt_dm_desc_by_uuid(dm, chrc, BT_UUID_CSC_MEASUREMENT);
-		if (!desc) 
-		{
-			printk("Missing CSC measurement char CCC descriptor\n");
-			err = bt_gatt_dm_data_release(dm);
-			if (err) 
-			{
-				printk("Could not release discovery data, err: %d\n", err);
-			}
-			return;
-		}
+	// Search the CCC descriptor by its UUID
+	desc = bt_gatt_dm_desc_by_uuid(dm, chrc, BT_UUID_GATT_CCC);
+	if (!desc) 
+	{
+		printk("Missing %s measurement char CCC descriptor\n", P::name);
+		return -EINVAL;
+	}
+	params->notify = notify<P>;
+	params->value = BT_GATT_CCC_NOTIFY;
+	params->ccc_handle = desc->handle;
+	return 0;
+}
 
-		subscribe_params[nbrConnectionsCentral-1].value_handle = desc->handle;
+const struct bt_uuid *DeviceManager::batteryUuid()
+{
+	return BT_UUID_BAS;
+}
 
-		// Search the CCC descriptor by its UUID
-		desc = bt_gatt_dm_desc_by_uuid(dm, chrc, BT_UUID_GATT_CCC);
-		if (!desc) 
-		{
-			printk("Missing CSC measurement char CCC descriptor\n");
-			err = bt_gatt_dm_data_release(dm);
-			if (err) 
-			{
-				printk("Could not release discovery data, err: %d\n", err);
-			}
-			return;
-		}
+int DeviceManager::batteryFound(struct gatt_link *link, struct bt_gatt_dm *dm)
+{
+	const struct bt_gatt_dm_attr *chrc;
+	const struct bt_gatt_dm_attr *desc;
+	struct sensor_link *sensor = (struct sensor_link *) link->context;
 
-		subscribe_params[nbrConnectionsCentral-1].ccc_handle = desc->handle;
-		
-		// Subscribe attribute value notification
-		err = bt_gatt_subscribe(bt_gatt_dm_conn_get(dm), &subscribe_params[nbrConnectionsCentral-1]);
-		if (err) 
-		{
-			printk("Subscription failed (err %d)\n", err);
-		}
+	chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_BAS_BATTERY_LEVEL);
+	if (!chrc)
+	{
+		printk("Missing battery level characteristic\n");
+		return -EINVAL;
+	}
+	desc = bt_gatt_dm_desc_by_uuid(dm, chrc, BT_UUID_BAS_BATTERY_LEVEL);
+	if (!desc)
+	{
+		printk("Missing battery level characteristic value\n");
+		return -EINVAL;
+	}
+	link->readHandle = desc->handle;
+	ELOG1(BATTERY_DISCOVERY, nbrConnectionsCentral);
 
-		bt_gatt_dm_data_release(dm);
+	// the client of the BatteryManager takes the handles for the later reads
+	return battery_client_assign(sensor->type, dm);
+}
+
+int DeviceManager::batteryRead(struct gatt_link *link, struct bt_gatt_dm *dm)
+{
+	struct sensor_link *sensor = (struct sensor_link *) link->context;
+
+	battery_level_set(sensor->type, link->readData[0]);
+	return 0;
+}
+
+template <typename P>
+void DeviceManager::linkFinished(struct gatt_link *link, int err)
+{
+	if (err == -ENOENT)
+	{
+		printk("Service not found!\n");
+		uint8_t error[1];
+		error[0] = 10;
+		data_service_send(error, sizeof(error));
+		// reconnect for another try
+		bt_conn_disconnect(link->conn, 100);
 	}
-	
+	else if (err)
+	{
+		printk("Subscription failed (err %d)\n", err);
+	}
+	else
+	{
+		printk("[SUBSCRIBED] %s\n", P::name);
+		subscribed<P>();
+	}
+}
+
+template <typename P>
+void DeviceManager::subscribed()
+{
+	if (nbrConnectionsCentral < nbrAddresses)
+	{
+		// continue with the next sensor of the sensor infos
+		initScan();
+	}
+	else
+	{
+		printk("Discovery completed\n");
+		subscriptionDone = true;
+		dk_set_led_on(CON_STATUS_LED_CENTRAL);
+	}
+}
+
+template <>
+void DeviceManager::subscribed<CscProfile>()
+{
+	uint8_t connectedCode[1];
+
 	// check number of connections -> can be modified for more devices
 	// send message code to client
 	switch (nbrConnectionsCentral)
@@ -968,7 +1047,7 @@ void DeviceManager::discoveryCompletedCSC(struct bt_gatt_dm *dm, void *ctx)
 			subscriptionDone = true;
 			dk_set_led_on(CON_STATUS_LED_CENTRAL);
 			connectedCode[0] = 14;
-			data_service_send(peripheralConn,connectedCode, sizeof(connectedCode));
+			data_service_send(connectedCode, sizeof(connectedCode));
 		}
 		else if (nbrAddresses == 1 && sensorInfos == 2)
 		{
@@ -976,27 +1055,27 @@ void DeviceManager::discoveryCompletedCSC(struct bt_gatt_dm *dm, void *ctx)
 			subscriptionDone = true;
 			dk_set_led_on(CON_STATUS_LED_CENTRAL);
 			connectedCode[0] = 15;
-			data_service_send(peripheralConn,connectedCode, sizeof(connectedCode));
+			data_service_send(connectedCode, sizeof(connectedCode));
 		}
 		else if (nbrAddresses == 2 && (sensorInfos == 3 || sensorInfos == 5))	
 		{
 			printk("First discovery completed\n");
 			connectedCode[0] = 17;	// speed connected
-			data_service_send(peripheralConn,connectedCode, sizeof(connectedCode));
+			data_service_send(connectedCode, sizeof(connectedCode));
 			initScan();				
 		}
 		else if (nbrAddresses == 2 && sensorInfos == 6)
 		{
 			printk("First discovery completed\n");
 			connectedCode[0] = 18;	// cadence connected
-			data_service_send(peripheralConn,connectedCode, sizeof(connectedCode));
+			data_service_send(connectedCode, sizeof(connectedCode));
 			initScan();				
 		}
 		else if (nbrAddresses == 3)
 		{
 			printk("First discovery completed\n");	
 			connectedCode[0] = 17; // speed sensor connected
-			data_service_send(peripheralConn,connectedCode, sizeof(connectedCode));
+			data_service_send(connectedCode, sizeof(connectedCode));
 			initScan();
 		}
 		break;
@@ -1005,7 +1084,7 @@ void DeviceManager::discoveryCompletedCSC(struct bt_gatt_dm *dm, void *ctx)
 		{
 			printk("Second discovery completed\n");
 			connectedCode[0] = 19;	// cadence sensor connected
-			data_service_send(peripheralConn, connectedCode, sizeof(connectedCode));
+			data_service_send(connectedCode, sizeof(connectedCode));
 			dk_set_led_on(CON_STATUS_LED_CENTRAL);
 			subscriptionDone = true;
 		}	
@@ -1013,7 +1092,7 @@ void DeviceManager::discoveryCompletedCSC(struct bt_gatt_dm *dm, void *ctx)
 		{
 			printk("Second discovery completed\n");	
 			connectedCode[0] = 21;	// cadence sensor connected
-			data_service_send(peripheralConn,connectedCode, sizeof(connectedCode));
+			data_service_send(connectedCode, sizeof(connectedCode));
 			initScan();
 		}
 		break;
@@ -1022,89 +1101,10 @@ void DeviceManager::discoveryCompletedCSC(struct bt_gatt_dm *dm, void *ctx)
 	}
 }
 
-void DeviceManager::discovery_service_not_found(struct bt_conn *conn, void *ctx) 
-{
-	printk("Service not found!\n");
-	serviceNotFound = true;
-	uint8_t error[1];
-	error[0] = 10;
-	data_service_send(peripheralConn,error, sizeof(error));
-	// reconnect for another try
-	bt_conn_disconnect(conn,100);
-}
-
-void DeviceManager::discovery_error_found(struct bt_conn *conn, int err, void *ctx)
-{
-	printk("The discovery procedure failed, err %d\n", err);
-}
-
-
-void DeviceManager::discoveryCompletedHR(struct bt_gatt_dm *dm, void *ctx) 
+template <>
+void DeviceManager::subscribed<HeartRateProfile>()
 {
 	uint8_t connectedCode[1];
-	uint8_t err;
-
-	const struct bt_gatt_dm_attr *gatt_chrc;
-	const struct bt_gatt_dm_attr *gatt_desc;
-
-	struct bt_conn *conn = bt_gatt_dm_conn_get(dm);
-
-	printk("The discovery procedure succeeded\n");
-
-	bt_gatt_dm_data_print(dm);
-
-	// Get the characteristic by its UUID
-	gatt_chrc = bt_gatt_dm_char_by_uuid(dm, BT_UUID_HRS_MEASUREMENT);
-
-	if (!gatt_chrc) 
-	{
-		printk("No heart rate measurement characteristic found\n");
-		return;
-	}
-
-	// Search the descriptor by its UUID
-	gatt_desc = bt_gatt_dm_desc_by_uuid(dm, gatt_chrc, BT_UUID_HRS_MEASUREMENT);
-
-	if (!gatt_desc) 
-	{
-		printk("No heat rate measurement characteristic value found\n");
-		return;
-	}
-
-	subscribe_params[nbrConnectionsCentral-1].value_handle = gatt_desc->handle;
-
-	// Search the CCC descriptor by its UUID
-	gatt_desc = bt_gatt_dm_desc_by_uuid(dm, gatt_chrc,
-			BT_UUID_GATT_CCC);
-
-	if (!gatt_desc) 
-	{
-		printk("No heart rate CCC descriptor found. "
-		       "Heart rate service does not support notifications. \n");
-		return;
-	}
-
-	subscribe_params[nbrConnectionsCentral-1].notify = notify_HR;
-	subscribe_params[nbrConnectionsCentral-1].value = BT_GATT_CCC_NOTIFY;
-	subscribe_params[nbrConnectionsCentral-1].ccc_handle = gatt_desc->handle;
-
-	// Subscribe attribute value notification
-	err = bt_gatt_subscribe(conn, &subscribe_params[nbrConnectionsCentral-1]);
-
-	if (err && err != -EALREADY) 
-	{
-		printk("Subscribe failed (err %d)\n", err);
-	} 
-	else 
-	{
-		printk("[SUBSCRIBED]\n");
-	}
-
-	err = bt_gatt_dm_data_release(dm);
-	if (err) 
-	{
-		printk("Could not release the discovery data (err %d)\n", err);
-	}
 
 	subscriptionDone = true;
 
@@ -1114,7 +1114,7 @@ void DeviceManager::discoveryCompletedHR(struct bt_gatt_dm *dm, void *ctx)
 	case 1:
 		dk_set_led_on(CON_STATUS_LED_CENTRAL);
 		connectedCode[0] = 16;
-		data_service_send(peripheralConn,connectedCode, sizeof(connectedCode));
+		data_service_send(connectedCode, sizeof(connectedCode));
 		printk("Discovery completed\n");
 		break;
 	case 2:
@@ -1124,7 +1124,7 @@ void DeviceManager::discoveryCompletedHR(struct bt_gatt_dm *dm, void *ctx)
 		{
 			if (reconnectedHeartRate)
 			{
-				if (batterySubscriptionDone)
+				if (battery_client_ready(TYPE_HEARTRATE))
 				{
 					reconnectedHeartRate = false;
 					connectedCode[0] = 24;
@@ -1140,13 +1140,13 @@ void DeviceManager::discoveryCompletedHR(struct bt_gatt_dm *dm, void *ctx)
 				connectedCode[0] = 22;	
 			}
 			
-			data_service_send(peripheralConn,connectedCode, sizeof(connectedCode));
+			data_service_send(connectedCode, sizeof(connectedCode));
 		}
 		else if (sensorInfos == 6)
 		{
 			if (reconnectedHeartRate)
 			{
-				if (batterySubscriptionDone)
+				if (battery_client_ready(TYPE_HEARTRATE))
 				{
 					reconnectedHeartRate = false;
 					connectedCode[0] = 24;
@@ -1162,13 +1162,13 @@ void DeviceManager::discoveryCompletedHR(struct bt_gatt_dm *dm, void *ctx)
 				connectedCode[0] = 20;
 			}
 
-			data_service_send(peripheralConn,connectedCode, sizeof(connectedCode));
+			data_service_send(connectedCode, sizeof(connectedCode));
 		}
 		break;
 	case 3:
 		if (reconnectedHeartRate)
 		{
-			if (batterySubscriptionDone)
+			if (battery_client_ready(TYPE_HEARTRATE))
 			{
 				reconnectedHeartRate = false;
 				connectedCode[0] = 24;
@@ -1184,7 +1184,7 @@ void DeviceManager::discoveryCompletedHR(struct bt_gatt_dm *dm, void *ctx)
 			connectedCode[0] = 23;
 		}
 
-		data_service_send(peripheralConn,connectedCode, sizeof(connectedCode));
+		data_service_send(connectedCode, sizeof(connectedCode));
 		printk("Third discovery completed\n");
 		dk_set_led_on(CON_STATUS_LED_CENTRAL);
 		break;
@@ -1194,303 +1194,511 @@ void DeviceManager::discoveryCompletedHR(struct bt_gatt_dm *dm, void *ctx)
 	dk_set_led_on(CON_STATUS_LED_CENTRAL);
 }
 
-uint8_t DeviceManager::onReceived(struct bt_conn *conn,
+template <>
+uint8_t DeviceManager::notify<CscProfile>(struct bt_conn *conn,
 			struct bt_gatt_subscribe_params *params,
 			const void *data, uint16_t length) 
 {
 	// local variables 
 	uint8_t batteryLevelToSend[4];
-	static uint8_t cntFirstSpeed = 0;
-	static uint8_t cntFirstCadence = 0;
-	static uint8_t cntNbrReceived1 = 0;
-	static uint8_t cntNbrReceived2 = 0;
-	static uint8_t cntForDiscover = 0;
-	static uint8_t cntZerosSpeed = 0;
-	static uint8_t cntZerosCadence = 0;
-	uint8_t err = 0;
+	bool processed = false;
+	uint16_t streams = wantedStreams();
+	struct latency_stamps stamps;
+	stamps.received = latency_now();
+
+	// every measurement of the sensor for the gaps of the link, also before its subscription is done
+	if (data != nullptr)
+	{
+		link_monitor_csc(conn, (const uint8_t *) data, length, boardTimeUs());
+	}
 		
 	// start calculating and showing data only when all characteristics are subscribed
-	if (subscriptionDone)
+	// and an application shows speed or cadence,
+	// the battery service is discovered with the connection of the sensor (GattOps)
+	if (subscriptionDone && (streams & CscProfile::streams))
 	{
-		if (!batterySubscriptionDone)
-		{			
-			if (cntBatterySubscriptions == nbrConnectionsCentral)
+		if (length > 0)
+		{
+			// when a sensor disconnects, ask for battery level
+			if (cscDisconnected)
 			{
-				batterySubscriptionDone = true;
+				batteryRestart(TYPE_CSC_SPEED);
+				batteryRestart(TYPE_CSC_CADENCE);
 			}
-			else 
+
+			// when application disconnects and reconnects, ask for battery level
+			if (peripheralDisconnected && connectedPeripheral)
 			{
-				if (isFree())
-				{
-					initBatteryManager(sensorInfos);
-					err = gatt_discover_battery_service(centralConnections[cntBatterySubscriptions]);	
-					
-					printk("Nbr connections %d\n", cntBatterySubscriptions);
+				peripheralDisconnected = false;
+				batteryRestart(TYPE_CSC_SPEED);
+				batteryRestart(TYPE_CSC_CADENCE);
+				batteryRestart(TYPE_HEARTRATE);
+			}
 
-					if (err == 0)
-					{
-						cntBatterySubscriptions++;
-					}
-				}
+			// compute the speed or the cadence, the values are sent in pipelineOutput()
+			k_mutex_lock(&pipelineLock, K_FOREVER);
+			currentStamps = &stamps;
+			uint32_t cycles = cpu_stats_begin();
+			updatePipelineConfig();
+			uint8_t type = CscProfile::process(pipeline, data, length, boardTimeUs());
+			processed = true;
+			scheduleDeadline();
+			cpu_stats_end(CPU_SUBSYS_CSC, cycles);
+			currentStamps = nullptr;
+			k_mutex_unlock(&pipelineLock);
+			sim_report_rx(type);
+
+			if (!(streams & STREAM_BIT(TYPE_BATTERY)))
+			{
+				// no battery level shown, asked again when an application wants it
+				batteryRestart(TYPE_CSC_SPEED);
+				batteryRestart(TYPE_CSC_CADENCE);
 			}
-		}
-		else if (!serviceFound())
-		{
-			cntBatterySubscriptions--;
-			batterySubscriptionDone = false;
-		}
-		else
-		{
-			if (length > 0)
+			else if (type == TYPE_CSC_SPEED)
 			{
-				// when a sensor disconnects, ask for battery level
-				if (cscDisconnected)
+				// ask at the beginning and every BATTERY_READ_PERIOD_MS for the battery level
+				cycles = cpu_stats_begin();
+				if (isValueReady(TYPE_CSC_SPEED))
 				{
-					cntFirstSpeed = 0;
-					cntFirstCadence = 0;			
+					// send new battery level to client
+					resetReadyValue(TYPE_CSC_SPEED);
+					DeviceManager::data.battValue_speed = getBatteryLevel(TYPE_CSC_SPEED);
+					batteryLevelToSend[0] = TYPE_BATTERY;
+					batteryLevelToSend[1] = TYPE_CSC_SPEED;
+					batteryLevelToSend[2] = DeviceManager::data.battValue_speed;
+					broadcast_set_battery(TYPE_CSC_SPEED, DeviceManager::data.battValue_speed);
+					data_service_send(batteryLevelToSend,sizeof(batteryLevelToSend));				
 				}
-
-				// when application disconnects and reconnects, ask for battery level
-				if (peripheralDisconnected && connectedPeripheral)
-				{
-					peripheralDisconnected = false;
-					cntFirstSpeed = 0;
-					cntFirstCadence = 0;
-					cntFirstHR = 0;
-				}
-				
-				// check if notifications are on, when no, disconnect from application -> so the user can reconnect
-				if (!areNotificationsOn() && disconnectOnce)
+				else if (batteryDue(TYPE_CSC_SPEED))
 				{
-					disconnectOnce = false;
-					bt_conn_disconnect(peripheralConn,1);
+					askForBatteryLevel(TYPE_CSC_SPEED);
 				}
-
-				// save the new received data
-				DeviceManager::data.saveData(data);
-
-				uint8_t val_after_comma;
-				uint8_t dataToSend[3];
-
-				if (getDiameter() != 0 && diameterSet == false)
-				{
-					diameterSet = true;
-					DeviceManager::data.wheelDiameter = getDiameter();
-				}
-				else if (getDiameter() == 0 && diameterSet == true)
-				{
-					// reset button was pressed
-					diameterSet = false;
-				}
-				
-				if (DeviceManager::data.type == TYPE_CSC_SPEED)
+				cpu_stats_end(CPU_SUBSYS_BATTERY, cycles);
+			}
+			else if (type == TYPE_CSC_CADENCE)
+			{
+				// ask at the beginning and every BATTERY_READ_PERIOD_MS for the battery level
+				cycles = cpu_stats_begin();
+				if (isValueReady(TYPE_CSC_CADENCE))
 				{
-					// calculate speed
-					if (diameterSet)
-					{						
-						uint16_t speed = DeviceManager::data.calcSpeed();
-						if (speed == 0)
-						{
-							cntZerosSpeed++;
-						}
-						else
-						{
-							cntZerosSpeed = 0;
-						}
-
-						if (speed > 0 || cntZerosSpeed >= 3)	// when 3 times speed is 0, bike is not running any more
-						{
-							// 1. value: type -> speed
-							// 2. value: 8 bit on the left side of comma
-							// 3. value: 8 bit on the right side of comma
-							dataToSend[0] = TYPE_CSC_SPEED;
-							dataToSend[1] = (uint8_t) (speed/100);	
-							val_after_comma = (uint8_t) (speed);
-							dataToSend[2] = val_after_comma;
-
-							if (peripheralConn != nullptr)
-							{	
-								printk("Speed: %d\n",speed/100);
-								data_service_send(peripheralConn,dataToSend, sizeof(dataToSend));
-							}
-						}
-					}
-
-					// ask from at the beginning and time to time for the battery level
-					if (cntFirstSpeed == 2 || cntNbrReceived1 == 50)
-					{
-						cntNbrReceived1 = 0;
-						askForBatteryLevel(TYPE_CSC_SPEED);
-						cntFirstSpeed++;
-					}
-					else if (isValueReady(TYPE_CSC_SPEED))
-					{
-						// send new battery level to client
-						resetReadyValue(TYPE_CSC_SPEED);
-						DeviceManager::data.battValue_speed = getBatteryLevel(TYPE_CSC_SPEED);
-						batteryLevelToSend[0] = TYPE_BATTERY;
-						batteryLevelToSend[1] = TYPE_CSC_SPEED;
-						batteryLevelToSend[2] = DeviceManager::data.battValue_speed;
-						data_service_send(peripheralConn,batteryLevelToSend,sizeof(batteryLevelToSend));				
-					}
-					else
-					{
-						cntNbrReceived1++;
-						cntFirstSpeed++;
-					}		
+					// send new battery level to client
+					resetReadyValue(TYPE_CSC_CADENCE);
+					DeviceManager::data.battValue_cadence = getBatteryLevel(TYPE_CSC_CADENCE);
+					batteryLevelToSend[0] = TYPE_BATTERY;
+					batteryLevelToSend[1] = TYPE_CSC_CADENCE;	
+					batteryLevelToSend[2] = DeviceManager::data.battValue_cadence;
+					broadcast_set_battery(TYPE_CSC_CADENCE, DeviceManager::data.battValue_cadence);
+					data_service_send(batteryLevelToSend,sizeof(batteryLevelToSend));			
 				}
-				else if (DeviceManager::data.type == TYPE_CSC_CADENCE)
+				else if (batteryDue(TYPE_CSC_CADENCE))
 				{
-					// calculate rpm (rounds per minute)
-					uint16_t rpm = DeviceManager::data.calcRPM();
-					if (rpm == 0)
-					{	
-						cntZerosCadence++;
-					}
-					else
-					{
-						cntZerosCadence = 0;
-					}
-					
-					if (rpm > 0 || cntZerosCadence >= 3)	// when 3 times speed is 0, bike is not running any more
-					{			
-						if (rpm < 500)
-						{
-							// 1. value: type -> cadence
-							// 2. value: 8 lsb of cadence value
-							// 3. value: 8 msb of cadence value					
-							dataToSend[0] = TYPE_CSC_CADENCE;	
-							dataToSend[1] = (uint8_t) rpm;
-							dataToSend[2] = (uint8_t) (rpm >> 8);	
-							if (peripheralConn != nullptr)
-							{
-								printk("Cadence rpm: %d\n",rpm);
-								data_service_send(peripheralConn,dataToSend, sizeof(dataToSend));
-							}
-						}
-					}	
-
-					// ask from time to time for the battery level
-					if (cntFirstCadence == 3 || cntNbrReceived2 == 100)
-					{
-						askForBatteryLevel(TYPE_CSC_CADENCE);
-						cntNbrReceived2 = 0;
-						cntFirstCadence++;
-					}
-					else if (isValueReady(TYPE_CSC_CADENCE))
-					{
-						// send new battery level to client
-						resetReadyValue(TYPE_CSC_CADENCE);
-						DeviceManager::data.battValue_cadence = getBatteryLevel(TYPE_CSC_CADENCE);
-						batteryLevelToSend[0] = TYPE_BATTERY;
-						batteryLevelToSend[1] = TYPE_CSC_CADENCE;	
-						batteryLevelToSend[2] = DeviceManager::data.battValue_cadence;
-						data_service_send(peripheralConn,batteryLevelToSend,sizeof(batteryLevelToSend));			
-					}
-					else 
-					{
-						cntFirstCadence++;
-						cntNbrReceived2++;
-					}					
+					askForBatteryLevel(TYPE_CSC_CADENCE);
 				}
+				cpu_stats_end(CPU_SUBSYS_BATTERY, cycles);
 			}
 		}
 	}
 	else
 	{
-		cntFirstSpeed = 0;
-		cntFirstCadence = 0;		
+		batteryRestart(TYPE_CSC_SPEED);
+		batteryRestart(TYPE_CSC_CADENCE);
+	}
+
+	if (data != nullptr)
+	{
+		trace_record(processed ? CscProfile::traceKind : CscProfile::traceKind | TRACE_KIND_SKIPPED, k_cycle_get_32(),
+					 bt_conn_index(conn), params->value_handle, data, length);
 	}
 
 	return BT_GATT_ITER_CONTINUE;
 }
 
-uint8_t DeviceManager::notify_HR(struct bt_conn *conn,
+template <>
+uint8_t DeviceManager::notify<HeartRateProfile>(struct bt_conn *conn,
 		struct bt_gatt_subscribe_params *params,
 		const void *data, uint16_t length) 
 {
 	// local variables
-	uint8_t err = 0;
-	static bool onceHeartRate = true;
-	static uint16_t cntNbrReceived = 0;	
-	uint8_t dataToSend[2];
+	bool processed = false;
+	uint16_t streams = wantedStreams();
 	uint8_t batteryLevelToSend[4];
-	dataToSend[0] = TYPE_HEARTRATE;
+	struct latency_stamps stamps;
+	stamps.received = latency_now();
 	batteryLevelToSend[0] = TYPE_BATTERY;
 	batteryLevelToSend[1] = TYPE_HEARTRATE;
 
-	if (sensorInfos == 7)
+	if (data != nullptr)
 	{
-		if (onceHeartRate || (peripheralDisconnected && connectedPeripheral))
-		{
-			cntFirstHR = 0;
-			peripheralDisconnected = false;
-			onceHeartRate = false;
-			initBatteryManager(sensorInfos);
-			err = gatt_discover_battery_service(centralConnections[cntBatterySubscriptions]);	
-			if (err == 0)
-			{
-				batterySubscriptionDone = true;
-			}			
-		}	
+		link_monitor_notified(conn, boardTimeUs());
+	}
+
+	// the battery service is discovered with the connection of the sensor (GattOps),
+	// without speed or cadence sensor the reconnection of the application is handled here
+	if (sensorInfos == 7 && peripheralDisconnected && connectedPeripheral)
+	{
+		batteryRestart(TYPE_HEARTRATE);
+		peripheralDisconnected = false;
 	}
 
 	if (hrDisconnected)
 	{
 		hrDisconnected = false;
-		cntFirstHR = 0;
+		batteryRestart(TYPE_HEARTRATE);
 	}
 	
-	if (batterySubscriptionDone)
+	if (battery_client_ready(TYPE_HEARTRATE) && (streams & STREAM_BIT(TYPE_BATTERY)))
 	{
-		// ask from time to time for the battery level
-		if (cntFirstHR == 2 || cntNbrReceived == 300)
-		{
-			cntFirstHR++;
-			cntNbrReceived++;
-			askForBatteryLevel(TYPE_HEARTRATE);
-		}
-		else if (isValueReady(TYPE_HEARTRATE))
+		// ask at the beginning and every BATTERY_READ_PERIOD_MS for the battery level
+		uint32_t cycles = cpu_stats_begin();
+		if (isValueReady(TYPE_HEARTRATE))
 		{
 			// send new battery level to client
 			resetReadyValue(TYPE_HEARTRATE);
-			cntNbrReceived = 0;
-			cntFirstHR++;
 			DeviceManager::data.battValue_heartRate = getBatteryLevel(TYPE_HEARTRATE);
 			batteryLevelToSend[2] = DeviceManager::data.battValue_heartRate;
-			data_service_send(peripheralConn,batteryLevelToSend,sizeof(batteryLevelToSend));
+			broadcast_set_battery(TYPE_HEARTRATE, DeviceManager::data.battValue_heartRate);
+			data_service_send(batteryLevelToSend,sizeof(batteryLevelToSend));
+		}
+		else if (batteryDue(TYPE_HEARTRATE))
+		{
+			askForBatteryLevel(TYPE_HEARTRATE);
+		}
+		cpu_stats_end(CPU_SUBSYS_BATTERY, cycles);
+	}
+	else
+	{
+		batteryRestart(TYPE_HEARTRATE);
+	}
+
+	if (!data && gatt_link_of(params)->ready)
+	{
+		ELOG0(HR_UNSUBSCRIBED);
+		params->value_handle = 0U;
+		return BT_GATT_ITER_STOP;
+	}
+
+	// the values are processed when the connection sequence of the sensor is completed
+	// and an application shows the heart rate or its variability
+	if (data != nullptr && gatt_link_of(params)->ready && (streams & HeartRateProfile::streams))
+	{
+		// the value is sent in pipelineOutput()
+		CpuScope scope(CPU_SUBSYS_HEARTRATE);
+		k_mutex_lock(&pipelineLock, K_FOREVER);
+		currentStamps = &stamps;
+		processed = true;
+		uint8_t type = HeartRateProfile::process(pipeline, data, length, boardTimeUs());
+		scheduleDeadline();
+		if (type)
+		{
+			sim_report_rx(type);
 		}
 		else
 		{
-			cntFirstHR++;
-			cntNbrReceived++;
-		}	
+			ELOG1(HR_UNKNOWN_FORMAT, length);
+		}
+		currentStamps = nullptr;
+		k_mutex_unlock(&pipelineLock);
+	}
 
-		if (!data) {
-			printk("[UNSUBSCRIBED]\n");
-			params->value_handle = 0U;
-			return BT_GATT_ITER_STOP;
+	if (data != nullptr)
+	{
+		trace_record(processed ? HeartRateProfile::traceKind : HeartRateProfile::traceKind | TRACE_KIND_SKIPPED, k_cycle_get_32(),
+					 bt_conn_index(conn), params->value_handle, data, length);
+	}
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+template <typename P>
+uint8_t DeviceManager::notify(struct bt_conn *conn,
+		struct bt_gatt_subscribe_params *params,
+		const void *data, uint16_t length) 
+{
+	struct latency_stamps stamps;
+	stamps.received = latency_now();
+
+	if (!data)
+	{
+		printk("%s unsubscribed\n", P::name);
+		params->value_handle = 0U;
+		return BT_GATT_ITER_STOP;
+	}
+	link_monitor_notified(conn, boardTimeUs());
+
+	// the values are sent in pipelineOutput(), only processed when an application shows them
+	uint8_t type = 0;
+	if (wantedStreams() & P::streams)
+	{
+		CpuScope scope(CPU_SUBSYS_POWER);
+		k_mutex_lock(&pipelineLock, K_FOREVER);
+		currentStamps = &stamps;
+		updatePipelineConfig();
+		type = P::process(pipeline, data, length, boardTimeUs());
+		scheduleDeadline();
+		currentStamps = nullptr;
+		k_mutex_unlock(&pipelineLock);
+	}
+	if (type)
+	{
+		sim_report_rx(type);
+	}
+
+	trace_record(type ? P::traceKind : P::traceKind | TRACE_KIND_SKIPPED, k_cycle_get_32(),
+				 bt_conn_index(conn), params->value_handle, data, length);
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+uint64_t DeviceManager::boardTimeUs()
+{
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+void DeviceManager::updatePipelineConfig()
+{
+	if (data_service_config_version() != pipelineConfigVersion)
+	{
+		struct app_config config;
+
+		pipelineConfigVersion = data_service_config(&config);
+		pipeline.setDiameter(SensorPipeline::diameterFromCode(config.diameterCode));
+	}
+
+	// the last events of a metric not processed for a while are too old for a rate
+	uint16_t streams = wantedStreams();
+	uint16_t resumed = streams & ~pipelineStreams;
+	uint16_t stopped = pipelineStreams & ~streams;
+	pipelineStreams = streams;
+	resetStreams(resumed);
+
+	// the notifications of a metric not processed do not reach its watch
+	static const uint8_t watched[] = {TYPE_CSC_SPEED, TYPE_CSC_CADENCE, TYPE_POWER};
+	for (uint8_t i = 0; i < ARRAY_SIZE(watched); i++)
+	{
+		if (stopped & STREAM_BIT(watched[i]))
+		{
+			pipeline.stopWatch(watched[i]);
 		}
+	}
+	uint16_t heartRate = SensorProfiles::streamsOf(SENSOR_PROFILE_HRS);
+	if ((stopped & heartRate) && !(streams & heartRate))
+	{
+		pipeline.stopWatch(TYPE_HEARTRATE);
+	}
+}
 
-		if (length == 2)
+void DeviceManager::resetStreams(uint16_t streams)
+{
+	if (streams & STREAM_BIT(TYPE_CSC_SPEED))
+	{
+		pipeline.resetClock(TYPE_CSC_SPEED);
+	}
+	if (streams & STREAM_BIT(TYPE_CSC_CADENCE))
+	{
+		pipeline.resetClock(TYPE_CSC_CADENCE);
+	}
+	if (streams & STREAM_BIT(TYPE_POWER))
+	{
+		pipeline.resetClock(TYPE_POWER);
+	}
+}
+
+bool DeviceManager::profileConnected(uint8_t profile)
+{
+	for (uint8_t i = 0; i < ARRAY_SIZE(sensorOf); i++)
+	{
+		if (sensorOf[i] != nullptr && sensorOf[i]->profile == profile)
 		{
-				uint8_t hr_bpm = ((uint8_t *)data)[1];
-				DeviceManager::data.heartRate = hr_bpm;
-				dataToSend[1] = hr_bpm;
-				printk("[NOTIFICATION] Heart Rate %u bpm\n", hr_bpm);
-				data_service_send(peripheralConn,dataToSend,sizeof(dataToSend));
-		} 
-		else 
+			return true;
+		}
+	}
+	return false;
+}
+
+void DeviceManager::ingestMeasurement(uint8_t profile, const uint8_t *data, uint8_t length, uint8_t sensor,
+									 bool resync)
+{
+	struct latency_stamps stamps;
+	stamps.received = latency_now();
+
+	// the values are sent in pipelineOutput(), only processed when an application shows them,
+	// a connected sensor of the profile feeds the same counters of the pipeline
+	uint8_t type = 0;
+	if ((wantedStreams() & SensorProfiles::streamsOf(profile)) && !profileConnected(profile))
+	{
+		CpuScope scope(CPU_SUBSYS_SCAN);
+		k_mutex_lock(&pipelineLock, K_FOREVER);
+		currentStamps = &stamps;
+		updatePipelineConfig();
+		if (resync)
 		{
-			printk("[NOTIFICATION] data %p length %u\n", data, length);
+			// no rate from the counters of another sensor
+			resetStreams(SensorProfiles::streamsOf(profile));
 		}
+		type = SensorProfiles::process(profile, pipeline, data, length, boardTimeUs());
+		scheduleDeadline();
+		currentStamps = nullptr;
+		k_mutex_unlock(&pipelineLock);
 	}
-	else
+	if (type)
 	{
-		cntFirstHR = 0;
+		sim_report_rx(type);
 	}
 
-	return BT_GATT_ITER_CONTINUE;
+	// no connection, the handle is the index of the sensor in the allowlist
+	uint8_t kind = SensorProfiles::traceKindOf(profile);
+	trace_record(type ? kind : kind | TRACE_KIND_SKIPPED, k_cycle_get_32(), 0xff, sensor, data, length);
+}
+
+void DeviceManager::rideStatsCommand(const uint8_t *data, uint16_t length)
+{
+	uint8_t frames[RIDE_STATS_PAGES][RIDE_STATS_FRAME_LEN];
+	uint8_t lengths[RIDE_STATS_PAGES];
+
+	// the frames are encoded under the lock and sent after it
+	k_mutex_lock(&pipelineLock, K_FOREVER);
+	RideStats &stats = pipeline.stats();
+	if (data[0] == RX_RIDE_STATS_RESET)
+	{
+		if (length >= 2 && data[1] > 0)
+		{
+			stats.setHeartRateMax(data[1]);
+		}
+		stats.reset();
+	}
+	for (uint8_t page = 0; page < RIDE_STATS_PAGES; page++)
+	{
+		lengths[page] = stats.frame(page, frames[page]);
+	}
+	k_mutex_unlock(&pipelineLock);
+
+	for (uint8_t page = 0; page < RIDE_STATS_PAGES; page++)
+	{
+		data_service_send(frames[page], lengths[page]);
+	}
+}
+
+void DeviceManager::ingestScanTick(struct k_work *work)
+{
+#if defined(CONFIG_APP_ADV_INGEST)
+	k_delayed_work_submit(&ingestWork, K_MSEC(ADV_INGEST_REPEAT_MS));
+
+	// the DeviceManager stops the scan after the last subscription,
+	// -EALREADY when it is still running
+	if (subscriptionDone && adv_ingest_count() > 0)
+	{
+		bt_scan_start(BT_SCAN_TYPE_SCAN_PASSIVE);
+	}
+#endif
+}
+
+void DeviceManager::estimatorTick(struct k_work *work)
+{
+#if defined(CONFIG_APP_CSC_ESTIMATOR)
+	k_delayed_work_submit(&estimatorWork, K_MSEC(CONFIG_APP_CSC_ESTIMATOR_PERIOD_MS));
+
+	CpuScope scope(CPU_SUBSYS_CSC);
+	k_mutex_lock(&pipelineLock, K_FOREVER);
+	updatePipelineConfig();
+	pipeline.estimate(boardTimeUs());
+	k_mutex_unlock(&pipelineLock);
+#endif
+}
+
+void DeviceManager::deadlineTick(struct k_work *work)
+{
+	k_mutex_lock(&pipelineLock, K_FOREVER);
+	scheduledDeadline = SENSOR_WATCH_NEVER;
+	updatePipelineConfig();
+	pipeline.checkDeadlines(boardTimeUs());
+	scheduleDeadline();
+	k_mutex_unlock(&pipelineLock);
+}
+
+void DeviceManager::scheduleDeadline()
+{
+	uint64_t deadline = pipeline.nextDeadline();
+
+	if (deadline == scheduledDeadline)
+	{
+		return;
+	}
+	scheduledDeadline = deadline;
+	if (deadline == SENSOR_WATCH_NEVER)
+	{
+		k_delayed_work_cancel(&deadlineWork);
+		return;
+	}
+
+	uint64_t now = boardTimeUs();
+	k_delayed_work_submit(&deadlineWork, deadline > now ? K_USEC(deadline - now) : K_NO_WAIT);
+}
+
+void DeviceManager::pipelineOutput(uint8_t sensor, uint16_t value, uint64_t time, const uint8_t *frame, uint16_t len)
+{
+#if defined(CONFIG_APP_TIMELINE_STAMPS)
+	uint8_t stamped[12];
+#endif
+
+	switch (sensor)
+	{
+	case LATENCY_SENSOR_SPEED:
+		broadcast_set_speed(value);
+		ELOG2(SPEED, value, time / 1000);
+		break;
+	case LATENCY_SENSOR_CADENCE:
+		broadcast_set_cadence(value);
+		ELOG2(CADENCE, value, time / 1000);
+		break;
+	case LATENCY_SENSOR_HEARTRATE:
+		broadcast_set_heart_rate((uint8_t) value);
+		ELOG2(HEART_RATE, value, time / 1000);
+		break;
+	case LATENCY_SENSOR_POWER:
+		ELOG2(POWER, value, time / 1000);
+		break;
+	case PIPELINE_OUTPUT_HRV:
+		// derived from several samples -> no latency measurement
+		if (connectedPeripheral)
+		{
+			data_service_send(frame, len);
+		}
+		return;
+	case PIPELINE_OUTPUT_STATE:
+		// by time, not caused by a notification -> no latency measurement
+		ELOG2(SENSOR_STATE, frame[1], value);
+		if (connectedPeripheral)
+		{
+			data_service_send(frame, len);
+		}
+		return;
+	default:
+		break;
+	}
+
+#if defined(CONFIG_APP_TIMELINE_STAMPS)
+	// append the time on the board timeline in ms -> the application can
+	// correlate the values of all sensors
+	if (len + 4 <= sizeof(stamped))
+	{
+		memcpy(stamped, frame, len);
+		sys_put_le32((uint32_t) (time / 1000), &stamped[len]);
+		frame = stamped;
+		len += 4;
+	}
+#endif
+
+	if (connectedPeripheral && currentStamps != nullptr)
+	{
+		currentStamps->computed = latency_now();
+		currentStamps->sensor = sensor;
+		data_service_send_sample(frame, len, currentStamps, value);
+	}
+	else if (connectedPeripheral)
+	{
+		// estimated value, not caused by a notification -> no latency
+		data_service_send_sample(frame, len, NULL, value);
+	}
 }
 
 bool DeviceManager::checkAddresses(char addr1[],char addr2[])
@@ -1516,3 +1724,17 @@ bool DeviceManager::checkAddresses(char addr1[],char addr2[])
 	}
 	return retVal;
 }
+
+uint8_t DeviceManager::slotOf(char addr[])
+{
+	char *sensors[] = {sensor1, sensor2, sensor3};
+
+	for (uint8_t i = 0; i < nbrAddresses && i < ARRAY_SIZE(sensors); i++)
+	{
+		if (checkAddresses(addr, sensors[i]))
+		{
+			return i;
+		}
+	}
+	return SENSOR_PLAN_SLOTS;
+}
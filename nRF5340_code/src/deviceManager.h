@@ -16,14 +16,25 @@
  *--------------------------------------------------------------------------*/ 
 
 #include "Data.h"
-#include "DataService.h"
+#include "SensorPipeline.h"
+#include "dataService.h"
+#include "Broadcaster.h"
+#include "AdvertisingManager.h"
+#include "MotionClient.h"
+#include "SensorProfile.h"
+#include "AdvIngest.h"
+#include "DeviceInventory.h"
+#include "GattOps.h"
+#include "LinkMonitor.h"
 
 extern "C"
 {
     #include "BatteryManager.h"
 }
 
+#if defined(CONFIG_APP_LBS)
 #include <bluetooth/services/lbs.h>
+#endif
 #include <dk_buttons_and_leds.h>
 #include <settings/settings.h>
 #include <bluetooth/scan.h>
@@ -43,10 +54,9 @@ extern "C"
 
 #define USER_BUTTON             DK_BTN1_MSK
 
-// Thingy advertisement UUID 
-#define BT_UUID_THINGY                                                         \
-	BT_UUID_DECLARE_128(0x42, 0x00, 0x74, 0xA9, 0xFF, 0x52, 0x10, 0x9B,    \
-			    0x33, 0x49, 0x35, 0x9B, 0x00, 0x01, 0x68, 0xEF)
+// battery level of a sensor: first read after its first values, then periodically
+#define BATTERY_FIRST_READ_MS   2000
+#define BATTERY_READ_PERIOD_MS  60000
 
 // Thingy service UUID 
 #define BT_UUID_UI                                                         \
@@ -63,14 +73,15 @@ extern "C"
 	BT_UUID_DECLARE_128(0x42, 0x00, 0x74, 0xA9, 0xFF, 0x52, 0x10, 0x9B,    \
 			    0x33, 0x49, 0x35, 0x9B, 0x01, 0x03, 0x68, 0xEF)
 
-// Type definitions
-#define TYPE_CSC_SPEED 1
-#define TYPE_CSC_CADENCE 2
-#define TYPE_HEARTRATE 3
-#define TYPE_BATTERY 4
-
-// define maximum of central connections
-#define MAX_CONNECTIONS_CENTRAL 5
+// context of a connected sensor, a block of a memory slab (CONFIG_APP_SENSOR_LINKS),
+// the subscribe and read parameters are in its GATT link
+struct sensor_link
+{
+    struct bt_conn *conn;
+    uint8_t slot;       // 0 to 2 for sensor1 to sensor3, the sensor plan of its address
+    uint8_t profile;    // SENSOR_PROFILE_*
+    uint8_t type;       // TYPE_* of the BatteryManager
+};
 
 class DeviceManager {
 public:
@@ -82,6 +93,11 @@ public:
      */
     DeviceManager();
 
+    // roles of the board, chosen at build time (CONFIG_APP_ROLE_*),
+    // the code of a disabled role is removed by the compiler and the linker
+    static constexpr bool isCentral = !IS_ENABLED(CONFIG_APP_ROLE_PERIPHERAL);
+    static constexpr bool isPeripheral = !IS_ENABLED(CONFIG_APP_ROLE_CENTRAL);
+
    /**
     * @brief Get the Device object
     * 
@@ -90,55 +106,18 @@ public:
     *         2 when peripheral role
     *         1 when central role
     */
-    static uint8_t getDevice();
+    static constexpr uint8_t getDevice()
+    {
+        return (isCentral ? 1 : 0) + (isPeripheral ? 2 : 0);
+    }
 
     /**
-     * @brief setter:
-     *        set the attributes and call the associated init method
+     * @brief call the init methods of the roles of the build
      *        if it should be a central and peripheral, start with the initialitation
      *        of the peripheral and wait till the connection is etablished
      *        after that, start the initialitation of the central
-     * 
-     * @param c true = central role
-     * @param p true = peripheral role
-    */
-    void setDevice(bool c, bool p);
-
-/*---------------------------------------------------------------------------
- * public callback functions
- *--------------------------------------------------------------------------*/ 
-    /**
-     * @brief callback function, is called when discovery of the service is completed
-     * 
-     * @param dm holds the address of the connected device, user context and discover parameter        
-     * @param ctx context, not used in this case
-    */
-    static void discoveryCompletedCSC(struct bt_gatt_dm *dm, void *ctx);
-
-    /**
-     * @brief callback function, is called when service was not found
-     * 
-     * @param conn connection structure which does not include the service
-     * @param ctx context, not used in this case
-    */
-    static void discovery_service_not_found(struct bt_conn *conn, void *ctx);
-
-    /**
-     * @brief callback function, is called when an error occurs while discovering the service
-     * 
-     * @param conn connection structure which the error occurs
-     * @param err error code, 0 if success
-     * @param ctx context, not used in this case
     */
-    static void discovery_error_found(struct bt_conn *conn, int err, void *ctx);
-
-    /**
-     * @brief callback function, is called when discovery of the service is completed
-     * 
-     * @param dm holds the address of the connected device, user context and discover parameter
-     * @param ctx context, not used in this case
-     */
-    static void discoveryCompletedHR(struct bt_gatt_dm *dm, void *ctx);   
+    void start();
 
 private:
 /*---------------------------------------------------------------------------
@@ -162,7 +141,8 @@ private:
     static void disconnected(struct bt_conn *conn, uint8_t reason);
 
     /**
-     * @brief LE connection parameter update request
+     * @brief LE connection parameter update request, adjusted for a weak link
+     *        by the link monitor
      * 
      * @param conn the connection structure
      * @param param proposed connection parameters
@@ -182,6 +162,16 @@ private:
     static void le_param_updated(struct bt_conn *conn, uint16_t interval,
 				 uint16_t latency, uint16_t timeout);
 
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+    /**
+     * @brief the PHY of an LE connection has been updated
+     * 
+     * @param conn the connection structure
+     * @param param the new PHY
+     */
+    static void le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param);
+#endif
+
 /*--------------------------------------------------------------------------
  * methods for peripheral role
  *--------------------------------------------------------------------------*/
@@ -198,6 +188,7 @@ private:
     */
     static void startAdvertising();
 
+#if defined(CONFIG_APP_LBS)
     /**
      * @brief send notification that button state has changed
      * 
@@ -227,6 +218,7 @@ private:
      * @param led_state true led on, false led off
      */
     static void app_led_cb(bool led_state);
+#endif /* CONFIG_APP_LBS */
 
 /*---------------------------------------------------------------------------
  * methods for central role
@@ -253,13 +245,22 @@ private:
     /**
      * @brief start scanning after disconnect
      * 
-     * @param type of sensors which has disconnected
+     * @param profile SENSOR_PROFILE_* of the sensor which has disconnected
      */
-    static void reScan(uint8_t type);
+    static void reScan(uint8_t profile);
+
+    /**
+     * @brief add the service of a profile to the scan filters
+     * 
+     * @param profile SENSOR_PROFILE_*, nothing is added for SENSOR_PROFILE_NONE
+     * @return int error code, 0 if success
+     */
+    static int addScanFilter(uint8_t profile);
 
     /**
      * @brief callback function, is called when a device is found
-     *        used at the start befor scan with filters
+     *        used at the start befor scan with filters, starts the
+     *        scan with filters when the application sent its sensors
      * 
      * @param addr address of the found device
      * @param rssi rssi value of the found device in db
@@ -270,42 +271,90 @@ private:
                             struct net_buf_simple *ad);
     
     /**
-     * @brief start discovery process for the heart rate sensor
-     * 
-     */
-    static void discoverHR();
-
-    /**
-     * @brief start discovery process for the CSC sensors
+     * @brief start the GATT sequence of the last connected sensor: discovery and
+     *        subscription of its profile, discovery and read of its battery service
      * 
+     * @param sensor context of the sensor
      */
-    static void discoverCSC();
+    static void discover(struct sensor_link *sensor);
 
     /**
-     * @brief callback function, is called when new data is received over ble
+     * @brief callback function, is called when new data of a profile is received over ble
      * 
+     * @tparam P sensor profile (SensorProfile.h)
      * @param conn connection structure which sends the data
      * @param params subscribe parameter
      * @param data the received data
      * @param length the length of the received data
      * @return uint8_t value to continue
      */
-    static uint8_t notify_HR(struct bt_conn *conn,
+    template <typename P>
+    static uint8_t notify(struct bt_conn *conn,
 		struct bt_gatt_subscribe_params *params,
 		const void *data, uint16_t length);
 
     /**
-     * @brief callback function, is called when new data is received over ble
+     * @brief 16 bit UUIDs of a profile, in static memory for the scan filter and the discovery
      * 
-     * @param conn connection structure which sends the data
-     * @param params subscribe parameter, not used in this case
-     * @param data the received data
-     * @param length the length of the received data
-     * @return uint8_t value to continue
-    */    
-    static uint8_t onReceived(struct bt_conn *conn,
-			struct bt_gatt_subscribe_params *params,
-			const void *data, uint16_t length);
+     * @tparam P sensor profile (SensorProfile.h)
+     */
+    template <typename P>
+    static const struct bt_uuid *serviceUuid();
+    template <typename P>
+    static const struct bt_uuid *measurementUuid();
+
+    /**
+     * @brief steps of the GATT sequence (GattOps.h): the measurement characteristic
+     *        of a profile is prepared for the subscription, the battery level
+     *        characteristic for the read
+     * 
+     * @tparam P sensor profile (SensorProfile.h)
+     * @param link link of the sensor
+     * @param dm discovery data, released after the call
+     * @return int error code, 0 if success
+     */
+    template <typename P>
+    static int measurementFound(struct gatt_link *link, struct bt_gatt_dm *dm);
+    static const struct bt_uuid *batteryUuid();
+    static int batteryFound(struct gatt_link *link, struct bt_gatt_dm *dm);
+    static int batteryRead(struct gatt_link *link, struct bt_gatt_dm *dm);
+
+    /**
+     * @brief end of the GATT sequence of a sensor, a sensor without the service
+     *        of its profile is disconnected for another try
+     * 
+     * @tparam P sensor profile (SensorProfile.h)
+     * @param link link of the sensor
+     * @param err error code of the sequence, 0 if success
+     */
+    template <typename P>
+    static void linkFinished(struct gatt_link *link, int err);
+
+    /**
+     * @brief the last connected sensor is subscribed, inform the application 
+     *        and continue with the next sensor
+     * 
+     * @tparam P sensor profile (SensorProfile.h)
+     */
+    template <typename P>
+    static void subscribed();
+
+    // visitors of SensorProfiles, called with the profile of a sensor
+    struct ScanFilterVisitor
+    {
+        int err;
+
+        template <typename P>
+        void operator()(P profile);
+    };
+
+    struct DiscoverVisitor
+    {
+        struct gatt_link *link;
+
+        template <typename P>
+        void operator()(P profile);
+    };
 
     /**
      * @brief callback function, is called when a device with the applicable filter is found
@@ -343,30 +392,133 @@ private:
     */
     static bool checkAddresses(char addr1[],char addr2[]);
 
+    /**
+     * @brief slot of a sensor in the sensor plan, given by the address
+     *        of the application it matches (the connections drop and
+     *        come back in any order)
+     *
+     * @param addr address of the sensor
+     * @return uint8_t 0 for sensor1, 1 for sensor2, 2 for sensor3,
+     *         SENSOR_PLAN_SLOTS if none matches
+     */
+    static uint8_t slotOf(char addr[]);
+
+    /**
+     * @brief callback of the pipeline for a new value, sends it to the applications
+     *        and updates the broadcast
+     * 
+     * @param sensor LATENCY_SENSOR_* or PIPELINE_OUTPUT_HRV
+     * @param value computed value
+     * @param time time of the value on the board timeline in us
+     * @param frame frame for the application
+     * @param len length of the frame
+     */
+    static void pipelineOutput(uint8_t sensor, uint16_t value, uint64_t time, const uint8_t *frame, uint16_t len);
+
+    /**
+     * @brief board uptime for the sensor timeline
+     *
+     * @return uint64_t uptime in us
+     */
+    static uint64_t boardTimeUs();
+
+    /**
+     * @brief apply a new snapshot of the application settings to the pipeline,
+     *        only copied when its version changed, forget the state of the
+     *        metrics whose processing resumes and stop the watches of the
+     *        metrics no longer processed, pipelineLock must be held
+     */
+    static void updatePipelineConfig();
+
+    /**
+     * @brief forget the clocks and the estimated rates of metrics,
+     *        pipelineLock must be held
+     *
+     * @param streams STREAM_BIT() of the metrics
+     */
+    static void resetStreams(uint16_t streams);
+
+    /**
+     * @brief check if a connected sensor has a profile, its notifications
+     *        and the measurements of a broadcasting sensor of this profile
+     *        would be differenced against each other
+     *
+     * @param profile SENSOR_PROFILE_*
+     * @return true if a connected sensor has the profile
+     */
+    static bool profileConnected(uint8_t profile);
+
+    /**
+     * @brief measurement of an allowlisted broadcasting sensor, 
+     *        processed like a notification of its profile
+     * 
+     * @param profile SENSOR_PROFILE_* of the measurement
+     * @param data the measurement
+     * @param length the length of the measurement
+     * @param sensor index of the sensor in the allowlist
+     * @param resync true if the previous measurement of the profile is of
+     *               another sensor or too old
+     */
+    static void ingestMeasurement(uint8_t profile, const uint8_t *data, uint8_t length, uint8_t sensor,
+                                  bool resync);
+
+    /**
+     * @brief command RX_CMD_RIDE_STATS of the application: reset the
+     *        statistics of the ride if asked, then send all pages
+     * 
+     * @param data mode (RX_RIDE_STATS_*) and its parameters
+     * @param length the length of the data
+     */
+    static void rideStatsCommand(const uint8_t *data, uint16_t length);
+
+    /**
+     * @brief keeps the scan running for the broadcasting sensors
+     *        when all connected sensors are subscribed
+     * 
+     * @param work work item
+     */
+    static void ingestScanTick(struct k_work *work);
+
+    /**
+     * @brief sends the estimated speed and cadence every
+     *        CONFIG_APP_CSC_ESTIMATOR_PERIOD_MS
+     * 
+     * @param work work item
+     */
+    static void estimatorTick(struct k_work *work);
+
+    /**
+     * @brief applies the deadlines of the sensor values (SensorWatch.h)
+     *        and schedules itself at the next one
+     * 
+     * @param work work item
+     */
+    static void deadlineTick(struct k_work *work);
+
+    /**
+     * @brief schedule deadlineTick() at the next deadline of the pipeline,
+     *        called after every change of the pipeline, pipelineLock must be held
+     */
+    static void scheduleDeadline();
+
 private:    
     /*
      * private attributes 
      */
-    static bool isCentral;
-    static bool isPeripheral;
+#if defined(CONFIG_APP_LBS)
     static bool app_button_state;
+#endif
     static bool subscriptionDone;
-    static bool batterySubscriptionDone;
-    static bool diameterSet;
     static bool once_sensor1;
 	static bool once_sensor2;
     static bool once_sensor3;
-    static bool serviceNotFound;
     static bool reconnectedHeartRate;
     static bool peripheralDisconnected;
     static bool connectedPeripheral;
     static bool cscDisconnected;
     static bool hrDisconnected;
-    static bool disconnectOnce;
     static uint8_t nbrAddresses;
-    static uint8_t cntBatterySubscriptions;
     static uint8_t nbrConnectionsCentral;
-    static uint8_t cntFirstHR;
     /*
      * sensor infos has the following information about which sensors the user wants to connect:
      * 1 -> just one speed sensor 
@@ -376,6 +528,9 @@ private:
      * 5 -> one speed and one heart rate sensor
      * 6 -> one cadence and one heart rate sensor
      * 7 -> just one heart rate sensor
+     * 8 -> one power meter
+     * 9 -> one power meter and one heart rate sensor
+     * the profile of every sensor is given by sensor_plan()
      */
     static uint8_t sensorInfos;
 
@@ -390,17 +545,30 @@ private:
     // data struct scanning
     static const struct bt_data ad[];
 
-    // array of central connections
-    static struct bt_conn *centralConnections[MAX_CONNECTIONS_CENTRAL];
-
-    // peripheral connection, there is just one -> with the android application
-    static struct bt_conn *peripheralConn;
-
     // data object, containts all the received data with the calculate functions
     static Data data;
 
-    // array of subscribe parameters -> for every connection one parameter
-    static struct bt_gatt_subscribe_params subscribe_params[MAX_CONNECTIONS_CENTRAL];
+    // computation of the values for the application, portable for the host replay
+    static SensorPipeline pipeline;
+
+    // time stamps of the notification in process, used by pipelineOutput()
+    static struct latency_stamps *currentStamps;
+
+    // the pipeline is used by the notifications and by the estimator tick
+    static struct k_mutex pipelineLock;
+    // version of the settings used by the pipeline and by the scan
+    static uint32_t pipelineConfigVersion;
+    static uint32_t scanConfigVersion;
+    // metrics processed by the pipeline, see wantedStreams()
+    static uint16_t pipelineStreams;
+    static struct k_delayed_work estimatorWork;
+    static struct k_delayed_work deadlineWork;
+    static uint64_t scheduledDeadline;
+    static struct k_delayed_work ingestWork;
+
+    // context of every connected sensor, by the index of the connection,
+    // the order of the connections does not matter
+    static struct sensor_link *sensorOf[CONFIG_BT_MAX_CONN];
 
     // connection/disconnection callback structure
     struct bt_conn_cb conn_callbacks = {
@@ -408,13 +576,18 @@ private:
 		.disconnected = disconnected,
         .le_param_req = le_param_req,
         .le_param_updated = le_param_updated,
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+        .le_phy_updated = le_phy_updated,
+#endif
     };
 
+#if defined(CONFIG_APP_LBS)
     // led & button callback structure
     struct bt_lbs_cb lbs_callbacs = {
         .led_cb    = app_led_cb,
         .button_cb = app_button_cb,
     };
+#endif
 
     // connection authorize callback structure
     struct bt_conn_auth_cb conn_auth_callbacks = {};
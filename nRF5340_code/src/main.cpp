@@ -10,15 +10,21 @@
  * 
  */
 
-#include "DeviceManager.h"
+#include "deviceManager.h"
+#include "CpuStats.h"
+#include "Latency.h"
 
 void main(void)
 {
 
 	printk("Application start\n");
 
+	// cycle counter and thread sampling for the diagnostic service
+	cpu_stats_init();
+	latency_init();
+
 	// create a new device manager
 	DeviceManager dManager;
-	// start application as peripheral and central
-	dManager.setDevice(true,true);
+	// start the roles of the build (CONFIG_APP_ROLE_*)
+	dManager.start();
 } 	
\ No newline at end of file
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2021
+ *
+ * Checks the DSP kernels with the known answers of DspCheck.c and
+ * prints the time per sample. Exits with 1 if a kernel gives a wrong
+ * answer or a hash other than the expected one.
+ *
+ * usage: dsp_bench [repetitions]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Dsp.h"
+#include "DspCheck.h"
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	long repetitions = argc > 1 ? atol(argv[1]) : 2000;
+	volatile uint32_t sink = 0;
+	int failed = 0;
+
+	if (repetitions <= 0)
+	{
+		fprintf(stderr, "usage: %s [repetitions]\n", argv[0]);
+		return 1;
+	}
+
+	for (uint8_t k = 0; k < DSP_CHECK_KERNELS; k++)
+	{
+		uint32_t hash = dsp_check_run(k, DSP_CHECK_HASH_INIT);
+		int known = dsp_check_known(k);
+		double start = now_ns();
+
+		for (long r = 0; r < repetitions; r++)
+		{
+			sink += dsp_check_run(k, DSP_CHECK_HASH_INIT);
+		}
+		double ns = (now_ns() - start) / repetitions / DSP_CHECK_SAMPLES;
+
+		if (known > 0)
+		{
+			printf("%-8s %7.2f ns/sample, known answer %d WRONG\n", dsp_check_name(k), ns, known - 1);
+			failed = 1;
+		}
+		else if (known < 0)
+		{
+			printf("%-8s %7.2f ns/sample, hash %08x expected %08x MISMATCH\n", dsp_check_name(k), ns,
+			       hash, dsp_check_expected(k));
+			failed = 1;
+		}
+		else
+		{
+			printf("%-8s %7.2f ns/sample, hash %08x ok\n", dsp_check_name(k), ns, hash);
+		}
+	}
+	return failed;
+}
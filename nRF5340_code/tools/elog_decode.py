@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021
+#
+# Decoder for the binary event log (CONFIG_APP_ELOG_BINARY=y).
+# Reads the RTT console output, formats every "#EL" record with the
+# format strings of src/EventLogEvents.h and passes other lines through.
+#
+# usage: elog_decode.py [rtt_log.txt] [--events path/to/EventLogEvents.h]
+#                       [--cycles-per-sec 32768]
+#
+
+import argparse
+import os
+import re
+import sys
+
+EVENT_RE = re.compile(r'^\s*ELOG_EVENT\(\s*(\w+)\s*,\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+LEVELS = {
+    'ELOG_LEVEL_ERR': 'ERR',
+    'ELOG_LEVEL_WRN': 'WRN',
+    'ELOG_LEVEL_INF': 'INF',
+    'ELOG_LEVEL_DBG': 'DBG',
+}
+
+
+def load_events(path):
+    """Return the event table, the index is the event id."""
+    events = []
+    with open(path) as f:
+        for line in f:
+            m = EVENT_RE.match(line)
+            if m:
+                fmt = m.group(3).encode().decode('unicode_escape')
+                events.append((m.group(1), LEVELS.get(m.group(2), '?'), fmt))
+    return events
+
+
+def to_signed(value, spec):
+    if spec == 'd' and value & 0x80000000:
+        return value - (1 << 32)
+    return value
+
+
+def format_record(fmt, args):
+    """Apply a printk format to the raw 32 bit arguments."""
+    specs = re.findall(r'%[-0-9]*([udxXcsp%])', fmt)
+    values = []
+    for spec in specs:
+        if spec == '%':
+            continue
+        values.append(to_signed(args[len(values)] if len(values) < len(args) else 0, spec))
+    fmt = re.sub(r'%([-0-9]*)[p]', r'0x%\g<1>x', fmt)
+    try:
+        return fmt % tuple(values)
+    except (TypeError, ValueError):
+        return fmt + ' ' + ' '.join('0x%08x' % a for a in args)
+
+
+def main():
+    default_events = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                  '..', 'src', 'EventLogEvents.h')
+    parser = argparse.ArgumentParser(description='Decode the binary event log')
+    parser.add_argument('input', nargs='?', help='RTT log, stdin when omitted')
+    parser.add_argument('--events', default=default_events, help='event table')
+    parser.add_argument('--cycles-per-sec', type=int, default=32768,
+                        help='frequency of k_cycle_get_32()')
+    opts = parser.parse_args()
+
+    events = load_events(opts.events)
+    src = open(opts.input) if opts.input else sys.stdin
+
+    for line in src:
+        fields = line.split()
+        if len(fields) < 4 or fields[0] != '#EL':
+            sys.stdout.write(line)
+            continue
+        event_id = int(fields[1], 16)
+        nargs = int(fields[2], 16)
+        cycles = int(fields[3], 16)
+        args = [int(a, 16) for a in fields[4:4 + nargs]]
+        ms = cycles * 1000.0 / opts.cycles_per_sec
+        if event_id >= len(events):
+            print('[%10.3f ms] <unknown event %d> %s' % (ms, event_id, args))
+            continue
+        name, level, fmt = events[event_id]
+        print('[%10.3f ms] %s %-18s %s' % (ms, level, name, format_record(fmt, args)))
+
+
+if __name__ == '__main__':
+    main()
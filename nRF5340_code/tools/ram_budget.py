@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021
+#
+# RAM budget of the firmware per subsystem, generated from the linker map:
+# every input section in the SRAM region is counted for the object file it
+# comes from, the object files are grouped in subsystems. The pools of the
+# application are fixed slabs sized by Kconfig, so the budget of a build
+# with more sensors is known before it runs.
+#
+# usage: ram_budget.py zephyr.map [--objects]
+#        west build -t ram_budget
+#
+
+import os
+import re
+import sys
+
+# subsystem of the object files of the application, by source file name
+APP_SUBSYSTEMS = {
+    'main': 'app',
+    'dkstub': 'app',
+    'devicemanager': 'sensors',
+    'gattops': 'sensors',
+    'sensorpipeline': 'pipeline',
+    'sensorclock': 'pipeline',
+    'cscestimator': 'pipeline',
+    'hrvwindow': 'pipeline',
+    'powerwindow': 'pipeline',
+    'ridestats': 'pipeline',
+    'sensorwatch': 'pipeline',
+    'linkstats': 'sensors',
+    'linkmonitor': 'sensors',
+    'data': 'pipeline',
+    'dsp': 'pipeline',
+    'batterymanager': 'battery',
+    'dataservice': 'uplink',
+    'advertisingmanager': 'uplink',
+    'uplinkbench': 'uplink',
+    'broadcaster': 'broadcast',
+    'advingest': 'ingest',
+    'deviceinventory': 'inventory',
+    'motionclient': 'motion',
+    'motionfeatures': 'motion',
+    'eventlog': 'diag',
+    'tracerecorder': 'diag',
+    'cpustats': 'diag',
+    'diagservice': 'diag',
+    'latency': 'diag',
+    'simreport': 'diag',
+    'dspcheck': 'diag',
+}
+
+# subsystem of the libraries of Zephyr and NCS, first match of the path
+LIB_SUBSYSTEMS = [
+    ('bluetooth', 'bluetooth'),
+    ('gatt_dm', 'bluetooth'),
+    ('bas_client', 'bluetooth'),
+    ('lbs', 'bluetooth'),
+    ('libkernel', 'kernel'),
+    ('rpmsg', 'ipc'),
+    ('open-amp', 'ipc'),
+    ('libmetal', 'ipc'),
+    ('libc', 'libc'),
+    ('drivers', 'drivers'),
+    ('libgcc', 'toolchain'),
+]
+
+SECTION_ONLY = re.compile(r'^ (\S+)\s*$')
+SECTION_ENTRY = re.compile(r'^ (\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S.*))?$')
+WRAPPED_ENTRY = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S.*))?$')
+REGION = re.compile(r'^(\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)')
+
+
+def ram_region(lines):
+    """Return origin and length of the SRAM region of the memory configuration."""
+    for line in lines:
+        match = REGION.match(line)
+        if match and match.group(1) in ('SRAM', 'RAM'):
+            return int(match.group(2), 16), int(match.group(3), 16)
+    return None
+
+
+def input_sections(lines):
+    """Yield name, address, size and object file of every input section."""
+    started = False
+    pending = None
+    for line in lines:
+        if not started:
+            started = line.startswith('Linker script and memory map')
+            continue
+        if pending is not None:
+            match = WRAPPED_ENTRY.match(line)
+            if match:
+                yield pending, int(match.group(1), 16), int(match.group(2), 16), match.group(3) or ''
+            pending = None
+            continue
+        match = SECTION_ENTRY.match(line)
+        if match:
+            yield match.group(1), int(match.group(2), 16), int(match.group(3), 16), match.group(4) or ''
+            continue
+        match = SECTION_ONLY.match(line)
+        if match and not match.group(1).startswith('*('):
+            pending = match.group(1)
+
+
+def subsystem(section, obj):
+    """Subsystem of an input section."""
+    if 'kheap' in section:
+        # the system heap, only used by the discovery manager (bt_gatt_dm)
+        return 'heap'
+    if section == '*fill*' or not obj:
+        return 'padding'
+    if obj.startswith('app/'):
+        source = re.search(r'\(([^)]*)\)', obj)
+        name = source.group(1) if source else os.path.basename(obj)
+        name = name.split('.')[0].lower()
+        return APP_SUBSYSTEMS.get(name, 'app')
+    for pattern, name in LIB_SUBSYSTEMS:
+        if pattern in obj:
+            return name
+    return 'zephyr'
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith('--')]
+    objects = '--objects' in sys.argv
+    if len(args) != 1:
+        print('usage: ram_budget.py zephyr.map [--objects]', file=sys.stderr)
+        return 1
+
+    with open(args[0], errors='replace') as f:
+        lines = f.read().splitlines()
+
+    region = ram_region(lines)
+    if region is None:
+        print('no SRAM region in %s' % args[0], file=sys.stderr)
+        return 1
+    origin, length = region
+
+    totals = {}
+    per_object = {}
+    for section, address, size, obj in input_sections(lines):
+        if size == 0 or not origin <= address < origin + length:
+            continue
+        name = subsystem(section, obj)
+        totals[name] = totals.get(name, 0) + size
+        key = (name, obj or section)
+        per_object[key] = per_object.get(key, 0) + size
+
+    used = sum(totals.values())
+    print('%-12s %8s %7s' % ('subsystem', 'bytes', 'share'))
+    for name, size in sorted(totals.items(), key=lambda item: -item[1]):
+        print('%-12s %8u %6.1f %%' % (name, size, 100.0 * size / used))
+        if objects:
+            entries = [(o, s) for (n, o), s in per_object.items() if n == name]
+            for obj, size in sorted(entries, key=lambda item: -item[1]):
+                print('    %8u %s' % (size, obj))
+    print('%-12s %8u of %u bytes SRAM (%.1f %%)' % ('total', used, length, 100.0 * used / length))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
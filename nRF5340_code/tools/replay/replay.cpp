@@ -0,0 +1,242 @@
+/**
+ * @file    replay.cpp
+ * @author  Schwery Bastian (bastian98@gmx.ch)
+ * @brief   Host replay of a recorded notification trace through the same
+ *          processing code as the board (Data, SensorPipeline). Every
+ *          value for the application is printed with the time of the
+ *          notification in the trace, the run is as fast as possible.
+ * @version 0.1
+ * @date    2021-08
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/*---------------------------------------------------------------------------
+ * INCLUDES
+ *--------------------------------------------------------------------------*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "LinkStats.h"
+#include "SensorPipeline.h"
+#include "SensorProfile.h"
+#include "TraceRecorder.h"
+
+/*---------------------------------------------------------------------------
+ * GLOBAL VARIABLES
+ *--------------------------------------------------------------------------*/
+static const char *const sensorNames[LATENCY_SENSOR_COUNT] = {"speed", "cadence", "heartrate", "power"};
+
+static Data data;
+static SensorPipeline pipeline;
+
+// gaps of the notifications of every connection, like the link monitor of the board
+#define REPLAY_LINKS 8
+static LinkStats links[REPLAY_LINKS];
+static bool linkUsed[REPLAY_LINKS];
+
+// time of the record in process, in us since the start of the trace
+static uint64_t currentUs;
+static uint32_t outputs;
+
+static void output(uint8_t sensor, uint16_t value, uint64_t time, const uint8_t *frame, uint16_t len)
+{
+    printf("%llu.%03llu %s %u @%llu.%03llu", (unsigned long long) (currentUs / 1000),
+           (unsigned long long) (currentUs % 1000),
+           sensor < LATENCY_SENSOR_COUNT ? sensorNames[sensor] : sensor == PIPELINE_OUTPUT_HRV ? "hrv" :
+           sensor == PIPELINE_OUTPUT_STATE ? "state" : "?", value,
+           (unsigned long long) (time / 1000), (unsigned long long) (time % 1000));
+    for (uint16_t i = 0; i < len; i++)
+    {
+        printf("%s%02x", i == 0 ? " " : "", frame[i]);
+    }
+    printf("\n");
+    outputs++;
+}
+
+static int usage()
+{
+    fprintf(stderr, "usage: replay <trace.trc> [--realtime] [--hrv <beats>] [--estimate <ms>]\n");
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = nullptr;
+    bool realtime = false;
+    int hrvBeats = 0;
+    uint64_t estimatePeriod = 0;
+    uint64_t nextEstimate = 0;
+    uint8_t header[12];
+    uint8_t record[TRACE_HEADER_SIZE + TRACE_MAX_PAYLOAD];
+    uint32_t cyclesPerSec;
+    uint32_t records = 0;
+    uint32_t skipped = 0;
+    uint32_t lastCycles = 0;
+    uint64_t cycles = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--realtime") == 0)
+        {
+            realtime = true;
+        }
+        else if (strcmp(argv[i], "--hrv") == 0 && i + 1 < argc)
+        {
+            // like CONFIG_APP_HRV_UPLINK_BEATS
+            hrvBeats = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--estimate") == 0 && i + 1 < argc)
+        {
+            // like CONFIG_APP_CSC_ESTIMATOR_PERIOD_MS
+            estimatePeriod = (uint64_t) atoi(argv[++i]) * 1000;
+        }
+        else if (path == nullptr)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            return usage();
+        }
+    }
+    if (path == nullptr)
+    {
+        return usage();
+    }
+
+    FILE *trace = fopen(path, "rb");
+    if (trace == nullptr)
+    {
+        perror(path);
+        return 1;
+    }
+    if (fread(header, 1, sizeof(header), trace) != sizeof(header) || memcmp(header, "PCTR", 4) != 0 || header[4] != 1)
+    {
+        fprintf(stderr, "%s is not a trace of version 1\n", path);
+        return 1;
+    }
+    cyclesPerSec = sys_get_le32(&header[8]);
+
+    pipeline.init(&data, output);
+    for (uint8_t i = 0; i < REPLAY_LINKS; i++)
+    {
+        links[i].reset();
+    }
+    pipeline.setHrvUplink((uint8_t) hrvBeats);
+    pipeline.setEstimator(estimatePeriod > 0);
+    auto start = std::chrono::steady_clock::now();
+
+    while (fread(record, 1, TRACE_HEADER_SIZE, trace) == TRACE_HEADER_SIZE)
+    {
+        uint8_t len = record[8];
+        const uint8_t *payload = &record[TRACE_HEADER_SIZE];
+
+        if (len > TRACE_MAX_PAYLOAD || fread(&record[TRACE_HEADER_SIZE], 1, len, trace) != len)
+        {
+            fprintf(stderr, "truncated record %u\n", records);
+            break;
+        }
+
+        // 32 bit cycle counter of the board -> 64 bit
+        uint32_t now = sys_get_le32(record);
+        if (records == 0)
+        {
+            lastCycles = now;
+        }
+        cycles += (uint32_t) (now - lastCycles);
+        lastCycles = now;
+        uint64_t recordUs = cycles * 1000000 / cyclesPerSec;
+        records++;
+
+        // estimator ticks and deadlines of the sensors before this record, in time order
+        while (true)
+        {
+            uint64_t deadline = pipeline.nextDeadline();
+            bool estimate = estimatePeriod > 0 && nextEstimate <= recordUs && nextEstimate <= deadline;
+
+            if (estimate)
+            {
+                currentUs = nextEstimate;
+                pipeline.estimate(nextEstimate);
+                nextEstimate += estimatePeriod;
+            }
+            else if (deadline <= recordUs)
+            {
+                currentUs = deadline;
+                pipeline.checkDeadlines(deadline);
+            }
+            else
+            {
+                break;
+            }
+        }
+        currentUs = recordUs;
+
+        if (realtime)
+        {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(currentUs));
+        }
+
+        // every notification, also the skipped ones, for the gaps of its connection
+        uint8_t kind = record[4] & ~TRACE_KIND_SKIPPED;
+        if (record[5] < REPLAY_LINKS && kind != TRACE_KIND_DIAMETER)
+        {
+            linkUsed[record[5]] = true;
+            if (kind == TRACE_KIND_CSC)
+            {
+                links[record[5]].notifiedCsc(payload, len, currentUs);
+            }
+            else
+            {
+                links[record[5]].notified(currentUs, LINK_ACTIVE_ALWAYS);
+            }
+        }
+
+        // notifications of the sensors -> profile of the record
+        bool notification = SensorProfiles::visitTraceKind(record[4], [&](auto profile) {
+            decltype(profile)::process(pipeline, payload, len, currentUs);
+        });
+        if (notification)
+        {
+            continue;
+        }
+
+        if (record[4] == TRACE_KIND_DIAMETER && len >= 1)
+        {
+            pipeline.setDiameter(SensorPipeline::diameterFromCode(payload[0]));
+        }
+        else if (record[4] != TRACE_KIND_DIAMETER)
+        {
+            // not processed on the board either
+            skipped++;
+        }
+    }
+    fclose(trace);
+
+    double hostSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double traceSeconds = currentUs / 1e6;
+    fprintf(stderr, "%u records (%u skipped), %u outputs, trace %.1f s, replay %.3f s (%.0fx real time)\n",
+            records, skipped, outputs, traceSeconds, hostSeconds,
+            hostSeconds > 0 ? traceSeconds / hostSeconds : 0.0);
+
+    const RideStats &stats = pipeline.stats();
+    fprintf(stderr, "ride %u m, moving %u of %u s, speed %u/%u, cadence %u/%u, heart rate %u/%u, power %u/%u (avg/max)\n",
+            stats.distanceM(), stats.movingS(), stats.elapsedS(), stats.averageSpeed(), stats.maxSpeed(),
+            stats.averageCadence(), stats.maxCadence(), stats.averageHeartRate(), stats.maxHeartRate(),
+            stats.averagePower(), stats.maxPower());
+    for (uint8_t i = 0; i < REPLAY_LINKS; i++)
+    {
+        if (linkUsed[i])
+        {
+            fprintf(stderr, "link %u: %u received, %u lost in %u gaps (longest %u ms), period %u us\n", i,
+                    links[i].received(), links[i].lost(), links[i].gaps(), links[i].longestGapMs(),
+                    links[i].periodUs());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+/*
+ * Host replacement of <zephyr/types.h> for tools/replay
+ */
+
+#ifndef SHIM_ZEPHYR_TYPES_H_
+#define SHIM_ZEPHYR_TYPES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#endif /* SHIM_ZEPHYR_TYPES_H_ */
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021
+#
+# Aggregates the "#SIM" lines of a BabbleSim fleet run (sim/run_fleet.sh)
+# into one JSON document: throughput, drops and time to connect.
+#
+# usage: sim_report.py hub.log sensor_0.log [sensor_1.log ...]
+#
+
+import json
+import sys
+
+# index of the profiles in the "rx" array of the board
+PROFILES = ['csc_speed', 'csc_cadence', 'hrs']
+
+
+def last_records(path, kind):
+    """Return the last record of every device of a kind in a log, by address."""
+    records = {}
+    with open(path, errors='replace') as f:
+        for line in f:
+            prefix = '#SIM %s ' % kind
+            pos = line.find(prefix)
+            if pos < 0:
+                continue
+            try:
+                record = json.loads(line[pos + len(prefix):])
+            except ValueError:
+                continue
+            records[record.get('addr', kind)] = record
+    return records
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('usage: sim_report.py hub.log sensor_0.log [sensor_1.log ...]', file=sys.stderr)
+        return 1
+
+    hub = last_records(sys.argv[1], 'hub').get('hub')
+    if hub is None:
+        print('no report of the board in %s' % sys.argv[1], file=sys.stderr)
+        return 1
+
+    sensors = []
+    for path in sys.argv[2:]:
+        sensors.extend(last_records(path, 'sensor').values())
+
+    seconds = hub['t_ms'] / 1000.0 if hub['t_ms'] else 1.0
+    profiles = {}
+    for i, name in enumerate(PROFILES):
+        sent = sum(s['sent'] for s in sensors if s['profile'] == name)
+        received = hub['rx'][i]
+        profiles[name] = {
+            'sent': sent,
+            'received': received,
+            'dropped': max(sent - received, 0),
+            'rate_hz': round(received / seconds, 2),
+        }
+
+    report = {
+        'duration_ms': hub['t_ms'],
+        'profiles': profiles,
+        'sensor_connects': hub['connects'],
+        'sensor_disconnects': hub['disconnects'],
+        'ttc_max_ms': hub['ttc_max_ms'],
+        'sensors': sorted(sensors, key=lambda s: s['addr']),
+    }
+    print(json.dumps(report, indent=2, sort_keys=True))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
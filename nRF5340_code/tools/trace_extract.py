@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021
+#
+# Converts the "#TR" lines of a console log (CONFIG_APP_TRACE=y, board RTT
+# or simulation) into a binary trace file for tools/replay.
+#
+# trace file, little endian:
+#   "PCTR", version (1), 3 reserved bytes, cycles per second (4),
+#   followed by the records of src/TraceRecorder.h
+#
+# usage: trace_extract.py console.log out.trc [--cycles-per-sec 32768]
+#
+
+import argparse
+import struct
+import sys
+
+MAGIC = b'PCTR'
+VERSION = 1
+HEADER_SIZE = 9
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Extract the binary trace of a console log')
+    parser.add_argument('log')
+    parser.add_argument('trace')
+    parser.add_argument('--cycles-per-sec', type=int, default=32768,
+                        help='frequency of k_cycle_get_32() on the board')
+    args = parser.parse_args()
+
+    records = 0
+    dropped = 0
+    with open(args.log, errors='replace') as log, open(args.trace, 'wb') as out:
+        out.write(MAGIC + struct.pack('<B3xI', VERSION, args.cycles_per_sec))
+        for line in log:
+            pos = line.find('#TR')
+            if pos < 0:
+                continue
+            fields = line[pos:].split()
+            if fields[0] == '#TR-DROP' and len(fields) > 1:
+                dropped += int(fields[1])
+                continue
+            if fields[0] != '#TR' or len(fields) < 2:
+                continue
+            try:
+                record = bytes.fromhex(fields[1])
+            except ValueError:
+                continue
+            # incomplete lines of an interrupted log
+            if len(record) < HEADER_SIZE or len(record) != HEADER_SIZE + record[8]:
+                continue
+            out.write(record)
+            records += 1
+
+    print('%d records, %d dropped on the board' % (records, dropped), file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())